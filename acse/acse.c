@@ -7,15 +7,23 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "list.h"
 #include "target_info.h"
 #include "program.h"
 #include "target_asm_print.h"
+#include "target_obj_print.h"
 #include "target_transform.h"
 #include "cfg.h"
 #include "reg_alloc.h"
+#include "optimizations.h"
+#include "pass_manager.h"
+#include "string_map.h"
+#include "arena.h"
 #include "parser.h"
 #include "errors.h"
+#include "timing.h"
+#include "cache.h"
 
 // This constant is generated by the Makefile.
 extern const char *acseVersion;
@@ -46,6 +54,117 @@ char *getLogFileName(const char *logType, const char *fn)
 }
 
 
+static t_analysisSet fixPseudoInstructionsPass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  fixPseudoInstructions(program);
+  return ANALYSIS_NONE;
+}
+
+static t_analysisSet fixSyscallsPass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  fixSyscalls(program);
+  return ANALYSIS_NONE;
+}
+
+static t_analysisSet fixUnsupportedImmediatesPass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  fixUnsupportedImmediates(program);
+  return ANALYSIS_NONE;
+}
+
+static t_analysisSet removeUnreachableCodePass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  if (removeUnreachableCode(program, pmGetDominators(pm)))
+    return ANALYSIS_NONE;
+  return ANALYSIS_ALL;
+}
+
+static t_analysisSet removeDeadCodePass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  // Repeat until no more instructions become dead.
+  while (removeDeadCode(program, pmGetLiveness(pm)))
+    pmInvalidate(pm, ANALYSIS_NONE);
+  return ANALYSIS_ALL;
+}
+
+static t_analysisSet regAllocPass(
+    t_passManager *pm, t_program *program, void *context)
+{
+#ifndef NDEBUG
+  const char *outputFn = (const char *)context;
+  char *logFn;
+  FILE *logFp;
+#endif
+  t_cfg *graph = pmGetLiveness(pm);
+#ifndef NDEBUG
+  timingStart("debug-logs");
+  logFn = getLogFileName("controlFlow", outputFn);
+  logFp = fopen(logFn, "w");
+  if (logFp) {
+    fprintf(stderr, " -> Writing the control flow graph to \"%s\"\n", logFn);
+    cfgDump(graph, logFp, true);
+    fclose(logFp);
+  }
+  free(logFn);
+  timingStop();
+#endif
+  t_regAllocator *regAlloc = newRegAllocator(program, graph);
+  regallocRun(regAlloc);
+#ifndef NDEBUG
+  timingStart("debug-logs");
+  logFn = getLogFileName("regAlloc", outputFn);
+  logFp = fopen(logFn, "w");
+  if (logFp) {
+    fprintf(stderr, " -> Writing the register bindings to \"%s\"\n", logFn);
+    regallocDump(regAlloc, logFp);
+    fclose(logFp);
+  }
+  free(logFn);
+  timingStop();
+#endif
+  deleteRegAllocator(regAlloc);
+  return ANALYSIS_NONE;
+}
+
+static t_analysisSet removeRedundantCopiesPass(
+    t_passManager *pm, t_program *program, void *context)
+{
+  if (removeRedundantCopies(program))
+    return ANALYSIS_NONE;
+  return ANALYSIS_ALL;
+}
+
+/* Adds the passes run after parsing for the given optimization level. */
+void addPasses(t_passManager *pm, int optLevel, char *outputFn)
+{
+  // Exit system calls are lost by the lowering, so unreachable code is found
+  // before it.
+  if (optLevel >= 2) {
+    pmAddPass(pm, "remove-unreachable-code", "Removing unreachable code.",
+        removeUnreachableCodePass, NULL);
+    pmAddPass(pm, "remove-dead-code", "Removing dead code.",
+        removeDeadCodePass, NULL);
+  }
+  pmAddPass(pm, "fix-pseudo-instructions",
+      "Lowering of pseudo-instructions to machine instructions.",
+      fixPseudoInstructionsPass, NULL);
+  pmAddPass(pm, "fix-syscalls", NULL, fixSyscallsPass, NULL);
+  pmAddPass(pm, "fix-unsupported-immediates", NULL,
+      fixUnsupportedImmediatesPass, NULL);
+  pmAddPass(pm, "register-allocation", "Performing register allocation.",
+      regAllocPass, outputFn);
+  if (optLevel >= 1) {
+    pmAddPass(pm, "remove-redundant-copies", "Removing redundant copies.",
+        removeRedundantCopiesPass, NULL);
+  }
+}
+
+
 void banner(void)
 {
   printf("ACSE %s compiler, (c) 2008-24 Politecnico di Milano\n", TARGET_NAME);
@@ -60,33 +179,276 @@ void version(void)
 void usage(const char *name)
 {
   banner();
-  printf("usage: %s [options] input\n\n", name);
+  printf("usage: %s [options] input...\n\n", name);
   puts("Options:");
   puts("  -o ASMFILE    Name the output ASMFILE (default output.asm)");
+  puts("  -o DIR/       With several inputs, write the output of each one");
+  puts("                to DIR/NAME.s (default ./NAME.s)");
+  puts("  -c            Write an executable ELF file instead of assembly");
+  puts("                code, named output.o or DIR/NAME.o by default");
+  puts("  -j N          Compile up to N inputs in parallel (default 1)");
+  puts("  -O LEVEL      Optimization level: 0 (default), 1 or 2; -O means -O1");
+  puts("  --cache-dir=DIR");
+  puts("                Reuse the outputs of previous compilations of the");
+  puts("                same sources, kept in DIR");
+  puts("  --cache-size=MIB");
+  puts("                Maximum size of the cache (default 256 MiB)");
+  puts("  --time-passes[=json]");
+  puts("                Report the time and memory used by each phase");
   puts("  -v, --version Display version number");
   puts("  -h, --help    Displays available options");
 }
 
-int main(int argc, char *argv[])
+
+/// Options of the compilation of a file.
+typedef struct {
+  int optLevel;          ///< The optimization level.
+  bool timingJSON;       ///< Whether to print the --time-passes report as JSON.
+  bool emitObject;       ///< Whether to write an ELF file instead of assembly.
+  const char *cacheDir;  ///< The directory of the cache, or NULL if none.
+  size_t cacheMaxBytes;  ///< The maximum size of the cache.
+  /// Everything besides the source the output depends on, for the cache.
+  const char *cacheConfig;
+} t_compileOptions;
+
+/* Compiles a source file to an assembly file, or to an executable file.
+ * Returns whether the compilation succeeded. */
+static bool compile(
+    char *inputFn, char *outputFn, const t_compileOptions *options)
 {
-  char *name = argv[0];
-  int ch, res = 0;
 #ifndef NDEBUG
   char *logFn;
   FILE *logFp;
 #endif
+  bool res = false;
+  t_program *program = NULL;
+  t_cacheKey *cacheKey = NULL;
+
+  if (options->cacheDir) {
+    timingStart("cache-lookup");
+    cacheKey = newCacheKey(options->cacheDir, inputFn, options->cacheConfig);
+    res = cacheKey && cacheFetch(cacheKey, outputFn);
+    timingStop();
+    if (res) {
+#ifndef NDEBUG
+      fprintf(stderr, "Copied the output of \"%s\" from the cache to \"%s\"\n",
+          inputFn, outputFn);
+#endif
+      goto end;
+    }
+  }
+
+#ifndef NDEBUG
+  fprintf(stderr, "Parsing the input program\n");
+  fprintf(stderr, " -> Reading input from \"%s\"\n", inputFn);
+#endif
+  timingStart("parse");
+  program = parseProgram(inputFn);
+  if (program) {
+    timingSetCounter(TIMING_INSTRUCTIONS, program->instructions.length);
+    timingSetCounter(TIMING_TEMPORARIES, program->firstUnusedReg);
+  }
+  timingStop();
+  if (!program)
+    goto end;
+#ifndef NDEBUG
+  timingStart("debug-logs");
+  logFn = getLogFileName("frontend", outputFn);
+  logFp = fopen(logFn, "w");
+  if (logFp) {
+    fprintf(stderr, " -> Writing the output of parsing to \"%s\"\n", logFn);
+    programDump(program, logFp);
+    fclose(logFp);
+  }
+  free(logFn);
+  timingStop();
+#endif
+
+  t_passManager *pm = newPassManager(program);
+  addPasses(pm, options->optLevel, outputFn);
+  pmRun(pm);
+  deletePassManager(pm);
+
+#ifndef NDEBUG
+  if (options->emitObject)
+    fprintf(stderr, "Writing the executable file.\n");
+  else
+    fprintf(stderr, "Writing the assembly file.\n");
+  fprintf(stderr, " -> Output file name: \"%s\"\n", outputFn);
+  fprintf(stderr, " -> Code segment size: %d instructions\n",
+      program->instructions.length);
+  fprintf(stderr, " -> Data segment size: %d elements\n",
+      program->symbols.length);
+  fprintf(stderr, " -> Number of labels: %d\n", program->labels.length);
+#endif
+  // writeObject() reports its own errors, which are not only about writing
+  // the output file.
+  bool ok;
+  if (options->emitObject) {
+    timingStart("write-object");
+    ok = writeObject(program, outputFn);
+  } else {
+    timingStart("write-assembly");
+    ok = writeAssembly(program, outputFn);
+    if (!ok)
+      emitError(nullFileLocation, "could not write output file \"%s\"",
+          outputFn);
+  }
+  timingStop();
+  if (!ok)
+    goto end;
+  if (cacheKey) {
+    timingStart("cache-store");
+    cacheStore(cacheKey, outputFn, options->cacheMaxBytes);
+    timingStop();
+  }
+
+  res = true;
+end:
+  deleteCacheKey(cacheKey);
+  deleteProgram(program);
+  timingReport(stderr, options->timingJSON, inputFn);
+  return res;
+}
+
+
+/* Returns the name of the output file of a source file compiled in the given
+ * directory: the name of the source file without its directory and its
+ * extension, followed by the given extension. */
+static char *getOutputFileName(
+    const char *dir, const char *inputFn, const char *outExt)
+{
+  const char *base = strrchr(inputFn, '/');
+  base = base ? base + 1 : inputFn;
+  const char *ext = strrchr(base, '.');
+  int baseLen = ext && ext != base ? (int)(ext - base) : (int)strlen(base);
+
+  size_t nameLen = strlen(dir) + (size_t)baseLen + strlen(outExt) + 1;
+  char *outfn = malloc(nameLen);
+  if (!outfn)
+    fatalError("out of memory");
+  snprintf(outfn, nameLen, "%s%.*s%s", dir, baseLen, base, outExt);
+  return outfn;
+}
+
+/// A set of files compiled in parallel by a pool of threads.
+typedef struct {
+  char **inputs;   ///< The names of the source files.
+  char **outputs;  ///< The names of the output files.
+  int numFiles;    ///< The number of files.
+  const t_compileOptions *options; ///< The options of the compilation.
+  int nextFile;    ///< The next file to compile, taken atomically.
+  int numFailed;   ///< The number of failed compilations, updated atomically.
+} t_batch;
+
+/* Thread function compiling the files of a batch until none is left. */
+static void *batchThread(void *arg)
+{
+  t_batch *batch = (t_batch *)arg;
+  for (;;) {
+    int i = __atomic_fetch_add(&batch->nextFile, 1, __ATOMIC_RELAXED);
+    if (i >= batch->numFiles)
+      break;
+    if (!compile(batch->inputs[i], batch->outputs[i], batch->options))
+      __atomic_fetch_add(&batch->numFailed, 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+/* Compiles several files with the given number of threads. Returns the
+ * number of failed compilations. */
+static int compileBatch(t_batch *batch, int numThreads)
+{
+  if (numThreads > batch->numFiles)
+    numThreads = batch->numFiles;
+  pthread_t *threads = malloc(sizeof(pthread_t) * (size_t)numThreads);
+  if (!threads)
+    fatalError("out of memory");
+
+  // The calling thread works as well, after starting the other ones.
+  int numStarted = 0;
+  for (; numStarted < numThreads - 1; numStarted++) {
+    if (pthread_create(&threads[numStarted], NULL, batchThread, batch) != 0)
+      break;
+  }
+  batchThread(batch);
+  for (int i = 0; i < numStarted; i++)
+    pthread_join(threads[i], NULL);
+
+  free(threads);
+  return batch->numFailed;
+}
+
+
+int main(int argc, char *argv[])
+{
+  char *name = argv[0];
+  int ch;
   static const struct option options[] = {
-      {   "help", no_argument, NULL, 'h'},
-      {"version", no_argument, NULL, 'v'},
+      {       "help",       no_argument, NULL, 'h'},
+      {    "version",       no_argument, NULL, 'v'},
+      {"time-passes", optional_argument, NULL, 'T'},
+      {  "cache-dir", required_argument, NULL, 'C'},
+      { "cache-size", required_argument, NULL, 'S'},
+      {         NULL,                 0, NULL,   0},
   };
 
-  char *outputFn = "output.asm";
+  char *outputFn = NULL;
+  int numThreads = 1;
+  t_compileOptions compileOptions = {0, false, false, NULL, 256 << 20, NULL};
 
-  while ((ch = getopt_long(argc, argv, "ho:v", options, NULL)) != -1) {
+  while ((ch = getopt_long(argc, argv, "chj:o:O::v", options, NULL)) != -1) {
     switch (ch) {
+      case 'c':
+        compileOptions.emitObject = true;
+        break;
       case 'o':
         outputFn = optarg;
         break;
+      case 'j': {
+        char *end;
+        long n = strtol(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0' || n < 1 || n > 1024) {
+          emitError(nullFileLocation, "invalid number of jobs '%s'", optarg);
+          return 1;
+        }
+        numThreads = (int)n;
+        break;
+      }
+      case 'O':
+        if (optarg == NULL) {
+          compileOptions.optLevel = 1;
+        } else if (strlen(optarg) == 1 && optarg[0] >= '0' &&
+            optarg[0] <= '2') {
+          compileOptions.optLevel = optarg[0] - '0';
+        } else {
+          emitError(
+              nullFileLocation, "invalid optimization level '%s'", optarg);
+          return 1;
+        }
+        break;
+      case 'C':
+        compileOptions.cacheDir = optarg;
+        break;
+      case 'S': {
+        char *end;
+        long n = strtol(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0' || n < 1 || n > (1L << 20)) {
+          emitError(nullFileLocation, "invalid cache size '%s'", optarg);
+          return 1;
+        }
+        compileOptions.cacheMaxBytes = (size_t)n << 20;
+        break;
+      }
+      case 'T':
+        if (optarg != NULL && strcmp(optarg, "json") != 0) {
+          emitError(nullFileLocation,
+              "invalid argument '%s' for --time-passes", optarg);
+          return 1;
+        }
+        timingEnable();
+        compileOptions.timingJSON = optarg != NULL;
+        break;
       case 'h':
         usage(name);
         return 1;
@@ -104,9 +466,6 @@ int main(int argc, char *argv[])
   if (argc < 1) {
     usage(name);
     return 1;
-  } else if (argc > 1) {
-    emitError(nullFileLocation, "cannot assemble more than one file");
-    return 1;
   }
 
 #ifndef NDEBUG
@@ -114,77 +473,65 @@ int main(int argc, char *argv[])
   printf("\n");
 #endif
 
-  res = 1;
+  char cacheConfig[256];
+  snprintf(cacheConfig, sizeof(cacheConfig), "acse %s target %s -O%d%s",
+      acseVersion, TARGET_NAME, compileOptions.optLevel,
+      compileOptions.emitObject ? " -c" : "");
+  compileOptions.cacheConfig = cacheConfig;
 
+  // With a single input, the output is the file given by -o unless it names
+  // a directory.
+  size_t outputLen = outputFn ? strlen(outputFn) : 0;
+  bool outputIsDir = outputLen > 0 && outputFn[outputLen - 1] == '/';
+  if (argc == 1 && !outputIsDir) {
+    if (!outputFn)
+      outputFn = compileOptions.emitObject ? "output.o" : "output.asm";
+    bool ok = compile(argv[0], outputFn, &compileOptions);
 #ifndef NDEBUG
-  fprintf(stderr, "Parsing the input program\n");
-  fprintf(stderr, " -> Reading input from \"%s\"\n", argv[0]);
+    fprintf(stderr, "Finished.\n");
 #endif
-  t_program *program = parseProgram(argv[0]);
-  if (!program)
-    goto fail;
-#ifndef NDEBUG
-  logFn = getLogFileName("frontend", outputFn);
-  logFp = fopen(logFn, "w");
-  if (logFp) {
-    fprintf(stderr, " -> Writing the output of parsing to \"%s\"\n", logFn);
-    programDump(program, logFp);
-    fclose(logFp);
+    return ok ? 0 : 1;
   }
-  free(logFn);
-#endif
-
-#ifndef NDEBUG
-  fprintf(stderr, "Lowering of pseudo-instructions to machine instructions.\n");
-#endif
-  doTargetSpecificTransformations(program);
 
-#ifndef NDEBUG
-  fprintf(stderr, "Performing register allocation.\n");
-  logFn = getLogFileName("controlFlow", outputFn);
-  logFp = fopen(logFn, "w");
-  if (logFp) {
-    fprintf(stderr, " -> Writing the control flow graph to \"%s\"\n", logFn);
-    t_cfg *cfg = programToCFG(program);
-    cfgComputeLiveness(cfg);
-    cfgDump(cfg, logFp, true);
-    deleteCFG(cfg);
-    fclose(logFp);
-  }
-  free(logFn);
-#endif
-  t_regAllocator *regAlloc = newRegAllocator(program);
-  regallocRun(regAlloc);
-#ifndef NDEBUG
-  logFn = getLogFileName("regAlloc", outputFn);
-  logFp = fopen(logFn, "w");
-  if (logFp) {
-    fprintf(stderr, " -> Writing the register bindings to \"%s\"\n", logFn);
-    regallocDump(regAlloc, logFp);
-    fclose(logFp);
+  // Otherwise every input has its own output file in the directory.
+  char *outputDir = "";
+  if (outputFn && outputIsDir) {
+    outputDir = outputFn;
+  } else if (outputFn) {
+    emitError(nullFileLocation,
+        "the output must be a directory ending with '/' when compiling more "
+        "than one file");
+    return 1;
   }
-  free(logFn);
-#endif
-  deleteRegAllocator(regAlloc);
 
-#ifndef NDEBUG
-  fprintf(stderr, "Writing the assembly file.\n");
-  fprintf(stderr, " -> Output file name: \"%s\"\n", outputFn);
-  fprintf(stderr, " -> Code segment size: %d instructions\n",
-      listLength(program->instructions));
-  fprintf(stderr, " -> Data segment size: %d elements\n",
-      listLength(program->symbols));
-  fprintf(stderr, " -> Number of labels: %d\n", listLength(program->labels));
-#endif
-  bool ok = writeAssembly(program, outputFn);
-  if (!ok) {
-    emitError(nullFileLocation, "could not write output file");
-    goto fail;
+  t_batch batch = {argv, NULL, argc, &compileOptions, 0, 0};
+  batch.outputs = malloc(sizeof(char *) * (size_t)argc);
+  if (!batch.outputs)
+    fatalError("out of memory");
+  t_arena *arena = newArena();
+  t_stringMap inputsByOutput;
+  stringMapInit(&inputsByOutput, arena);
+  int res = 0;
+  for (int i = 0; i < argc; i++) {
+    batch.outputs[i] = getOutputFileName(
+        outputDir, argv[i], compileOptions.emitObject ? ".o" : ".s");
+    char *otherInput = stringMapGet(&inputsByOutput, batch.outputs[i]);
+    if (otherInput) {
+      emitError(nullFileLocation, "\"%s\" and \"%s\" would both be compiled "
+          "to \"%s\"", otherInput, argv[i], batch.outputs[i]);
+      res = 1;
+    }
+    stringMapSet(&inputsByOutput, batch.outputs[i], argv[i]);
   }
+  stringMapClear(&inputsByOutput);
+  deleteArena(arena);
 
-  res = 0;
-fail:
-  deleteProgram(program);
+  if (res == 0 && compileBatch(&batch, numThreads) > 0)
+    res = 1;
+
+  for (int i = 0; i < argc; i++)
+    free(batch.outputs[i]);
+  free(batch.outputs);
 #ifndef NDEBUG
   fprintf(stderr, "Finished.\n");
 #endif
@@ -0,0 +1,126 @@
+/// @file arena.c
+/// @brief Region-based memory allocator implementation
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include "arena.h"
+#include "errors.h"
+
+/// Size of the chunks of memory of an arena, unless an allocation requires
+/// a larger one.
+#define ARENA_CHUNK_SIZE ((size_t)64 * 1024)
+
+/// Alignment of all the allocations.
+#define ARENA_ALIGN (alignof(max_align_t))
+
+struct t_arenaChunk {
+  struct t_arenaChunk *next;
+  size_t size;
+  alignas(max_align_t) char data[];
+};
+
+_Thread_local t_arenaStats arenaStats;
+
+
+t_arena *newArena(void)
+{
+  t_arena *result = malloc(sizeof(t_arena));
+  if (result == NULL)
+    fatalError("out of memory");
+  result->chunks = NULL;
+  result->next = NULL;
+  result->end = NULL;
+  return result;
+}
+
+
+static void arenaAddChunk(t_arena *arena, size_t minSize)
+{
+  size_t size = ARENA_CHUNK_SIZE;
+  if (minSize > size)
+    size = minSize;
+  t_arenaChunk *chunk = malloc(sizeof(t_arenaChunk) + size);
+  if (chunk == NULL)
+    fatalError("out of memory");
+  chunk->next = arena->chunks;
+  chunk->size = size;
+  arena->chunks = chunk;
+  arena->next = chunk->data;
+  arena->end = chunk->data + size;
+
+  arenaStats.chunkBytes += size;
+  if (arenaStats.chunkBytes > arenaStats.peakChunkBytes)
+    arenaStats.peakChunkBytes = arenaStats.chunkBytes;
+}
+
+
+static void arenaFreeChunk(t_arenaChunk *chunk)
+{
+  arenaStats.chunkBytes -= chunk->size;
+  free(chunk);
+}
+
+
+void *arenaAlloc(t_arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (size == 0)
+    size = ARENA_ALIGN;
+  if ((size_t)(arena->end - arena->next) < size)
+    arenaAddChunk(arena, size);
+  void *result = arena->next;
+  arena->next += size;
+  arenaStats.allocs++;
+  arenaStats.allocBytes += size;
+  return result;
+}
+
+
+void *arenaCalloc(t_arena *arena, size_t size)
+{
+  void *result = arenaAlloc(arena, size);
+  memset(result, 0, size);
+  return result;
+}
+
+
+char *arenaStrdup(t_arena *arena, const char *str)
+{
+  size_t size = strlen(str) + 1;
+  char *result = arenaAlloc(arena, size);
+  memcpy(result, str, size);
+  return result;
+}
+
+
+void arenaReset(t_arena *arena)
+{
+  // Keep the oldest chunk, which is usually enough for scratch memory that
+  // is reset often.
+  t_arenaChunk *chunk = arena->chunks;
+  if (chunk == NULL)
+    return;
+  while (chunk->next != NULL) {
+    t_arenaChunk *next = chunk->next;
+    arenaFreeChunk(chunk);
+    chunk = next;
+  }
+  arena->chunks = chunk;
+  arena->next = chunk->data;
+  arena->end = chunk->data + chunk->size;
+}
+
+
+void deleteArena(t_arena *arena)
+{
+  if (arena == NULL)
+    return;
+  t_arenaChunk *chunk = arena->chunks;
+  while (chunk != NULL) {
+    t_arenaChunk *next = chunk->next;
+    arenaFreeChunk(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
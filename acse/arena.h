@@ -0,0 +1,81 @@
+/// @file arena.h
+/// @brief Region-based memory allocator
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @defgroup arena Arena Allocator
+ * @brief Library for allocating many objects with the same lifetime.
+ *
+ * An arena allocates memory by taking consecutive pieces of large chunks,
+ * which makes allocations much faster and more compact than with malloc().
+ * Objects allocated from an arena cannot be freed individually, instead the
+ * whole arena is freed at once when all of its objects are no longer needed.
+ *
+ * ACSE uses an arena for the objects of a program (instructions, labels,
+ * symbols and the nodes of the lists that contain them), one for the objects
+ * of each control flow graph, and temporary arenas for the scratch memory of
+ * the analyses.
+ * @{
+ */
+
+typedef struct t_arenaChunk t_arenaChunk;
+
+/// An arena allocator.
+typedef struct {
+  t_arenaChunk *chunks; ///< The chunks of the arena, the current one first.
+  char *next;           ///< The first free byte in the current chunk.
+  char *end;            ///< The end of the current chunk.
+} t_arena;
+
+/// Statistics on the memory allocated from all the arenas.
+typedef struct {
+  unsigned long allocs;     ///< Number of allocations.
+  unsigned long allocBytes; ///< Bytes allocated, including the padding.
+  size_t chunkBytes;        ///< Bytes currently held by the arenas.
+  size_t peakChunkBytes;    ///< Maximum of `chunkBytes' since the last reset.
+} t_arenaStats;
+
+/// The statistics of all the arenas used by the current thread. The peak can
+/// be reset by the client by setting it to the current value of `chunkBytes'.
+extern _Thread_local t_arenaStats arenaStats;
+
+/** Create a new empty arena.
+ * @returns The new arena. */
+t_arena *newArena(void);
+
+/** Allocate memory from an arena. The memory is not initialized, and is
+ * suitably aligned for any object.
+ * @param arena The arena where to allocate the memory.
+ * @param size  The size of the memory to allocate, in bytes.
+ * @returns A pointer to the allocated memory. */
+void *arenaAlloc(t_arena *arena, size_t size);
+
+/** Allocate memory initialized to zero from an arena.
+ * @param arena The arena where to allocate the memory.
+ * @param size  The size of the memory to allocate, in bytes.
+ * @returns A pointer to the allocated memory. */
+void *arenaCalloc(t_arena *arena, size_t size);
+
+/** Copy a string in an arena.
+ * @param arena The arena where to allocate the copy.
+ * @param str   The string to be copied.
+ * @returns The copy of the string. */
+char *arenaStrdup(t_arena *arena, const char *str);
+
+/** Free all the memory allocated from an arena, which can then be reused.
+ * @param arena The arena to be cleared. */
+void arenaReset(t_arena *arena);
+
+/** Free an arena and all the memory allocated from it.
+ * @param arena The arena to be freed. */
+void deleteArena(t_arena *arena);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,297 @@
+/// @file cache.c
+/// @brief Cache of the outputs of the compiler indexed by their inputs
+///        implementation
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "errors.h"
+
+/// Number of subdirectories of the cache.
+#define CACHE_NUM_SUBDIRS 16
+/// Percentage of its share of the maximum size a subdirectory is reduced to
+/// when it is too large, so that it is not cleaned up again at every store.
+#define CACHE_EVICT_PERCENT 80
+/// First line of the entries, to be changed when their format changes.
+#define CACHE_MAGIC "acse-cache 1\n"
+
+
+/* Reads a whole file in a new buffer, and returns it, or NULL in case of
+ * error. The size of the file is returned in `len'. */
+static char *readFile(const char *fn, size_t *len)
+{
+  FILE *fp = fopen(fn, "rb");
+  if (fp == NULL)
+    return NULL;
+
+  size_t capacity = 4096, size = 0;
+  char *buf = malloc(capacity);
+  if (buf == NULL)
+    fatalError("out of memory");
+  for (;;) {
+    size += fread(buf + size, 1, capacity - size, fp);
+    if (size < capacity)
+      break;
+    capacity *= 2;
+    buf = realloc(buf, capacity);
+    if (buf == NULL)
+      fatalError("out of memory");
+  }
+
+  bool error = ferror(fp);
+  fclose(fp);
+  if (error) {
+    free(buf);
+    return NULL;
+  }
+  *len = size;
+  return buf;
+}
+
+/* Appends `n' bytes to a buffer, growing it as needed. */
+static void bufAppend(
+    char **buf, size_t *len, size_t *capacity, const void *data, size_t n)
+{
+  if (*len + n > *capacity) {
+    while (*len + n > *capacity)
+      *capacity = *capacity ? *capacity * 2 : 256;
+    *buf = realloc(*buf, *capacity);
+    if (*buf == NULL)
+      fatalError("out of memory");
+  }
+  memcpy(*buf + *len, data, n);
+  *len += n;
+}
+
+/* 64-bit FNV-1a hash of a buffer. */
+static uint64_t cacheHash(const char *buf, size_t len)
+{
+  uint64_t hash = 14695981039346656037u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)buf[i];
+    hash *= 1099511628211u;
+  }
+  return hash;
+}
+
+
+t_cacheKey *newCacheKey(
+    const char *dir, const char *sourceFn, const char *config)
+{
+  size_t sourceLen;
+  char *source = readFile(sourceFn, &sourceLen);
+  if (source == NULL)
+    return NULL;
+
+  t_cacheKey *key = malloc(sizeof(t_cacheKey));
+  if (key == NULL)
+    fatalError("out of memory");
+  key->dir = dir;
+
+  // The name of the source is part of the key because it is written in the
+  // output. The variable parts are preceded by their length, so that no two
+  // different keys have the same bytes.
+  char header[64];
+  int headerLen;
+  size_t capacity = 0;
+  key->key = NULL;
+  key->keyLen = 0;
+  bufAppend(&key->key, &key->keyLen, &capacity, CACHE_MAGIC,
+      strlen(CACHE_MAGIC));
+  headerLen = snprintf(header, sizeof(header), "config %zu\n", strlen(config));
+  bufAppend(&key->key, &key->keyLen, &capacity, header, (size_t)headerLen);
+  bufAppend(&key->key, &key->keyLen, &capacity, config, strlen(config));
+  headerLen =
+      snprintf(header, sizeof(header), "\nfile %zu\n", strlen(sourceFn));
+  bufAppend(&key->key, &key->keyLen, &capacity, header, (size_t)headerLen);
+  bufAppend(&key->key, &key->keyLen, &capacity, sourceFn, strlen(sourceFn));
+  headerLen = snprintf(header, sizeof(header), "\nsource %zu\n", sourceLen);
+  bufAppend(&key->key, &key->keyLen, &capacity, header, (size_t)headerLen);
+  bufAppend(&key->key, &key->keyLen, &capacity, source, sourceLen);
+  free(source);
+
+  uint64_t hash = cacheHash(key->key, key->keyLen);
+  size_t dirLen = strlen(dir);
+  key->subdir = malloc(dirLen + 3);
+  key->path = malloc(dirLen + 20);
+  if (key->subdir == NULL || key->path == NULL)
+    fatalError("out of memory");
+  snprintf(key->subdir, dirLen + 3, "%s/%x", dir,
+      (unsigned)(hash >> 60) % CACHE_NUM_SUBDIRS);
+  snprintf(key->path, dirLen + 20, "%s/%016llx", key->subdir,
+      (unsigned long long)hash);
+  return key;
+}
+
+void deleteCacheKey(t_cacheKey *key)
+{
+  if (key == NULL)
+    return;
+  free(key->key);
+  free(key->subdir);
+  free(key->path);
+  free(key);
+}
+
+
+bool cacheFetch(t_cacheKey *key, const char *outputFn)
+{
+  size_t len;
+  char *entry = readFile(key->path, &len);
+  if (entry == NULL)
+    return false;
+
+  // Check the key, and that the output is complete.
+  bool res = false;
+  if (len <= key->keyLen || memcmp(entry, key->key, key->keyLen) != 0)
+    goto fail;
+  char *output = entry + key->keyLen;
+  char *outputData = memchr(output, '\n', len - key->keyLen);
+  if (outputData == NULL || strncmp(output, "output ", 7) != 0)
+    goto fail;
+  // The number is followed by the newline, so it cannot overflow the entry.
+  char *end;
+  size_t outputLen = strtoul(output + 7, &end, 10);
+  if (end != outputData++ || (size_t)(entry + len - outputData) != outputLen)
+    goto fail;
+
+  FILE *fp = fopen(outputFn, "wb");
+  if (fp == NULL)
+    goto fail;
+  res = fwrite(outputData, 1, outputLen, fp) == outputLen;
+  if (fclose(fp) == EOF)
+    res = false;
+
+  // Mark the entry as recently used.
+  if (res)
+    utimensat(AT_FDCWD, key->path, NULL, 0);
+fail:
+  free(entry);
+  return res;
+}
+
+
+/// A file of a subdirectory of the cache considered for eviction.
+typedef struct {
+  char *name;     ///< The name of the file.
+  off_t size;     ///< The size of the file.
+  time_t lastUse; ///< The last time the file was written or used.
+} t_cacheFile;
+
+static int compareLastUse(const void *a, const void *b)
+{
+  const t_cacheFile *fa = a, *fb = b;
+  return (fa->lastUse > fb->lastUse) - (fa->lastUse < fb->lastUse);
+}
+
+/* Removes the least recently used files of a subdirectory of the cache until
+ * its size is a fraction of `maxBytes', if it is larger than `maxBytes'.
+ * Another process can be removing the same files at the same time, therefore
+ * a file not found is not an error. */
+static void cacheEvict(const char *subdir, size_t maxBytes)
+{
+  DIR *dp = opendir(subdir);
+  if (dp == NULL)
+    return;
+
+  t_cacheFile *files = NULL;
+  int numFiles = 0, capacity = 0;
+  size_t totalBytes = 0;
+  size_t subdirLen = strlen(subdir);
+  char *path = malloc(subdirLen + 256 + 2);
+  if (path == NULL)
+    fatalError("out of memory");
+  struct dirent *ent;
+  while ((ent = readdir(dp)) != NULL) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+      continue;
+    struct stat st;
+    snprintf(path, subdirLen + 256 + 2, "%s/%s", subdir, ent->d_name);
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    if (numFiles == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      files = realloc(files, sizeof(t_cacheFile) * (size_t)capacity);
+      if (files == NULL)
+        fatalError("out of memory");
+    }
+    files[numFiles].name = strdup(ent->d_name);
+    if (files[numFiles].name == NULL)
+      fatalError("out of memory");
+    files[numFiles].size = st.st_size;
+    files[numFiles].lastUse = st.st_mtime;
+    numFiles++;
+    totalBytes += (size_t)st.st_size;
+  }
+  closedir(dp);
+
+  if (totalBytes > maxBytes) {
+    size_t targetBytes = maxBytes / 100 * CACHE_EVICT_PERCENT;
+    qsort(files, (size_t)numFiles, sizeof(t_cacheFile), compareLastUse);
+    for (int i = 0; i < numFiles && totalBytes > targetBytes; i++) {
+      snprintf(path, subdirLen + 256 + 2, "%s/%s", subdir, files[i].name);
+      if (unlink(path) == 0 || errno == ENOENT)
+        totalBytes -= (size_t)files[i].size;
+    }
+  }
+
+  for (int i = 0; i < numFiles; i++)
+    free(files[i].name);
+  free(files);
+  free(path);
+}
+
+void cacheStore(t_cacheKey *key, const char *outputFn, size_t maxBytes)
+{
+  size_t outputLen;
+  char *output = readFile(outputFn, &outputLen);
+  if (output == NULL)
+    return;
+
+  // The directories may have been created by someone else in the meantime.
+  if ((mkdir(key->dir, 0777) != 0 && errno != EEXIST) ||
+      (mkdir(key->subdir, 0777) != 0 && errno != EEXIST)) {
+    free(output);
+    return;
+  }
+
+  // The entry is written to a temporary file with a unique name, and then
+  // renamed, which atomically replaces any entry with the same key.
+  size_t tmpLen = strlen(key->subdir) + 12;
+  char *tmpPath = malloc(tmpLen);
+  if (tmpPath == NULL)
+    fatalError("out of memory");
+  snprintf(tmpPath, tmpLen, "%s/tmp.XXXXXX", key->subdir);
+  int fd = mkstemp(tmpPath);
+  if (fd < 0)
+    goto end;
+  // mkstemp() makes the file private, but the cache may be shared.
+  fchmod(fd, 0644);
+  FILE *fp = fdopen(fd, "wb");
+  if (fp == NULL) {
+    close(fd);
+    unlink(tmpPath);
+    goto end;
+  }
+  bool ok = fwrite(key->key, 1, key->keyLen, fp) == key->keyLen;
+  ok = ok && fprintf(fp, "output %zu\n", outputLen) > 0;
+  ok = ok && fwrite(output, 1, outputLen, fp) == outputLen;
+  if (fclose(fp) == EOF)
+    ok = false;
+  if (!ok || rename(tmpPath, key->path) != 0) {
+    unlink(tmpPath);
+    goto end;
+  }
+
+  cacheEvict(key->subdir, maxBytes / CACHE_NUM_SUBDIRS);
+end:
+  free(tmpPath);
+  free(output);
+}
@@ -0,0 +1,71 @@
+/// @file cache.h
+/// @brief Cache of the outputs of the compiler indexed by their inputs
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @defgroup cache Compilation Cache
+ * @brief Cache of the outputs of the compiler indexed by their inputs
+ *
+ * The cache is a directory holding one file (an entry) for each output
+ * produced. The key of an entry is made of the bytes and the name of the
+ * source file (which appears in the output) and of a configuration string
+ * describing everything else the output depends on (the version of the
+ * compiler, the target and the options). Entries are
+ * named after a hash of their key, and spread in 16 subdirectories by the
+ * first digit of the hash. Each entry also contains its whole key, which is
+ * compared with the one looked up, so that a collision of the hashes cannot
+ * produce a wrong output.
+ *
+ * The cache can be shared by any number of processes and threads: entries
+ * are written to a temporary file and then renamed, so that they appear
+ * complete or not at all. When a subdirectory grows beyond its share of the
+ * maximum size, the entries used least recently are removed. Any error in
+ * accessing the cache is ignored, and results in a miss.
+ * @{
+ */
+
+/// The key of an entry of the cache.
+typedef struct {
+  const char *dir; ///< The directory of the cache.
+  char *key;       ///< The whole key, which starts the entry.
+  size_t keyLen;   ///< The number of bytes of the key.
+  char *subdir;    ///< The subdirectory of the entry.
+  char *path;      ///< The path of the entry.
+} t_cacheKey;
+
+/** Create the key of the entry for a source file.
+ * @param dir      The directory of the cache.
+ * @param sourceFn The name of the source file.
+ * @param config   The configuration of the compiler.
+ * @returns The new key, or NULL if the source file cannot be read. */
+t_cacheKey *newCacheKey(
+    const char *dir, const char *sourceFn, const char *config);
+
+/** Free the memory associated with a key.
+ * @param key The key to be freed. */
+void deleteCacheKey(t_cacheKey *key);
+
+/** Copy the output cached for a key to a file.
+ * @param key      The key.
+ * @param outputFn The name of the file where the output is written.
+ * @returns Whether the key was found in the cache and its output was written
+ *          to the file. */
+bool cacheFetch(t_cacheKey *key, const char *outputFn);
+
+/** Add the output of a compilation to the cache, and remove the least
+ * recently used entries if the cache becomes too large.
+ * @param key      The key.
+ * @param outputFn The name of the file containing the output.
+ * @param maxBytes The maximum size of the cache. */
+void cacheStore(t_cacheKey *key, const char *outputFn, size_t maxBytes);
+
+/**
+ * @}
+ */
+
+#endif
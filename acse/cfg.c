@@ -3,20 +3,30 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cfg.h"
 #include "target_info.h"
 #include "target_asm_print.h"
 #include "errors.h"
 
 
-static bool compareCFGRegAndRegID(void *a, void *b)
+/* Makes room in the table of registers indexed by identifier for the
+ * identifiers up to `size' (excluded). */
+static void cfgReserveRegIDs(t_cfg *graph, int size)
 {
-  t_cfgReg *cfgReg = (t_cfgReg *)a;
-  t_regID id = *((t_regID *)b);
-
-  if (cfgReg == NULL)
-    return false;
-  return cfgReg->tempRegID == id;
+  if (size <= graph->regsByIDSize)
+    return;
+  int newSize = graph->regsByIDSize * 2;
+  if (newSize < size)
+    newSize = size;
+  t_cfgReg **regsByID =
+      realloc(graph->regsByID, sizeof(t_cfgReg *) * (size_t)newSize);
+  if (regsByID == NULL)
+    fatalError("out of memory");
+  for (int i = graph->regsByIDSize; i < newSize; i++)
+    regsByID[i] = NULL;
+  graph->regsByID = regsByID;
+  graph->regsByIDSize = newSize;
 }
 
 /* Alloc a new control flow graph register object. If a register object
@@ -24,23 +34,19 @@ static bool compareCFGRegAndRegID(void *a, void *b)
  * object. */
 static t_cfgReg *createCFGRegister(t_cfg *graph, t_instrArg *arg)
 {
-  // Test if a register with the same identifier is already present.
-  t_listNode *elementFound =
-      listFindWithCallback(graph->registers, &arg->ID, compareCFGRegAndRegID);
+  assert(arg->ID >= 0);
+  cfgReserveRegIDs(graph, arg->ID + 1);
 
-  t_cfgReg *result;
-  if (elementFound) {
-    // It's there: just use it.
-    result = (t_cfgReg *)elementFound->data;
-  } else {
+  // Test if a register with the same identifier is already present.
+  t_cfgReg *result = graph->regsByID[arg->ID];
+  if (result == NULL) {
     // If it's not there it needs to be created.
-    result = malloc(sizeof(t_cfgReg));
-    if (result == NULL)
-      fatalError("out of memory");
+    result = arenaAlloc(graph->arena, sizeof(t_cfgReg));
     result->tempRegID = arg->ID;
     result->mcRegWhitelist = NULL;
-    // Insert it in the list of registers
-    graph->registers = listInsert(graph->registers, result, -1);
+    // Insert it in the list of registers and in the table.
+    vectorAppend(&graph->registers, result);
+    graph->regsByID[arg->ID] = result;
   }
 
   // Copy the machine register allocation constraint, or compute the
@@ -67,33 +73,19 @@ static t_cfgReg *createCFGRegister(t_cfg *graph, t_instrArg *arg)
 }
 
 
-static t_bbNode *newBBNode(t_instruction *instr)
+static t_bbNode *newBBNode(t_cfg *graph, t_instruction *instr)
 {
-  t_bbNode *result = malloc(sizeof(t_bbNode));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_bbNode *result = arenaAlloc(graph->arena, sizeof(t_bbNode));
   for (int i = 0; i < CFG_MAX_DEFS; i++)
     result->defs[i] = NULL;
   for (int i = 0; i < CFG_MAX_USES; i++)
     result->uses[i] = NULL;
   result->instr = instr;
-  result->in = NULL;
-  result->out = NULL;
+  result->listNode = NULL;
   result->parent = NULL;
   return result;
 }
 
-/** Free a given basic block node.
- *  @param node The node to be freed. */
-static void deleteBBNode(t_bbNode *node)
-{
-  if (node == NULL)
-    return;
-  deleteList(node->in);
-  deleteList(node->out);
-  free(node);
-}
-
 static void bbNodeComputeDefUses(t_bbNode *node)
 {
   t_cfg *graph = node->parent->parent;
@@ -123,38 +115,35 @@ static void bbNodeComputeDefUses(t_bbNode *node)
 
 
 /** Allocate a new empty basic block.
+ *  @param graph The graph which will contain the block.
  *  @returns The new block. */
-t_basicBlock *newBasicBlock(void)
+static t_basicBlock *newBasicBlock(t_cfg *graph)
 {
-  t_basicBlock *result = malloc(sizeof(t_basicBlock));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_basicBlock *result = arenaAlloc(graph->arena, sizeof(t_basicBlock));
   result->pred = NULL;
   result->succ = NULL;
-  result->nodes = NULL;
-  result->parent = NULL;
+  listInit(&result->nodes, graph->arena);
+  result->index = -1;
+  result->parent = graph;
+  result->use = NULL;
+  result->def = NULL;
+  result->liveIn = NULL;
+  result->liveOut = NULL;
+  result->inWorklist = false;
+  result->idom = NULL;
   return result;
 }
 
-/** Frees the memory associated with a given basic block.
+/** Frees the memory associated with a given basic block which is not owned
+ * by the arena of the graph.
  *  @param block The block to be freed. */
-void deleteBasicBlock(t_basicBlock *block)
+static void deleteBasicBlock(t_basicBlock *block)
 {
   if (block == NULL)
     return;
 
   deleteList(block->pred);
   deleteList(block->succ);
-
-  t_listNode *curNode = block->nodes;
-  while (curNode != NULL) {
-    t_bbNode *curCFGNode = (t_bbNode *)curNode->data;
-    deleteBBNode(curCFGNode);
-    curNode = curNode->next;
-  }
-
-  deleteList(block->nodes);
-  free(block);
 }
 
 /** Adds a predecessor to a basic block.
@@ -163,7 +152,9 @@ void deleteBasicBlock(t_basicBlock *block)
 void bbAddPred(t_basicBlock *block, t_basicBlock *pred)
 {
   // Do not insert if the block is already inserted in the list of predecessors.
-  if (listFind(block->pred, pred) == NULL) {
+  // The lists of predecessors and successors are kept consistent, and the
+  // latter is shorter since a block has at most two successors.
+  if (listFind(pred->succ, block) == NULL) {
     block->pred = listInsert(block->pred, pred, -1);
     pred->succ = listInsert(pred->succ, block, -1);
   }
@@ -183,8 +174,8 @@ void bbAddSucc(t_basicBlock *block, t_basicBlock *succ)
 
 t_bbNode *bbInsertInstruction(t_basicBlock *block, t_instruction *instr)
 {
-  t_bbNode *newNode = newBBNode(instr);
-  block->nodes = listInsert(block->nodes, newNode, -1);
+  t_bbNode *newNode = newBBNode(block->parent, instr);
+  newNode->listNode = listAppend(&block->nodes, newNode);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
   return newNode;
@@ -193,12 +184,11 @@ t_bbNode *bbInsertInstruction(t_basicBlock *block, t_instruction *instr)
 t_bbNode *bbInsertInstructionBefore(
     t_basicBlock *block, t_instruction *instr, t_bbNode *ip)
 {
-  t_listNode *listIP = listFind(block->nodes, ip);
-  if (listIP == NULL)
+  if (ip->parent != block)
     fatalError("bug: invalid basic block node; corrupt CFG?");
 
-  t_bbNode *newNode = newBBNode(instr);
-  block->nodes = listInsertBefore(block->nodes, listIP, newNode);
+  t_bbNode *newNode = newBBNode(block->parent, instr);
+  newNode->listNode = listAddBefore(&block->nodes, ip->listNode, newNode);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
   return newNode;
@@ -207,12 +197,11 @@ t_bbNode *bbInsertInstructionBefore(
 t_bbNode *bbInsertInstructionAfter(
     t_basicBlock *block, t_instruction *instr, t_bbNode *ip)
 {
-  t_listNode *listIP = listFind(block->nodes, ip);
-  if (listIP == NULL)
+  if (ip->parent != block)
     fatalError("bug: invalid basic block node; corrupt CFG?");
 
-  t_bbNode *newNode = newBBNode(instr);
-  block->nodes = listInsertAfter(block->nodes, listIP, newNode);
+  t_bbNode *newNode = newBBNode(block->parent, instr);
+  newNode->listNode = listAddAfter(&block->nodes, ip->listNode, newNode);
   newNode->parent = block;
   bbNodeComputeDefUses(newNode);
   return newNode;
@@ -224,38 +213,36 @@ static t_cfg *newCFG(void)
   t_cfg *result = malloc(sizeof(t_cfg));
   if (result == NULL)
     fatalError("out of memory");
-  result->blocks = NULL;
-  result->registers = NULL;
+  result->arena = newArena();
+  vectorInit(&result->blocks);
+  vectorInit(&result->registers);
+  result->regSetWords = 0;
+  result->regsByID = NULL;
+  result->regsByIDSize = 0;
   // Create the dummy ending block.
-  result->endingBlock = newBasicBlock();
-  result->endingBlock->parent = result;
+  result->endingBlock = newBasicBlock(result);
   return result;
 }
 
 void deleteCFG(t_cfg *graph)
 {
-  t_listNode *curNode;
   if (graph == NULL)
     return;
 
-  curNode = graph->blocks;
-  while (curNode) {
-    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
-    deleteBasicBlock(curBlock);
-    curNode = curNode->next;
-  }
-  deleteList(graph->blocks);
+  for (int i = 0; i < graph->blocks.length; i++)
+    deleteBasicBlock((t_basicBlock *)graph->blocks.items[i]);
+  vectorClear(&graph->blocks);
   deleteBasicBlock(graph->endingBlock);
 
-  curNode = graph->registers;
-  while (curNode) {
-    t_cfgReg *curReg = (t_cfgReg *)curNode->data;
+  for (int i = 0; i < graph->registers.length; i++) {
+    t_cfgReg *curReg = (t_cfgReg *)graph->registers.items[i];
     deleteList(curReg->mcRegWhitelist);
-    free(curReg);
-    curNode = curNode->next;
   }
-  deleteList(graph->registers);
+  vectorClear(&graph->registers);
+  free(graph->regsByID);
 
+  // All the blocks, nodes and registers are freed with the arena.
+  deleteArena(graph->arena);
   free(graph);
 }
 
@@ -264,38 +251,11 @@ void deleteCFG(t_cfg *graph)
  *  @returns The new block. */
 t_basicBlock *cfgCreateBlock(t_cfg *graph)
 {
-  t_basicBlock *block = newBasicBlock();
-  graph->blocks = listInsert(graph->blocks, block, -1);
-  block->parent = graph;
+  t_basicBlock *block = newBasicBlock(graph);
+  block->index = vectorAppend(&graph->blocks, block);
   return block;
 }
 
-static t_basicBlock *cfgSearchLabel(t_cfg *graph, t_label *label)
-{
-  if (label == NULL)
-    return NULL;
-
-  t_basicBlock *bblock = NULL;
-  t_listNode *curNode = graph->blocks;
-  while (curNode != NULL) {
-    bblock = (t_basicBlock *)curNode->data;
-
-    // Check the first node of the basic block. If its instruction has a label,
-    // check if it's the label we are searching for.
-    t_bbNode *curCFGNode = (t_bbNode *)bblock->nodes->data;
-    if ((curCFGNode->instr)->label != NULL) {
-      if ((curCFGNode->instr)->label->labelID == label->labelID)
-        // Found!
-        break;
-    }
-
-    curNode = curNode->next;
-  }
-
-  return bblock;
-}
-
-
 static bool instrIsStartingNode(t_instruction *instr)
 {
   return instr->label != NULL;
@@ -306,7 +266,8 @@ static bool instrIsEndingNode(t_instruction *instr)
   return isExitInstruction(instr) || isJumpInstruction(instr);
 }
 
-static void cfgComputeTransitions(t_cfg *graph)
+static void cfgComputeTransitions(t_cfg *graph, t_basicBlock **blockByLabel,
+    unsigned int numLabels)
 {
   // This function is the continuation of programToCFG(), where after creating
   // the blocks in the CFG we need to construct the transitions between them.
@@ -314,13 +275,11 @@ static void cfgComputeTransitions(t_cfg *graph)
   // found at the end of (some of the) basic blocks. The algorithm for adding
   // the transitions simply consists of searching for every branch, and adding
   // the correct outgoing edges to its basic block.
-  t_listNode *curNode = graph->blocks;
-  while (curNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
 
     // Get the last instruction in the basic block.
-    t_listNode *lastNode = listGetLastNode(curBlock->nodes);
-    t_bbNode *lastCFGNode = (t_bbNode *)lastNode->data;
+    t_bbNode *lastCFGNode = (t_bbNode *)curBlock->nodes.tail->data;
     t_instruction *lastInstr = lastCFGNode->instr;
 
     // If the instruction is return-like or exit-like, by definition the next
@@ -336,7 +295,10 @@ static void cfgComputeTransitions(t_cfg *graph)
     if (isJumpInstruction(lastInstr)) {
       if (lastInstr->addressParam == NULL)
         fatalError("bug: malformed jump instruction with no label in CFG");
-      t_basicBlock *jumpBlock = cfgSearchLabel(graph, lastInstr->addressParam);
+      unsigned int labelID = lastInstr->addressParam->labelID;
+      t_basicBlock *jumpBlock = NULL;
+      if (labelID < numLabels)
+        jumpBlock = blockByLabel[labelID];
       if (jumpBlock == NULL)
         fatalError("bug: malformed jump instruction with invalid label in CFG");
       bbAddPred(jumpBlock, curBlock);
@@ -349,10 +311,9 @@ static void cfgComputeTransitions(t_cfg *graph)
     // the instructions in the program, we can rely on this property to fetch
     // the correct block for this fallthrough case.
     if (!isUnconditionalJump(lastInstr)) {
-      t_listNode *nextNode = curNode->next;
-      if (nextNode != NULL) {
+      if (i + 1 < graph->blocks.length) {
         // The current basic block has a successor in the list, all is fine
-        t_basicBlock *nextBlock = nextNode->data;
+        t_basicBlock *nextBlock = graph->blocks.items[i + 1];
         bbAddSucc(curBlock, nextBlock);
         bbAddPred(nextBlock, curBlock);
       } else {
@@ -362,14 +323,20 @@ static void cfgComputeTransitions(t_cfg *graph)
         bbAddPred(graph->endingBlock, curBlock);
       }
     }
-
-    curNode = curNode->next;
   }
 }
 
 t_cfg *programToCFG(t_program *program)
 {
   t_cfg *result = newCFG();
+  cfgReserveRegIDs(result, program->firstUnusedReg);
+
+  // Table of the blocks starting with each label, indexed by label ID, for
+  // finding the targets of the jumps.
+  unsigned int numLabels = program->firstUnusedLblID;
+  t_basicBlock **blockByLabel = calloc(numLabels, sizeof(t_basicBlock *));
+  if (numLabels > 0 && blockByLabel == NULL)
+    fatalError("out of memory");
 
   // Generate each basic block, by splitting the list of instruction at each
   // terminator instruction or labeled instruction. Labeled instructions are
@@ -382,7 +349,7 @@ t_cfg *programToCFG(t_program *program)
   // block is created lazily at the next instruction found. This ensures no
   // empty blocks are created.
   t_basicBlock *bblock = NULL;
-  t_listNode *curNode = program->instructions;
+  t_listNode *curNode = program->instructions.head;
   while (curNode != NULL) {
     t_instruction *curInstr = (t_instruction *)curNode->data;
 
@@ -391,6 +358,10 @@ t_cfg *programToCFG(t_program *program)
     // a terminator) then create a new basic block.
     if (instrIsStartingNode(curInstr) || bblock == NULL)
       bblock = cfgCreateBlock(result);
+    if (instrIsStartingNode(curInstr)) {
+      assert(curInstr->label->labelID < numLabels);
+      blockByLabel[curInstr->label->labelID] = bblock;
+    }
 
     // Add the instruction to the end of the current basic block.
     t_bbNode *curCFGNode = bbInsertInstruction(bblock, curInstr);
@@ -405,7 +376,8 @@ t_cfg *programToCFG(t_program *program)
 
   // Now all the blocks have been created, we need to add the edges between
   // blocks, which is done in the cfgComputeTransitions() function.
-  cfgComputeTransitions(result);
+  cfgComputeTransitions(result, blockByLabel, numLabels);
+  free(blockByLabel);
   return result;
 }
 
@@ -413,23 +385,18 @@ t_cfg *programToCFG(t_program *program)
 void cfgToProgram(t_program *program, t_cfg *graph)
 {
   // Erase the old code segment.
-  program->instructions = deleteList(program->instructions);
+  listClear(&program->instructions);
 
   // Iterate through all the instructions in all the basic blocks (in order)
   // and re-add them to the program.
-  t_listNode *curBlockNode = graph->blocks;
-  while (curBlockNode != NULL) {
-    t_basicBlock *bblock = (t_basicBlock *)curBlockNode->data;
-    t_listNode *curInnerNode = bblock->nodes;
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *bblock = (t_basicBlock *)graph->blocks.items[i];
+    t_listNode *curInnerNode = bblock->nodes.head;
     while (curInnerNode != NULL) {
       t_bbNode *node = (t_bbNode *)curInnerNode->data;
-
-      program->instructions =
-          listInsert(program->instructions, node->instr, -1);
-
+      listAppend(&program->instructions, node->instr);
       curInnerNode = curInnerNode->next;
     }
-    curBlockNode = curBlockNode->next;
   }
 }
 
@@ -440,11 +407,10 @@ int cfgIterateNodes(t_cfg *graph, void *context,
   int counter = 0;
   int exitcode = 0;
 
-  t_listNode *curBlockNode = graph->blocks;
-  while (curBlockNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
 
-    t_listNode *curInnerNode = curBlock->nodes;
+    t_listNode *curInnerNode = curBlock->nodes.head;
     while (curInnerNode != NULL) {
       t_bbNode *curCFGNode = (t_bbNode *)curInnerNode->data;
 
@@ -455,193 +421,475 @@ int cfgIterateNodes(t_cfg *graph, void *context,
       counter++;
       curInnerNode = curInnerNode->next;
     }
-
-    curBlockNode = curBlockNode->next;
   }
   return exitcode;
 }
 
 
-t_listNode *bbGetLiveOut(t_basicBlock *bblock)
+static t_cfgRegSetWord *newRegSet(t_cfg *graph)
 {
-  if (bblock == NULL)
-    return NULL;
-  if (bblock->nodes == NULL)
-    return NULL;
+  return arenaCalloc(
+      graph->arena, sizeof(t_cfgRegSetWord) * (size_t)graph->regSetWords);
+}
 
-  t_listNode *last = listGetLastNode(bblock->nodes);
-  t_bbNode *lastNode = (t_bbNode *)last->data;
-  return listClone(lastNode->out);
+static void regSetAdd(t_cfgRegSetWord *set, t_regID reg)
+{
+  t_cfgRegSetWord bit = (t_cfgRegSetWord)1 << (reg % CFG_REG_SET_WORD_BITS);
+  set[reg / CFG_REG_SET_WORD_BITS] |= bit;
 }
 
-t_listNode *bbGetLiveIn(t_basicBlock *bblock)
+static void regSetRemove(t_cfgRegSetWord *set, t_regID reg)
 {
-  if (bblock == NULL)
-    return NULL;
-  if (bblock->nodes == NULL)
-    return NULL;
+  t_cfgRegSetWord bit = (t_cfgRegSetWord)1 << (reg % CFG_REG_SET_WORD_BITS);
+  set[reg / CFG_REG_SET_WORD_BITS] &= ~bit;
+}
 
-  t_bbNode *firstNode = (t_bbNode *)bblock->nodes->data;
-  return listClone(firstNode->in);
+/* Adds all the registers in `src' to `dest'. Returns whether `dest' was
+ * modified. */
+static bool regSetUnion(
+    t_cfg *graph, t_cfgRegSetWord *dest, t_cfgRegSetWord *src)
+{
+  t_cfgRegSetWord added = 0;
+  for (int i = 0; i < graph->regSetWords; i++) {
+    added |= src[i] & ~dest[i];
+    dest[i] |= src[i];
+  }
+  return added != 0;
 }
 
-static t_listNode *addElementToSet(t_listNode *set, void *element,
-    bool (*compareFunc)(void *a, void *b), bool *modified)
+bool cfgRegSetContains(t_cfgRegSetWord *set, t_regID reg)
 {
-  if (element == NULL)
-    return set;
+  if (set == NULL || reg < 0)
+    return false;
+  t_cfgRegSetWord bit = (t_cfgRegSetWord)1 << (reg % CFG_REG_SET_WORD_BITS);
+  return (set[reg / CFG_REG_SET_WORD_BITS] & bit) != 0;
+}
 
-  // Add the element if it's not already in the `set' list.
-  if (listFindWithCallback(set, element, compareFunc) == NULL) {
-    set = listInsert(set, element, -1);
-    if (modified != NULL)
-      (*modified) = true;
-  }
+t_cfgReg *cfgRegSetNext(t_cfg *graph, t_cfgRegSetWord *set, t_regID start)
+{
+  if (set == NULL || start < 0)
+    return NULL;
 
-  return set;
+  int i = start / CFG_REG_SET_WORD_BITS;
+  if (i >= graph->regSetWords)
+    return NULL;
+  // Ignore the registers before `start' in its word.
+  t_cfgRegSetWord word =
+      set[i] & ((t_cfgRegSetWord)-1 << (start % CFG_REG_SET_WORD_BITS));
+  while (word == 0) {
+    if (++i >= graph->regSetWords)
+      return NULL;
+    word = set[i];
+  }
+  int bit = 0;
+  while (!(word & ((t_cfgRegSetWord)1 << bit)))
+    bit++;
+  return graph->regsByID[i * CFG_REG_SET_WORD_BITS + bit];
 }
 
-static t_listNode *addElementsToSet(t_listNode *set, t_listNode *elements,
-    bool (*compareFunc)(void *a, void *b), bool *modified)
+static t_listNode *regSetToList(t_cfg *graph, t_cfgRegSetWord *set)
 {
-  // Add all the elements to the set one by one.
-  t_listNode *curNode = elements;
-  while (curNode != NULL) {
-    void *curData = curNode->data;
-    set = addElementToSet(set, curData, compareFunc, modified);
-    curNode = curNode->next;
+  t_listNode *result = NULL;
+  t_cfgReg *reg = cfgRegSetNext(graph, set, 0);
+  while (reg != NULL) {
+    result = listInsert(result, reg, -1);
+    reg = cfgRegSetNext(graph, set, reg->tempRegID + 1);
   }
+  return result;
+}
+
+t_listNode *bbGetLiveOut(t_basicBlock *bblock)
+{
+  if (bblock == NULL)
+    return NULL;
+  if (bblock->nodes.head == NULL)
+    return NULL;
 
-  // Return the new list.
-  return set;
+  return regSetToList(bblock->parent, bblock->liveOut);
 }
 
-static t_listNode *computeLiveInSetEquation(t_cfgReg *defs[CFG_MAX_DEFS],
-    t_cfgReg *uses[CFG_MAX_USES], t_listNode *liveOut)
+t_listNode *bbGetLiveIn(t_basicBlock *bblock)
 {
-  // Initialize live in set as equal to live out set.
-  t_listNode *liveIn = listClone(liveOut);
+  if (bblock == NULL)
+    return NULL;
+  if (bblock->nodes.head == NULL)
+    return NULL;
+
+  return regSetToList(bblock->parent, bblock->liveIn);
+}
 
-  // Add all items from set of uses.
+/* Computes the live in set of a node from its live out set, in place:
+ *   in(node) = use(node) U (out(node) - def(node)) */
+static void computeLiveInSetEquation(t_cfgReg *defs[CFG_MAX_DEFS],
+    t_cfgReg *uses[CFG_MAX_USES], t_cfgRegSetWord *live)
+{
+  // Remove the definitions first, so that registers both defined and used
+  // by the node stay in the set.
+  for (int i = 0; i < CFG_MAX_DEFS; i++) {
+    if (defs[i] != NULL)
+      regSetRemove(live, defs[i]->tempRegID);
+  }
   for (int i = 0; i < CFG_MAX_USES; i++) {
     if (uses[i] == NULL)
       continue;
     if (TARGET_REG_ZERO_IS_CONST && uses[i]->tempRegID == REG_0)
       continue;
-    liveIn = addElementToSet(liveIn, uses[i], NULL, NULL);
+    regSetAdd(live, uses[i]->tempRegID);
   }
+}
 
-  // Remove items from set of definitions as long as they are not present in
-  // the set of uses.
-  for (int defIdx = 0; defIdx < CFG_MAX_DEFS; defIdx++) {
-    int found = 0;
-
-    if (defs[defIdx] == NULL)
-      continue;
-    if (TARGET_REG_ZERO_IS_CONST && defs[defIdx]->tempRegID == REG_0)
-      continue;
-
-    for (int useIdx = 0; useIdx < CFG_MAX_USES && !found; useIdx++) {
-      if (uses[useIdx] && uses[useIdx]->tempRegID == defs[defIdx]->tempRegID)
-        found = 1;
+/* Computes the registers used by a block before being defined in it, and
+ * the registers it defines, with a backward pass over its nodes. */
+static void bbComputeUseDef(t_basicBlock *block)
+{
+  t_listNode *curLI = block->nodes.tail;
+  while (curLI != NULL) {
+    t_bbNode *curNode = (t_bbNode *)curLI->data;
+    for (int i = 0; i < CFG_MAX_DEFS; i++) {
+      if (curNode->defs[i] == NULL)
+        continue;
+      regSetAdd(block->def, curNode->defs[i]->tempRegID);
+      regSetRemove(block->use, curNode->defs[i]->tempRegID);
     }
-
-    if (!found)
-      liveIn = listFindAndRemove(liveIn, defs[defIdx]);
+    for (int i = 0; i < CFG_MAX_USES; i++) {
+      if (curNode->uses[i] == NULL)
+        continue;
+      if (TARGET_REG_ZERO_IS_CONST && curNode->uses[i]->tempRegID == REG_0)
+        continue;
+      regSetAdd(block->use, curNode->uses[i]->tempRegID);
+    }
+    curLI = curLI->prev;
   }
-
-  return liveIn;
 }
 
-/* Re-computes the live registers out of a block by applying the standard
- * flow equation:
- *   out(block) = union in(block') for all successor block' */
-static t_listNode *cfgComputeLiveOutOfBlock(t_cfg *graph, t_basicBlock *block)
+/* Re-computes the live registers in and out of a block by applying the
+ * standard flow equations:
+ *   out(block) = union in(block') for all successor block'
+ *   in(block) = use(block) U (out(block) - def(block))
+ * Returns whether the live in set was modified. */
+static bool bbUpdateLiveness(t_cfg *graph, t_basicBlock *block)
 {
-  // Iterate through all the successor blocks
-  t_listNode *result = NULL;
+  for (int i = 0; i < graph->regSetWords; i++)
+    block->liveOut[i] = 0;
+
   t_listNode *curSuccNode = block->succ;
   while (curSuccNode != NULL) {
     t_basicBlock *curSuccessor = (t_basicBlock *)curSuccNode->data;
+    if (curSuccessor != graph->endingBlock)
+      regSetUnion(graph, block->liveOut, curSuccessor->liveIn);
+    curSuccNode = curSuccNode->next;
+  }
+
+  t_cfgRegSetWord changed = 0;
+  for (int i = 0; i < graph->regSetWords; i++) {
+    t_cfgRegSetWord liveIn =
+        block->use[i] | (block->liveOut[i] & ~block->def[i]);
+    changed |= liveIn ^ block->liveIn[i];
+    block->liveIn[i] = liveIn;
+  }
+  return changed != 0;
+}
+
+/* Sizes the register sets after the registers in the graph, and computes the
+ * use and def sets of all the blocks. */
+static void cfgInitLiveness(t_cfg *graph)
+{
+  t_regID maxRegID = 0;
+  for (int i = 0; i < graph->registers.length; i++) {
+    t_cfgReg *curReg = (t_cfgReg *)graph->registers.items[i];
+    if (curReg->tempRegID > maxRegID)
+      maxRegID = curReg->tempRegID;
+  }
+  graph->regSetWords = maxRegID / CFG_REG_SET_WORD_BITS + 1;
+  cfgReserveRegIDs(graph, graph->regSetWords * CFG_REG_SET_WORD_BITS);
+
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
+    curBlock->use = newRegSet(graph);
+    curBlock->def = newRegSet(graph);
+    curBlock->liveIn = newRegSet(graph);
+    curBlock->liveOut = newRegSet(graph);
+    curBlock->inWorklist = false;
+    bbComputeUseDef(curBlock);
+  }
+}
+
+/* Stores the blocks of the graph in `order' in postorder, so that blocks
+ * come after their successors except along back edges. If `allBlocks' is
+ * true, the depth-first visits start from each block not visited yet, in
+ * program order, to also include unreachable blocks. Otherwise only the
+ * blocks reachable from the first one are visited. The visited blocks are
+ * marked as queued. Returns the number of blocks visited. */
+static int cfgComputePostorder(
+    t_cfg *graph, t_basicBlock **order, bool allBlocks, t_arena *scratch)
+{
+  int numBlocks = graph->blocks.length;
+  t_basicBlock **stack =
+      arenaAlloc(scratch, sizeof(t_basicBlock *) * (size_t)numBlocks);
+  t_listNode **nextSucc =
+      arenaAlloc(scratch, sizeof(t_listNode *) * (size_t)numBlocks);
+
+  int numVisited = 0;
+  int numRoots = allBlocks ? numBlocks : (numBlocks > 0 ? 1 : 0);
+  for (int i = 0; i < numRoots; i++) {
+    t_basicBlock *root = (t_basicBlock *)graph->blocks.items[i];
+    if (root->inWorklist)
+      continue;
 
-    if (curSuccessor != graph->endingBlock) {
-      // Update our block's 'out' set by adding all registers 'in' to the
-      // current successor.
-      t_listNode *liveINRegs = bbGetLiveIn(curSuccessor);
-      result = addElementsToSet(result, liveINRegs, NULL, NULL);
-      deleteList(liveINRegs);
+    root->inWorklist = true;
+    stack[0] = root;
+    nextSucc[0] = root->succ;
+    int depth = 1;
+    while (depth > 0) {
+      t_listNode *succNode = nextSucc[depth - 1];
+      if (succNode == NULL) {
+        // All the successors have been visited.
+        order[numVisited++] = stack[--depth];
+        continue;
+      }
+      nextSucc[depth - 1] = succNode->next;
+      t_basicBlock *succ = (t_basicBlock *)succNode->data;
+      if (succ == graph->endingBlock || succ->inWorklist)
+        continue;
+      succ->inWorklist = true;
+      stack[depth] = succ;
+      nextSucc[depth] = succ->succ;
+      depth++;
     }
+  }
+  return numVisited;
+}
 
-    curSuccNode = curSuccNode->next;
+void cfgComputeLiveness(t_cfg *graph)
+{
+  cfgInitLiveness(graph);
+
+  // The worklist is a circular queue of the blocks whose live out set may
+  // have changed. Each block is queued at most once at any time. Blocks are
+  // initially queued in postorder, which requires few iterations on graphs
+  // without loops.
+  int numBlocks = graph->blocks.length;
+  if (numBlocks == 0)
+    return;
+  t_arena *scratch = newArena();
+  t_basicBlock **worklist =
+      arenaAlloc(scratch, sizeof(t_basicBlock *) * (size_t)numBlocks);
+  cfgComputePostorder(graph, worklist, true, scratch);
+  int head = 0;
+  int length = numBlocks;
+
+  while (length > 0) {
+    t_basicBlock *curBlock = worklist[head];
+    head = (head + 1) % numBlocks;
+    length--;
+    curBlock->inWorklist = false;
+
+    // When the live in set of a block changes, the live out sets of its
+    // predecessors must be recomputed.
+    if (!bbUpdateLiveness(graph, curBlock))
+      continue;
+    t_listNode *curPredNode = curBlock->pred;
+    while (curPredNode != NULL) {
+      t_basicBlock *curPred = (t_basicBlock *)curPredNode->data;
+      if (!curPred->inWorklist) {
+        curPred->inWorklist = true;
+        worklist[(head + length) % numBlocks] = curPred;
+        length++;
+      }
+      curPredNode = curPredNode->next;
+    }
   }
 
-  return result;
+  deleteArena(scratch);
 }
 
-static bool cfgUpdateLivenessOfNodesInBlock(t_cfg *graph, t_basicBlock *bblock)
+/* Finds the nearest common dominator of two blocks, given the index of each
+ * block in postorder. */
+static t_basicBlock *intersectDominators(
+    t_basicBlock *a, t_basicBlock *b, int *postorderIndex)
 {
-  // Keep track of whether we modified something or not.
-  bool modified = false;
+  while (a != b) {
+    while (postorderIndex[a->index] < postorderIndex[b->index])
+      a = a->idom;
+    while (postorderIndex[b->index] < postorderIndex[a->index])
+      b = b->idom;
+  }
+  return a;
+}
 
-  // Start with the last node in the basic block, we will proceed upwards
-  // from there.
-  t_listNode *curLI = listGetLastNode(bblock->nodes);
-  // The live in set of the successors of the last node in the block is the
-  // live out set of the block itself.
-  t_listNode *successorsLiveIn = cfgComputeLiveOutOfBlock(graph, bblock);
+void cfgComputeDominators(t_cfg *graph)
+{
+  int numBlocks = graph->blocks.length;
+  for (int i = 0; i < numBlocks; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
+    curBlock->idom = NULL;
+    curBlock->inWorklist = false;
+  }
+  if (numBlocks == 0)
+    return;
 
-  while (curLI != NULL) {
-    // Get the current CFG node.
-    t_bbNode *curNode = (t_bbNode *)curLI->data;
+  // Iterative algorithm by Cooper, Harvey and Kennedy: the immediate
+  // dominator of each block is the nearest common dominator of its
+  // predecessors, and the blocks are visited in reverse postorder until
+  // nothing changes.
+  t_arena *scratch = newArena();
+  t_basicBlock **order =
+      arenaAlloc(scratch, sizeof(t_basicBlock *) * (size_t)numBlocks);
+  int numReachable = cfgComputePostorder(graph, order, false, scratch);
+  int *postorderIndex = arenaAlloc(scratch, sizeof(int) * (size_t)numBlocks);
+  for (int i = 0; i < numReachable; i++) {
+    postorderIndex[order[i]->index] = i;
+    order[i]->inWorklist = false;
+  }
 
-    // Live out of a block is equal to the union of the live in sets of the
-    // successors.
-    curNode->out =
-        addElementsToSet(curNode->out, successorsLiveIn, NULL, &modified);
-    deleteList(successorsLiveIn);
+  t_basicBlock *entry = order[numReachable - 1];
+  entry->idom = entry;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = numReachable - 2; i >= 0; i--) {
+      t_basicBlock *curBlock = order[i];
+      t_basicBlock *newIdom = NULL;
+      t_listNode *curPredNode = curBlock->pred;
+      for (; curPredNode != NULL; curPredNode = curPredNode->next) {
+        t_basicBlock *curPred = (t_basicBlock *)curPredNode->data;
+        // Skip the predecessors not processed yet and the unreachable ones.
+        if (curPred->idom == NULL)
+          continue;
+        if (newIdom == NULL)
+          newIdom = curPred;
+        else
+          newIdom = intersectDominators(curPred, newIdom, postorderIndex);
+      }
+      if (curBlock->idom != newIdom) {
+        curBlock->idom = newIdom;
+        changed = true;
+      }
+    }
+  }
 
-    // Compute the live in set of the block using the set of definition,
-    // uses and live out registers of the block.
-    t_listNode *liveIn =
-        computeLiveInSetEquation(curNode->defs, curNode->uses, curNode->out);
-    curNode->in = addElementsToSet(curNode->in, liveIn, NULL, &modified);
+  deleteArena(scratch);
+}
 
-    // Since there are no branches in a basic block, the successors of
-    // the predecessor is just the current block.
-    successorsLiveIn = liveIn;
+/// Liveness of the nodes of a block, computed for one node at a time in
+/// forward order. The live in and live out sets of a node only differ in the
+/// registers defined or used by the node, so it is enough to remember which
+/// of these registers are live at the exit of each node.
+typedef struct {
+  /// Registers live at the entry of the current node.
+  t_cfgRegSetWord *in;
+  /// Registers live at the exit of the current node.
+  t_cfgRegSetWord *out;
+  /// For each node, one bit for each of its definitions and uses, in this
+  /// order, set if the register is live at the exit of the node.
+  uint8_t *liveOutRegs;
+} t_nodeLiveness;
+
+/* Makes `set' contain the registers of a node which are live at its exit,
+ * according to the given bits. */
+static void applyNodeLiveOut(
+    t_bbNode *node, uint8_t liveOutRegs, t_cfgRegSetWord *set)
+{
+  t_cfgReg *regs[CFG_MAX_DEFS + CFG_MAX_USES];
+  memcpy(regs, node->defs, sizeof(node->defs));
+  memcpy(regs + CFG_MAX_DEFS, node->uses, sizeof(node->uses));
+  for (int i = 0; i < CFG_MAX_DEFS + CFG_MAX_USES; i++) {
+    if (regs[i] == NULL)
+      continue;
+    if (liveOutRegs & (1 << i))
+      regSetAdd(set, regs[i]->tempRegID);
+    else
+      regSetRemove(set, regs[i]->tempRegID);
+  }
+}
 
-    // Continue backwards to the previous node.
+/* Computes the liveness of the nodes in a block with a backward pass from the
+ * live out set of the block. On return, the `in' and `out' sets are both the
+ * live in set of the first node. Everything is allocated in `scratch'. */
+static void bbComputeNodeLiveness(
+    t_basicBlock *block, t_arena *scratch, t_nodeLiveness *result)
+{
+  t_cfg *graph = block->parent;
+  size_t setSize = sizeof(t_cfgRegSetWord) * (size_t)graph->regSetWords;
+  int numNodes = block->nodes.length;
+  result->in = arenaAlloc(scratch, setSize);
+  result->out = arenaAlloc(scratch, setSize);
+  result->liveOutRegs = arenaAlloc(scratch, (size_t)numNodes);
+
+  t_cfgRegSetWord *live = result->in;
+  memcpy(live, block->liveOut, setSize);
+  t_listNode *curLI = block->nodes.tail;
+  for (int i = numNodes - 1; i >= 0; i--) {
+    t_bbNode *curNode = (t_bbNode *)curLI->data;
+    // Since there are no branches in a basic block, the live out set of a
+    // node is the live in set of the next one.
+    t_cfgReg *regs[CFG_MAX_DEFS + CFG_MAX_USES];
+    memcpy(regs, curNode->defs, sizeof(curNode->defs));
+    memcpy(regs + CFG_MAX_DEFS, curNode->uses, sizeof(curNode->uses));
+    uint8_t liveOutRegs = 0;
+    for (int j = 0; j < CFG_MAX_DEFS + CFG_MAX_USES; j++) {
+      if (regs[j] && cfgRegSetContains(live, regs[j]->tempRegID))
+        liveOutRegs |= 1 << j;
+    }
+    result->liveOutRegs[i] = liveOutRegs;
+    computeLiveInSetEquation(curNode->defs, curNode->uses, live);
     curLI = curLI->prev;
   }
+  memcpy(result->out, live, setSize);
+}
 
-  deleteList(successorsLiveIn);
+/* Moves to the given node: turns the `out' set from the live in set of the
+ * node to its live out set. */
+static void nodeLivenessEnter(
+    t_nodeLiveness *liveness, t_bbNode *node, int index)
+{
+  applyNodeLiveOut(node, liveness->liveOutRegs[index], liveness->out);
+}
 
-  // Return a non-zero value if anything was modified.
-  return modified;
+/* Moves past the given node: turns the `in' set from the live in set of the
+ * node to the live in set of the next one, which is equal to `out'. */
+static void nodeLivenessLeave(
+    t_nodeLiveness *liveness, t_bbNode *node, int index)
+{
+  applyNodeLiveOut(node, liveness->liveOutRegs[index], liveness->in);
 }
 
-static bool cfgPerformLivenessIteration(t_cfg *graph)
+int cfgIterateNodesLiveness(t_cfg *graph, void *context,
+    int (*callback)(t_bbNode *node, int nodeIndex, t_cfgRegSetWord *in,
+        t_cfgRegSetWord *out, void *context))
 {
-  bool modified = false;
-  t_listNode *curNode = listGetLastNode(graph->blocks);
-  while (curNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
+  int counter = 0;
+  int exitcode = 0;
 
-    // Update the liveness informations for the current basic block.
-    if (cfgUpdateLivenessOfNodesInBlock(graph, curBlock))
-      modified = true;
+  // The sets of each block are discarded before moving to the next one.
+  t_arena *scratch = newArena();
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
+    arenaReset(scratch);
+    t_nodeLiveness liveness;
+    bbComputeNodeLiveness(curBlock, scratch, &liveness);
 
-    curNode = curNode->prev;
-  }
-  return modified;
-}
+    int j = 0;
+    t_listNode *curInnerNode = curBlock->nodes.head;
+    while (curInnerNode != NULL) {
+      t_bbNode *curCFGNode = (t_bbNode *)curInnerNode->data;
 
-void cfgComputeLiveness(t_cfg *graph)
-{
-  bool modified;
-  do {
-    modified = cfgPerformLivenessIteration(graph);
-  } while (modified);
+      nodeLivenessEnter(&liveness, curCFGNode, j);
+      exitcode = callback(
+          curCFGNode, counter, liveness.in, liveness.out, context);
+      if (exitcode != 0) {
+        deleteArena(scratch);
+        return exitcode;
+      }
+      nodeLivenessLeave(&liveness, curCFGNode, j);
+
+      counter++;
+      j++;
+      curInnerNode = curInnerNode->next;
+    }
+  }
+  deleteArena(scratch);
+  return exitcode;
 }
 
 
@@ -674,21 +922,17 @@ static void dumpArrayOfCFGRegisters(t_cfgReg **array, int size, FILE *fout)
   fflush(fout);
 }
 
-static void dumpListOfCFGRegisters(t_listNode *regs, FILE *fout)
+static void dumpRegSet(t_cfg *graph, t_cfgRegSetWord *regs, FILE *fout)
 {
-  if (regs == NULL)
-    return;
   if (fout == NULL)
     return;
 
-  t_listNode *currentListNode = regs;
-  while (currentListNode != NULL) {
-    t_cfgReg *curReg = (t_cfgReg *)currentListNode->data;
+  t_cfgReg *curReg = cfgRegSetNext(graph, regs, 0);
+  while (curReg != NULL) {
     dumpCFGRegister(curReg, fout);
-    if (currentListNode->next != NULL)
+    curReg = cfgRegSetNext(graph, regs, curReg->tempRegID + 1);
+    if (curReg != NULL)
       fprintf(fout, ", ");
-
-    currentListNode = currentListNode->next;
   }
   fflush(fout);
 }
@@ -697,19 +941,10 @@ static int cfgComputeBBIndex(t_basicBlock *bb)
 {
   t_cfg *cfg = bb->parent;
   if (bb == cfg->endingBlock)
-    return listLength(cfg->blocks);
-
-  int res = 1;
-  t_listNode *cur = cfg->blocks;
-  while (cur) {
-    t_basicBlock *bb2 = (t_basicBlock *)cur->data;
-    if (bb2 == bb)
-      return res;
-    res++;
-    cur = cur->next;
-  }
-
-  fatalError("bug: malformed CFG, found basic block not in list");
+    return cfg->blocks.length;
+  if (bb->index < 0 || cfg->blocks.items[bb->index] != bb)
+    fatalError("bug: malformed CFG, found basic block not in list");
+  return bb->index + 1;
 }
 
 static void dumpBBList(t_listNode *list, FILE *fout)
@@ -724,7 +959,8 @@ static void dumpBBList(t_listNode *list, FILE *fout)
   }
 }
 
-static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
+static void cfgDumpBB(
+    t_basicBlock *block, FILE *fout, bool verbose, t_arena *scratch)
 {
   if (block == NULL)
     return;
@@ -738,8 +974,15 @@ static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
   dumpBBList(block->succ, fout);
   fprintf(fout, "}\n");
 
+  // The liveness of the nodes is only available after cfgComputeLiveness().
+  t_cfg *graph = block->parent;
+  bool hasLiveness = verbose && block->liveOut != NULL;
+  t_nodeLiveness liveness;
+  if (hasLiveness)
+    bbComputeNodeLiveness(block, scratch, &liveness);
+
   int count = 1;
-  t_listNode *elem = block->nodes;
+  t_listNode *elem = block->nodes.head;
   while (elem != NULL) {
     t_bbNode *curCFGNode = (t_bbNode *)elem->data;
 
@@ -758,12 +1001,16 @@ static void cfgDumpBB(t_basicBlock *block, FILE *fout, bool verbose)
       dumpArrayOfCFGRegisters(curCFGNode->uses, CFG_MAX_USES, fout);
       fprintf(fout, "}\n");
 
+      if (hasLiveness)
+        nodeLivenessEnter(&liveness, curCFGNode, count - 1);
       fprintf(fout, "    in  = {");
-      dumpListOfCFGRegisters(curCFGNode->in, fout);
+      dumpRegSet(graph, hasLiveness ? liveness.in : NULL, fout);
       fprintf(fout, "}\n");
       fprintf(fout, "    out = {");
-      dumpListOfCFGRegisters(curCFGNode->out, fout);
+      dumpRegSet(graph, hasLiveness ? liveness.out : NULL, fout);
       fprintf(fout, "}\n");
+      if (hasLiveness)
+        nodeLivenessLeave(&liveness, curCFGNode, count - 1);
     }
 
     count++;
@@ -787,22 +1034,19 @@ void cfgDump(t_cfg *graph, FILE *fout, bool verbose)
         "As a result, it does not appear in the liveness sets.\n\n");
   }
 
-  fprintf(fout, "Number of basic blocks:   %d\n", listLength(graph->blocks));
-  fprintf(
-      fout, "Number of used registers: %d\n\n", listLength(graph->registers));
+  fprintf(fout, "Number of basic blocks:   %d\n", graph->blocks.length);
+  fprintf(fout, "Number of used registers: %d\n\n", graph->registers.length);
 
   fprintf(fout, "## Basic Blocks\n\n");
 
-  int counter = 1;
-  t_listNode *curNode = graph->blocks;
-  while (curNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curNode->data;
-    fprintf(fout, "Block %d:\n", counter);
-    cfgDumpBB(curBlock, fout, verbose);
+  t_arena *scratch = newArena();
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
+    fprintf(fout, "Block %d:\n", i + 1);
+    arenaReset(scratch);
+    cfgDumpBB(curBlock, fout, verbose, scratch);
     fprintf(fout, "\n");
-
-    counter++;
-    curNode = curNode->next;
   }
+  deleteArena(scratch);
   fflush(fout);
 }
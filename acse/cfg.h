@@ -6,8 +6,10 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "program.h"
 #include "list.h"
+#include "vector.h"
 
 /**
  * @defgroup cfg Control Flow Graph
@@ -36,24 +38,31 @@ typedef struct {
   t_listNode *mcRegWhitelist;
 } t_cfgReg;
 
+/** Word of a set of temporary registers. Register sets are bitsets indexed by
+ * register identifier, stored as arrays of t_cfg.regSetWords words. A NULL
+ * register set is empty. */
+typedef uint64_t t_cfgRegSetWord;
+
+/// Number of registers in each word of a register set.
+#define CFG_REG_SET_WORD_BITS 64
+
 typedef struct t_basicBlock t_basicBlock;
 typedef struct t_cfg t_cfg;
 
-/** Node in a basic block. Represents an instruction, the temporary registers
- * it uses and/or defines, and live temporary registers in/out of the node. */
+/** Node in a basic block. Represents an instruction and the temporary
+ * registers it uses and/or defines. */
 typedef struct {
   /// Pointer to the containing basic block.
   t_basicBlock *parent;
   /// Pointer to the instruction associated with this node.
   t_instruction *instr;
+  /// Element of the list of nodes of the containing block which holds this
+  /// node, so that instructions can be inserted next to it in constant time.
+  t_listNode *listNode;
   /// Set of registers defined by this node ('def' set). NULL slots are ignored.
   t_cfgReg *defs[CFG_MAX_DEFS];
   /// Set of registers used by this node ('use' set). NULL slots are ignored.
   t_cfgReg *uses[CFG_MAX_USES];
-  /// Set of registers live at the entry of the node ('in' set).
-  t_listNode *in;
-  /// Set of registers live at the exit of the node ('out' set).
-  t_listNode *out;
 } t_bbNode;
 
 /** Structure representing a basic block, i.e. a segment of contiguous
@@ -64,18 +73,44 @@ struct t_basicBlock {
   t_cfg *parent;     ///< The containing basic block.
   t_listNode *pred;  ///< List of predecessors to this basic block.
   t_listNode *succ;  ///< List of successors to this basic block.
-  t_listNode *nodes; ///< List of instructions in the block.
+  t_list nodes;      ///< List of instructions in the block.
+  int index;         ///< Position of the block in the list of blocks.
+  /// Registers used by the block before being defined in it.
+  t_cfgRegSetWord *use;
+  /// Registers defined by the block.
+  t_cfgRegSetWord *def;
+  /// Registers live at the entry of the block.
+  t_cfgRegSetWord *liveIn;
+  /// Registers live at the exit of the block.
+  t_cfgRegSetWord *liveOut;
+  /// Whether the block is queued for the liveness analysis.
+  bool inWorklist;
+  /// Immediate dominator of the block, computed by cfgComputeDominators().
+  /// The first block is its own immediate dominator, and unreachable blocks
+  /// have none (NULL).
+  t_basicBlock *idom;
 };
 
 /** Data structure describing a control flow graph. */
 struct t_cfg {
-  /// List of all the basic blocks, in program order.
-  t_listNode *blocks;
+  /// All the basic blocks, in program order.
+  t_vector blocks;
   /// Unique final basic block. The control flow must eventually reach here.
   /// This block is always empty, and is not part of the 'blocks' list.
   t_basicBlock *endingBlock;
-  /// List of all temporary registers used in the program.
-  t_listNode *registers;
+  /// All temporary registers used in the program, in order of first use.
+  t_vector registers;
+  /// Number of words in each register set, enough for all the registers in
+  /// the `registers' vector. Computed by cfgComputeLiveness().
+  int regSetWords;
+  /// Registers in the `registers' vector indexed by their identifier, with
+  /// NULL for unused identifiers.
+  t_cfgReg **regsByID;
+  /// Number of elements in the `regsByID' array. Always enough for the
+  /// register sets.
+  int regsByIDSize;
+  /// Arena where the blocks, the nodes and the registers are allocated.
+  t_arena *arena;
 };
 
 
@@ -146,9 +181,47 @@ void deleteCFG(t_cfg *graph);
 /// @{
 
 /** Computes graph-level liveness information of temporary registers.
+ * Only the sets of registers live at the entry and exit of each block are
+ * stored, the liveness at each node is computed by cfgIterateNodesLiveness().
  *  @param graph The control flow graph. */
 void cfgComputeLiveness(t_cfg *graph);
 
+/** Iterates through the nodes in a control flow graph like cfgIterateNodes(),
+ * also passing to the callback the sets of registers live at the entry (`in')
+ * and at the exit (`out') of each node. The sets are computed one block at a
+ * time, and are valid only during the callback. Only valid after calling
+ * cfgComputeLiveness() on the graph.
+ *  @param graph    The graph that must be iterated over.
+ *  @param context  The context pointer that will be passed to the callback
+ *                  function.
+ *  @param callback The callback function that will be called at each node
+ *                  found. It can return a non-zero value to stop the
+ *                  iteration process.
+ *  @returns The value returned by the last callback invocation. */
+int cfgIterateNodesLiveness(t_cfg *graph, void *context,
+    int (*callback)(t_bbNode *node, int nodeIndex, t_cfgRegSetWord *in,
+        t_cfgRegSetWord *out, void *context));
+
+/** Finds the next register in a register set, in order of identifier.
+ * @param graph The control flow graph the set belongs to.
+ * @param set   The register set.
+ * @param start The identifier where to start the search.
+ * @return The first register in the set with an identifier greater than or
+ *         equal to `start', or NULL if there is none. */
+t_cfgReg *cfgRegSetNext(t_cfg *graph, t_cfgRegSetWord *set, t_regID start);
+
+/** Computes the immediate dominator of each block of the graph, i.e. the
+ * last block other than itself which is found on every path from the first
+ * block of the graph to the block.
+ *  @param graph The control flow graph. */
+void cfgComputeDominators(t_cfg *graph);
+
+/** Checks if a register is in a register set.
+ * @param set The register set.
+ * @param reg The identifier of the register.
+ * @return Whether the register is in the set. */
+bool cfgRegSetContains(t_cfgRegSetWord *set, t_regID reg);
+
 /** Retrieve the list of live temporary registers entering the given block.
  * Only valid after calling cfgComputeLiveness() on the graph.
  * @param bblock The basic block.
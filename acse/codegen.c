@@ -4,7 +4,6 @@
 #include <stddef.h>
 #include "errors.h"
 #include "codegen.h"
-#include "scanner.h"
 #include "target_info.h"
 
 
@@ -444,7 +443,7 @@ t_regID genLoadVariable(t_program *program, t_symbol *var)
   // Check if the symbol is an array; in that case do not generate any more
   // code. Calling emitError will eventually stop compilation anyway.
   if (isArray(var)) {
-    emitError(curFileLoc, "'%s' is an array", var->ID);
+    emitError(program->curFileLoc, "'%s' is an array", var->ID);
     return REG_0;
   }
 
@@ -464,7 +463,7 @@ void genStoreRegisterToVariable(t_program *program, t_symbol *var, t_regID reg)
   // any code (but emitting an error that will eventually stop further
   // compilation).
   if (isArray(var)) {
-    emitError(curFileLoc, "'%s' is an array", var->ID);
+    emitError(program->curFileLoc, "'%s' is an array", var->ID);
     return;
   }
 
@@ -497,7 +496,7 @@ t_regID genLoadArrayAddress(t_program *program, t_symbol *array, t_regID rIdx)
 {
   if (!isArray(array)) {
     // If the symbol is not an array, bail out returning a dummy register ID.
-    emitError(curFileLoc, "'%s' is a scalar", array->ID);
+    emitError(program->curFileLoc, "'%s' is a scalar", array->ID);
     return REG_0;
   }
   t_label *label = array->label;
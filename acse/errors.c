@@ -6,18 +6,21 @@
 #include <stdarg.h>
 #include "errors.h"
 
-int numErrors;
+_Thread_local int numErrors;
 
 
 static void printMessage(
     t_fileLocation loc, const char *category, const char *fmt, va_list arg)
 {
+  // Keep the message together when several files are compiled in parallel.
+  flockfile(stderr);
   if (loc.file && loc.row >= 0)
     fprintf(stderr, "%s:%d: %s: ", loc.file, loc.row + 1, category);
   else
     fprintf(stderr, "%s: ", category);
   vfprintf(stderr, fmt, arg);
   fputc('\n', stderr);
+  funlockfile(stderr);
 }
 
 void emitError(t_fileLocation loc, const char *fmt, ...)
@@ -24,8 +24,8 @@ typedef struct {
 /// A global constant that represents an unknown file location.
 static const t_fileLocation nullFileLocation = {NULL, -1};
 
-/// The number of errors logged by emitError up to now.
-extern int numErrors;
+/// The number of errors logged by emitError up to now by the current thread.
+extern _Thread_local int numErrors;
 
 /** Prints an error message depending on the given code.
  * Does not terminate the program.
@@ -145,13 +145,10 @@ t_listNode *listFind(t_listNode *list, void *data)
 }
 
 
-t_listNode *listRemoveNode(t_listNode *list, t_listNode *element)
+/* Removes an element from a list without freeing it. */
+static t_listNode *listUnlinkNode(t_listNode *list, t_listNode *element)
 {
-  if (list == NULL || element == NULL)
-    return list;
   assert(list->prev == NULL && "prev link of head of list not NULL");
-  if ((element->prev == NULL) && (element != list))
-    return list;
 
   if (element->prev != NULL) {
     // In the middle or at the end of the list.
@@ -171,12 +168,24 @@ t_listNode *listRemoveNode(t_listNode *list, t_listNode *element)
       list = NULL;
   }
 
-  free(element);
   // Return the new head of the list.
   return list;
 }
 
 
+t_listNode *listRemoveNode(t_listNode *list, t_listNode *element)
+{
+  if (list == NULL || element == NULL)
+    return list;
+  if ((element->prev == NULL) && (element != list))
+    return list;
+
+  list = listUnlinkNode(list, element);
+  free(element);
+  return list;
+}
+
+
 t_listNode *listFindAndRemove(t_listNode *list, void *data)
 {
   t_listNode *curNode = listFind(list, data);
@@ -241,3 +250,70 @@ t_listNode *listClone(t_listNode *list)
 {
   return listAppendList(NULL, list);
 }
+
+
+void listInit(t_list *list, t_arena *arena)
+{
+  list->head = NULL;
+  list->tail = NULL;
+  list->length = 0;
+  list->arena = arena;
+}
+
+
+t_listNode *listAddAfter(t_list *list, t_listNode *listPos, void *data)
+{
+  t_listNode *newElem;
+  if (list->arena) {
+    newElem = arenaAlloc(list->arena, sizeof(t_listNode));
+    newElem->data = data;
+    newElem->prev = NULL;
+    newElem->next = NULL;
+  } else {
+    newElem = newListNode(data);
+  }
+  list->head = listInsertNodeAfter(list->head, listPos, newElem);
+  if (newElem->next == NULL)
+    list->tail = newElem;
+  list->length++;
+  return newElem;
+}
+
+
+t_listNode *listAddBefore(t_list *list, t_listNode *listPos, void *data)
+{
+  if (!listPos) {
+    // Add at the end of the list.
+    return listAddAfter(list, list->tail, data);
+  }
+  return listAddAfter(list, listPos->prev, data);
+}
+
+
+t_listNode *listAppend(t_list *list, void *data)
+{
+  return listAddAfter(list, list->tail, data);
+}
+
+
+void listRemove(t_list *list, t_listNode *element)
+{
+  if (element == NULL)
+    return;
+  assert(list->length > 0 && "element to remove not belonging to the list");
+  if (element == list->tail)
+    list->tail = element->prev;
+  if (list->arena)
+    list->head = listUnlinkNode(list->head, element);
+  else
+    list->head = listRemoveNode(list->head, element);
+  list->length--;
+}
+
+
+void listClear(t_list *list)
+{
+  if (!list->arena)
+    deleteList(list->head);
+  listInit(list, list->arena);
+}
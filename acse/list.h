@@ -5,6 +5,7 @@
 #define LIST_H
 
 #include <stdbool.h>
+#include "arena.h"
 
 /**
  * @defgroup list Double-Linked List
@@ -164,6 +165,60 @@ t_listNode *listClone(t_listNode *list);
  * @returns NULL. */
 t_listNode *deleteList(t_listNode *list);
 
+
+/// A list that also keeps track of its last node and of its number of nodes,
+/// to add elements at the end and to count them in constant time. The nodes
+/// are linked in the same way as those of a list represented by its first
+/// node, so `head' can be traversed and searched with the functions above.
+/// An empty list has all the fields set to zero.
+typedef struct {
+  t_listNode *head; ///< The first node, or NULL if the list is empty.
+  t_listNode *tail; ///< The last node, or NULL if the list is empty.
+  int length;       ///< The number of nodes in the list.
+  /// The arena where the nodes are allocated, or NULL if they are allocated
+  /// individually. Nodes allocated in an arena are freed with the arena.
+  t_arena *arena;
+} t_list;
+
+/** Initialize an empty list.
+ * @param list  The list to be initialized.
+ * @param arena The arena where the nodes of the list will be allocated, or
+ *              NULL to allocate them individually. */
+void listInit(t_list *list, t_arena *arena);
+
+/** Add an element at the end of a list.
+ * @param list The list where to add the element.
+ * @param data The data pointer that will be associated to the new element.
+ * @returns The new element. */
+t_listNode *listAppend(t_list *list, void *data);
+
+/** Add a new element in a list after another given element.
+ * @param list    The list where to add the element.
+ * @param listPos The existing element after which the new element will be
+ *                inserted. If NULL, the element will be added at the beginning
+ *                of the list.
+ * @param data The data pointer that will be associated to the new element.
+ * @returns The new element. */
+t_listNode *listAddAfter(t_list *list, t_listNode *listPos, void *data);
+
+/** Add a new element in a list before another given element.
+ * @param list    The list where to add the element.
+ * @param listPos The existing element before which the new element will be
+ *                inserted. If NULL, the element will be added at the end
+ *                of the list.
+ * @param data The data pointer that will be associated to the new element.
+ * @returns The new element. */
+t_listNode *listAddBefore(t_list *list, t_listNode *listPos, void *data);
+
+/** Remove a given element from a list.
+ * @param list    The list where to remove an element.
+ * @param element The element to remove from the list. */
+void listRemove(t_list *list, t_listNode *element);
+
+/** Remove all the elements of a list, leaving it empty.
+ * @param list The list to be cleared. */
+void listClear(t_list *list);
+
 /**
  * @}
  */
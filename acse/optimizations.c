@@ -0,0 +1,96 @@
+/// @file optimizations.c
+/// @brief Optimization passes on the intermediate representation
+
+#include <stdbool.h>
+#include "optimizations.h"
+#include "target_info.h"
+#include "vector.h"
+
+
+/* Removes from the program the instructions in a vector, which must be in
+ * the same order as in the program. */
+static void removeInstructions(t_program *program, t_vector *instrs)
+{
+  int i = 0;
+  t_listNode *curNode = program->instructions.head;
+  while (curNode != NULL && i < instrs->length) {
+    // The instruction may be replaced by a nop to keep its label, in that
+    // case the nop is skipped.
+    t_listNode *nextNode = curNode->next;
+    if (curNode->data == instrs->items[i]) {
+      removeInstructionAt(program, curNode);
+      i++;
+    }
+    curNode = nextNode;
+  }
+}
+
+
+bool removeUnreachableCode(t_program *program, t_cfg *graph)
+{
+  t_vector unreachable;
+  vectorInit(&unreachable);
+  for (int i = 0; i < graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)graph->blocks.items[i];
+    if (curBlock->idom != NULL)
+      continue;
+    t_listNode *curNode = curBlock->nodes.head;
+    for (; curNode != NULL; curNode = curNode->next)
+      vectorAppend(&unreachable, ((t_bbNode *)curNode->data)->instr);
+  }
+
+  bool changed = unreachable.length > 0;
+  removeInstructions(program, &unreachable);
+  vectorClear(&unreachable);
+  return changed;
+}
+
+
+static int findDeadCodeNodeCallback(t_bbNode *node, int nodeIndex,
+    t_cfgRegSetWord *in, t_cfgRegSetWord *out, void *context)
+{
+  t_vector *dead = (t_vector *)context;
+  t_cfgReg *def = node->defs[0];
+  if (def == NULL || !isPureInstruction(node->instr))
+    return 0;
+  if (!cfgRegSetContains(out, def->tempRegID))
+    vectorAppend(dead, node->instr);
+  return 0;
+}
+
+bool removeDeadCode(t_program *program, t_cfg *graph)
+{
+  t_vector dead;
+  vectorInit(&dead);
+  cfgIterateNodesLiveness(graph, (void *)&dead, findDeadCodeNodeCallback);
+
+  bool changed = dead.length > 0;
+  removeInstructions(program, &dead);
+  vectorClear(&dead);
+  return changed;
+}
+
+
+bool removeRedundantCopies(t_program *program)
+{
+  bool changed = false;
+  t_listNode *curNode = program->instructions.head;
+  while (curNode != NULL) {
+    t_listNode *nextNode = curNode->next;
+    t_instruction *instr = (t_instruction *)curNode->data;
+    t_instruction *next = nextNode ? (t_instruction *)nextNode->data : NULL;
+
+    // Copies are generated as additions of zero. Keep the labeled copies
+    // which would be replaced by a nop.
+    bool isCopy = instr->opcode == OPC_ADDI && instr->immediate == 0 &&
+        instr->rDest->ID == instr->rSrc1->ID;
+    bool keepsLabel = !instr->label || (next && !next->label);
+    if (isCopy && keepsLabel) {
+      removeInstructionAt(program, curNode);
+      changed = true;
+    }
+
+    curNode = nextNode;
+  }
+  return changed;
+}
@@ -0,0 +1,49 @@
+/// @file optimizations.h
+/// @brief Optimization passes on the intermediate representation
+
+#ifndef OPTIMIZATIONS_H
+#define OPTIMIZATIONS_H
+
+#include <stdbool.h>
+#include "program.h"
+#include "cfg.h"
+
+/**
+ * @defgroup optimizations Optimizations
+ * @brief Optimization passes on the intermediate representation
+ *
+ * These functions remove redundant instructions from the program. They are
+ * enabled by the optimization level of the compiler, and run at different
+ * points of the sequence of passes (see the pass manager).
+ * @{
+ */
+
+/** Remove the instructions which can never be executed, because no path
+ *  from the beginning of the program leads to them.
+ *  @param program The program to be transformed.
+ *  @param graph   The control flow graph of the program, with the
+ *                 dominators already computed.
+ *  @returns Whether the program was modified. */
+bool removeUnreachableCode(t_program *program, t_cfg *graph);
+
+/** Remove the instructions without side effects whose result is never used.
+ *  The instructions which become useless after the removal are only found
+ *  by running the optimization again.
+ *  @param program The program to be transformed.
+ *  @param graph   The control flow graph of the program, with the liveness
+ *                 of the registers already computed.
+ *  @returns Whether the program was modified. */
+bool removeDeadCode(t_program *program, t_cfg *graph);
+
+/** Remove the copies from a register to itself, which are left by the
+ *  register allocator when the source and the destination of a copy are
+ *  allocated to the same register.
+ *  @param program The program to be transformed, after register allocation.
+ *  @returns Whether the program was modified. */
+bool removeRedundantCopies(t_program *program);
+
+/**
+ * @}
+ */
+
+#endif
@@ -33,9 +33,20 @@ typedef struct {
 /**
  * @defgroup parser Syntatic and Lexical Analysis
  * @brief Functions used for syntactic and lexical analysis
+ *
+ * The parser and the scanner are reentrant: all their state is kept in the
+ * scanner object and in the program being compiled, so that several files
+ * can be compiled at the same time by different threads.
  * @{
  */
 
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+/** Opaque state of a scanner.
+ *  @note This type is also defined by Flex-generated code. */
+typedef void *yyscan_t;
+#endif
+
 /** Performs the initial syntactic-driven translation of the source code.
  *  This function is mostly a wrapper around yyparse().
  *  @param fn The path to the source code file to be compiled.
@@ -51,10 +62,12 @@ t_program *parseProgram(char *fn);
  * @{
  */
 
-/** Report a syntax error.
+/** Report a syntax error at the current location of a program.
  *  @note This function is also used by Bison-generated code.
- *  @param msg The error message. */
-void yyerror(const char *msg);
+ *  @param scanner The scanner reading the program.
+ *  @param program The program being compiled.
+ *  @param msg     The error message. */
+void yyerror(yyscan_t scanner, t_program *program, const char *msg);
 
 /**
  * @}
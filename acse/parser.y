@@ -9,22 +9,36 @@
 #include "errors.h"
 #include "list.h"
 #include "codegen.h"
-#include "scanner.h"
 #include "parser.h"
+%}
 
-/*
- * Global variables
- */
+/* The declarations needed by the semantic values, also copied to the header
+ * file of the parser. */
+%code requires {
+#include "parser.h"
+}
 
-// The program currently being compiled.
-static t_program *program;
+/* The declarations which need the semantic values. */
+%code {
+#include "scanner.h"
 
-void yyerror(const char *msg)
+void yyerror(yyscan_t scanner, t_program *program, const char *msg)
 {
-  emitError(curFileLoc, "%s", msg);
+  emitError(program->curFileLoc, "%s", msg);
+}
 }
 
-%}
+/*
+ * Reentrancy
+ *
+ * The parser is pure, and gets the scanner and the program being compiled as
+ * parameters of yyparse(), instead of using global variables. The scanner is
+ * also passed to yylex().
+ */
+
+%define api.pure full
+%param {yyscan_t scanner}
+%parse-param {t_program *program}
 
 /*
  * Axiom declaration
@@ -442,7 +456,7 @@ var_id
   {
     t_symbol *var = getSymbol(program, $1);
     if (var == NULL) {
-      yyerror("variable not declared");
+      yyerror(scanner, program, "variable not declared");
       YYERROR;
     }
     $$ = var;
@@ -460,12 +474,16 @@ t_program *parseProgram(char *fn)
     return NULL;
   }
 
-  program = newProgram();
-  curFileLoc.file = fn;
-  curFileLoc.row = 0;
+  t_program *program = newProgram();
+  program->curFileLoc.file = fn;
+  program->curFileLoc.row = 0;
   numErrors = 0;
-  yyin = fp;
-  yyparse();
+  yyscan_t scanner;
+  if (yylex_init_extra(program, &scanner) != 0)
+    fatalError("out of memory");
+  yyset_in(fp, scanner);
+  yyparse(scanner, program);
+  yylex_destroy(scanner);
 
   if (numErrors > 0) {
     fprintf(stderr, "%d error(s) generated.\n", numErrors);
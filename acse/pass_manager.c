@@ -0,0 +1,134 @@
+/// @file pass_manager.c
+/// @brief Sequencing of the passes of the compiler and of their analyses
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pass_manager.h"
+#include "vector.h"
+#include "errors.h"
+#include "timing.h"
+
+/// A pass in the sequence of a pass manager.
+typedef struct {
+  const char *name;        ///< The name of the pass.
+  const char *description; ///< Message printed before the pass, or NULL.
+  t_passFunction function; ///< The function implementing the pass.
+  void *context;           ///< The context pointer for the function.
+} t_pass;
+
+/// Structure encapsulating the state of the pass manager.
+struct t_passManager {
+  /// The program the passes are run on.
+  t_program *program;
+  /// The passes to run, in order.
+  t_vector passes;
+  /// The control flow graph of the program, or NULL if not valid.
+  t_cfg *graph;
+  /// The set of analyses whose results are valid.
+  t_analysisSet valid;
+};
+
+
+t_passManager *newPassManager(t_program *program)
+{
+  t_passManager *result = malloc(sizeof(t_passManager));
+  if (result == NULL)
+    fatalError("out of memory");
+  result->program = program;
+  vectorInit(&result->passes);
+  result->graph = NULL;
+  result->valid = ANALYSIS_NONE;
+  return result;
+}
+
+void deletePassManager(t_passManager *pm)
+{
+  if (pm == NULL)
+    return;
+  pmInvalidate(pm, ANALYSIS_NONE);
+  for (int i = 0; i < pm->passes.length; i++)
+    free(pm->passes.items[i]);
+  vectorClear(&pm->passes);
+  free(pm);
+}
+
+
+void pmAddPass(t_passManager *pm, const char *name, const char *description,
+    t_passFunction function, void *context)
+{
+  t_pass *pass = malloc(sizeof(t_pass));
+  if (pass == NULL)
+    fatalError("out of memory");
+  pass->name = name;
+  pass->description = description;
+  pass->function = function;
+  pass->context = context;
+  vectorAppend(&pm->passes, pass);
+}
+
+void pmRun(t_passManager *pm)
+{
+  for (int i = 0; i < pm->passes.length; i++) {
+    t_pass *pass = (t_pass *)pm->passes.items[i];
+#ifndef NDEBUG
+    if (pass->description)
+      fprintf(stderr, "%s\n", pass->description);
+#endif
+    timingStart(pass->name);
+    t_analysisSet preserved = pass->function(pm, pm->program, pass->context);
+    pmInvalidate(pm, preserved);
+    timingSetCounter(TIMING_INSTRUCTIONS, pm->program->instructions.length);
+    timingSetCounter(TIMING_TEMPORARIES, pm->program->firstUnusedReg);
+    if (pm->graph)
+      timingSetCounter(TIMING_BLOCKS, pm->graph->blocks.length);
+    timingStop();
+  }
+}
+
+
+void pmInvalidate(t_passManager *pm, t_analysisSet preserved)
+{
+  pm->valid &= preserved;
+  // All the other analyses are computed on the control flow graph.
+  if (!(pm->valid & ANALYSIS_CFG)) {
+    deleteCFG(pm->graph);
+    pm->graph = NULL;
+    pm->valid = ANALYSIS_NONE;
+  }
+}
+
+t_cfg *pmGetCFG(t_passManager *pm)
+{
+  if (!(pm->valid & ANALYSIS_CFG)) {
+    timingStart("build-cfg");
+    pm->graph = programToCFG(pm->program);
+    pm->valid = ANALYSIS_CFG;
+    timingSetCounter(TIMING_BLOCKS, pm->graph->blocks.length);
+    timingStop();
+  }
+  return pm->graph;
+}
+
+t_cfg *pmGetLiveness(t_passManager *pm)
+{
+  t_cfg *graph = pmGetCFG(pm);
+  if (!(pm->valid & ANALYSIS_LIVENESS)) {
+    timingStart("liveness");
+    cfgComputeLiveness(graph);
+    pm->valid |= ANALYSIS_LIVENESS;
+    timingStop();
+  }
+  return graph;
+}
+
+t_cfg *pmGetDominators(t_passManager *pm)
+{
+  t_cfg *graph = pmGetCFG(pm);
+  if (!(pm->valid & ANALYSIS_DOMINATORS)) {
+    timingStart("dominators");
+    cfgComputeDominators(graph);
+    pm->valid |= ANALYSIS_DOMINATORS;
+    timingStop();
+  }
+  return graph;
+}
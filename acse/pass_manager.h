@@ -0,0 +1,102 @@
+/// @file pass_manager.h
+/// @brief Sequencing of the passes of the compiler and of their analyses
+
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include "program.h"
+#include "cfg.h"
+
+/**
+ * @defgroup passmgr Pass Manager
+ * @brief Sequencing of the passes of the compiler and of their analyses
+ *
+ * After parsing, the program is processed by a sequence of passes, which
+ * lower it to the target, optimize it and allocate its registers. The pass
+ * manager runs the passes in order, and keeps the results of the analyses
+ * they need (the control flow graph, the liveness of the registers and the
+ * dominators) until a pass invalidates them. In this way an analysis is only
+ * computed again when the program has actually changed.
+ * @{
+ */
+
+/// Analyses whose results are kept by the pass manager.
+typedef enum {
+  ANALYSIS_CFG = 1 << 0,        ///< The control flow graph of the program.
+  ANALYSIS_LIVENESS = 1 << 1,   ///< The liveness of the registers in the CFG.
+  ANALYSIS_DOMINATORS = 1 << 2, ///< The dominators of the blocks in the CFG.
+} t_analysis;
+
+/// Set of analyses, as a combination of t_analysis values.
+typedef int t_analysisSet;
+
+/// The empty set of analyses.
+#define ANALYSIS_NONE ((t_analysisSet)0)
+/// The set of all the analyses.
+#define ANALYSIS_ALL \
+  ((t_analysisSet)(ANALYSIS_CFG | ANALYSIS_LIVENESS | ANALYSIS_DOMINATORS))
+
+/** Opaque pass manager object. */
+typedef struct t_passManager t_passManager;
+
+/** Function implementing a pass.
+ * The analyses needed by the pass are obtained from the pass manager with
+ * pmGetCFG() and the related functions.
+ * @param pm      The pass manager running the pass.
+ * @param program The program to be transformed.
+ * @param context The context pointer given to pmAddPass().
+ * @returns The set of analyses which are still valid after the pass. */
+typedef t_analysisSet (*t_passFunction)(
+    t_passManager *pm, t_program *program, void *context);
+
+/** Create a new pass manager with no passes.
+ * @param program The program the passes will be run on.
+ * @returns The new pass manager. */
+t_passManager *newPassManager(t_program *program);
+
+/** Free a pass manager and the results of the analyses it keeps.
+ * @param pm The pass manager. */
+void deletePassManager(t_passManager *pm);
+
+/** Add a pass at the end of the sequence of passes of a pass manager.
+ * @param pm          The pass manager.
+ * @param name        The name of the pass.
+ * @param description Message printed before running the pass in debug
+ *                    builds, or NULL.
+ * @param function    The function implementing the pass.
+ * @param context     A pointer passed unchanged to the function. */
+void pmAddPass(t_passManager *pm, const char *name, const char *description,
+    t_passFunction function, void *context);
+
+/** Run all the passes of a pass manager, in order.
+ * @param pm The pass manager. */
+void pmRun(t_passManager *pm);
+
+/** Discard the results of the analyses not in the given set. The liveness
+ * and the dominators are discarded as well when the control flow graph is.
+ * @param pm        The pass manager.
+ * @param preserved The set of analyses which are still valid. */
+void pmInvalidate(t_passManager *pm, t_analysisSet preserved);
+
+/** Get the control flow graph of the program, building it if needed.
+ * @param pm The pass manager.
+ * @returns The control flow graph, owned by the pass manager. */
+t_cfg *pmGetCFG(t_passManager *pm);
+
+/** Get the control flow graph of the program with the liveness of the
+ * registers, computing them if needed.
+ * @param pm The pass manager.
+ * @returns The control flow graph, owned by the pass manager. */
+t_cfg *pmGetLiveness(t_passManager *pm);
+
+/** Get the control flow graph of the program with the immediate dominator
+ * of each block, computing them if needed.
+ * @param pm The pass manager.
+ * @returns The control flow graph, owned by the pass manager. */
+t_cfg *pmGetDominators(t_passManager *pm);
+
+/**
+ * @}
+ */
+
+#endif
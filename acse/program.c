@@ -4,59 +4,51 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <assert.h>
 #include "errors.h"
 #include "program.h"
-#include "scanner.h"
 #include "codegen.h"
 #include "target_info.h"
 #include "target_asm_print.h"
 
 
-static t_label *newLabel(unsigned int value)
+static t_label *newLabel(t_arena *arena, unsigned int value)
 {
-  t_label *result = (t_label *)malloc(sizeof(t_label));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_label *result = (t_label *)arenaAlloc(arena, sizeof(t_label));
   result->labelID = value;
   result->name = NULL;
   result->global = 0;
   result->isAlias = 0;
+  result->isAssigned = false;
+  result->nextWithSameID = NULL;
   return result;
 }
 
-void deleteLabel(t_label *lab)
-{
-  free(lab->name);
-  free(lab);
-}
 
-void deleteLabels(t_listNode *labels)
+/* Allocates memory for an object of an instruction, in the given arena or
+ * with malloc() if the arena is NULL. */
+static void *instrAlloc(t_arena *arena, size_t size)
 {
-  t_listNode *curNode = labels;
-  while (curNode != NULL) {
-    t_label *curLabel = (t_label *)curNode->data;
-    deleteLabel(curLabel);
-    curNode = curNode->next;
-  }
-  deleteList(labels);
+  if (arena)
+    return arenaAlloc(arena, size);
+  void *result = malloc(size);
+  if (result == NULL)
+    fatalError("out of memory");
+  return result;
 }
 
-
-t_instrArg *newInstrArg(t_regID ID)
+t_instrArg *newInstrArg(t_arena *arena, t_regID ID)
 {
-  t_instrArg *result = (t_instrArg *)malloc(sizeof(t_instrArg));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_instrArg *result = (t_instrArg *)instrAlloc(arena, sizeof(t_instrArg));
   result->ID = ID;
   result->mcRegWhitelist = NULL;
   return result;
 }
 
-t_instruction *newInstruction(int opcode)
+t_instruction *newInstruction(t_arena *arena, int opcode)
 {
-  t_instruction *result = (t_instruction *)malloc(sizeof(t_instruction));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_instruction *result =
+      (t_instruction *)instrAlloc(arena, sizeof(t_instruction));
   result->opcode = opcode;
   result->rDest = NULL;
   result->rSrc1 = NULL;
@@ -65,50 +57,46 @@ t_instruction *newInstruction(int opcode)
   result->label = NULL;
   result->addressParam = NULL;
   result->comment = NULL;
+  result->sourceLoc = nullFileLocation;
+  result->isHeapAllocated = arena == NULL;
   return result;
 }
 
+/* Frees the memory of an instruction which is not owned by the arena of the
+ * program. Comments are always allocated in the arena. */
 void deleteInstruction(t_instruction *inst)
 {
   if (inst == NULL)
     return;
-  if (inst->rDest != NULL) {
-    deleteList(inst->rDest->mcRegWhitelist);
-    free(inst->rDest);
-  }
-  if (inst->rSrc1 != NULL) {
-    deleteList(inst->rSrc1->mcRegWhitelist);
-    free(inst->rSrc1);
-  }
-  if (inst->rSrc2 != NULL) {
-    deleteList(inst->rSrc2->mcRegWhitelist);
-    free(inst->rSrc2);
+  t_instrArg *args[] = {inst->rDest, inst->rSrc1, inst->rSrc2};
+  for (int i = 0; i < 3; i++) {
+    if (args[i] == NULL)
+      continue;
+    deleteList(args[i]->mcRegWhitelist);
+    if (inst->isHeapAllocated)
+      free(args[i]);
   }
-  free(inst->comment);
-  free(inst);
+  if (inst->isHeapAllocated)
+    free(inst);
 }
 
-void deleteInstructions(t_listNode *instructions)
+void deleteInstructions(t_list *instructions)
 {
-  if (instructions == NULL)
-    return;
-
-  t_listNode *curNode = instructions;
+  t_listNode *curNode = instructions->head;
   while (curNode != NULL) {
     t_instruction *curInstr = (t_instruction *)curNode->data;
     deleteInstruction(curInstr);
     curNode = curNode->next;
   }
 
-  deleteList(instructions);
+  listClear(instructions);
 }
 
 
-t_symbol *newSymbol(char *ID, t_symbolType type, int arraySize)
+t_symbol *newSymbol(
+    t_arena *arena, char *ID, t_symbolType type, int arraySize)
 {
-  t_symbol *result = (t_symbol *)malloc(sizeof(t_symbol));
-  if (result == NULL)
-    fatalError("out of memory");
+  t_symbol *result = (t_symbol *)arenaAlloc(arena, sizeof(t_symbol));
   result->type = type;
   result->arraySize = arraySize;
   result->ID = ID;
@@ -119,22 +107,18 @@ t_symbol *newSymbol(char *ID, t_symbolType type, int arraySize)
 static void deleteSymbol(t_symbol *s)
 {
   free(s->ID);
-  free(s);
 }
 
-static void deleteSymbols(t_listNode *variables)
+static void deleteSymbols(t_list *variables)
 {
-  if (variables == NULL)
-    return;
-
-  t_listNode *curNode = variables;
+  t_listNode *curNode = variables->head;
   while (curNode != NULL) {
     t_symbol *curSymbol = (t_symbol *)curNode->data;
     deleteSymbol(curSymbol);
     curNode = curNode->next;
   }
 
-  deleteList(variables);
+  listClear(variables);
 }
 
 
@@ -143,12 +127,18 @@ t_program *newProgram(void)
   t_program *result = (t_program *)malloc(sizeof(t_program));
   if (result == NULL)
     fatalError("out of memory");
-  result->symbols = NULL;
-  result->instructions = NULL;
+  result->arena = newArena();
+  listInit(&result->symbols, result->arena);
+  listInit(&result->instructions, result->arena);
   result->firstUnusedReg = 1; // We are excluding register R0.
-  result->labels = NULL;
+  listInit(&result->labels, result->arena);
   result->firstUnusedLblID = 0;
   result->pendingLabel = NULL;
+  stringMapInit(&result->symbolsByID, result->arena);
+  vectorInit(&result->labelsByID);
+  stringMapInit(&result->labelNameCounts, result->arena);
+  result->curFileLoc = nullFileLocation;
+  result->lastFileLoc = nullFileLocation;
 
   // Create the start label.
   t_label *lStart = createLabel(result);
@@ -163,43 +153,94 @@ void deleteProgram(t_program *program)
 {
   if (program == NULL)
     return;
-  deleteSymbols(program->symbols);
-  deleteInstructions(program->instructions);
-  deleteLabels(program->labels);
+  // The labels and most of the memory of the symbols and instructions are
+  // owned by the arena.
+  deleteSymbols(&program->symbols);
+  deleteInstructions(&program->instructions);
+  stringMapClear(&program->symbolsByID);
+  vectorClear(&program->labelsByID);
+  stringMapClear(&program->labelNameCounts);
+  deleteArena(program->arena);
   free(program);
 }
 
 
+/* Returns the name of the labels with the given ID, as getLabelName() would.
+ * The buffer is used for the generated names, and must be at least 24
+ * characters long. */
+static const char *labelIDName(
+    t_program *program, unsigned int labelID, char *buf)
+{
+  t_label *first = program->labelsByID.items[labelID];
+  if (first->name)
+    return first->name;
+  snprintf(buf, 24, "l_%d", labelID);
+  return buf;
+}
+
+/* Adds `delta' to the number of label IDs with the name of the given ID. */
+static void updateLabelNameCount(
+    t_program *program, unsigned int labelID, int delta)
+{
+  char buf[24];
+  const char *name = labelIDName(program, labelID, buf);
+  int count = LIST_DATA_TO_INT(stringMapGet(&program->labelNameCounts, name));
+  stringMapSet(
+      &program->labelNameCounts, name, INT_TO_LIST_DATA(count + delta));
+}
+
 t_label *createLabel(t_program *program)
 {
-  t_label *result = newLabel(program->firstUnusedLblID);
-  if (result == NULL)
-    fatalError("out of memory");
+  t_label *result = newLabel(program->arena, program->firstUnusedLblID);
   program->firstUnusedLblID++;
-  program->labels = listInsert(program->labels, result, -1);
+  listAppend(&program->labels, result);
+  int index = vectorAppend(&program->labelsByID, result);
+  assert(index == (int)result->labelID);
+  updateLabelNameCount(program, result->labelID, 1);
   return result;
 }
 
 /* Set a name to a label without resolving duplicates. */
 void setRawLabelName(t_program *program, t_label *label, const char *finalName)
 {
-  t_listNode *i;
-
-  // Check the entire list of labels because there might be two
-  // label objects with the same ID and they need to be kept in sync.
-  for (i = program->labels; i != NULL; i = i->next) {
-    t_label *thisLab = i->data;
-
-    if (thisLab->labelID == label->labelID) {
-      // Found! Remove old name.
-      free(thisLab->name);
-      // Change to new name.
-      if (finalName)
-        thisLab->name = strdup(finalName);
-      else
-        thisLab->name = NULL;
-    }
+  updateLabelNameCount(program, label->labelID, -1);
+
+  // There might be more label objects with the same ID and they need to be
+  // kept in sync. The old names are freed with the arena.
+  t_label *thisLab = program->labelsByID.items[label->labelID];
+  for (; thisLab != NULL; thisLab = thisLab->nextWithSameID) {
+    if (finalName)
+      thisLab->name = arenaStrdup(program->arena, finalName);
+    else
+      thisLab->name = NULL;
   }
+
+  updateLabelNameCount(program, label->labelID, 1);
+}
+
+/* Moves a label object to the list of the label objects with another ID. */
+static void changeLabelID(
+    t_program *program, t_label *label, unsigned int labelID)
+{
+  if (label->labelID == labelID)
+    return;
+
+  // Unlink the label from the objects with its old ID. If it was the last one,
+  // its old ID and name are not used anymore.
+  t_label **prev = (t_label **)&program->labelsByID.items[label->labelID];
+  while (*prev != label)
+    prev = &(*prev)->nextWithSameID;
+  if (prev == (t_label **)&program->labelsByID.items[label->labelID] &&
+      label->nextWithSameID == NULL)
+    updateLabelNameCount(program, label->labelID, -1);
+  *prev = label->nextWithSameID;
+
+  // Insert it after the first object with the new ID, which keeps giving the
+  // name of the ID until the names are synchronized.
+  t_label *first = program->labelsByID.items[labelID];
+  label->nextWithSameID = first->nextWithSameID;
+  first->nextWithSameID = label;
+  label->labelID = labelID;
 }
 
 void setLabelName(t_program *program, t_label *label, const char *name)
@@ -221,29 +262,17 @@ void setLabelName(t_program *program, t_label *label, const char *name)
     fatalError("out of memory");
   snprintf(finalName, allocatedSpace, "%s", sanitizedName);
   int serial = -1;
-  bool ok;
-  do {
-    t_listNode *i;
-    ok = true;
-    for (i = program->labels; i != NULL; i = i->next) {
-      t_label *thisLab = i->data;
-      char *thisLabName;
-      int difference;
-
-      if (thisLab->labelID == label->labelID)
-        continue;
-
-      thisLabName = getLabelName(thisLab);
-      difference = strcmp(finalName, thisLabName);
-      free(thisLabName);
-
-      if (difference == 0) {
-        ok = false;
-        snprintf(finalName, allocatedSpace, "%s_%d", sanitizedName, ++serial);
-        break;
-      }
-    }
-  } while (!ok);
+  while (true) {
+    // Count the other label IDs with the same name.
+    char buf[24];
+    int count = LIST_DATA_TO_INT(
+        stringMapGet(&program->labelNameCounts, finalName));
+    if (strcmp(labelIDName(program, label->labelID, buf), finalName) == 0)
+      count--;
+    if (count == 0)
+      break;
+    snprintf(finalName, allocatedSpace, "%s_%d", sanitizedName, ++serial);
+  }
 
   free(sanitizedName);
   setRawLabelName(program, label, finalName);
@@ -253,11 +282,8 @@ void setLabelName(t_program *program, t_label *label, const char *name)
 void assignLabel(t_program *program, t_label *label)
 {
   // Check if this label has already been assigned.
-  for (t_listNode *li = program->instructions; li != NULL; li = li->next) {
-    t_instruction *instr = li->data;
-    if (instr->label && instr->label->labelID == label->labelID)
-      fatalError("bug: label already assigned");
-  }
+  if (label->isAssigned)
+    fatalError("bug: label already assigned");
 
   // Test if the next instruction already has a label.
   if (program->pendingLabel != NULL) {
@@ -276,7 +302,7 @@ void assignLabel(t_program *program, t_label *label)
       name = strdup(name);
 
     // Change ID and name.
-    label->labelID = (program->pendingLabel)->labelID;
+    changeLabelID(program, label, program->pendingLabel->labelID);
     setRawLabelName(program, label, name);
 
     // Promote both labels to global if at least one is global.
@@ -311,40 +337,44 @@ char *getLabelName(t_label *label)
 
 void addInstruction(t_program *program, t_instruction *instr)
 {
-  static t_fileLocation lastFileLoc = {NULL, -1};
-
   // Assign the currently pending label if there is one.
   instr->label = program->pendingLabel;
   program->pendingLabel = NULL;
+  if (instr->label) {
+    t_label *lab = program->labelsByID.items[instr->label->labelID];
+    for (; lab != NULL; lab = lab->nextWithSameID)
+      lab->isAssigned = true;
+  }
 
   // Add a comment with the line number.
-  if (curFileLoc.row >= 0 &&
-      (curFileLoc.file != lastFileLoc.file ||
-          curFileLoc.row != lastFileLoc.row)) {
-    size_t fileNameLen = strlen(curFileLoc.file);
+  t_fileLocation loc = program->curFileLoc;
+  if (loc.row >= 0 && (loc.file != program->lastFileLoc.file ||
+                          loc.row != program->lastFileLoc.row)) {
+    size_t fileNameLen = strlen(loc.file);
     size_t strBufSz = fileNameLen + 10 + 1;
-    instr->comment = calloc(strBufSz, sizeof(char));
-    if (instr->comment) {
-      snprintf(instr->comment, strBufSz, "%s:%d", curFileLoc.file,
-          curFileLoc.row + 1);
-    }
+    instr->comment = arenaAlloc(program->arena, strBufSz);
+    snprintf(instr->comment, strBufSz, "%s:%d", loc.file, loc.row + 1);
+    instr->sourceLoc = loc;
   }
-  lastFileLoc = curFileLoc;
+  program->lastFileLoc = loc;
 
   // Update the list of instructions.
-  program->instructions = listInsert(program->instructions, instr, -1);
+  listAppend(&program->instructions, instr);
 }
 
 t_instruction *genInstruction(t_program *program, int opcode, t_regID rd,
     t_regID rs1, t_regID rs2, t_label *label, int immediate)
 {
-  t_instruction *instr = newInstruction(opcode);
+  // Instructions generated without a program are allocated individually,
+  // as they may be added to the program later.
+  t_arena *arena = program ? program->arena : NULL;
+  t_instruction *instr = newInstruction(arena, opcode);
   if (rd != REG_INVALID)
-    instr->rDest = newInstrArg(rd);
+    instr->rDest = newInstrArg(arena, rd);
   if (rs1 != REG_INVALID)
-    instr->rSrc1 = newInstrArg(rs1);
+    instr->rSrc1 = newInstrArg(arena, rs1);
   if (rs2 != REG_INVALID)
-    instr->rSrc2 = newInstrArg(rs2);
+    instr->rSrc2 = newInstrArg(arena, rs2);
   if (label)
     instr->addressParam = label;
   instr->immediate = immediate;
@@ -376,8 +406,7 @@ void removeInstructionAt(t_program *program, t_listNode *instrLi)
       // instruction is already labeled.
       if (!nextInst || (nextInst->label)) {
         nextInst = genNOP(NULL);
-        program->instructions =
-            listInsertAfter(program->instructions, instrLi, nextInst);
+        listAddAfter(&program->instructions, instrLi, nextInst);
       }
       nextInst->label = instrToRemove->label;
       instrToRemove->label = NULL;
@@ -386,12 +415,14 @@ void removeInstructionAt(t_program *program, t_listNode *instrLi)
     // Move the comment, if possible; otherwise it will be discarded.
     if (nextInst && instrToRemove->comment && !nextInst->comment) {
       nextInst->comment = instrToRemove->comment;
+      nextInst->sourceLoc = instrToRemove->sourceLoc;
       instrToRemove->comment = NULL;
+      instrToRemove->sourceLoc = nullFileLocation;
     }
   }
 
   // Remove the instruction.
-  program->instructions = listRemoveNode(program->instructions, instrLi);
+  listRemove(&program->instructions, instrLi);
   deleteInstruction(instrToRemove);
 }
 
@@ -411,19 +442,20 @@ t_symbol *createSymbol(
     fatalError("bug: invalid type");
   // Check array size validity.
   if (type == TYPE_INT_ARRAY && arraySize <= 0) {
-    emitError(curFileLoc, "invalid size %d for array %s", arraySize, ID);
+    emitError(program->curFileLoc, "invalid size %d for array %s", arraySize,
+        ID);
     return NULL;
   }
 
   // Check if another symbol already exists with the same ID.
   t_symbol *existingSym = getSymbol(program, ID);
   if (existingSym != NULL) {
-    emitError(curFileLoc, "variable '%s' already declared", ID);
+    emitError(program->curFileLoc, "variable '%s' already declared", ID);
     return NULL;
   }
 
   // Allocate and initialize a new symbol object.
-  t_symbol *res = newSymbol(ID, type, arraySize);
+  t_symbol *res = newSymbol(program->arena, ID, type, arraySize);
 
   // Reserve a new label for the variable.
   res->label = createLabel(program);
@@ -437,7 +469,8 @@ t_symbol *createSymbol(
   free(lblName);
 
   // Now we can add the new variable to the program.
-  program->symbols = listInsert(program->symbols, res, -1);
+  listAppend(&program->symbols, res);
+  stringMapSet(&program->symbolsByID, ID, res);
   return res;
 }
 
@@ -451,24 +484,10 @@ bool isArray(t_symbol *symbol)
 }
 
 
-static bool compareVariableWithIDString(void *a, void *b)
-{
-  t_symbol *var = (t_symbol *)a;
-  char *str = (char *)b;
-  return strcmp(var->ID, str) == 0;
-}
-
 t_symbol *getSymbol(t_program *program, char *ID)
 {
-  // Search inside the list of variables.
-  t_listNode *elementFound =
-      listFindWithCallback(program->symbols, ID, compareVariableWithIDString);
-
-  // If the element is found return it to the caller. Otherwise return NULL.
-  if (elementFound != NULL)
-    return (t_symbol *)elementFound->data;
-
-  return NULL;
+  // Returns NULL if there is no symbol with this identifier.
+  return (t_symbol *)stringMapGet(&program->symbolsByID, ID);
 }
 
 
@@ -479,8 +498,8 @@ void genEpilog(t_program *program)
     return;
   }
 
-  if (program->instructions != NULL) {
-    t_listNode *lastNode = listGetLastNode(program->instructions);
+  if (program->instructions.tail != NULL) {
+    t_listNode *lastNode = program->instructions.tail;
     t_instruction *lastInstr = (t_instruction *)lastNode->data;
     if (lastInstr->opcode == OPC_CALL_EXIT_0)
       return;
@@ -495,7 +514,7 @@ void programDump(t_program *program, FILE *fout)
   fprintf(fout, "# Program dump\n\n");
 
   fprintf(fout, "## Variables\n\n");
-  t_listNode *curVarNode = program->symbols;
+  t_listNode *curVarNode = program->symbols.head;
   while (curVarNode) {
     t_symbol *var = curVarNode->data;
     fprintf(fout, "\"%s\":\n", var->ID);
@@ -515,7 +534,7 @@ void programDump(t_program *program, FILE *fout)
   }
 
   fprintf(fout, "\n## Instructions\n\n");
-  t_listNode *curInstNode = program->instructions;
+  t_listNode *curInstNode = program->instructions.head;
   while (curInstNode) {
     t_instruction *instr = curInstNode->data;
     if (instr == NULL)
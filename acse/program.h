@@ -7,6 +7,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "list.h"
+#include "vector.h"
+#include "string_map.h"
+#include "errors.h"
 
 /**
  * @defgroup program Program Intermediate Representation
@@ -44,7 +47,7 @@ typedef enum {
  * @note A label object does not uniquely identify a label, its labelID field
  * does. This is used for aliasing multiple label objects to the same
  * physical label if more than one label is assigned to an instruction. */
-typedef struct {
+typedef struct t_label {
   /// Unique numeric identifier for the label.
   unsigned int labelID;
   /// Name of the label. If NULL, the name will be automatically generated in
@@ -55,6 +58,10 @@ typedef struct {
   /// True if this label object is an alias to another one with the same
   /// labelID.
   bool isAlias;
+  /// True if the label has been assigned to an instruction.
+  bool isAssigned;
+  /// Next label object with the same labelID, or NULL.
+  struct t_label *nextWithSameID;
 } t_label;
 
 /** Object representing a register argument to an instruction. */
@@ -77,6 +84,13 @@ typedef struct {
   t_label *addressParam; ///< Address argument.
   /// A comment string associated with the instruction, or NULL if none.
   char *comment;
+  /// The source line whose code begins with this instruction, or
+  /// nullFileLocation. Set together with the "file:line" comment.
+  t_fileLocation sourceLoc;
+  /// True if the instruction and its arguments were allocated individually
+  /// instead of in the arena of the program, because they were generated
+  /// without a program. In that case they are freed individually as well.
+  bool isHeapAllocated;
 } t_instruction;
 
 /** A structure that represents the properties of a given symbol in the source
@@ -96,12 +110,26 @@ typedef struct t_symbol {
 /** Object containing the program's intermediate representation during the
  * compilation process. */
 typedef struct {
-  t_listNode *labels;            ///< List of all labels.
-  t_listNode *instructions;      ///< List of instructions.
-  t_listNode *symbols;           ///< Symbol table.
+  t_list labels;                 ///< List of all labels.
+  t_list instructions;           ///< List of instructions.
+  t_list symbols;                ///< Symbol table.
   t_regID firstUnusedReg;        ///< Next unused register ID.
   unsigned int firstUnusedLblID; ///< Next unused label ID.
   t_label *pendingLabel;         ///< Next pending label to assign.
+  /// Symbols indexed by identifier.
+  t_stringMap symbolsByID;
+  /// First label object of each label ID, indexed by label ID.
+  t_vector labelsByID;
+  /// Number of label IDs having each name, as returned by getLabelName().
+  t_stringMap labelNameCounts;
+  /// Arena where the instructions, labels and symbols are allocated.
+  t_arena *arena;
+  /// Location in the source file of the code being generated, used in the
+  /// error messages and in the comments of the instructions. Updated by the
+  /// scanner.
+  t_fileLocation curFileLoc;
+  /// Value of `curFileLoc' when the last instruction was added.
+  t_fileLocation lastFileLoc;
 } t_program;
 
 
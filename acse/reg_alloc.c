@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include "reg_alloc.h"
@@ -13,6 +14,7 @@
 #include "list.h"
 #include "cfg.h"
 #include "target_asm_print.h"
+#include "timing.h"
 
 /// Maximum amount of arguments to an instruction.
 #define MAX_INSTR_ARGS (CFG_MAX_DEFS + CFG_MAX_USES)
@@ -23,36 +25,55 @@
 #define RA_REGISTER_INVALID ((t_regID)(-1))
 
 
+/// Set of physical registers, with one bit for each register identifier.
+typedef uint32_t t_regSet;
+
+/// The register set containing only the given register.
+#define REG_SET_SINGLE(reg) ((t_regSet)1 << (reg))
+
+/// Ordered set of the physical registers where a temporary register can be
+/// allocated, from the most preferred to the least preferred.
+typedef struct {
+  /// The registers in the set.
+  t_regSet mask;
+  /// Number of registers in the set.
+  int numRegs;
+  /// The registers in the set, in order of preference.
+  t_regID regs[NUM_REGISTERS];
+} t_regConstraints;
+
 /// Structure describing a live interval of a register in a program.
 typedef struct {
   /// Identifier of the register.
   t_regID tempRegID;
-  /// List of all physical registers where this temporary register can be
+  /// False if the register can be allocated to any register. Only used
+  /// before the constraints are initialized.
+  bool isConstrained;
+  /// All the physical registers where this temporary register can be
   /// allocated.
-  t_listNode *mcRegConstraints;
+  t_regConstraints constraints;
   /// Index of the first instruction that uses/defines this register.
   int startPoint;
+  /// Order of the interval among the ones with the same start point.
+  int startRank;
   /// Index of the last instruction that uses/defines this register.
   int endPoint;
+  /// Sequence number of the last time the interval was made active. Among
+  /// active intervals with the same end point, the most recent comes first.
+  int activeSeq;
 } t_liveInterval;
 
-/// Structure used for mapping a spilled temporary register to the label
-/// pointing to its physical storage location in memory.
-typedef struct {
-  /// The spilled temporary register ID.
-  t_regID tempRegID;
-  /// The label pointing to the spill area.
-  t_label *label;
-} t_spillLocation;
-
 /// Structure encapsulating the state of the register allocator.
 struct t_regAllocator {
   /// The program where register allocation needs to be performed.
   t_program *program;
-  /// The temporary control flow graph produced from the program.
+  /// The control flow graph of the program, with the liveness information.
+  /// Not owned by the register allocator.
   t_cfg *graph;
-  /// List of live intervals, ordered depending on their start index.
-  t_listNode *liveIntervals;
+  /// Array of live intervals, ordered depending on their start index.
+  t_liveInterval *liveIntervals;
+  /// Number of elements in the `liveIntervals' array.
+  int numLiveIntervals;
   /// Number of temporary registers in the program.
   int tempRegNum;
   /// Pointer to a dynamically allocated array which maps every temporary
@@ -60,8 +81,9 @@ struct t_regAllocator {
   /// Temporary registers allocated to a spill location are marked by the
   /// RA_SPILL_REQUIRED virtual register ID.
   t_regID *bindings;
-  /// List of spill locations for temporary registers in the program.
-  t_listNode *spills;
+  /// Array which maps every spilled temporary register to the label pointing
+  /// to its physical storage location in memory, or to NULL.
+  t_label **spillLabels;
 };
 
 /// Structure representing the current state of an instruction argument during
@@ -94,165 +116,200 @@ typedef struct {
 } t_spillState;
 
 
-static t_liveInterval *newLiveInterval(
-    t_regID tempRegID, t_listNode *mcRegs, int startPoint, int endPoint)
+/* Initializes a set of constraints from a list of registers. */
+static void initRegConstraints(t_regConstraints *set, t_listNode *regs)
 {
-  t_liveInterval *result = malloc(sizeof(t_liveInterval));
-  if (result == NULL)
-    fatalError("out of memory");
-  result->tempRegID = tempRegID;
-  result->mcRegConstraints = listClone(mcRegs);
-  result->startPoint = startPoint;
-  result->endPoint = endPoint;
-  return result;
+  set->mask = 0;
+  set->numRegs = 0;
+  for (; regs; regs = regs->next) {
+    t_regID reg = (t_regID)LIST_DATA_TO_INT(regs->data);
+    if (set->mask & REG_SET_SINGLE(reg))
+      continue;
+    set->mask |= REG_SET_SINGLE(reg);
+    set->regs[set->numRegs++] = reg;
+  }
 }
 
-static void deleteLiveInterval(t_liveInterval *interval)
+/* Returns the set of the registers in a list. */
+static t_regSet listToRegSet(t_listNode *regs)
 {
-  if (interval == NULL)
-    return;
-  free(interval->mcRegConstraints);
-  free(interval);
+  t_regSet result = 0;
+  for (; regs; regs = regs->next)
+    result |= REG_SET_SINGLE(LIST_DATA_TO_INT(regs->data));
+  return result;
 }
 
-/* Given two live intervals, compare them by the start point (find whichever
- * starts first). */
-static int compareLiveIntStartPoints(void *varA, void *varB)
+/* Move the registers of set `a` which are also in the array `b` to the front
+ * of the set. */
+static void optimizeRegisterSet(t_regConstraints *a, const t_regID *b, int n)
 {
-  t_liveInterval *liA = (t_liveInterval *)varA;
-  t_liveInterval *liB = (t_liveInterval *)varB;
-
-  if (varA == NULL)
-    return 0;
-  if (varB == NULL)
-    return 0;
-
-  return liA->startPoint - liB->startPoint;
+  for (int i = 0; i < n; i++) {
+    if (!(a->mask & REG_SET_SINGLE(b[i])))
+      continue;
+    int pos = 0;
+    while (a->regs[pos] != b[i])
+      pos++;
+    memmove(&a->regs[1], &a->regs[0], sizeof(t_regID) * (size_t)pos);
+    a->regs[0] = b[i];
+  }
 }
 
-/* Given two live intervals, compare them by the end point (find whichever
- * ends first). */
-static int compareLiveIntEndPoints(void *varA, void *varB)
+static void subtractRegisterSets(t_regConstraints *a, t_regSet b)
 {
-  t_liveInterval *liA = (t_liveInterval *)varA;
-  t_liveInterval *liB = (t_liveInterval *)varB;
-
-  if (varA == NULL)
-    return 0;
-  if (varB == NULL)
-    return 0;
-
-  return liA->endPoint - liB->endPoint;
+  if (!(a->mask & b))
+    return;
+  a->mask &= ~b;
+  int n = 0;
+  for (int i = 0; i < a->numRegs; i++) {
+    if (a->mask & REG_SET_SINGLE(a->regs[i]))
+      a->regs[n++] = a->regs[i];
+  }
+  a->numRegs = n;
 }
 
-/* Given two live intervals, check if they refer to the same interval. */
-static bool compareLiveIntWithRegID(void *a, void *b)
-{
-  t_liveInterval *interval = (t_liveInterval *)a;
-  t_regID tempRegID = *((t_regID *)b);
-  return interval->tempRegID == tempRegID;
-}
 
-/* Update the liveness interval list to account for the fact that variable 'var'
- * is live at index 'counter' in the current program.
- * If the variable already appears in the list, its live interval its prolonged
+/* Update the live intervals to account for the fact that variable 'var' is
+ * live at index 'counter' in the current program.
+ * If the variable already has an interval, its live interval its prolonged
  * to include the given counter location.
  * Otherwise, a new liveness interval is generated for it. */
-static t_listNode *updateIntervalsWithLiveVarAtLocation(
-    t_listNode *intervals, t_cfgReg *var, int counter)
+static void updateIntervalsWithLiveVarAtLocation(t_regAllocator *ra,
+    int *intervalIndexes, t_cfgReg *var, int counter, int startRank)
 {
   // Search if there's already a liveness interval for the variable.
-  t_listNode *element_found = listFindWithCallback(
-      intervals, &(var->tempRegID), compareLiveIntWithRegID);
-
-  if (!element_found) {
-    // It's not there: add a new interval at the end of the list.
-    t_liveInterval *interval =
-        newLiveInterval(var->tempRegID, var->mcRegWhitelist, counter, counter);
-    intervals = listInsert(intervals, interval, -1);
+  int index = intervalIndexes[var->tempRegID];
+
+  if (index < 0) {
+    // It's not there: add a new interval at the end of the array.
+    index = ra->numLiveIntervals++;
+    intervalIndexes[var->tempRegID] = index;
+    t_liveInterval *interval = &ra->liveIntervals[index];
+    interval->tempRegID = var->tempRegID;
+    interval->isConstrained = var->mcRegWhitelist != NULL;
+    initRegConstraints(&interval->constraints, var->mcRegWhitelist);
+    interval->startPoint = counter;
+    interval->startRank = startRank;
+    interval->endPoint = counter;
+    interval->activeSeq = 0;
   } else {
     // It's there: update the interval range.
-    t_liveInterval *interval_found = (t_liveInterval *)element_found->data;
+    t_liveInterval *interval_found = &ra->liveIntervals[index];
     // Counter should always be increasing!
     assert(interval_found->startPoint <= counter);
     assert(interval_found->endPoint <= counter);
     interval_found->endPoint = counter;
   }
-
-  return intervals;
 }
 
-/* Add/augment the live interval list with the variables live at a given
- * instruction location in the program. */
-static t_listNode *updateIntervalsWithInstrAtLocation(
-    t_listNode *result, t_bbNode *node, int counter)
+/// Context of the callback used by getLiveIntervals().
+typedef struct {
+  t_regAllocator *ra;
+  /// Index in the array of live intervals of each temporary register, or -1.
+  int *intervalIndexes;
+} t_liveIntervalsContext;
+
+/* Returns the rank of an interval starting at a node, given the registers
+ * live in and out of the node: 0 if the register is live at the entry of the
+ * node, 1 if it is only live at its exit, 2 if it is defined and never
+ * used. */
+static int getStartRank(
+    t_cfgRegSetWord *in, t_cfgRegSetWord *out, t_cfgReg *var)
 {
-  t_listNode *elem;
+  if (cfgRegSetContains(in, var->tempRegID))
+    return 0;
+  if (cfgRegSetContains(out, var->tempRegID))
+    return 1;
+  return 2;
+}
 
-  elem = node->in;
-  while (elem != NULL) {
-    t_cfgReg *curCFGReg = (t_cfgReg *)elem->data;
-    result = updateIntervalsWithLiveVarAtLocation(result, curCFGReg, counter);
-    elem = elem->next;
+/* Add/augment the live intervals with the variables live at a given
+ * instruction location in the program.
+ *   Only the endpoints of the live intervals are needed, so the whole live
+ * sets are only scanned at the beginning and at the end of each block. In the
+ * middle of a block, a register can only start being live when it is defined
+ * and stop being live after its last use. */
+static int getLiveIntervalsNodeCallback(t_bbNode *node, int nodeIndex,
+    t_cfgRegSetWord *in, t_cfgRegSetWord *out, void *context)
+{
+  t_liveIntervalsContext *ctx = (t_liveIntervalsContext *)context;
+  t_cfg *graph = node->parent->parent;
+  t_cfgReg *curCFGReg;
+
+  if (node->parent->nodes.head->data == node) {
+    curCFGReg = cfgRegSetNext(graph, in, 0);
+    while (curCFGReg != NULL) {
+      updateIntervalsWithLiveVarAtLocation(
+          ctx->ra, ctx->intervalIndexes, curCFGReg, nodeIndex, 0);
+      curCFGReg = cfgRegSetNext(graph, in, curCFGReg->tempRegID + 1);
+    }
   }
 
-  elem = node->out;
-  while (elem != NULL) {
-    t_cfgReg *curCFGReg = (t_cfgReg *)elem->data;
-    result = updateIntervalsWithLiveVarAtLocation(result, curCFGReg, counter);
-    elem = elem->next;
+  for (int i = 0; i < CFG_MAX_USES; i++) {
+    // Uses of registers which are never live are ignored.
+    curCFGReg = node->uses[i];
+    if (curCFGReg && cfgRegSetContains(in, curCFGReg->tempRegID))
+      updateIntervalsWithLiveVarAtLocation(
+          ctx->ra, ctx->intervalIndexes, curCFGReg, nodeIndex, 0);
   }
 
   for (int i = 0; i < CFG_MAX_DEFS; i++) {
-    if (node->defs[i])
-      result =
-          updateIntervalsWithLiveVarAtLocation(result, node->defs[i], counter);
+    curCFGReg = node->defs[i];
+    if (curCFGReg)
+      updateIntervalsWithLiveVarAtLocation(ctx->ra, ctx->intervalIndexes,
+          curCFGReg, nodeIndex, getStartRank(in, out, curCFGReg));
   }
 
-  return result;
-}
+  if (node->parent->nodes.tail->data == node) {
+    curCFGReg = cfgRegSetNext(graph, out, 0);
+    while (curCFGReg != NULL) {
+      updateIntervalsWithLiveVarAtLocation(ctx->ra, ctx->intervalIndexes,
+          curCFGReg, nodeIndex, getStartRank(in, out, curCFGReg));
+      curCFGReg = cfgRegSetNext(graph, out, curCFGReg->tempRegID + 1);
+    }
+  }
 
-static int getLiveIntervalsNodeCallback(
-    t_bbNode *node, int nodeIndex, void *context)
-{
-  t_listNode **list = (t_listNode **)context;
-  *list = updateIntervalsWithInstrAtLocation(*list, node, nodeIndex);
   return 0;
 }
 
-/* Collect a list of live intervals from the in/out sets in the CFG.
- * Since cfgIterateNodes passes incrementing counter values to the
- * callback, the list returned from here is already ordered. */
-static t_listNode *getLiveIntervals(t_cfg *graph)
+/* Given two live intervals, compare them by the start point (find whichever
+ * starts first). Intervals starting at the same point are ordered by rank,
+ * then by register identifier. */
+static int compareLiveIntStartPoints(const void *varA, const void *varB)
 {
-  t_listNode *result = NULL;
-  cfgIterateNodes(graph, (void *)&result, getLiveIntervalsNodeCallback);
-  return result;
+  const t_liveInterval *liA = (const t_liveInterval *)varA;
+  const t_liveInterval *liB = (const t_liveInterval *)varB;
+
+  if (liA->startPoint != liB->startPoint)
+    return liA->startPoint - liB->startPoint;
+  if (liA->startRank != liB->startRank)
+    return liA->startRank - liB->startRank;
+  return liA->tempRegID - liB->tempRegID;
 }
 
-
-/* Move the elements in list `a` which are also contained in list `b` to the
- * front of the list. */
-static t_listNode *optimizeRegisterSet(t_listNode *a, t_listNode *b)
+/* Collect the live intervals from the in/out sets in the CFG, ordered by
+ * start point. */
+static void getLiveIntervals(t_regAllocator *ra)
 {
-  for (; b; b = b->next) {
-    t_listNode *old;
-    if ((old = listFind(a, b->data))) {
-      a = listRemoveNode(a, old);
-      a = listInsert(a, b->data, 0);
-    }
-  }
-  return a;
-}
+  t_liveIntervalsContext ctx;
+  ctx.ra = ra;
+  ctx.intervalIndexes = malloc(sizeof(int) * (size_t)ra->tempRegNum);
+  ra->liveIntervals = calloc(
+      (size_t)ra->graph->registers.length + 1, sizeof(t_liveInterval));
+  if (ctx.intervalIndexes == NULL || ra->liveIntervals == NULL)
+    fatalError("out of memory");
+  for (int i = 0; i < ra->tempRegNum; i++)
+    ctx.intervalIndexes[i] = -1;
+  ra->numLiveIntervals = 0;
 
-static t_listNode *subtractRegisterSets(t_listNode *a, t_listNode *b)
-{
-  for (; b; b = b->next) {
-    a = listFindAndRemove(a, b->data);
-  }
-  return a;
+  cfgIterateNodesLiveness(
+      ra->graph, (void *)&ctx, getLiveIntervalsNodeCallback);
+  free(ctx.intervalIndexes);
+
+  qsort(ra->liveIntervals, (size_t)ra->numLiveIntervals,
+      sizeof(t_liveInterval), compareLiveIntStartPoints);
 }
 
+
 /* Create register constraint sets for all temporaries that don't have one.
  * This is the main function that makes register allocation with constraints
  * work.
@@ -265,75 +322,102 @@ static t_listNode *subtractRegisterSets(t_listNode *a, t_listNode *b)
  * constraints, but in ACSE this doesn't happen. */
 static void initializeRegisterConstraints(t_regAllocator *ra)
 {
-  t_listNode *i = ra->liveIntervals;
-  for (; i; i = i->next) {
-    t_liveInterval *interval = i->data;
+  // Only the intervals with constraints are scanned for each interval, so
+  // collect their indexes first.
+  int *constrained = malloc(sizeof(int) * (size_t)(ra->numLiveIntervals + 1));
+  if (constrained == NULL)
+    fatalError("out of memory");
+  int numConstrained = 0;
+  for (int i = 0; i < ra->numLiveIntervals; i++) {
+    if (ra->liveIntervals[i].isConstrained)
+      constrained[numConstrained++] = i;
+  }
+
+  t_listNode *genPurposeRegs = getListOfGenPurposeMachineRegisters();
+  int firstAfter = 0;
+  for (int i = 0; i < ra->numLiveIntervals; i++) {
+    t_liveInterval *interval = &ra->liveIntervals[i];
+    // Skip the constrained intervals up to this one.
+    while (firstAfter < numConstrained && constrained[firstAfter] <= i)
+      firstAfter++;
     // Skip instructions that already have constraints.
-    if (interval->mcRegConstraints)
+    if (interval->isConstrained)
       continue;
     // Initial set consists of all registers.
-    interval->mcRegConstraints = getListOfGenPurposeMachineRegisters();
+    initRegConstraints(&interval->constraints, genPurposeRegs);
+    interval->isConstrained = true;
 
     // Scan the temporary registers that are alive together with this one and
     // already have constraints.
-    t_listNode *j = i->next;
-    for (; j; j = j->next) {
-      t_liveInterval *overlappingIval = j->data;
+    for (int j = firstAfter; j < numConstrained; j++) {
+      t_liveInterval *overlappingIval = &ra->liveIntervals[constrained[j]];
       if (overlappingIval->startPoint > interval->endPoint)
         break;
-      if (!overlappingIval->mcRegConstraints)
-        continue;
       if (overlappingIval->startPoint == interval->endPoint) {
         // Some instruction is using our temporary register as a source and the
         // other temporary register as a destination. Optimize the constraint
         // order to allow allocating source and destination to the same register
         // if possible.
-        interval->mcRegConstraints = optimizeRegisterSet(
-            interval->mcRegConstraints, overlappingIval->mcRegConstraints);
+        optimizeRegisterSet(&interval->constraints,
+            overlappingIval->constraints.regs,
+            overlappingIval->constraints.numRegs);
       } else {
         // Another variable (defined after this one) wants to be allocated
         // to a restricted set of registers. Punch a hole in the current
         // variable's set of allowed registers to ensure that this is
         // possible.
-        interval->mcRegConstraints = subtractRegisterSets(
-            interval->mcRegConstraints, overlappingIval->mcRegConstraints);
+        subtractRegisterSets(
+            &interval->constraints, overlappingIval->constraints.mask);
       }
     }
   }
+
+  deleteList(genPurposeRegs);
+  free(constrained);
 }
 
+/// A call instruction and the registers it clobbers.
+typedef struct {
+  int nodeIndex;
+  t_regSet clobberedRegs;
+} t_callSite;
+
+/// Context of the callback used by handleCallerSaveRegisters().
+typedef struct {
+  t_callSite *calls;
+  int numCalls;
+  int callsCapacity;
+  t_regSet callerSaveRegs;
+} t_callSitesContext;
+
 static int handleCallerSaveRegistersNodeCallback(
     t_bbNode *node, int nodeIndex, void *context)
 {
-  t_regAllocator *ra = (t_regAllocator *)context;
+  t_callSitesContext *ctx = (t_callSitesContext *)context;
 
   if (!isCallInstruction(node->instr))
     return 0;
 
-  t_listNode *clobberedRegs = getListOfCallerSaveMachineRegisters();
+  t_regSet clobberedRegs = ctx->callerSaveRegs;
   for (int i = 0; i < CFG_MAX_DEFS; i++) {
     if (node->defs[i] != NULL)
-      clobberedRegs =
-          subtractRegisterSets(clobberedRegs, node->defs[i]->mcRegWhitelist);
+      clobberedRegs &= ~listToRegSet(node->defs[i]->mcRegWhitelist);
   }
   for (int i = 0; i < CFG_MAX_USES; i++) {
     if (node->uses[i] != NULL)
-      clobberedRegs =
-          subtractRegisterSets(clobberedRegs, node->uses[i]->mcRegWhitelist);
+      clobberedRegs &= ~listToRegSet(node->uses[i]->mcRegWhitelist);
   }
 
-  t_listNode *li_ival = ra->liveIntervals;
-  while (li_ival) {
-    t_liveInterval *ival = li_ival->data;
-
-    if (ival->startPoint <= nodeIndex && nodeIndex <= ival->endPoint) {
-      ival->mcRegConstraints =
-          subtractRegisterSets(ival->mcRegConstraints, clobberedRegs);
-    }
-
-    li_ival = li_ival->next;
+  if (ctx->numCalls == ctx->callsCapacity) {
+    ctx->callsCapacity = ctx->callsCapacity ? ctx->callsCapacity * 2 : 16;
+    ctx->calls = realloc(
+        ctx->calls, sizeof(t_callSite) * (size_t)ctx->callsCapacity);
+    if (ctx->calls == NULL)
+      fatalError("out of memory");
   }
-
+  ctx->calls[ctx->numCalls].nodeIndex = nodeIndex;
+  ctx->calls[ctx->numCalls].clobberedRegs = clobberedRegs;
+  ctx->numCalls++;
   return 0;
 }
 
@@ -341,73 +425,69 @@ static int handleCallerSaveRegistersNodeCallback(
  * function calls. */
 static void handleCallerSaveRegisters(t_regAllocator *ra, t_cfg *cfg)
 {
-  cfgIterateNodes(cfg, (void *)ra, handleCallerSaveRegistersNodeCallback);
-}
-
-
-static t_spillLocation *newSpillLocation(t_label *label, t_regID tempRegID)
-{
-  t_spillLocation *result = malloc(sizeof(t_spillLocation));
-  if (result == NULL)
-    fatalError("out of memory");
-  result->label = label;
-  result->tempRegID = tempRegID;
-  return result;
-}
-
-static bool compareSpillLocWithRegId(void *a, void *b)
-{
-  t_spillLocation *spillLoc = (t_spillLocation *)a;
-  t_regID reg = *((t_regID *)b);
-
-  if (spillLoc == NULL)
-    return 0;
-  return spillLoc->tempRegID == reg;
-}
-
-static void deleteSpillLocationList(t_listNode *spills)
-{
-  if (spills == NULL)
-    return;
+  // Collect the calls, which are found in order of node index.
+  t_callSitesContext ctx = {NULL, 0, 0, 0};
+  t_listNode *callerSaveRegs = getListOfCallerSaveMachineRegisters();
+  ctx.callerSaveRegs = listToRegSet(callerSaveRegs);
+  deleteList(callerSaveRegs);
+  cfgIterateNodes(cfg, (void *)&ctx, handleCallerSaveRegistersNodeCallback);
+
+  for (int i = 0; i < ra->numLiveIntervals; i++) {
+    t_liveInterval *ival = &ra->liveIntervals[i];
+
+    // Find the first call inside the interval.
+    int lo = 0, hi = ctx.numCalls;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (ctx.calls[mid].nodeIndex < ival->startPoint)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
 
-  t_listNode *curNode = spills;
-  while (curNode != NULL) {
-    t_spillLocation *spillLoc = (t_spillLocation *)curNode->data;
-    free(spillLoc);
-    curNode = curNode->next;
+    // Remove the registers clobbered by all the calls inside the interval,
+    // stopping early if all the caller-save registers have been found.
+    t_regSet clobberedRegs = 0;
+    for (int j = lo; j < ctx.numCalls; j++) {
+      if (ctx.calls[j].nodeIndex > ival->endPoint)
+        break;
+      clobberedRegs |= ctx.calls[j].clobberedRegs;
+      if (clobberedRegs == ctx.callerSaveRegs)
+        break;
+    }
+    subtractRegisterSets(&ival->constraints, clobberedRegs);
   }
 
-  deleteList(spills);
+  free(ctx.calls);
 }
 
 
-t_regAllocator *newRegAllocator(t_program *program)
+t_regAllocator *newRegAllocator(t_program *program, t_cfg *graph)
 {
   t_regAllocator *result = (t_regAllocator *)calloc(1, sizeof(t_regAllocator));
   if (result == NULL)
     fatalError("out of memory");
+  // Register sets must have a bit for each physical register.
+  assert(NUM_REGISTERS <= sizeof(t_regSet) * 8);
 
-  // Create a CFG from the given program and compute the liveness intervals.
   result->program = program;
-  result->graph = programToCFG(program);
-  cfgComputeLiveness(result->graph);
-
-  // Compute the ordered list of live intervals.
-  result->liveIntervals = getLiveIntervals(result->graph);
+  result->graph = graph;
 
   // Find the maximum temporary register ID in the program, then allocate the
-  // array of register bindings with that size. If there are unused register
-  // IDs, the array will have holes, but that's not a problem.
+  // arrays indexed by register ID with that size. If there are unused
+  // register IDs, the arrays will have holes, but that's not a problem.
   t_regID maxTempRegID = 0;
-  t_listNode *curCFGRegNode = result->graph->registers;
-  while (curCFGRegNode != NULL) {
-    t_cfgReg *curCFGReg = (t_cfgReg *)curCFGRegNode->data;
+  for (int i = 0; i < result->graph->registers.length; i++) {
+    t_cfgReg *curCFGReg = (t_cfgReg *)result->graph->registers.items[i];
     if (maxTempRegID < curCFGReg->tempRegID)
       maxTempRegID = curCFGReg->tempRegID;
-    curCFGRegNode = curCFGRegNode->next;
   }
   result->tempRegNum = maxTempRegID + 1;
 
+  // Compute the ordered array of live intervals.
+  timingStart("live-intervals");
+  getLiveIntervals(result);
+
   // allocate space for the binding array, and initialize it.
   result->bindings = malloc(sizeof(t_regID) * (size_t)result->tempRegNum);
   if (result->bindings == NULL)
@@ -420,12 +500,15 @@ t_regAllocator *newRegAllocator(t_program *program)
   if (TARGET_REG_ZERO_IS_CONST)
     result->bindings[REG_0] = REG_0;
 
-  // Initialize the list of spill locations.
-  result->spills = NULL;
+  // Initialize the array of spill locations.
+  result->spillLabels = calloc((size_t)result->tempRegNum, sizeof(t_label *));
+  if (result->spillLabels == NULL)
+    fatalError("out of memory");
 
   // Initialize register constraints.
   initializeRegisterConstraints(result);
   handleCallerSaveRegisters(result, result->graph);
+  timingStop();
 
   // return the new register allocator.
   return result;
@@ -436,41 +519,92 @@ void deleteRegAllocator(t_regAllocator *RA)
   if (RA == NULL)
     return;
 
-  t_listNode *curNode = RA->liveIntervals;
-  while (curNode) {
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
-    deleteLiveInterval(curInterval);
-    curNode = curNode->next;
-  }
-
-  deleteList(RA->liveIntervals);
+  free(RA->liveIntervals);
   free(RA->bindings);
-  deleteSpillLocationList(RA->spills);
-  deleteCFG(RA->graph);
+  free(RA->spillLabels);
 
   free(RA);
 }
 
 
-static bool compareFreeRegListNodes(void *freeReg, void *constraintReg)
+/// Set of the active live intervals, i.e. the intervals which are currently
+/// allocated to a register. It is a binary min-heap ordered by end point.
+/// Since every active interval holds a physical register, its size is
+/// bounded by the number of registers.
+typedef struct {
+  t_liveInterval *items[NUM_REGISTERS];
+  int length;
+  /// Sequence number of the next interval made active.
+  int nextSeq;
+} t_activeIntervals;
+
+/* Given two live intervals, compare them by the end point (find whichever
+ * ends first). Among intervals with the same end point, the interval made
+ * active last comes first. */
+static bool activeIntervalPrecedes(t_liveInterval *a, t_liveInterval *b)
+{
+  if (a->endPoint != b->endPoint)
+    return a->endPoint < b->endPoint;
+  return a->activeSeq > b->activeSeq;
+}
+
+static void activeSiftUp(t_activeIntervals *active, int i)
+{
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!activeIntervalPrecedes(active->items[i], active->items[parent]))
+      break;
+    t_liveInterval *tmp = active->items[i];
+    active->items[i] = active->items[parent];
+    active->items[parent] = tmp;
+    i = parent;
+  }
+}
+
+static void activeSiftDown(t_activeIntervals *active, int i)
 {
-  return INT_TO_LIST_DATA(constraintReg) == INT_TO_LIST_DATA(freeReg);
+  while (true) {
+    int first = i;
+    for (int child = 2 * i + 1; child <= 2 * i + 2; child++) {
+      if (child < active->length &&
+          activeIntervalPrecedes(active->items[child], active->items[first]))
+        first = child;
+    }
+    if (first == i)
+      break;
+    t_liveInterval *tmp = active->items[i];
+    active->items[i] = active->items[first];
+    active->items[first] = tmp;
+    i = first;
+  }
 }
 
-/* Remove from activeInterv all the live intervals that end before the
- * beginning of the current live interval. */
-static void expireOldIntervals(t_regAllocator *RA, t_listNode **activeInterv,
-    t_listNode **freeRegs, t_liveInterval *interval)
+static void activeInsert(t_activeIntervals *active, t_liveInterval *interval)
 {
-  // No active intervals, bail out!
-  if (*activeInterv == NULL)
-    return;
+  assert(active->length < NUM_REGISTERS);
+  interval->activeSeq = active->nextSeq++;
+  active->items[active->length] = interval;
+  activeSiftUp(active, active->length++);
+}
 
-  // Iterate over the set of active intervals.
-  t_listNode *curNode = *activeInterv;
-  while (curNode != NULL) {
+static void activeRemoveAt(t_activeIntervals *active, int i)
+{
+  active->items[i] = active->items[--active->length];
+  if (i < active->length) {
+    activeSiftUp(active, i);
+    activeSiftDown(active, i);
+  }
+}
+
+/* Remove from the active intervals all the live intervals that end before the
+ * beginning of the current live interval. */
+static void expireOldIntervals(t_regAllocator *RA, t_activeIntervals *active,
+    t_regSet *freeRegs, t_liveInterval *interval)
+{
+  // Iterate over the set of active intervals in order of end point.
+  while (active->length > 0) {
     // Get the live interval
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
+    t_liveInterval *curInterval = active->items[0];
 
     // If the considered interval ends before the beginning of the current live
     // interval, we don't need to keep track of it anymore; otherwise, this is
@@ -483,46 +617,27 @@ static void expireOldIntervals(t_regAllocator *RA, t_listNode **activeInterv,
     // associated to curInterval is being used by the instruction that defines
     // interval. As a result, we can allocate interval to the same reg as
     // curInterval.
-    if (curInterval->endPoint == interval->startPoint) {
-      t_regID curIntReg = RA->bindings[curInterval->tempRegID];
-      if (curIntReg >= 0) {
-        t_listNode *allocated =
-            listInsert(NULL, INT_TO_LIST_DATA(curIntReg), 0);
-        interval->mcRegConstraints =
-            optimizeRegisterSet(interval->mcRegConstraints, allocated);
-        deleteList(allocated);
-      }
-    }
+    t_regID curIntReg = RA->bindings[curInterval->tempRegID];
+    if (curInterval->endPoint == interval->startPoint && curIntReg >= 0)
+      optimizeRegisterSet(&interval->constraints, &curIntReg, 1);
 
-    // Get the next live interval.
-    t_listNode *nextNode = curNode->next;
-
-    // Remove the current element from the list.
-    *activeInterv = listFindAndRemove(*activeInterv, curInterval);
+    // Remove the current element from the active intervals.
+    activeRemoveAt(active, 0);
 
     // Free all the registers associated with the removed interval.
-    *freeRegs = listInsert(
-        *freeRegs, INT_TO_LIST_DATA(RA->bindings[curInterval->tempRegID]), 0);
-
-    // Step to the next interval.
-    curNode = nextNode;
+    *freeRegs |= REG_SET_SINGLE(curIntReg);
   }
 }
 
-/* Get a new register from the free list. */
+/* Get a new register from the free set. */
 static t_regID assignRegister(
-    t_regAllocator *RA, t_listNode **freeRegs, t_listNode *constraints)
-{
-  if (constraints == NULL)
-    return RA_SPILL_REQUIRED;
-
-  for (t_listNode *i = constraints; i; i = i->next) {
-    t_regID tempRegID = (t_regID)LIST_DATA_TO_INT(i->data);
-    t_listNode *freeReg = listFindWithCallback(
-        *freeRegs, INT_TO_LIST_DATA(tempRegID), compareFreeRegListNodes);
-    if (freeReg) {
-      *freeRegs = listRemoveNode(*freeRegs, freeReg);
-      return tempRegID;
+    t_regSet *freeRegs, t_regConstraints *constraints)
+{
+  for (int i = 0; i < constraints->numRegs; i++) {
+    t_regID reg = constraints->regs[i];
+    if (*freeRegs & REG_SET_SINGLE(reg)) {
+      *freeRegs &= ~REG_SET_SINGLE(reg);
+      return reg;
     }
   }
 
@@ -530,14 +645,14 @@ static t_regID assignRegister(
 }
 
 /* Perform a spill that allows the allocation of the given interval, given the
- * list of active live intervals. */
+ * set of active live intervals. */
 static void spillAtInterval(
-    t_regAllocator *RA, t_listNode **activeInterv, t_liveInterval *interval)
+    t_regAllocator *RA, t_activeIntervals *active, t_liveInterval *interval)
 {
   // An interval is made active when its register is allocated. As a result,
-  // if the list of active intervals is empty and we request a spill, we are
+  // if the set of active intervals is empty and we request a spill, we are
   // working on a machine with 0 registers and we need to spill everything.
-  if (*activeInterv == NULL) {
+  if (active->length == 0) {
     RA->bindings[interval->tempRegID] = RA_SPILL_REQUIRED;
     return;
   }
@@ -545,22 +660,25 @@ static void spillAtInterval(
   // If the current interval ends before the last one successfully allocated,
   // spill the last one. This has the result of making one register available
   // much sooner. Otherwise spill the current interval.
-  t_listNode *lastNode = listGetLastNode(*activeInterv);
-  t_liveInterval *lastInterval = (t_liveInterval *)lastNode->data;
+  int last = 0;
+  for (int i = 1; i < active->length; i++) {
+    if (activeIntervalPrecedes(active->items[last], active->items[i]))
+      last = i;
+  }
+  t_liveInterval *lastInterval = active->items[last];
   if (lastInterval->endPoint > interval->endPoint) {
     // The last interval does end later than the current one.
     // Ensure that the current interval is allocatable to the last interval's
     // register.
     t_regID attempt = RA->bindings[lastInterval->tempRegID];
-    if (listFind(interval->mcRegConstraints, INT_TO_LIST_DATA(attempt))) {
+    if (interval->constraints.mask & REG_SET_SINGLE(attempt)) {
       // All conditions satisfied for the last interval.
       // Take its register for our interval and mark it as spilled.
       RA->bindings[interval->tempRegID] = RA->bindings[lastInterval->tempRegID];
       RA->bindings[lastInterval->tempRegID] = RA_SPILL_REQUIRED;
-      // Update the active intervals list.
-      *activeInterv = listFindAndRemove(*activeInterv, lastInterval);
-      *activeInterv =
-          listInsertSorted(*activeInterv, interval, compareLiveIntEndPoints);
+      // Update the active intervals.
+      activeRemoveAt(active, last);
+      activeInsert(active, interval);
       return;
     }
   }
@@ -569,68 +687,67 @@ static void spillAtInterval(
 
 static void executeLinearScan(t_regAllocator *RA)
 {
-  t_listNode *freeRegs = getListOfMachineRegisters();
-  t_listNode *activeInterv = NULL;
+  t_regSet freeRegs = 0;
+  for (t_regID reg = 1; reg < NUM_REGISTERS; reg++)
+    freeRegs |= REG_SET_SINGLE(reg);
+  t_activeIntervals active;
+  active.length = 0;
+  active.nextSeq = 0;
 
-  for (t_listNode *curNode = RA->liveIntervals; curNode != NULL;
-       curNode = curNode->next) {
-    t_liveInterval *curInterval = (t_liveInterval *)curNode->data;
+  for (int i = 0; i < RA->numLiveIntervals; i++) {
+    t_liveInterval *curInterval = &RA->liveIntervals[i];
 
     // Check which intervals are ended and remove them from the active set,
     // thus freeing registers.
-    expireOldIntervals(RA, &activeInterv, &freeRegs, curInterval);
+    expireOldIntervals(RA, &active, &freeRegs, curInterval);
 
-    t_regID reg = assignRegister(RA, &freeRegs, curInterval->mcRegConstraints);
+    t_regID reg = assignRegister(&freeRegs, &curInterval->constraints);
 
     // If all registers are busy, perform a spill.
     if (reg == RA_SPILL_REQUIRED) {
-      spillAtInterval(RA, &activeInterv, curInterval);
+      spillAtInterval(RA, &active, curInterval);
     } else {
       // Otherwise, assign a new register to the current live interval
-      // and add the current interval to the list of active intervals, in
+      // and add the current interval to the set of active intervals, in
       // order of ending points (to allow easier expire management).
       RA->bindings[curInterval->tempRegID] = reg;
-      activeInterv =
-          listInsertSorted(activeInterv, curInterval, compareLiveIntEndPoints);
+      activeInsert(&active, curInterval);
     }
   }
-
-  activeInterv = deleteList(activeInterv);
-  freeRegs = deleteList(freeRegs);
 }
 
 
 /* For each spilled variable, this function statically allocates memory for
- * that variable, returns a list of t_templabel structures mapping the
- * spilled variables and the label that points to the allocated memory block. */
+ * that variable, and records the label that points to the allocated memory
+ * block in the array of spill labels. */
 static void materializeSpillMemory(t_regAllocator *RA)
 {
+  int numSpills = 0;
   for (t_regID counter = 0; counter < RA->tempRegNum; counter++) {
     if (RA->bindings[counter] != RA_SPILL_REQUIRED)
       continue;
+    numSpills++;
 
-    // Statically allocate some room for the spilled variable and add it to the
-    // list of spills.
+    // Statically allocate some room for the spilled variable and record its
+    // label.
     char name[32];
     sprintf(name, ".t%d", counter);
     t_symbol *sym = createSymbol(RA->program, strdup(name), TYPE_INT, 0);
-    t_spillLocation *spillLoc = newSpillLocation(sym->label, counter);
-    RA->spills = listInsert(RA->spills, spillLoc, -1);
+    RA->spillLabels[counter] = sym->label;
   }
+  timingSetCounter(TIMING_SPILLS, numSpills);
 }
 
 static void genStoreSpillVariable(t_regAllocator *RA, t_regID rSpilled,
     t_regID rSrc, t_basicBlock *block, t_bbNode *curCFGNode, bool before)
 {
   // Find the spill location.
-  t_listNode *elementFound =
-      listFindWithCallback(RA->spills, &rSpilled, compareSpillLocWithRegId);
-  if (elementFound == NULL)
+  t_label *spillLabel = RA->spillLabels[rSpilled];
+  if (spillLabel == NULL)
     fatalError("bug: t%d missing from the spill label list", rSpilled);
-  t_spillLocation *loc = (t_spillLocation *)elementFound->data;
 
   // Insert a store instruction in the required position.
-  t_instruction *storeInstr = genSWGlobal(NULL, rSrc, loc->label, REG_T6);
+  t_instruction *storeInstr = genSWGlobal(NULL, rSrc, spillLabel, REG_T6);
   if (before) {
     bbInsertInstructionBefore(block, storeInstr, curCFGNode);
   } else {
@@ -642,14 +759,12 @@ static void genLoadSpillVariable(t_regAllocator *RA, t_regID rSpilled,
     t_regID rDest, t_basicBlock *block, t_bbNode *curCFGNode, bool before)
 {
   // Find the spill location.
-  t_listNode *elementFound =
-      listFindWithCallback(RA->spills, &rSpilled, compareSpillLocWithRegId);
-  if (elementFound == NULL)
+  t_label *spillLabel = RA->spillLabels[rSpilled];
+  if (spillLabel == NULL)
     fatalError("bug: t%d missing from the spill label list", rSpilled);
-  t_spillLocation *loc = (t_spillLocation *)elementFound->data;
 
   // Insert a load instruction in the required position.
-  t_instruction *loadInstr = genLWGlobal(NULL, rDest, loc->label);
+  t_instruction *loadInstr = genLWGlobal(NULL, rDest, spillLabel);
   if (before) {
     bbInsertInstructionBefore(block, loadInstr, curCFGNode);
     // If the `curCFGNode' instruction has a label, move it to the new
@@ -800,7 +915,7 @@ static void materializeRegAllocInBB(t_regAllocator *RA, t_basicBlock *curBlock)
   }
 
   t_bbNode *curCFGNode = NULL;
-  t_listNode *curInnerNode = curBlock->nodes;
+  t_listNode *curInnerNode = curBlock->nodes.head;
   while (curInnerNode != NULL) {
     curCFGNode = (t_bbNode *)curInnerNode->data;
     // Change the register IDs of the argument of the instruction according
@@ -812,7 +927,7 @@ static void materializeRegAllocInBB(t_regAllocator *RA, t_basicBlock *curBlock)
   if (curCFGNode == NULL)
     fatalError("bug: invalid CFG where a block has no nodes");
 
-  bool bbHasTermInstr = curBlock->nodes &&
+  bool bbHasTermInstr = curBlock->nodes.head &&
       (isJumpInstruction(curCFGNode->instr) ||
           isExitInstruction(curCFGNode->instr));
 
@@ -827,11 +942,9 @@ static void materializeRegAllocInBB(t_regAllocator *RA, t_basicBlock *curBlock)
 
 static void materializeRegAllocInCFG(t_regAllocator *RA)
 {
-  t_listNode *curBlockNode = RA->graph->blocks;
-  while (curBlockNode != NULL) {
-    t_basicBlock *curBlock = (t_basicBlock *)curBlockNode->data;
+  for (int i = 0; i < RA->graph->blocks.length; i++) {
+    t_basicBlock *curBlock = (t_basicBlock *)RA->graph->blocks.items[i];
     materializeRegAllocInBB(RA, curBlock);
-    curBlockNode = curBlockNode->next;
   }
 }
 
@@ -841,17 +954,23 @@ void regallocRun(t_regAllocator *regalloc)
   // Bind each temporary register to a physical register using the linear scan
   // algorithm. Spilled registers are all tagged with the fictitious register
   // RA_SPILL_REQUIRED.
+  timingStart("linear-scan");
   executeLinearScan(regalloc);
+  timingStop();
 
   // Generate statically allocated globals for each spilled temporary register.
+  timingStart("spill-materialization");
   materializeSpillMemory(regalloc);
 
   // Replace temporary register IDs with physical register IDs. In case of
   // spilled registers, add load/store instructions appropriately.
   materializeRegAllocInCFG(regalloc);
+  timingStop();
 
   // Rewrite the program object from the CFG.
+  timingStart("cfg-to-program");
   cfgToProgram(regalloc->program, regalloc->graph);
+  timingStop();
 }
 
 
@@ -870,16 +989,9 @@ void dumpVariableBindings(t_regAllocator *RA, FILE *fout)
     free(regStr);
 
     if (physReg == RA_SPILL_REQUIRED) {
-      t_listNode *spillLi = RA->spills;
-      t_spillLocation *loc;
-      while (spillLi) {
-        loc = (t_spillLocation *)spillLi->data;
-        if (loc->tempRegID == tempReg)
-          break;
-        spillLi = spillLi->next;
-      }
-      if (spillLi) {
-        char *labelName = getLabelName(loc->label);
+      t_label *spillLabel = RA->spillLabels[tempReg];
+      if (spillLabel) {
+        char *labelName = getLabelName(spillLabel);
         fprintf(fout, "spilled to label %s\n", labelName);
         free(labelName);
       } else {
@@ -897,14 +1009,13 @@ void dumpVariableBindings(t_regAllocator *RA, FILE *fout)
   fflush(fout);
 }
 
-void dumpLiveIntervals(t_listNode *intervals, FILE *fout)
+void dumpLiveIntervals(t_liveInterval *intervals, int numIntervals, FILE *fout)
 {
   if (fout == NULL)
     return;
 
-  t_listNode *curNode = intervals;
-  while (curNode != NULL) {
-    t_liveInterval *interval = (t_liveInterval *)curNode->data;
+  for (int n = 0; n < numIntervals; n++) {
+    t_liveInterval *interval = &intervals[n];
 
     char *regStr = registerIDToString(interval->tempRegID, false);
     fprintf(fout, "%s:\n", regStr);
@@ -913,21 +1024,17 @@ void dumpLiveIntervals(t_listNode *intervals, FILE *fout)
     fprintf(fout, "  live interval = [%3d, %3d]\n", interval->startPoint,
         interval->endPoint);
     fprintf(fout, "  constraints = {");
-    t_listNode *i = interval->mcRegConstraints;
-    while (i) {
+    for (int i = 0; i < interval->constraints.numRegs; i++) {
       char *reg;
 
-      reg = registerIDToString((t_regID)LIST_DATA_TO_INT(i->data), true);
+      reg = registerIDToString(interval->constraints.regs[i], true);
       fprintf(fout, "%s", reg);
       free(reg);
 
-      if (i->next != NULL)
+      if (i + 1 < interval->constraints.numRegs)
         fprintf(fout, ", ");
-      i = i->next;
     }
     fprintf(fout, "}\n");
-
-    curNode = curNode->next;
   }
   fflush(fout);
 }
@@ -946,7 +1053,7 @@ void regallocDump(t_regAllocator *RA, FILE *fout)
   fprintf(fout, "Number of virtual registers used: %d\n\n", RA->tempRegNum);
 
   fprintf(fout, "## Live intervals and constraints\n\n");
-  dumpLiveIntervals(RA->liveIntervals, fout);
+  dumpLiveIntervals(RA->liveIntervals, RA->numLiveIntervals, fout);
   fprintf(fout, "\n");
 
   fprintf(fout, "## Register assignment\n\n");
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include "program.h"
+#include "cfg.h"
 
 /**
  * @defgroup regalloc Register Allocator
@@ -23,15 +24,19 @@ typedef struct t_regAllocator t_regAllocator;
 
 /** Create a new register allocator object for the given program.
  *  @param program The program whose registers need to be allocated.
+ *  @param graph   The control flow graph of the program, with the liveness
+ *                 of the registers already computed. The graph is modified
+ *                 by regallocRun(), and it is not valid afterwards.
  *  @return A new register allocator object. */
-t_regAllocator *newRegAllocator(t_program *program);
+t_regAllocator *newRegAllocator(t_program *program, t_cfg *graph);
 
 /** Deallocate a register allocator.
  *  @param regAlloc The register allocator object. */
 void deleteRegAllocator(t_regAllocator *regAlloc);
 
 /** Convert temporary register identifiers to real register identifiers,
- *  analyzing the live interval of each temporary register.
+ *  analyzing the live interval of each temporary register. The program is
+ *  rewritten from the control flow graph, which must be discarded.
  *  @param regAlloc The register allocator object. */
 void regallocRun(t_regAllocator *regAlloc);
 
@@ -1,28 +1,44 @@
 /// @file scanner.h
-/// @brief Header file associated to scanner.y
+/// @brief Header file associated to scanner.l
 
 #ifndef SCANNER_H
 #define SCANNER_H
 
 #include <stdio.h>
 #include "errors.h"
+#include "parser.tab.h"
 
 /**
  * @addtogroup parser
  * @{
  */
 
-/** The current location in the file being read by the scanner. */
-extern t_fileLocation curFileLoc;
+/** Creates a new scanner, which updates the current location in the source
+ *  file of the given program while reading its input.
+ *  @note This function is defined in Flex-generated code.
+ *  @param program The program being compiled.
+ *  @param scanner Set to the new scanner.
+ *  @return Zero on success, non-zero if out of memory. */
+int yylex_init_extra(t_program *program, yyscan_t *scanner);
+
+/** Sets the file read by a scanner.
+ *  @note This function is defined in Flex-generated code.
+ *  @param in      The file to be read.
+ *  @param scanner The scanner. */
+void yyset_in(FILE *in, yyscan_t scanner);
 
-/** The file currently being read by the scanner.
- *  @note This global variable is used by Flex-generated code. */
-extern FILE *yyin;
+/** Frees a scanner.
+ *  @note This function is defined in Flex-generated code.
+ *  @param scanner The scanner.
+ *  @return Zero. */
+int yylex_destroy(yyscan_t scanner);
 
 /** Scans the input up to the next token.
  *  @note This function is defined in Flex-generated code.
+ *  @param lvalp   Set to the semantic value of the token.
+ *  @param scanner The scanner.
  *  @return The next token identifier. */
-int yylex(void);
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
 
 /**
  * @}
@@ -0,0 +1,101 @@
+/// @file string_map.c
+/// @brief A hash table indexed by strings implementation
+
+#include <stdlib.h>
+#include <string.h>
+#include "string_map.h"
+#include "errors.h"
+
+
+void stringMapInit(t_stringMap *map, t_arena *arena)
+{
+  map->entries = NULL;
+  map->capacity = 0;
+  map->count = 0;
+  map->arena = arena;
+}
+
+
+/* FNV-1a hash of a string. */
+static uint32_t stringMapHash(const char *key)
+{
+  uint32_t hash = 2166136261u;
+  for (; *key; key++) {
+    hash ^= (unsigned char)*key;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+/* Returns the entry of a key, or the free entry where the key would be
+ * inserted if it is not in the map. The capacity must be a power of two
+ * greater than the number of keys. */
+static t_stringMapEntry *stringMapLookup(
+    t_stringMapEntry *entries, int capacity, const char *key, uint32_t hash)
+{
+  uint32_t mask = (uint32_t)capacity - 1;
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    t_stringMapEntry *entry = &entries[i];
+    if (entry->key == NULL)
+      return entry;
+    if (entry->hash == hash && strcmp(entry->key, key) == 0)
+      return entry;
+  }
+}
+
+
+static void stringMapGrow(t_stringMap *map)
+{
+  int newCapacity = map->capacity ? map->capacity * 2 : 64;
+  t_stringMapEntry *newEntries =
+      calloc((size_t)newCapacity, sizeof(t_stringMapEntry));
+  if (newEntries == NULL)
+    fatalError("out of memory");
+
+  for (int i = 0; i < map->capacity; i++) {
+    t_stringMapEntry *entry = &map->entries[i];
+    if (entry->key == NULL)
+      continue;
+    *stringMapLookup(newEntries, newCapacity, entry->key, entry->hash) =
+        *entry;
+  }
+
+  free(map->entries);
+  map->entries = newEntries;
+  map->capacity = newCapacity;
+}
+
+
+void *stringMapGet(t_stringMap *map, const char *key)
+{
+  if (map->count == 0)
+    return NULL;
+  uint32_t hash = stringMapHash(key);
+  return stringMapLookup(map->entries, map->capacity, key, hash)->value;
+}
+
+
+void stringMapSet(t_stringMap *map, const char *key, void *value)
+{
+  // Keep the load factor below 1/2.
+  if ((map->count + 1) * 2 > map->capacity)
+    stringMapGrow(map);
+
+  uint32_t hash = stringMapHash(key);
+  t_stringMapEntry *entry =
+      stringMapLookup(map->entries, map->capacity, key, hash);
+  if (entry->key == NULL) {
+    entry->key = arenaStrdup(map->arena, key);
+    entry->hash = hash;
+    map->count++;
+  }
+  entry->value = value;
+}
+
+
+void stringMapClear(t_stringMap *map)
+{
+  free(map->entries);
+  stringMapInit(map, map->arena);
+}
@@ -0,0 +1,65 @@
+/// @file string_map.h
+/// @brief A hash table indexed by strings
+
+#ifndef STRING_MAP_H
+#define STRING_MAP_H
+
+#include <stdint.h>
+#include "arena.h"
+
+/**
+ * @defgroup stringMap String Map
+ * @brief Library for associating data pointers to strings.
+ *
+ * A string map is a hash table which associates an untyped data pointer to
+ * each of a set of strings (the keys), and finds the data associated to a key
+ * in constant time on average. The keys are copied (interned) in an arena
+ * when they are added, so the strings passed to the map can be temporary.
+ * As for lists, the data pointed to by the values is owned by the client of
+ * the library.
+ * @{
+ */
+
+/// An entry of a string map.
+typedef struct {
+  const char *key; ///< The key, or NULL if the entry is free.
+  uint32_t hash;   ///< The hash of the key.
+  void *value;     ///< The data associated to the key.
+} t_stringMapEntry;
+
+/// A hash table indexed by strings.
+typedef struct {
+  t_stringMapEntry *entries; ///< The hash table, with open addressing.
+  int capacity;              ///< The number of entries in the table.
+  int count;                 ///< The number of keys in the table.
+  t_arena *arena;            ///< The arena where the keys are copied.
+} t_stringMap;
+
+/** Initialize an empty string map.
+ * @param map   The map to be initialized.
+ * @param arena The arena where the keys will be copied. */
+void stringMapInit(t_stringMap *map, t_arena *arena);
+
+/** Find the data associated to a key.
+ * @param map The map.
+ * @param key The key to search for.
+ * @returns The data associated to the key, or NULL if the key is not in the
+ *          map. */
+void *stringMapGet(t_stringMap *map, const char *key);
+
+/** Associate data to a key, replacing any previous association.
+ * @param map   The map.
+ * @param key   The key.
+ * @param value The data to associate to the key. */
+void stringMapSet(t_stringMap *map, const char *key, void *value);
+
+/** Remove all the keys of a string map, leaving it empty. The copies of the
+ * keys are freed with the arena.
+ * @param map The map to be cleared. */
+void stringMapClear(t_stringMap *map);
+
+/**
+ * @}
+ */
+
+#endif
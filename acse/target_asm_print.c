@@ -411,7 +411,7 @@ int instructionToString(
 
 bool translateForwardDeclarations(t_program *program, FILE *fp)
 {
-  for (t_listNode *li = program->labels; li != NULL; li = li->next) {
+  for (t_listNode *li = program->labels.head; li != NULL; li = li->next) {
     t_label *nextLabel = li->data;
 
     if (nextLabel->isAlias)
@@ -461,14 +461,14 @@ bool printInstruction(t_instruction *instr, FILE *fp, bool machineRegIDs)
 
 bool translateCodeSegment(t_program *program, FILE *fp)
 {
-  if (!program->instructions)
+  if (!program->instructions.head)
     return true;
 
   // Write the .text directive to switch to the text segment.
   if (fprintf(fp, "%-8s.text\n", "") < 0)
     return false;
 
-  t_listNode *curNode = program->instructions;
+  t_listNode *curNode = program->instructions.head;
   while (curNode != NULL) {
     t_instruction *curInstr = (t_instruction *)curNode->data;
     if (curInstr == NULL)
@@ -519,7 +519,7 @@ int printGlobalDeclaration(t_symbol *data, FILE *fp)
 bool translateDataSegment(t_program *program, FILE *fp)
 {
   // If the symbol table is empty, nothing to do.
-  if (program->symbols == NULL)
+  if (program->symbols.head == NULL)
     return true;
 
   // Write the .data directive to switch to the data segment.
@@ -527,7 +527,7 @@ bool translateDataSegment(t_program *program, FILE *fp)
     return false;
 
   // Print a static declaration for each symbol.
-  t_listNode *li = program->symbols;
+  t_listNode *li = program->symbols.head;
   while (li != NULL) {
     t_symbol *symbol = (t_symbol *)li->data;
 
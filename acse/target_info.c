@@ -45,6 +45,15 @@ bool isCallInstruction(t_instruction *instr)
 }
 
 
+bool isPureInstruction(t_instruction *instr)
+{
+  // Division by zero does not raise exceptions in RISC-V.
+  if (instr->opcode >= OPC_ADD && instr->opcode <= OPC_SLEIU)
+    return true;
+  return instr->opcode == OPC_LI || instr->opcode == OPC_LA;
+}
+
+
 t_regID getSpillMachineRegister(int i)
 {
   assert(i < NUM_SPILL_REGS);
@@ -188,6 +188,13 @@ bool isExitInstruction(t_instruction *instr);
  *  @returns true if the instruction is a call. */
 bool isCallInstruction(t_instruction *instr);
 
+/** Tests if the instruction only computes the value of its destination
+ *  register, with no other effects. Such an instruction can be removed if
+ *  its result is never used.
+ *  @param instr The instruction to be examined.
+ *  @returns true if the instruction has no side effects. */
+bool isPureInstruction(t_instruction *instr);
+
 
 /** Retrieves a register ID suitable for spill operations. The maximum index
  *  is always bounded by NUM_SPILL_REGS.
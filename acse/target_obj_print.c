@@ -0,0 +1,366 @@
+/// @file target_obj_print.c
+/// @brief Generation of the output object file implementation
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "list.h"
+#include "errors.h"
+#include "target_obj_print.h"
+#include "target_info.h"
+
+// The headers of the assembler declare a t_instruction type, a
+// t_fileLocation type and error functions with the same names as ours, and
+// use the same include guard for errors.h. Their names are changed while
+// including them, and the error functions are renamed in the same way when
+// the sources of the assembler are compiled for the compiler (see
+// `asm_cflags' in the Makefile).
+#undef ERRORS_H
+#define t_instruction t_asmInstruction
+#define t_fileLocation t_asmFileLocation
+#define nullFileLocation asmNullFileLocation
+#define emitError asmEmitError
+#define emitWarning asmEmitWarning
+#define fatalError asmFatalError
+#include "../asrv32im/object.h"
+#include "../asrv32im/output.h"
+#undef t_instruction
+#undef t_fileLocation
+#undef nullFileLocation
+#undef emitError
+#undef emitWarning
+#undef fatalError
+
+
+/// State of the translation of a program to an object.
+typedef struct {
+  t_object *obj;              ///< The object being built.
+  t_asmFileLocation location; ///< The source line of the last instructions.
+} t_objPrintState;
+
+
+static t_objLabel *getObjLabel(t_objPrintState *state, t_label *label)
+{
+  char *name = getLabelName(label);
+  t_objLabel *res = objGetLabel(state->obj, name);
+  free(name);
+  return res;
+}
+
+static bool declareLabel(
+    t_objPrintState *state, t_objSection *sec, t_label *label)
+{
+  if (objSecDeclareLabel(sec, getObjLabel(state, label)))
+    return true;
+  char *name = getLabelName(label);
+  emitError(nullFileLocation, "label \"%s\" already declared", name);
+  free(name);
+  return false;
+}
+
+
+static bool buildDataSection(t_program *program, t_objPrintState *state)
+{
+  t_objSection *data = objGetSection(state->obj, OBJ_SECTION_DATA);
+
+  for (t_listNode *li = program->symbols.head; li != NULL; li = li->next) {
+    t_symbol *symbol = (t_symbol *)li->data;
+
+    if (symbol->label != NULL && !declareLabel(state, data, symbol->label))
+      return false;
+
+    t_data item = {0};
+    switch (symbol->type) {
+      case TYPE_INT:
+        item.dataSize = 4 / TARGET_PTR_GRANULARITY;
+        break;
+      case TYPE_INT_ARRAY:
+        item.dataSize =
+            (size_t)(4 / TARGET_PTR_GRANULARITY) * (size_t)symbol->arraySize;
+        break;
+      default:
+        fatalError("bug: invalid data type found in the program");
+    }
+    item.initialized = false;
+    item.location = asmNullFileLocation;
+    objSecAppendData(data, item);
+  }
+  return true;
+}
+
+
+/* Marks the beginning of the code of a new source line, in the same way as
+ * the assembler does when it finds the "file:line" comment added by
+ * addInstruction() in the assembly code. */
+static void translateSourceLocation(
+    t_objPrintState *state, t_objSection *text, t_fileLocation loc)
+{
+  t_asmFileLocation *cur = &state->location;
+  if (cur->file == loc.file && cur->row == loc.row)
+    return;
+  cur->file = loc.file;
+  cur->row = loc.row;
+  cur->column = -1;
+  objSecAppendSourceLocation(text, *cur);
+}
+
+static t_instrRegID translateRegister(t_instrArg *reg)
+{
+  if (reg == NULL || reg->ID < 0 || reg->ID >= 32)
+    fatalError("bug: invalid instruction found in the program");
+  return reg->ID;
+}
+
+static bool checkImmediate(
+    t_objPrintState *state, int32_t imm, int32_t min, int32_t max)
+{
+  if (imm >= min && imm <= max)
+    return true;
+  t_fileLocation loc = {state->location.file, state->location.row};
+  emitError(loc, "immediate %d out of range", imm);
+  return false;
+}
+
+/* Returns the opcode of the assembler corresponding to an opcode of the
+ * target. */
+static t_instrOpcode translateOpcode(int opcode)
+{
+  switch (opcode) {
+    case OPC_ADD:
+      return INSTR_OPC_ADD;
+    case OPC_SUB:
+      return INSTR_OPC_SUB;
+    case OPC_AND:
+      return INSTR_OPC_AND;
+    case OPC_OR:
+      return INSTR_OPC_OR;
+    case OPC_XOR:
+      return INSTR_OPC_XOR;
+    case OPC_MUL:
+      return INSTR_OPC_MUL;
+    case OPC_DIV:
+      return INSTR_OPC_DIV;
+    case OPC_REM:
+      return INSTR_OPC_REM;
+    case OPC_SLL:
+      return INSTR_OPC_SLL;
+    case OPC_SRL:
+      return INSTR_OPC_SRL;
+    case OPC_SRA:
+      return INSTR_OPC_SRA;
+    case OPC_SLT:
+      return INSTR_OPC_SLT;
+    case OPC_SLTU:
+      return INSTR_OPC_SLTU;
+    case OPC_ADDI:
+      return INSTR_OPC_ADDI;
+    case OPC_ANDI:
+      return INSTR_OPC_ANDI;
+    case OPC_ORI:
+      return INSTR_OPC_ORI;
+    case OPC_XORI:
+      return INSTR_OPC_XORI;
+    case OPC_SLTI:
+      return INSTR_OPC_SLTI;
+    case OPC_SLTIU:
+      return INSTR_OPC_SLTIU;
+    case OPC_SLLI:
+      return INSTR_OPC_SLLI;
+    case OPC_SRLI:
+      return INSTR_OPC_SRLI;
+    case OPC_SRAI:
+      return INSTR_OPC_SRAI;
+    case OPC_J:
+      return INSTR_OPC_J;
+    case OPC_BEQ:
+      return INSTR_OPC_BEQ;
+    case OPC_BNE:
+      return INSTR_OPC_BNE;
+    case OPC_BLT:
+      return INSTR_OPC_BLT;
+    case OPC_BLTU:
+      return INSTR_OPC_BLTU;
+    case OPC_BGE:
+      return INSTR_OPC_BGE;
+    case OPC_BGEU:
+      return INSTR_OPC_BGEU;
+    case OPC_BGT:
+      return INSTR_OPC_BGT;
+    case OPC_BGTU:
+      return INSTR_OPC_BGTU;
+    case OPC_BLE:
+      return INSTR_OPC_BLE;
+    case OPC_BLEU:
+      return INSTR_OPC_BLEU;
+    case OPC_LW:
+      return INSTR_OPC_LW;
+    case OPC_LW_G:
+      return INSTR_OPC_LW_G;
+    case OPC_SW:
+      return INSTR_OPC_SW;
+    case OPC_SW_G:
+      return INSTR_OPC_SW_G;
+    case OPC_LI:
+      return INSTR_OPC_LI;
+    case OPC_LA:
+      return INSTR_OPC_LA;
+    case OPC_NOP:
+      return INSTR_OPC_NOP;
+    case OPC_ECALL:
+      return INSTR_OPC_ECALL;
+    case OPC_EBREAK:
+      return INSTR_OPC_EBREAK;
+  }
+  fatalError(
+      "bug: instruction not supported by the target found in the program");
+}
+
+static bool translateInstruction(
+    t_objPrintState *state, t_instruction *instr, t_asmInstruction *res)
+{
+  *res = (t_asmInstruction){0};
+  res->opcode = translateOpcode(instr->opcode);
+  res->immMode = INSTR_IMM_CONST;
+  res->location = state->location;
+  // The errors of the assembler are reported with a location only if it has
+  // a column.
+  res->location.column = 0;
+
+  // The operands are set as the assembler does when parsing the instruction
+  // printed by printInstruction().
+  bool hasLabel = false;
+  int32_t minImm = -0x800, maxImm = 0x7FF;
+  switch (instr->opcode) {
+    case OPC_ADD:
+    case OPC_SUB:
+    case OPC_AND:
+    case OPC_OR:
+    case OPC_XOR:
+    case OPC_MUL:
+    case OPC_DIV:
+    case OPC_REM:
+    case OPC_SLL:
+    case OPC_SRL:
+    case OPC_SRA:
+    case OPC_SLT:
+    case OPC_SLTU:
+      res->dest = translateRegister(instr->rDest);
+      res->src1 = translateRegister(instr->rSrc1);
+      res->src2 = translateRegister(instr->rSrc2);
+      break;
+    case OPC_SLLI:
+    case OPC_SRLI:
+    case OPC_SRAI:
+      minImm = 0;
+      maxImm = 31;
+      // fall through
+    case OPC_ADDI:
+    case OPC_ANDI:
+    case OPC_ORI:
+    case OPC_XORI:
+    case OPC_SLTI:
+    case OPC_SLTIU:
+    case OPC_LW:
+      res->dest = translateRegister(instr->rDest);
+      res->src1 = translateRegister(instr->rSrc1);
+      res->constant = instr->immediate;
+      if (!checkImmediate(state, instr->immediate, minImm, maxImm))
+        return false;
+      break;
+    case OPC_SW:
+      res->src1 = translateRegister(instr->rSrc1);
+      res->src2 = translateRegister(instr->rSrc2);
+      res->constant = instr->immediate;
+      if (!checkImmediate(state, instr->immediate, minImm, maxImm))
+        return false;
+      break;
+    case OPC_LW_G:
+    case OPC_LA:
+      res->dest = translateRegister(instr->rDest);
+      hasLabel = true;
+      break;
+    case OPC_SW_G:
+      // The destination is the register used to compute the address.
+      res->src2 = translateRegister(instr->rSrc1);
+      res->dest = translateRegister(instr->rDest);
+      hasLabel = true;
+      break;
+    case OPC_BEQ:
+    case OPC_BNE:
+    case OPC_BLT:
+    case OPC_BLTU:
+    case OPC_BGE:
+    case OPC_BGEU:
+    case OPC_BGT:
+    case OPC_BGTU:
+    case OPC_BLE:
+    case OPC_BLEU:
+      res->src1 = translateRegister(instr->rSrc1);
+      res->src2 = translateRegister(instr->rSrc2);
+      hasLabel = true;
+      break;
+    case OPC_J:
+      hasLabel = true;
+      break;
+    case OPC_LI:
+      res->dest = translateRegister(instr->rDest);
+      res->constant = instr->immediate;
+      break;
+  }
+
+  if (hasLabel) {
+    if (instr->addressParam == NULL)
+      fatalError("bug: invalid instruction found in the program");
+    res->immMode = INSTR_IMM_LBL;
+    res->label = getObjLabel(state, instr->addressParam);
+  }
+  return true;
+}
+
+static bool buildTextSection(t_program *program, t_objPrintState *state)
+{
+  t_objSection *text = objGetSection(state->obj, OBJ_SECTION_TEXT);
+
+  for (t_listNode *li = program->instructions.head; li != NULL;
+       li = li->next) {
+    t_instruction *instr = (t_instruction *)li->data;
+    if (instr == NULL)
+      fatalError("bug: NULL instruction found in the program");
+
+    if (instr->label != NULL && !declareLabel(state, text, instr->label))
+      return false;
+    if (instr->sourceLoc.row >= 0)
+      translateSourceLocation(state, text, instr->sourceLoc);
+    t_asmInstruction asmInstr;
+    if (!translateInstruction(state, instr, &asmInstr))
+      return false;
+    objSecAppendInstruction(text, asmInstr);
+  }
+  return true;
+}
+
+
+bool writeObject(t_program *program, const char *fn)
+{
+  t_objPrintState state;
+  state.obj = newObject();
+  state.location = asmNullFileLocation;
+
+  // The data segment is translated first, as in the assembly code, so that
+  // the labels are created in the same order.
+  bool res = false;
+  if (!buildDataSection(program, &state))
+    goto fail;
+  if (!buildTextSection(program, &state))
+    goto fail;
+  if (!objMaterialize(state.obj))
+    goto fail;
+  if (outputToELF(state.obj, fn) != OUT_NO_ERROR) {
+    emitError(nullFileLocation, "could not write output file \"%s\"", fn);
+    goto fail;
+  }
+
+  res = true;
+fail:
+  deleteObject(state.obj);
+  return res;
+}
@@ -0,0 +1,35 @@
+/// @file target_obj_print.h
+/// @brief Generation of the output object file
+
+#ifndef TARGET_OBJ_PRINT_H
+#define TARGET_OBJ_PRINT_H
+
+#include <stdbool.h>
+#include "program.h"
+
+/**
+ * @defgroup obj_print Object file output
+ * @brief Functions to write the compiled program as an executable file
+ *
+ * Instead of printing the assembly code and having it assembled by asrv32im,
+ * the compiled program can be written directly as an executable ELF file.
+ * The instructions and the data of the program are translated to the object
+ * model of the assembler, which is linked in the compiler, and then encoded
+ * and written by the assembler's own functions. The result is identical to
+ * the output of asrv32im on the assembly code written by writeAssembly().
+ * @{
+ */
+
+/** Write the program to the specified file as an executable ELF file.
+ *  @param program The program being compiled.
+ *  @param fn      The path of the output file.
+ *  @returns false if the program could not be encoded, or if an error
+ *           occurred while writing to the file. In both cases the error
+ *           has already been reported. */
+bool writeObject(t_program *program, const char *fn);
+
+/**
+ * @}
+ */
+
+#endif
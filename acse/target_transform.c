@@ -25,11 +25,7 @@
 t_listNode *addInstrAfter(
     t_program *program, t_listNode *prev, t_instruction *instr)
 {
-  program->instructions =
-      listInsertAfter(program->instructions, prev, (void *)instr);
-  if (prev == NULL)
-    return program->instructions;
-  return prev->next;
+  return listAddAfter(&program->instructions, prev, (void *)instr);
 }
 
 
@@ -140,7 +136,7 @@ bool isInt12(int immediate)
 
 void fixUnsupportedImmediates(t_program *program)
 {
-  t_listNode *curi = program->instructions;
+  t_listNode *curi = program->instructions.head;
 
   while (curi) {
     t_listNode *transformedInstrLnk = curi;
@@ -178,7 +174,7 @@ void fixUnsupportedImmediates(t_program *program)
 
 void fixPseudoInstructions(t_program *program)
 {
-  t_listNode *curi = program->instructions;
+  t_listNode *curi = program->instructions.head;
 
   while (curi) {
     t_listNode *transformedInstrLnk = curi;
@@ -281,7 +277,7 @@ void fixPseudoInstructions(t_program *program)
 
 void fixSyscalls(t_program *program)
 {
-  t_listNode *curi = program->instructions;
+  t_listNode *curi = program->instructions.head;
 
   while (curi) {
     t_listNode *transformedInstrLnk = curi;
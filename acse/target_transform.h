@@ -17,6 +17,21 @@
  *                 is performed in-place. */
 void doTargetSpecificTransformations(t_program *program);
 
+/** Replace the pseudo-instructions of the program not supported by the
+ *  target with equivalent sequences of instructions.
+ *  @param program The program that needs to be transformed. */
+void fixPseudoInstructions(t_program *program);
+
+/** Lower the system call pseudo-instructions of the program to `ecall'
+ *  instructions with their arguments in the appropriate registers.
+ *  @param program The program that needs to be transformed. */
+void fixSyscalls(t_program *program);
+
+/** Replace the immediate arguments of the program which are out of range
+ *  for their instructions with values loaded in registers.
+ *  @param program The program that needs to be transformed. */
+void fixUnsupportedImmediates(t_program *program);
+
 /**
  * @}
  */
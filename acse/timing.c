@@ -0,0 +1,213 @@
+/// @file timing.c
+/// @brief Measurement of the time and memory spent in each compilation phase
+
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "timing.h"
+#include "arena.h"
+#include "vector.h"
+#include "errors.h"
+
+/// Maximum nesting depth of the phases.
+#define TIMING_MAX_DEPTH 16
+
+/// Measurements of a phase.
+typedef struct {
+  const char *name;          ///< The name of the phase.
+  int depth;                 ///< Number of phases the phase is nested in.
+  double startTime;          ///< Time of the start of the phase, in seconds.
+  double seconds;            ///< Wall time of the phase.
+  unsigned long allocs;      ///< Number of allocations from the arenas.
+  unsigned long allocBytes;  ///< Bytes allocated from the arenas.
+  size_t outerPeakBytes;     ///< Peak of the arenas of the enclosing phase.
+  size_t peakBytes;          ///< Peak of the memory held by the arenas.
+  long maxRSS;               ///< Maximum resident set size at the end, in KiB.
+  /// Values of the counters, or -1 for the ones not set.
+  int counters[TIMING_NUM_COUNTERS];
+} t_timingRecord;
+
+/// Whether the measurements are enabled.
+static bool enabled = false;
+/// All the phases started by the current thread in the order they were
+/// started.
+static _Thread_local t_vector records;
+/// Phases started and not stopped yet, as indexes in `records'.
+static _Thread_local int openRecords[TIMING_MAX_DEPTH];
+/// Number of elements in `openRecords'.
+static _Thread_local int numOpenRecords = 0;
+
+/// Names of the counters in the report.
+static const char *counterNames[TIMING_NUM_COUNTERS] = {
+    "instructions", "temporaries", "blocks", "spills"};
+
+
+void timingEnable(void)
+{
+  enabled = true;
+}
+
+bool timingEnabled(void)
+{
+  return enabled;
+}
+
+
+static double getTime(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static long getMaxRSS(void)
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+
+void timingStart(const char *name)
+{
+  if (!enabled)
+    return;
+  assert(numOpenRecords < TIMING_MAX_DEPTH);
+
+  t_timingRecord *record = malloc(sizeof(t_timingRecord));
+  if (record == NULL)
+    fatalError("out of memory");
+  record->name = name;
+  record->depth = numOpenRecords;
+  for (int i = 0; i < TIMING_NUM_COUNTERS; i++)
+    record->counters[i] = -1;
+  openRecords[numOpenRecords++] = vectorAppend(&records, record);
+
+  // The counters are started last to measure as little as possible of the
+  // code above.
+  record->outerPeakBytes = arenaStats.peakChunkBytes;
+  arenaStats.peakChunkBytes = arenaStats.chunkBytes;
+  record->allocs = arenaStats.allocs;
+  record->allocBytes = arenaStats.allocBytes;
+  record->startTime = getTime();
+}
+
+void timingStop(void)
+{
+  if (!enabled)
+    return;
+  assert(numOpenRecords > 0);
+
+  double endTime = getTime();
+  t_timingRecord *record = records.items[openRecords[--numOpenRecords]];
+  record->seconds = endTime - record->startTime;
+  record->allocs = arenaStats.allocs - record->allocs;
+  record->allocBytes = arenaStats.allocBytes - record->allocBytes;
+  record->peakBytes = arenaStats.peakChunkBytes;
+  if (record->outerPeakBytes > arenaStats.peakChunkBytes)
+    arenaStats.peakChunkBytes = record->outerPeakBytes;
+  record->maxRSS = getMaxRSS();
+}
+
+void timingSetCounter(t_timingCounter counter, int value)
+{
+  if (!enabled || numOpenRecords == 0)
+    return;
+  t_timingRecord *record = records.items[openRecords[numOpenRecords - 1]];
+  record->counters[counter] = value;
+}
+
+
+static void printTable(FILE *fout, const char *input)
+{
+  fprintf(fout, "Input: %s\n", input);
+  // Only the allocations from the arenas are counted, not those made with
+  // malloc() by the rest of the compiler.
+  fprintf(fout, "%-32s %10s %12s %10s %14s %9s %8s %6s %6s %6s\n", "Phase",
+      "Time (ms)", "Arena allocs", "Arena KiB", "Arena peak KiB", "RSS KiB",
+      "Instrs", "Temps", "Blocks", "Spills");
+
+  double totalSeconds = 0;
+  unsigned long totalAllocs = 0, totalAllocBytes = 0;
+  size_t peakBytes = 0;
+  long maxRSS = 0;
+  for (int i = 0; i < records.length; i++) {
+    t_timingRecord *record = records.items[i];
+    fprintf(fout, "%*s%-*s %10.3f %12lu %10lu %14zu %9ld", record->depth * 2,
+        "", 32 - record->depth * 2, record->name, record->seconds * 1000.0,
+        record->allocs, record->allocBytes / 1024, record->peakBytes / 1024,
+        record->maxRSS);
+    for (int j = 0; j < TIMING_NUM_COUNTERS; j++) {
+      int width = j == TIMING_INSTRUCTIONS ? 8 : 6;
+      if (record->counters[j] < 0)
+        fprintf(fout, " %*s", width, "-");
+      else
+        fprintf(fout, " %*d", width, record->counters[j]);
+    }
+    fprintf(fout, "\n");
+
+    // Nested phases are already included in the enclosing ones.
+    if (record->depth == 0) {
+      totalSeconds += record->seconds;
+      totalAllocs += record->allocs;
+      totalAllocBytes += record->allocBytes;
+    }
+    if (record->peakBytes > peakBytes)
+      peakBytes = record->peakBytes;
+    if (record->maxRSS > maxRSS)
+      maxRSS = record->maxRSS;
+  }
+
+  fprintf(fout, "%-32s %10.3f %12lu %10lu %14zu %9ld\n", "Total",
+      totalSeconds * 1000.0, totalAllocs, totalAllocBytes / 1024,
+      peakBytes / 1024, maxRSS);
+}
+
+static void printJSON(FILE *fout, const char *input)
+{
+  // File names with quotes or backslashes are not escaped.
+  fprintf(fout, "{\"input\": \"%s\", \"phases\": [", input);
+  for (int i = 0; i < records.length; i++) {
+    t_timingRecord *record = records.items[i];
+    // The names of the phases never need to be escaped.
+    fprintf(fout,
+        "%s\n  {\"name\": \"%s\", \"depth\": %d, \"wall_ms\": %.3f, "
+        "\"arena_allocs\": %lu, \"arena_alloc_bytes\": %lu, "
+        "\"arena_peak_bytes\": %zu, "
+        "\"max_rss_kib\": %ld",
+        i > 0 ? "," : "", record->name, record->depth,
+        record->seconds * 1000.0, record->allocs, record->allocBytes,
+        record->peakBytes, record->maxRSS);
+    for (int j = 0; j < TIMING_NUM_COUNTERS; j++) {
+      if (record->counters[j] >= 0)
+        fprintf(fout, ", \"%s\": %d", counterNames[j], record->counters[j]);
+    }
+    fprintf(fout, "}");
+  }
+  fprintf(fout, "\n]}\n");
+}
+
+void timingReport(FILE *fout, bool json, const char *input)
+{
+  if (!enabled)
+    return;
+  assert(numOpenRecords == 0);
+
+  // Keep the report together when several files are compiled in parallel.
+  flockfile(fout);
+  if (json)
+    printJSON(fout, input);
+  else
+    printTable(fout, input);
+  funlockfile(fout);
+
+  for (int i = 0; i < records.length; i++)
+    free(records.items[i]);
+  vectorClear(&records);
+}
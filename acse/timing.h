@@ -0,0 +1,69 @@
+/// @file timing.h
+/// @brief Measurement of the time and memory spent in each compilation phase
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup timing Timing
+ * @brief Measurement of the time and memory spent in each compilation phase
+ *
+ * When enabled, each phase of the compilation (parsing, each pass, each
+ * analysis and the steps of the register allocation) is measured between a
+ * call to timingStart() and one to timingStop(). Phases can be nested, and a
+ * phase includes the time of the phases nested in it. For each phase the
+ * wall time, the allocations from the arenas, the peak memory held by the
+ * arenas and the maximum resident set size of the process are recorded,
+ * together with some counters on the size of the program set with
+ * timingSetCounter(). When not enabled, these functions do nothing.
+ *
+ * The measurements are kept separately for each thread, which must compile
+ * one file at a time.
+ * @{
+ */
+
+/// Counters on the size of the program recorded for each phase.
+typedef enum {
+  TIMING_INSTRUCTIONS, ///< Number of instructions.
+  TIMING_TEMPORARIES,  ///< Number of temporary register identifiers.
+  TIMING_BLOCKS,       ///< Number of basic blocks.
+  TIMING_SPILLS,       ///< Number of spilled temporary registers.
+  TIMING_NUM_COUNTERS
+} t_timingCounter;
+
+/** Enable the measurements. Must be called before any phase is started, and
+ * before starting the threads. */
+void timingEnable(void);
+
+/** Checks if the measurements are enabled.
+ * @returns Whether timingEnable() was called. */
+bool timingEnabled(void);
+
+/** Start measuring a new phase, nested in the current one if any.
+ * @param name The name of the phase. Must not be freed until the report is
+ *             printed. */
+void timingStart(const char *name);
+
+/** Stop measuring the current phase. */
+void timingStop(void);
+
+/** Set the value of a counter for the current phase.
+ * @param counter The counter.
+ * @param value   The value of the counter at the end of the phase. */
+void timingSetCounter(t_timingCounter counter, int value);
+
+/** Print the measurements of all the phases started by the current thread,
+ * in the order they were started, and free them.
+ * @param fout  The output file.
+ * @param json  Whether to print the report as JSON instead of a table.
+ * @param input The name of the file compiled. */
+void timingReport(FILE *fout, bool json, const char *input);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,38 @@
+/// @file vector.c
+/// @brief A growable array of pointers implementation
+
+#include <stdlib.h>
+#include "vector.h"
+#include "errors.h"
+
+
+void vectorInit(t_vector *vector)
+{
+  vector->items = NULL;
+  vector->length = 0;
+  vector->capacity = 0;
+}
+
+
+int vectorAppend(t_vector *vector, void *data)
+{
+  if (vector->length == vector->capacity) {
+    // Double the capacity so that appending takes constant amortized time.
+    int newCapacity = vector->capacity ? vector->capacity * 2 : 16;
+    void **newItems =
+        realloc(vector->items, sizeof(void *) * (size_t)newCapacity);
+    if (newItems == NULL)
+      fatalError("out of memory");
+    vector->items = newItems;
+    vector->capacity = newCapacity;
+  }
+  vector->items[vector->length] = data;
+  return vector->length++;
+}
+
+
+void vectorClear(t_vector *vector)
+{
+  free(vector->items);
+  vectorInit(vector);
+}
@@ -0,0 +1,48 @@
+/// @file vector.h
+/// @brief A growable array of pointers
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+/**
+ * @defgroup vector Vector
+ * @brief Library for dynamically growing arrays of pointers.
+ *
+ * A vector stores a sequence of untyped data pointers in a contiguous array,
+ * which is enlarged as needed when elements are added at its end. Compared
+ * to a list, elements can be accessed by position and counted in constant
+ * time, but cannot be inserted or removed in the middle. As for lists, the
+ * data pointed to by the elements is owned by the client of the library.
+ *
+ * The elements are accessed directly through the `items' array, which is
+ * valid up to `length' elements. An empty vector has all the fields set to
+ * zero.
+ * @{
+ */
+
+/// A growable array of pointers.
+typedef struct {
+  void **items; ///< The elements of the vector.
+  int length;   ///< The number of elements in the vector.
+  int capacity; ///< The number of elements allocated in `items'.
+} t_vector;
+
+/** Initialize an empty vector.
+ * @param vector The vector to be initialized. */
+void vectorInit(t_vector *vector);
+
+/** Add an element at the end of a vector.
+ * @param vector The vector where to add the element.
+ * @param data   The data pointer to be added.
+ * @returns The position of the new element. */
+int vectorAppend(t_vector *vector, void *data);
+
+/** Remove all the elements of a vector, leaving it empty.
+ * @param vector The vector to be cleared. */
+void vectorClear(t_vector *vector);
+
+/**
+ * @}
+ */
+
+#endif
@@ -6,18 +6,6 @@
 #define MASK(n)             (((uint32_t)1 << (uint32_t)(n)) - (uint32_t)1)
 #define SHIFT_MASK(x, a, b) (((uint32_t)(x) & MASK(b - a)) << a)
 
-#define ENC_OPCODE_CODE(x) (((x) << 2) | 3)
-#define ENC_OPCODE_LOAD    ENC_OPCODE_CODE(0x00)
-#define ENC_OPCODE_OPIMM   ENC_OPCODE_CODE(0x04)
-#define ENC_OPCODE_AUIPC   ENC_OPCODE_CODE(0x05)
-#define ENC_OPCODE_STORE   ENC_OPCODE_CODE(0x08)
-#define ENC_OPCODE_OP      ENC_OPCODE_CODE(0x0C)
-#define ENC_OPCODE_LUI     ENC_OPCODE_CODE(0x0D)
-#define ENC_OPCODE_BRANCH  ENC_OPCODE_CODE(0x18)
-#define ENC_OPCODE_JALR    ENC_OPCODE_CODE(0x19)
-#define ENC_OPCODE_JAL     ENC_OPCODE_CODE(0x1B)
-#define ENC_OPCODE_SYSTEM  ENC_OPCODE_CODE(0x1C)
-
 #define HI_20(x) ((((x) >> 12) + ((x) & 0x800 ? 1 : 0)) & 0xFFFFF)
 #define LO_12(x) ((x) & 0xFFF)
 
@@ -114,54 +102,9 @@ typedef struct t_encInstrData {
 bool encPhysicalInstruction(t_instruction instr, uint32_t pc, t_data *res)
 {
   static const t_encInstrData opInstData[] = {
-      {   INSTR_OPC_ADD, 'R',     ENC_OPCODE_OP,  0,      0x00},
-      {   INSTR_OPC_SUB, 'R',     ENC_OPCODE_OP,  0,      0x20},
-      {   INSTR_OPC_SLL, 'R',     ENC_OPCODE_OP,  1,      0x00},
-      {   INSTR_OPC_SLT, 'R',     ENC_OPCODE_OP,  2,      0x00},
-      {  INSTR_OPC_SLTU, 'R',     ENC_OPCODE_OP,  3,      0x00},
-      {   INSTR_OPC_XOR, 'R',     ENC_OPCODE_OP,  4,      0x00},
-      {   INSTR_OPC_SRL, 'R',     ENC_OPCODE_OP,  5,      0x00},
-      {   INSTR_OPC_SRA, 'R',     ENC_OPCODE_OP,  5,      0x20},
-      {    INSTR_OPC_OR, 'R',     ENC_OPCODE_OP,  6,      0x00},
-      {   INSTR_OPC_AND, 'R',     ENC_OPCODE_OP,  7,      0x00},
-      {   INSTR_OPC_MUL, 'R',     ENC_OPCODE_OP,  0,      0x01},
-      {  INSTR_OPC_MULH, 'R',     ENC_OPCODE_OP,  1,      0x01},
-      {INSTR_OPC_MULHSU, 'R',     ENC_OPCODE_OP,  2,      0x01},
-      { INSTR_OPC_MULHU, 'R',     ENC_OPCODE_OP,  3,      0x01},
-      {   INSTR_OPC_DIV, 'R',     ENC_OPCODE_OP,  4,      0x01},
-      {  INSTR_OPC_DIVU, 'R',     ENC_OPCODE_OP,  5,      0x01},
-      {   INSTR_OPC_REM, 'R',     ENC_OPCODE_OP,  6,      0x01},
-      {  INSTR_OPC_REMU, 'R',     ENC_OPCODE_OP,  7,      0x01},
-      {  INSTR_OPC_ADDI, 'I',  ENC_OPCODE_OPIMM,  0, 0x00 << 5},
-      {  INSTR_OPC_SLLI, 'I',  ENC_OPCODE_OPIMM,  1, 0x00 << 5},
-      {  INSTR_OPC_SLTI, 'I',  ENC_OPCODE_OPIMM,  2, 0x00 << 5},
-      { INSTR_OPC_SLTIU, 'I',  ENC_OPCODE_OPIMM,  3, 0x00 << 5},
-      {  INSTR_OPC_XORI, 'I',  ENC_OPCODE_OPIMM,  4, 0x00 << 5},
-      {  INSTR_OPC_SRLI, 'I',  ENC_OPCODE_OPIMM,  5, 0x00 << 5},
-      {  INSTR_OPC_SRAI, 'I',  ENC_OPCODE_OPIMM,  5, 0x20 << 5},
-      {   INSTR_OPC_ORI, 'I',  ENC_OPCODE_OPIMM,  6, 0x00 << 5},
-      {  INSTR_OPC_ANDI, 'I',  ENC_OPCODE_OPIMM,  7, 0x00 << 5},
-      {    INSTR_OPC_LB, 'I',   ENC_OPCODE_LOAD,  0, 0x00 << 5},
-      {    INSTR_OPC_LH, 'I',   ENC_OPCODE_LOAD,  1, 0x00 << 5},
-      {    INSTR_OPC_LW, 'I',   ENC_OPCODE_LOAD,  2, 0x00 << 5},
-      {   INSTR_OPC_LBU, 'I',   ENC_OPCODE_LOAD,  4, 0x00 << 5},
-      {   INSTR_OPC_LHU, 'I',   ENC_OPCODE_LOAD,  5, 0x00 << 5},
-      {   INSTR_OPC_LUI, 'U',    ENC_OPCODE_LUI,  0,         0},
-      { INSTR_OPC_AUIPC, 'U',  ENC_OPCODE_AUIPC,  0,         0},
-      {    INSTR_OPC_SB, 'S',  ENC_OPCODE_STORE,  0, 0x00 << 5},
-      {    INSTR_OPC_SH, 'S',  ENC_OPCODE_STORE,  1, 0x00 << 5},
-      {    INSTR_OPC_SW, 'S',  ENC_OPCODE_STORE,  2, 0x00 << 5},
-      {   INSTR_OPC_JAL, 'J',    ENC_OPCODE_JAL,  0,         0},
-      {  INSTR_OPC_JALR, 'I',   ENC_OPCODE_JALR,  0,         0},
-      {   INSTR_OPC_BEQ, 'B', ENC_OPCODE_BRANCH,  0,         0},
-      {   INSTR_OPC_BNE, 'B', ENC_OPCODE_BRANCH,  1,         0},
-      {   INSTR_OPC_BLT, 'B', ENC_OPCODE_BRANCH,  4,         0},
-      {   INSTR_OPC_BGE, 'B', ENC_OPCODE_BRANCH,  5,         0},
-      {  INSTR_OPC_BLTU, 'B', ENC_OPCODE_BRANCH,  6,         0},
-      {  INSTR_OPC_BGEU, 'B', ENC_OPCODE_BRANCH,  7,         0},
-      { INSTR_OPC_ECALL, 'I', ENC_OPCODE_SYSTEM,  0,         0},
-      {INSTR_OPC_EBREAK, 'I', ENC_OPCODE_SYSTEM,  0,         1},
-      {              -1,  -1,                -1, -1,        -1}
+      // Generated from the ISA description, one line per instruction
+#include "encode_table.h"
+      {-1, -1, -1, -1, -1}
   };
   const t_encInstrData *info;
   uint32_t buf;
@@ -358,6 +301,15 @@ int encExpandPseudoInstruction(
       mInstSz++;
       break;
 
+    case INSTR_OPC_CSRR:
+      mInstBuf[mInstSz].opcode = INSTR_OPC_CSRRS;
+      mInstBuf[mInstSz].dest = instr.dest;
+      mInstBuf[mInstSz].src1 = 0;
+      mInstBuf[mInstSz].immMode = INSTR_IMM_CONST;
+      mInstBuf[mInstSz].constant = instr.constant;
+      mInstSz++;
+      break;
+
     default:
       mInstBuf[mInstSz++] = instr;
   }
@@ -13,6 +13,8 @@ struct t_lexer {
   char *nextTokenPtr;
   t_fileLocation nextTokenLoc;
   char *lookahead;
+  char *commentBegin;
+  char *commentEnd;
 };
 
 
@@ -181,12 +183,15 @@ void deleteToken(t_token *tok)
     free(tok->value.id);
   else if (tok->id == TOK_STRING || tok->id == TOK_CHARACTER)
     free(tok->value.string);
+  else if (tok->id == TOK_NEWLINE)
+    free(tok->value.comment);
 }
 
 
 static void lexSkipWhitespaceAndComments(t_lexer *lex)
 {
   int state = 0;
+  lex->commentBegin = lex->commentEnd = NULL;
   while (state != -1 && *lex->lookahead != '\0') {
     if (state == 0) {
       // normal whitespace
@@ -198,9 +203,11 @@ static void lexSkipWhitespaceAndComments(t_lexer *lex)
         } else if (lexAcceptString(lex, "//")) {
           // beginning of a C++-style line comment
           state = 2;
+          lex->commentBegin = lex->lookahead;
         } else if (lexAcceptChar(lex, '#')) {
           // beginning of a RISC-V-style line comment
           state = 2;
+          lex->commentBegin = lex->lookahead;
         } else {
           // end of whitespace
           state = -1;
@@ -223,6 +230,7 @@ static void lexSkipWhitespaceAndComments(t_lexer *lex)
         // end of the line comment and end of whitespace
         // (newlines are not considered whitespace!)
         state = -1;
+        lex->commentEnd = lex->lookahead;
       } else {
         lex->lookahead++;
       }
@@ -417,151 +425,136 @@ typedef struct t_keywordData {
   int32_t info;
 } t_keywordData;
 
+static int lexFindKeyword(t_lexer *lex, const t_keywordData *kwdata)
+{
+  for (int i = 0; kwdata[i].text != NULL; i++) {
+    if (lexIdentEquals(lex, kwdata[i].text))
+      return i;
+  }
+  return -1;
+}
+
 static t_token *lexExpectIdentifierOrKeyword(t_lexer *lex)
 {
   static const t_keywordData kwdata[] = {
-      {    "x0",     TOK_REGISTER,                0},
-      {    "x1",     TOK_REGISTER,                1},
-      {    "x2",     TOK_REGISTER,                2},
-      {    "x3",     TOK_REGISTER,                3},
-      {    "x4",     TOK_REGISTER,                4},
-      {    "x5",     TOK_REGISTER,                5},
-      {    "x6",     TOK_REGISTER,                6},
-      {    "x7",     TOK_REGISTER,                7},
-      {    "x8",     TOK_REGISTER,                8},
-      {    "x8",     TOK_REGISTER,                8},
-      {    "x9",     TOK_REGISTER,                9},
-      {   "x10",     TOK_REGISTER,               10},
-      {   "x11",     TOK_REGISTER,               11},
-      {   "x12",     TOK_REGISTER,               12},
-      {   "x13",     TOK_REGISTER,               13},
-      {   "x14",     TOK_REGISTER,               14},
-      {   "x15",     TOK_REGISTER,               15},
-      {   "x16",     TOK_REGISTER,               16},
-      {   "x17",     TOK_REGISTER,               17},
-      {   "x18",     TOK_REGISTER,               18},
-      {   "x19",     TOK_REGISTER,               19},
-      {   "x20",     TOK_REGISTER,               20},
-      {   "x21",     TOK_REGISTER,               21},
-      {   "x22",     TOK_REGISTER,               22},
-      {   "x23",     TOK_REGISTER,               23},
-      {   "x24",     TOK_REGISTER,               24},
-      {   "x25",     TOK_REGISTER,               25},
-      {   "x26",     TOK_REGISTER,               26},
-      {   "x27",     TOK_REGISTER,               27},
-      {   "x28",     TOK_REGISTER,               28},
-      {   "x29",     TOK_REGISTER,               29},
-      {   "x30",     TOK_REGISTER,               30},
-      {   "x31",     TOK_REGISTER,               31},
-      {  "zero",     TOK_REGISTER,                0},
-      {    "ra",     TOK_REGISTER,                1},
-      {    "sp",     TOK_REGISTER,                2},
-      {    "gp",     TOK_REGISTER,                3},
-      {    "tp",     TOK_REGISTER,                4},
-      {    "t0",     TOK_REGISTER,                5},
-      {    "t1",     TOK_REGISTER,                6},
-      {    "t2",     TOK_REGISTER,                7},
-      {    "s0",     TOK_REGISTER,                8},
-      {    "fp",     TOK_REGISTER,                8},
-      {    "s1",     TOK_REGISTER,                9},
-      {    "a0",     TOK_REGISTER,               10},
-      {    "a1",     TOK_REGISTER,               11},
-      {    "a2",     TOK_REGISTER,               12},
-      {    "a3",     TOK_REGISTER,               13},
-      {    "a4",     TOK_REGISTER,               14},
-      {    "a5",     TOK_REGISTER,               15},
-      {    "a6",     TOK_REGISTER,               16},
-      {    "a7",     TOK_REGISTER,               17},
-      {    "s2",     TOK_REGISTER,               18},
-      {    "s3",     TOK_REGISTER,               19},
-      {    "s4",     TOK_REGISTER,               20},
-      {    "s5",     TOK_REGISTER,               21},
-      {    "s6",     TOK_REGISTER,               22},
-      {    "s7",     TOK_REGISTER,               23},
-      {    "s8",     TOK_REGISTER,               24},
-      {    "s9",     TOK_REGISTER,               25},
-      {   "s10",     TOK_REGISTER,               26},
-      {   "s11",     TOK_REGISTER,               27},
-      {    "t3",     TOK_REGISTER,               28},
-      {    "t4",     TOK_REGISTER,               29},
-      {    "t5",     TOK_REGISTER,               30},
-      {    "t6",     TOK_REGISTER,               31},
-      {   "add",     TOK_MNEMONIC,    INSTR_OPC_ADD},
-      {   "sub",     TOK_MNEMONIC,    INSTR_OPC_SUB},
-      {   "xor",     TOK_MNEMONIC,    INSTR_OPC_XOR},
-      {    "or",     TOK_MNEMONIC,     INSTR_OPC_OR},
-      {   "and",     TOK_MNEMONIC,    INSTR_OPC_AND},
-      {   "sll",     TOK_MNEMONIC,    INSTR_OPC_SLL},
-      {   "srl",     TOK_MNEMONIC,    INSTR_OPC_SRL},
-      {   "sra",     TOK_MNEMONIC,    INSTR_OPC_SRA},
-      {   "slt",     TOK_MNEMONIC,    INSTR_OPC_SLT},
-      {  "sltu",     TOK_MNEMONIC,   INSTR_OPC_SLTU},
-      {   "mul",     TOK_MNEMONIC,    INSTR_OPC_MUL},
-      {  "mulh",     TOK_MNEMONIC,   INSTR_OPC_MULH},
-      {"mulhsu",     TOK_MNEMONIC, INSTR_OPC_MULHSU},
-      { "mulhu",     TOK_MNEMONIC,  INSTR_OPC_MULHU},
-      {   "div",     TOK_MNEMONIC,    INSTR_OPC_DIV},
-      {  "divu",     TOK_MNEMONIC,   INSTR_OPC_DIVU},
-      {   "rem",     TOK_MNEMONIC,    INSTR_OPC_REM},
-      {  "remu",     TOK_MNEMONIC,   INSTR_OPC_REMU},
-      {  "addi",     TOK_MNEMONIC,   INSTR_OPC_ADDI},
-      {  "xori",     TOK_MNEMONIC,   INSTR_OPC_XORI},
-      {   "ori",     TOK_MNEMONIC,    INSTR_OPC_ORI},
-      {  "andi",     TOK_MNEMONIC,   INSTR_OPC_ANDI},
-      {  "slli",     TOK_MNEMONIC,   INSTR_OPC_SLLI},
-      {  "srli",     TOK_MNEMONIC,   INSTR_OPC_SRLI},
-      {  "srai",     TOK_MNEMONIC,   INSTR_OPC_SRAI},
-      {  "slti",     TOK_MNEMONIC,   INSTR_OPC_SLTI},
-      { "sltiu",     TOK_MNEMONIC,  INSTR_OPC_SLTIU},
-      {    "lb",     TOK_MNEMONIC,     INSTR_OPC_LB},
-      {    "lh",     TOK_MNEMONIC,     INSTR_OPC_LH},
-      {    "lw",     TOK_MNEMONIC,     INSTR_OPC_LW},
-      {   "lbu",     TOK_MNEMONIC,    INSTR_OPC_LBU},
-      {   "lhu",     TOK_MNEMONIC,    INSTR_OPC_LHU},
-      {    "sb",     TOK_MNEMONIC,     INSTR_OPC_SB},
-      {    "sh",     TOK_MNEMONIC,     INSTR_OPC_SH},
-      {    "sw",     TOK_MNEMONIC,     INSTR_OPC_SW},
-      {   "nop",     TOK_MNEMONIC,    INSTR_OPC_NOP},
-      { "ecall",     TOK_MNEMONIC,  INSTR_OPC_ECALL},
-      {"ebreak",     TOK_MNEMONIC, INSTR_OPC_EBREAK},
-      {   "lui",     TOK_MNEMONIC,    INSTR_OPC_LUI},
-      { "auipc",     TOK_MNEMONIC,  INSTR_OPC_AUIPC},
-      {   "jal",     TOK_MNEMONIC,    INSTR_OPC_JAL},
-      {  "jalr",     TOK_MNEMONIC,   INSTR_OPC_JALR},
-      {   "beq",     TOK_MNEMONIC,    INSTR_OPC_BEQ},
-      {   "bne",     TOK_MNEMONIC,    INSTR_OPC_BNE},
-      {   "blt",     TOK_MNEMONIC,    INSTR_OPC_BLT},
-      {   "bge",     TOK_MNEMONIC,    INSTR_OPC_BGE},
-      {  "bltu",     TOK_MNEMONIC,   INSTR_OPC_BLTU},
-      {  "bgeu",     TOK_MNEMONIC,   INSTR_OPC_BGEU},
-      {    "li",     TOK_MNEMONIC,     INSTR_OPC_LI},
-      {    "la",     TOK_MNEMONIC,     INSTR_OPC_LA},
-      {     "j",     TOK_MNEMONIC,      INSTR_OPC_J},
-      {   "bgt",     TOK_MNEMONIC,    INSTR_OPC_BGT},
-      {   "ble",     TOK_MNEMONIC,    INSTR_OPC_BLE},
-      {  "bgtu",     TOK_MNEMONIC,   INSTR_OPC_BGTU},
-      {  "bleu",     TOK_MNEMONIC,   INSTR_OPC_BLEU},
-      {  "beqz",     TOK_MNEMONIC,   INSTR_OPC_BEQZ},
-      {  "bnez",     TOK_MNEMONIC,   INSTR_OPC_BNEZ},
-      {  "blez",     TOK_MNEMONIC,   INSTR_OPC_BLEZ},
-      {  "bgez",     TOK_MNEMONIC,   INSTR_OPC_BGEZ},
-      {  "bltz",     TOK_MNEMONIC,   INSTR_OPC_BLTZ},
-      {  "bgtz",     TOK_MNEMONIC,   INSTR_OPC_BGTZ},
-      {    NULL, TOK_UNRECOGNIZED,                0}
+      {       "x0",     TOK_REGISTER,                   0},
+      {       "x1",     TOK_REGISTER,                   1},
+      {       "x2",     TOK_REGISTER,                   2},
+      {       "x3",     TOK_REGISTER,                   3},
+      {       "x4",     TOK_REGISTER,                   4},
+      {       "x5",     TOK_REGISTER,                   5},
+      {       "x6",     TOK_REGISTER,                   6},
+      {       "x7",     TOK_REGISTER,                   7},
+      {       "x8",     TOK_REGISTER,                   8},
+      {       "x8",     TOK_REGISTER,                   8},
+      {       "x9",     TOK_REGISTER,                   9},
+      {      "x10",     TOK_REGISTER,                  10},
+      {      "x11",     TOK_REGISTER,                  11},
+      {      "x12",     TOK_REGISTER,                  12},
+      {      "x13",     TOK_REGISTER,                  13},
+      {      "x14",     TOK_REGISTER,                  14},
+      {      "x15",     TOK_REGISTER,                  15},
+      {      "x16",     TOK_REGISTER,                  16},
+      {      "x17",     TOK_REGISTER,                  17},
+      {      "x18",     TOK_REGISTER,                  18},
+      {      "x19",     TOK_REGISTER,                  19},
+      {      "x20",     TOK_REGISTER,                  20},
+      {      "x21",     TOK_REGISTER,                  21},
+      {      "x22",     TOK_REGISTER,                  22},
+      {      "x23",     TOK_REGISTER,                  23},
+      {      "x24",     TOK_REGISTER,                  24},
+      {      "x25",     TOK_REGISTER,                  25},
+      {      "x26",     TOK_REGISTER,                  26},
+      {      "x27",     TOK_REGISTER,                  27},
+      {      "x28",     TOK_REGISTER,                  28},
+      {      "x29",     TOK_REGISTER,                  29},
+      {      "x30",     TOK_REGISTER,                  30},
+      {      "x31",     TOK_REGISTER,                  31},
+      {     "zero",     TOK_REGISTER,                   0},
+      {       "ra",     TOK_REGISTER,                   1},
+      {       "sp",     TOK_REGISTER,                   2},
+      {       "gp",     TOK_REGISTER,                   3},
+      {       "tp",     TOK_REGISTER,                   4},
+      {       "t0",     TOK_REGISTER,                   5},
+      {       "t1",     TOK_REGISTER,                   6},
+      {       "t2",     TOK_REGISTER,                   7},
+      {       "s0",     TOK_REGISTER,                   8},
+      {       "fp",     TOK_REGISTER,                   8},
+      {       "s1",     TOK_REGISTER,                   9},
+      {       "a0",     TOK_REGISTER,                  10},
+      {       "a1",     TOK_REGISTER,                  11},
+      {       "a2",     TOK_REGISTER,                  12},
+      {       "a3",     TOK_REGISTER,                  13},
+      {       "a4",     TOK_REGISTER,                  14},
+      {       "a5",     TOK_REGISTER,                  15},
+      {       "a6",     TOK_REGISTER,                  16},
+      {       "a7",     TOK_REGISTER,                  17},
+      {       "s2",     TOK_REGISTER,                  18},
+      {       "s3",     TOK_REGISTER,                  19},
+      {       "s4",     TOK_REGISTER,                  20},
+      {       "s5",     TOK_REGISTER,                  21},
+      {       "s6",     TOK_REGISTER,                  22},
+      {       "s7",     TOK_REGISTER,                  23},
+      {       "s8",     TOK_REGISTER,                  24},
+      {       "s9",     TOK_REGISTER,                  25},
+      {      "s10",     TOK_REGISTER,                  26},
+      {      "s11",     TOK_REGISTER,                  27},
+      {       "t3",     TOK_REGISTER,                  28},
+      {       "t4",     TOK_REGISTER,                  29},
+      {       "t5",     TOK_REGISTER,                  30},
+      {       "t6",     TOK_REGISTER,                  31},
+      // real instructions, generated from the ISA description
+#define ISA_AS_INSTR(id, mnemonic, syntax) \
+      {mnemonic, TOK_MNEMONIC, INSTR_OPC_##id},
+#include "instr_list.h"
+#undef ISA_AS_INSTR
+      // pseudo-instructions
+      {      "nop",     TOK_MNEMONIC,       INSTR_OPC_NOP},
+      {       "li",     TOK_MNEMONIC,        INSTR_OPC_LI},
+      {       "la",     TOK_MNEMONIC,        INSTR_OPC_LA},
+      {        "j",     TOK_MNEMONIC,         INSTR_OPC_J},
+      {      "bgt",     TOK_MNEMONIC,       INSTR_OPC_BGT},
+      {      "ble",     TOK_MNEMONIC,       INSTR_OPC_BLE},
+      {     "bgtu",     TOK_MNEMONIC,      INSTR_OPC_BGTU},
+      {     "bleu",     TOK_MNEMONIC,      INSTR_OPC_BLEU},
+      {     "beqz",     TOK_MNEMONIC,      INSTR_OPC_BEQZ},
+      {     "bnez",     TOK_MNEMONIC,      INSTR_OPC_BNEZ},
+      {     "blez",     TOK_MNEMONIC,      INSTR_OPC_BLEZ},
+      {     "bgez",     TOK_MNEMONIC,      INSTR_OPC_BGEZ},
+      {     "bltz",     TOK_MNEMONIC,      INSTR_OPC_BLTZ},
+      {     "bgtz",     TOK_MNEMONIC,      INSTR_OPC_BGTZ},
+      {     "csrr",     TOK_MNEMONIC,      INSTR_OPC_CSRR},
+      {    "cycle",          TOK_CSR,               0xC00},
+      {  "instret",          TOK_CSR,               0xC02},
+      {   "cycleh",          TOK_CSR,               0xC80},
+      { "instreth",          TOK_CSR,               0xC82},
+      {  "mhartid",          TOK_CSR,               0xF14},
+      {       NULL, TOK_UNRECOGNIZED,                   0}
   };
 
   lexAcceptIdentifier(lex);
-  for (int i = 0; kwdata[i].text != NULL; i++) {
-    if (lexIdentEquals(lex, kwdata[i].text)) {
-      t_token *res = createToken(lex, kwdata[i].id);
-      if (kwdata[i].id == TOK_REGISTER)
-        res->value.reg = kwdata[i].info;
-      else if (kwdata[i].id == TOK_MNEMONIC)
-        res->value.mnemonic = kwdata[i].info;
-      else
-        assert(0 && "bad keyword data table");
-      return res;
-    }
+  // Some mnemonics contain a dot (e.g. "lr.w"). The dot and the following
+  // characters are part of the token only if they form a keyword.
+  char *identEnd = lex->lookahead;
+  int kwIdx = -1;
+  if (lexAcceptChar(lex, '.') && lexAcceptIdentifier(lex) > 0)
+    kwIdx = lexFindKeyword(lex, kwdata);
+  if (kwIdx < 0) {
+    lex->lookahead = identEnd;
+    kwIdx = lexFindKeyword(lex, kwdata);
+  }
+
+  if (kwIdx >= 0) {
+    t_token *res = createToken(lex, kwdata[kwIdx].id);
+    if (kwdata[kwIdx].id == TOK_REGISTER)
+      res->value.reg = kwdata[kwIdx].info;
+    else if (kwdata[kwIdx].id == TOK_MNEMONIC)
+      res->value.mnemonic = kwdata[kwIdx].info;
+    else if (kwdata[kwIdx].id == TOK_CSR)
+      res->value.csr = kwdata[kwIdx].info;
+    else
+      assert(0 && "bad keyword data table");
+    return res;
   }
 
   t_token *res = createToken(lex, TOK_ID);
@@ -582,8 +575,14 @@ t_token *lexNextToken(t_lexer *lex)
     return createToken(lex, TOK_EOF);
   }
 
-  if (lexAcceptNewline(lex))
-    return createToken(lex, TOK_NEWLINE);
+  if (lexAcceptNewline(lex)) {
+    // Line comments are kept with the newline that terminates them, so that
+    // the parser can attach them to the statement on the same line.
+    t_token *res = createToken(lex, TOK_NEWLINE);
+    if (lex->commentBegin && lex->commentEnd)
+      res->value.comment = lexRangeToString(lex->commentBegin, lex->commentEnd);
+    return res;
+  }
   if (lexAcceptChar(lex, ';'))
     return createToken(lex, TOK_NEWLINE);
 
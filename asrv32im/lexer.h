@@ -34,7 +34,8 @@ enum {
   TOK_LO,
   TOK_PCREL_HI,
   TOK_PCREL_LO,
-  TOK_MNEMONIC
+  TOK_MNEMONIC,
+  TOK_CSR
 };
 
 typedef struct {
@@ -49,6 +50,8 @@ typedef struct {
     char *string;
     t_instrRegID reg;
     t_instrOpcode mnemonic;
+    int32_t csr;
+    char *comment;
   } value;
 } t_token;
 
@@ -9,6 +9,7 @@ struct t_objLabel {
   struct t_objLabel *next;
   char *name;
   t_objSecItem *pointer;
+  t_objSectionID section;
 };
 
 struct t_objSection {
@@ -23,6 +24,10 @@ struct t_object {
   t_objSection *data;
   t_objSection *text;
   t_objLabel *labelList;
+  // Hash table of the labels by name, with open addressing
+  t_objLabel **labelTable;
+  size_t labelTableSize;
+  size_t numLabels;
 };
 
 
@@ -51,6 +56,8 @@ static void deleteSection(t_objSection *sec)
 
   for (item = sec->items; item != NULL; item = nextItm) {
     nextItm = item->next;
+    if (item->class == OBJ_SEC_ITM_CLASS_SRC_LOCATION)
+      free(item->body.srcLocation.file);
     free(item);
   }
 
@@ -68,6 +75,9 @@ t_object *newObject(void)
   obj->data = newSection(OBJ_SECTION_DATA);
   obj->text = newSection(OBJ_SECTION_TEXT);
   obj->labelList = NULL;
+  obj->labelTable = NULL;
+  obj->labelTableSize = 0;
+  obj->numLabels = 0;
   return obj;
 }
 
@@ -87,19 +97,61 @@ void deleteObject(t_object *obj)
     free(lbl->name);
     free(lbl);
   }
+  free(obj->labelTable);
 
   free(obj);
 }
 
 
-t_objLabel *objFindLabel(t_object *obj, const char *name)
+// FNV-1a hash of a label name
+static size_t objLabelHash(const char *name)
 {
-  t_objLabel *lbl;
-  for (lbl = obj->labelList; lbl != NULL; lbl = lbl->next) {
-    if (strcmp(lbl->name, name) == 0)
-      break;
+  uint32_t hash = 2166136261u;
+  for (; *name; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619u;
   }
-  return lbl;
+  return hash;
+}
+
+// Returns the slot of the label table containing the label with the given
+// name, or the empty slot where it would be inserted
+static t_objLabel **objLabelTableLookup(
+    t_objLabel **table, size_t size, const char *name)
+{
+  size_t mask = size - 1;
+  for (size_t i = objLabelHash(name) & mask;; i = (i + 1) & mask) {
+    if (table[i] == NULL || strcmp(table[i]->name, name) == 0)
+      return &table[i];
+  }
+}
+
+static void objLabelTableInsert(t_object *obj, t_objLabel *lbl)
+{
+  // Keep the table at most half full
+  if ((obj->numLabels + 1) * 2 > obj->labelTableSize) {
+    size_t newSize = obj->labelTableSize ? obj->labelTableSize * 2 : 64;
+    t_objLabel **newTable = calloc(newSize, sizeof(t_objLabel *));
+    if (!newTable)
+      fatalError("out of memory");
+    for (size_t i = 0; i < obj->labelTableSize; i++) {
+      t_objLabel *old = obj->labelTable[i];
+      if (old)
+        *objLabelTableLookup(newTable, newSize, old->name) = old;
+    }
+    free(obj->labelTable);
+    obj->labelTable = newTable;
+    obj->labelTableSize = newSize;
+  }
+  *objLabelTableLookup(obj->labelTable, obj->labelTableSize, lbl->name) = lbl;
+  obj->numLabels++;
+}
+
+t_objLabel *objFindLabel(t_object *obj, const char *name)
+{
+  if (obj->labelTableSize == 0)
+    return NULL;
+  return *objLabelTableLookup(obj->labelTable, obj->labelTableSize, name);
 }
 
 t_objLabel *objGetLabel(t_object *obj, const char *name)
@@ -116,11 +168,19 @@ t_objLabel *objGetLabel(t_object *obj, const char *name)
     fatalError("out of memory");
   lbl->next = obj->labelList;
   lbl->pointer = NULL;
+  lbl->section = OBJ_SECTION_TEXT;
   obj->labelList = lbl;
+  objLabelTableInsert(obj, lbl);
   return lbl;
 }
 
 
+t_objLabel *objGetLabelList(t_object *obj)
+{
+  return obj->labelList;
+}
+
+
 t_objSection *objGetSection(t_object *obj, t_objSectionID id)
 {
   if (id == OBJ_SECTION_TEXT)
@@ -221,9 +281,29 @@ bool objSecDeclareLabel(t_objSection *sec, t_objLabel *label)
   objSecAppend(sec, itm);
 
   label->pointer = itm;
+  label->section = sec->id;
   return true;
 }
 
+// Source locations are empty items which mark the beginning of the code
+// generated from a given line of a source file (e.g. a LANCE program compiled
+// by ACSE). The location applies to all items up to the next marker.
+void objSecAppendSourceLocation(t_objSection *sec, t_fileLocation loc)
+{
+  t_objSecItem *itm;
+
+  itm = malloc(sizeof(t_objSecItem));
+  if (!itm)
+    fatalError("out of memory");
+  itm->address = 0;
+  itm->class = OBJ_SEC_ITM_CLASS_SRC_LOCATION;
+  itm->body.srcLocation = loc;
+  itm->body.srcLocation.file = strdup(loc.file);
+  if (!itm->body.srcLocation.file)
+    fatalError("out of memory");
+  objSecAppend(sec, itm);
+}
+
 
 t_objSecItem *objSecGetItemList(t_objSection *sec)
 {
@@ -244,11 +324,18 @@ uint32_t objSecGetSize(t_objSection *sec)
 t_objSecItem *objLabelGetPointedItem(t_objLabel *lbl)
 {
   t_objSecItem *item = lbl->pointer;
-  while (item && item->next && item->class == OBJ_SEC_ITM_CLASS_VOID)
+  while (item && item->next &&
+      (item->class == OBJ_SEC_ITM_CLASS_VOID ||
+          item->class == OBJ_SEC_ITM_CLASS_SRC_LOCATION))
     item = item->next;
   return item;
 }
 
+t_objLabel *objLabelGetNext(t_objLabel *lbl)
+{
+  return lbl->next;
+}
+
 const char *objLabelGetName(t_objLabel *lbl)
 {
   return lbl->name;
@@ -261,6 +348,16 @@ uint32_t objLabelGetPointer(t_objLabel *lbl)
   return lbl->pointer->address;
 }
 
+bool objLabelIsDeclared(t_objLabel *lbl)
+{
+  return lbl->pointer != NULL;
+}
+
+t_objSectionID objLabelGetSectionID(t_objLabel *lbl)
+{
+  return lbl->section;
+}
+
 
 static bool objSecExpandPseudoInstructions(t_objSection *sec)
 {
@@ -429,6 +526,9 @@ static void objSecDump(t_objSection *sec)
       printf("    Fill value = %02x\n", itm->body.alignData.fillByte);
     } else if (itm->class == OBJ_SEC_ITM_CLASS_VOID) {
       printf("    (null contents)\n");
+    } else if (itm->class == OBJ_SEC_ITM_CLASS_SRC_LOCATION) {
+      printf("    Source location = %s:%d\n", itm->body.srcLocation.file,
+          itm->body.srcLocation.row + 1);
     } else {
       printf("    (class is invalid!)\n");
     }
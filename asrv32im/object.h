@@ -19,59 +19,15 @@ typedef struct t_objSection t_objSection;
 typedef int t_instrRegID;
 typedef int t_instrOpcode;
 enum {
-  /* real instructions */
-  INSTR_OPC_ADD,
-  INSTR_OPC_SUB,
-  INSTR_OPC_XOR,
-  INSTR_OPC_OR,
-  INSTR_OPC_AND,
-  INSTR_OPC_SLL,
-  INSTR_OPC_SRL,
-  INSTR_OPC_SRA,
-  INSTR_OPC_SLT,
-  INSTR_OPC_SLTU,
-  INSTR_OPC_MUL,
-  INSTR_OPC_MULH,
-  INSTR_OPC_MULHSU,
-  INSTR_OPC_MULHU,
-  INSTR_OPC_DIV,
-  INSTR_OPC_DIVU,
-  INSTR_OPC_REM,
-  INSTR_OPC_REMU,
-  INSTR_OPC_ADDI,
-  INSTR_OPC_XORI,
-  INSTR_OPC_ORI,
-  INSTR_OPC_ANDI,
-  INSTR_OPC_SLLI,
-  INSTR_OPC_SRLI,
-  INSTR_OPC_SRAI,
-  INSTR_OPC_SLTI,
-  INSTR_OPC_SLTIU,
-  INSTR_OPC_LB,
-  INSTR_OPC_LH,
-  INSTR_OPC_LW,
-  INSTR_OPC_LBU,
-  INSTR_OPC_LHU,
-  INSTR_OPC_SB,
-  INSTR_OPC_SH,
-  INSTR_OPC_SW,
-  INSTR_OPC_ECALL,
-  INSTR_OPC_EBREAK,
-  INSTR_OPC_LUI,
-  INSTR_OPC_AUIPC,
-  INSTR_OPC_JAL,
-  INSTR_OPC_JALR,
-  INSTR_OPC_BEQ,
-  INSTR_OPC_BNE,
-  INSTR_OPC_BLT,
-  INSTR_OPC_BGE,
-  INSTR_OPC_BLTU,
-  INSTR_OPC_BGEU,
+  /* real instructions, generated from the ISA description */
+#define ISA_AS_INSTR(id, mnemonic, syntax) INSTR_OPC_##id,
+#include "instr_list.h"
+#undef ISA_AS_INSTR
   /* pseudo-instructions */
   INSTR_OPC_NOP,
   INSTR_OPC_LI,
   INSTR_OPC_LA,
-  INSTR_OPC_LB_G, // keep Lx_G/Sx_G in the same order as Lx/Sx above!
+  INSTR_OPC_LB_G, // keep Lx_G/Sx_G in the same order as Lx/Sx in the ISA!
   INSTR_OPC_LH_G,
   INSTR_OPC_LW_G,
   INSTR_OPC_LBU_G,
@@ -89,7 +45,8 @@ enum {
   INSTR_OPC_BLEZ,
   INSTR_OPC_BGEZ,
   INSTR_OPC_BLTZ,
-  INSTR_OPC_BGTZ
+  INSTR_OPC_BGTZ,
+  INSTR_OPC_CSRR
 };
 
 typedef int t_instrImmMode;
@@ -135,7 +92,8 @@ enum {
   OBJ_SEC_ITM_CLASS_INSTR,
   OBJ_SEC_ITM_CLASS_DATA,
   OBJ_SEC_ITM_CLASS_ALIGN_DATA,
-  OBJ_SEC_ITM_CLASS_VOID
+  OBJ_SEC_ITM_CLASS_VOID,
+  OBJ_SEC_ITM_CLASS_SRC_LOCATION
 };
 
 typedef struct t_objSecItem {
@@ -146,6 +104,7 @@ typedef struct t_objSecItem {
     t_instruction instr;
     t_data data;
     t_alignData alignData;
+    t_fileLocation srcLocation;
   } body;
 } t_objSecItem;
 
@@ -155,6 +114,7 @@ void deleteObject(t_object *obj);
 
 t_objLabel *objFindLabel(t_object *obj, const char *name);
 t_objLabel *objGetLabel(t_object *obj, const char *name);
+t_objLabel *objGetLabelList(t_object *obj);
 void objDump(t_object *obj);
 
 t_objSection *objGetSection(t_object *obj, t_objSectionID id);
@@ -163,14 +123,18 @@ void objSecAppendData(t_objSection *sec, t_data data);
 void objSecAppendAlignmentData(t_objSection *sec, t_alignData align);
 void objSecAppendInstruction(t_objSection *sec, t_instruction instr);
 bool objSecDeclareLabel(t_objSection *sec, t_objLabel *label);
+void objSecAppendSourceLocation(t_objSection *sec, t_fileLocation loc);
 
 t_objSecItem *objSecGetItemList(t_objSection *sec);
 uint32_t objSecGetStart(t_objSection *sec);
 uint32_t objSecGetSize(t_objSection *sec);
 
 t_objSecItem *objLabelGetPointedItem(t_objLabel *lbl);
+t_objLabel *objLabelGetNext(t_objLabel *lbl);
 const char *objLabelGetName(t_objLabel *lbl);
 uint32_t objLabelGetPointer(t_objLabel *lbl);
+bool objLabelIsDeclared(t_objLabel *lbl);
+t_objSectionID objLabelGetSectionID(t_objLabel *lbl);
 
 bool objMaterialize(t_object *obj);
 
@@ -75,6 +75,7 @@ typedef struct __attribute__((packed)) Elf32_Phdr {
 
 #define SHT_NULL      0         // null section
 #define SHT_PROGBITS  1         // section loaded with the program
+#define SHT_SYMTAB    2         // symbol table
 #define SHT_STRTAB    3         // string table
 
 #define SHF_WRITE     (1 << 0)  // section writable flag
@@ -95,6 +96,19 @@ typedef struct __attribute__((packed)) Elf32_Shdr {
   Elf32_Word sh_entsize;
 } Elf32_Shdr;
 
+#define STB_LOCAL     0         // symbol not visible outside the object
+#define STT_NOTYPE    0         // symbol type not specified
+#define ELF32_ST_INFO(b, t) (((b) << 4) + ((t) & 0xf))
+
+typedef struct __attribute__((packed)) Elf32_Sym {
+  Elf32_Word st_name;
+  Elf32_Addr st_value;
+  Elf32_Word st_size;
+  unsigned char st_info;
+  unsigned char st_other;
+  Elf32_Half st_shndx;
+} Elf32_Sym;
+
 
 typedef struct t_outStrTbl {
   char *buf;
@@ -122,7 +136,7 @@ void outStrTblAddString(t_outStrTbl *tbl, char *str, Elf32_Word *outIdx)
   size_t strSz = strlen(str) + 1;
   if (tbl->bufSz - tbl->tail < strSz) {
     size_t newBufSz = tbl->bufSz * 2 + strSz;
-    char *newBuf = realloc(tbl->buf, tbl->bufSz);
+    char *newBuf = realloc(tbl->buf, newBufSz);
     if (!newBuf)
       fatalError("out of memory");
     tbl->buf = newBuf;
@@ -134,6 +148,19 @@ void outStrTblAddString(t_outStrTbl *tbl, char *str, Elf32_Word *outIdx)
   tbl->tail += strSz;
 }
 
+void outStrTblGetString(t_outStrTbl *tbl, char *str, Elf32_Word *outIdx)
+{
+  size_t i = 0;
+  while (i < tbl->tail) {
+    if (strcmp(tbl->buf + i, str) == 0) {
+      *outIdx = (Elf32_Word)i;
+      return;
+    }
+    i += strlen(tbl->buf + i) + 1;
+  }
+  outStrTblAddString(tbl, str, outIdx);
+}
+
 Elf32_Shdr outputStrTabToELFSHdr(
     t_outStrTbl *tbl, Elf32_Addr fileOffset, Elf32_Word name)
 {
@@ -206,7 +233,8 @@ t_outError outputSecContentToFile(FILE *fp, off_t whence, t_objSection *sec)
 
   t_objSecItem *itm = objSecGetItemList(sec);
   for (; itm != NULL; itm = itm->next) {
-    if (itm->class == OBJ_SEC_ITM_CLASS_VOID) {
+    if (itm->class == OBJ_SEC_ITM_CLASS_VOID ||
+        itm->class == OBJ_SEC_ITM_CLASS_SRC_LOCATION) {
       continue;
     } else if (itm->class == OBJ_SEC_ITM_CLASS_DATA) {
       if (itm->body.data.initialized) {
@@ -239,6 +267,169 @@ t_outError outputSecContentToFile(FILE *fp, off_t whence, t_objSection *sec)
 }
 
 
+// The .srclines section maps code addresses to lines of the source file the
+// code was compiled from. Each entry applies from its address up to the
+// address of the next entry. File names are stored in .strtab.
+typedef struct __attribute__((packed)) t_outSrcLine {
+  Elf32_Addr address;
+  Elf32_Word file;
+  Elf32_Word line;
+} t_outSrcLine;
+
+typedef struct t_outSrcLineTbl {
+  t_outSrcLine *entries;
+  size_t count;
+} t_outSrcLineTbl;
+
+void initOutSrcLineTbl(
+    t_outSrcLineTbl *lines, t_objSection *sec, t_outStrTbl *strTbl)
+{
+  lines->entries = NULL;
+  lines->count = 0;
+  size_t bufCount = 0;
+
+  t_objSecItem *itm = objSecGetItemList(sec);
+  for (; itm != NULL; itm = itm->next) {
+    if (itm->class != OBJ_SEC_ITM_CLASS_SRC_LOCATION)
+      continue;
+    if (lines->count == bufCount) {
+      bufCount = bufCount * 2 + 16;
+      t_outSrcLine *newBuf =
+          realloc(lines->entries, bufCount * sizeof(t_outSrcLine));
+      if (!newBuf)
+        fatalError("out of memory");
+      lines->entries = newBuf;
+    }
+    Elf32_Word fileName;
+    outStrTblGetString(strTbl, itm->body.srcLocation.file, &fileName);
+    t_outSrcLine *entry = &lines->entries[lines->count++];
+    entry->address = itm->address;
+    entry->file = fileName;
+    entry->line = (Elf32_Word)itm->body.srcLocation.row + 1;
+  }
+}
+
+void deinitOutSrcLineTbl(t_outSrcLineTbl *lines)
+{
+  free(lines->entries);
+}
+
+Elf32_Shdr outputSrcLineTblToELFSHdr(
+    t_outSrcLineTbl *lines, Elf32_Addr fileOffset, Elf32_Word name)
+{
+  Elf32_Shdr shdr = {0};
+
+  shdr.sh_name = name;
+  shdr.sh_type = SHT_PROGBITS;
+  shdr.sh_flags = 0;
+  shdr.sh_addr = 0;
+  shdr.sh_offset = fileOffset;
+  shdr.sh_size = (Elf32_Word)(lines->count * sizeof(t_outSrcLine));
+  shdr.sh_link = SHN_UNDEF;
+  shdr.sh_info = 0;
+  shdr.sh_addralign = 0;
+  shdr.sh_entsize = sizeof(t_outSrcLine);
+
+  return shdr;
+}
+
+t_outError outputSrcLineTblContentToFile(
+    FILE *fp, off_t whence, t_outSrcLineTbl *lines)
+{
+  if (fseeko(fp, whence, SEEK_SET) < 0)
+    return OUT_FILE_ERROR;
+  if (fwrite(lines->entries, sizeof(t_outSrcLine), lines->count, fp) <
+      lines->count)
+    return OUT_FILE_ERROR;
+  return OUT_NO_ERROR;
+}
+
+
+// The .symtab section lists all the labels declared in the source, except
+// for numeric local labels, sorted by address. Symbols are needed only for
+// debugging, hence they are all local.
+typedef struct t_outSymTbl {
+  Elf32_Sym *entries;
+  size_t count;
+} t_outSymTbl;
+
+static int outCompareSymbols(const void *a, const void *b)
+{
+  const Elf32_Sym *sa = a, *sb = b;
+  if (sa->st_value != sb->st_value)
+    return sa->st_value < sb->st_value ? -1 : 1;
+  if (sa->st_name != sb->st_name)
+    return sa->st_name < sb->st_name ? -1 : 1;
+  return 0;
+}
+
+void initOutSymTbl(t_outSymTbl *syms, t_object *obj, t_outStrTbl *strTbl,
+    Elf32_Half textIdx, Elf32_Half dataIdx)
+{
+  size_t bufCount = 1;
+  t_objLabel *lbl = objGetLabelList(obj);
+  for (; lbl != NULL; lbl = objLabelGetNext(lbl))
+    bufCount++;
+  syms->entries = calloc(bufCount, sizeof(Elf32_Sym));
+  if (!syms->entries)
+    fatalError("out of memory");
+  // The first entry is the null symbol
+  syms->count = 1;
+
+  for (lbl = objGetLabelList(obj); lbl != NULL; lbl = objLabelGetNext(lbl)) {
+    const char *name = objLabelGetName(lbl);
+    if (!objLabelIsDeclared(lbl) || name[0] == '.')
+      continue;
+    Elf32_Word symName;
+    outStrTblAddString(strTbl, (char *)name, &symName);
+    Elf32_Sym *sym = &syms->entries[syms->count++];
+    sym->st_name = symName;
+    sym->st_value = objLabelGetPointer(lbl);
+    sym->st_info = ELF32_ST_INFO(STB_LOCAL, STT_NOTYPE);
+    if (objLabelGetSectionID(lbl) == OBJ_SECTION_TEXT)
+      sym->st_shndx = textIdx;
+    else
+      sym->st_shndx = dataIdx;
+  }
+  qsort(syms->entries + 1, syms->count - 1, sizeof(Elf32_Sym),
+      outCompareSymbols);
+}
+
+void deinitOutSymTbl(t_outSymTbl *syms)
+{
+  free(syms->entries);
+}
+
+Elf32_Shdr outputSymTblToELFSHdr(t_outSymTbl *syms, Elf32_Addr fileOffset,
+    Elf32_Word name, Elf32_Word strTblIdx)
+{
+  Elf32_Shdr shdr = {0};
+
+  shdr.sh_name = name;
+  shdr.sh_type = SHT_SYMTAB;
+  shdr.sh_flags = 0;
+  shdr.sh_addr = 0;
+  shdr.sh_offset = fileOffset;
+  shdr.sh_size = (Elf32_Word)(syms->count * sizeof(Elf32_Sym));
+  shdr.sh_link = strTblIdx;
+  // Index of the first non-local symbol
+  shdr.sh_info = (Elf32_Word)syms->count;
+  shdr.sh_addralign = 4;
+  shdr.sh_entsize = sizeof(Elf32_Sym);
+
+  return shdr;
+}
+
+t_outError outputSymTblContentToFile(FILE *fp, off_t whence, t_outSymTbl *syms)
+{
+  if (fseeko(fp, whence, SEEK_SET) < 0)
+    return OUT_FILE_ERROR;
+  if (fwrite(syms->entries, sizeof(Elf32_Sym), syms->count, fp) < syms->count)
+    return OUT_FILE_ERROR;
+  return OUT_NO_ERROR;
+}
+
+
 enum {
   PRG_ID_TEXT = 0,
   PRG_ID_DATA,
@@ -249,7 +440,9 @@ enum {
   SEC_ID_NULL = SHN_UNDEF,
   SEC_ID_TEXT,
   SEC_ID_DATA,
+  SEC_ID_STRTAB,
   SEC_ID_SYMTAB,
+  SEC_ID_SRCLINES,
   SEC_NUM
 };
 
@@ -266,6 +459,30 @@ t_outError outputToELF(t_object *obj, const char *fname)
   t_objSection *text = objGetSection(obj, OBJ_SECTION_TEXT);
   t_objSection *data = objGetSection(obj, OBJ_SECTION_DATA);
 
+  t_outStrTbl strTbl;
+  initOutStrTbl(&strTbl);
+  Elf32_Word textSecName, dataSecName, strtabSecName, symtabSecName;
+  Elf32_Word srcLinesSecName;
+  outStrTblAddString(&strTbl, ".text", &textSecName);
+  outStrTblAddString(&strTbl, ".data", &dataSecName);
+  outStrTblAddString(&strTbl, ".strtab", &strtabSecName);
+  outStrTblAddString(&strTbl, ".symtab", &symtabSecName);
+
+  t_outSymTbl symTbl;
+  initOutSymTbl(&symTbl, obj, &strTbl, SEC_ID_TEXT, SEC_ID_DATA);
+
+  // The .srclines section is emitted only if the source contained line
+  // information, and in that case it is the last section in the table.
+  t_outSrcLineTbl srcLines;
+  initOutSrcLineTbl(&srcLines, text, &strTbl);
+  Elf32_Half numSections = SEC_NUM;
+  if (srcLines.count > 0)
+    outStrTblAddString(&strTbl, ".srclines", &srcLinesSecName);
+  else
+    numSections = SEC_ID_SRCLINES;
+  size_t headSize = sizeof(t_outputELFHead) -
+      (SEC_NUM - numSections) * sizeof(Elf32_Shdr);
+
   t_outputELFHead head = {0};
   head.e.e_ident[EI_MAG0] = 0x7F;
   head.e.e_ident[EI_MAG1] = 'E';
@@ -284,8 +501,8 @@ t_outError outputToELF(t_object *obj, const char *fname)
   head.e.e_phentsize = sizeof(Elf32_Phdr);
   head.e.e_phnum = PRG_NUM;
   head.e.e_shentsize = sizeof(Elf32_Shdr);
-  head.e.e_shnum = SEC_NUM;
-  head.e.e_shstrndx = SEC_ID_SYMTAB;
+  head.e.e_shnum = numSections;
+  head.e.e_shstrndx = SEC_ID_STRTAB;
 
   t_objLabel *l_entry = objFindLabel(obj, "_start");
   if (!l_entry) {
@@ -296,16 +513,12 @@ t_outError outputToELF(t_object *obj, const char *fname)
     head.e.e_entry = objLabelGetPointer(l_entry);
   }
 
-  Elf32_Addr textAddr = sizeof(t_outputELFHead);
+  Elf32_Addr textAddr = (Elf32_Addr)headSize;
   Elf32_Addr dataAddr = textAddr + objSecGetSize(text);
   Elf32_Addr strtabAddr = dataAddr + objSecGetSize(data);
-
-  t_outStrTbl strTbl;
-  initOutStrTbl(&strTbl);
-  Elf32_Word textSecName, dataSecName, strtabSecName;
-  outStrTblAddString(&strTbl, ".text", &textSecName);
-  outStrTblAddString(&strTbl, ".data", &dataSecName);
-  outStrTblAddString(&strTbl, ".strtab", &strtabSecName);
+  Elf32_Addr symtabAddr = (strtabAddr + (Elf32_Addr)strTbl.tail + 3) & ~3U;
+  Elf32_Addr srcLinesAddr =
+      symtabAddr + (Elf32_Addr)(symTbl.count * sizeof(Elf32_Sym));
 
   head.p[PRG_ID_TEXT] = outputSecToELFPHdr(text, textAddr, PF_R + PF_X);
   head.p[PRG_ID_DATA] = outputSecToELFPHdr(data, dataAddr, PF_R + PF_W);
@@ -314,15 +527,20 @@ t_outError outputToELF(t_object *obj, const char *fname)
       text, textAddr, textSecName, SHF_ALLOC + SHF_EXECINSTR);
   head.s[SEC_ID_DATA] =
       outputSecToELFSHdr(data, dataAddr, dataSecName, SHF_ALLOC + SHF_WRITE);
-  head.s[SEC_ID_SYMTAB] =
+  head.s[SEC_ID_STRTAB] =
       outputStrTabToELFSHdr(&strTbl, strtabAddr, strtabSecName);
+  head.s[SEC_ID_SYMTAB] = outputSymTblToELFSHdr(
+      &symTbl, symtabAddr, symtabSecName, SEC_ID_STRTAB);
+  if (srcLines.count > 0)
+    head.s[SEC_ID_SRCLINES] =
+        outputSrcLineTblToELFSHdr(&srcLines, srcLinesAddr, srcLinesSecName);
 
   FILE *fp = fopen(fname, "wb");
   if (fp == NULL) {
     res = OUT_FILE_ERROR;
     goto exit;
   }
-  if (fwrite(&head, sizeof(t_outputELFHead), 1, fp) < 1) {
+  if (fwrite(&head, headSize, 1, fp) < 1) {
     res = OUT_FILE_ERROR;
     goto exit;
   }
@@ -335,8 +553,18 @@ t_outError outputToELF(t_object *obj, const char *fname)
   res = outputStrTabContentToFile(fp, strtabAddr, &strTbl);
   if (res != OUT_NO_ERROR)
     goto exit;
+  res = outputSymTblContentToFile(fp, symtabAddr, &symTbl);
+  if (res != OUT_NO_ERROR)
+    goto exit;
+  if (srcLines.count > 0) {
+    res = outputSrcLineTblContentToFile(fp, srcLinesAddr, &srcLines);
+    if (res != OUT_NO_ERROR)
+      goto exit;
+  }
 
 exit:
+  deinitOutSrcLineTbl(&srcLines);
+  deinitOutSymTbl(&symTbl);
   deinitOutStrTbl(&strTbl);
   if (fp)
     fclose(fp);
@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <ctype.h>
 #include "parser.h"
 #include "errors.h"
@@ -29,6 +31,7 @@ typedef struct t_parserState {
   int numErrors;
   t_localLabel *backLabels;
   t_localLabel *forwardLabels;
+  t_fileLocation srcLocation;
 } t_parserState;
 
 
@@ -160,6 +163,20 @@ static t_parserError expectNumber(
   return P_SYN_ERROR;
 }
 
+static t_parserError expectCSR(t_parserState *state, int32_t *res, bool last)
+{
+  if (parserAccept(state, TOK_CSR) == P_ACCEPT) {
+    *res = state->curToken->value.csr;
+  } else if (expectNumber(state, res, 0, 0xFFF) != P_ACCEPT) {
+    return P_SYN_ERROR;
+  }
+  if (!last &&
+      parserExpect(state, TOK_COMMA, "CSR must be followed by a comma") !=
+          P_ACCEPT)
+    return P_SYN_ERROR;
+  return P_ACCEPT;
+}
+
 static t_parserError acceptLabel(t_parserState *state, t_instruction *instr)
 {
   if (parserAccept(state, TOK_LOCAL_REF) == P_ACCEPT) {
@@ -266,49 +283,31 @@ enum {
   FORMAT_BRANCH,   // mnemonic rs1, rs2, label
   FORMAT_BRANCH_Z, // mnemonic rs1, label
   FORMAT_JUMP,     // mnemonic label
-  FORMAT_SYSTEM    // mnemonic
+  FORMAT_SYSTEM,   // mnemonic
+  FORMAT_LR,       // mnemonic rd, (rs1)
+  FORMAT_AMO,      // mnemonic rd, rs2, (rs1)
+  FORMAT_CSR,      // mnemonic rd, csr, rs1
+  FORMAT_CSRR      // mnemonic rd, csr
 };
 
 static t_instrFormat instrOpcodeToFormat(t_instrOpcode opcode)
 {
   switch (opcode) {
-    case INSTR_OPC_ADD:
-    case INSTR_OPC_SUB:
-    case INSTR_OPC_AND:
-    case INSTR_OPC_OR:
-    case INSTR_OPC_XOR:
-    case INSTR_OPC_MUL:
-    case INSTR_OPC_MULH:
-    case INSTR_OPC_MULHSU:
-    case INSTR_OPC_MULHU:
-    case INSTR_OPC_DIV:
-    case INSTR_OPC_DIVU:
-    case INSTR_OPC_REM:
-    case INSTR_OPC_REMU:
-    case INSTR_OPC_SLL:
-    case INSTR_OPC_SRL:
-    case INSTR_OPC_SRA:
-    case INSTR_OPC_SLT:
-    case INSTR_OPC_SLTU:
-      return FORMAT_OP;
-    case INSTR_OPC_ADDI:
-    case INSTR_OPC_ANDI:
-    case INSTR_OPC_ORI:
-    case INSTR_OPC_XORI:
-    case INSTR_OPC_SLLI:
-    case INSTR_OPC_SRLI:
-    case INSTR_OPC_SRAI:
-    case INSTR_OPC_SLTI:
-    case INSTR_OPC_SLTIU:
-      return FORMAT_OPIMM;
+    // real instructions, generated from the ISA description
+#define ISA_AS_INSTR(id, mnemonic, syntax) \
+    case INSTR_OPC_##id: \
+      return FORMAT_##syntax;
+#include "instr_list.h"
+#undef ISA_AS_INSTR
+    // pseudo-instructions
+    case INSTR_OPC_NOP:
+      return FORMAT_SYSTEM;
+    case INSTR_OPC_LI:
+      return FORMAT_LI;
+    case INSTR_OPC_LA:
+      return FORMAT_LA;
     case INSTR_OPC_J:
       return FORMAT_JUMP;
-    case INSTR_OPC_BEQ:
-    case INSTR_OPC_BNE:
-    case INSTR_OPC_BLT:
-    case INSTR_OPC_BLTU:
-    case INSTR_OPC_BGE:
-    case INSTR_OPC_BGEU:
     case INSTR_OPC_BGT:
     case INSTR_OPC_BLE:
     case INSTR_OPC_BGTU:
@@ -321,36 +320,50 @@ static t_instrFormat instrOpcodeToFormat(t_instrOpcode opcode)
     case INSTR_OPC_BLTZ:
     case INSTR_OPC_BGTZ:
       return FORMAT_BRANCH_Z;
-    case INSTR_OPC_LB:
-    case INSTR_OPC_LH:
-    case INSTR_OPC_LW:
-    case INSTR_OPC_LBU:
-    case INSTR_OPC_LHU:
-      return FORMAT_LOAD;
-    case INSTR_OPC_SB:
-    case INSTR_OPC_SH:
-    case INSTR_OPC_SW:
-      return FORMAT_STORE;
-    case INSTR_OPC_LI:
-      return FORMAT_LI;
-    case INSTR_OPC_LA:
-      return FORMAT_LA;
-    case INSTR_OPC_LUI:
-    case INSTR_OPC_AUIPC:
-      return FORMAT_LUI;
-    case INSTR_OPC_JAL:
-      return FORMAT_JAL;
-    case INSTR_OPC_JALR:
-      return FORMAT_JALR;
-    case INSTR_OPC_NOP:
-    case INSTR_OPC_ECALL:
-    case INSTR_OPC_EBREAK:
-      return FORMAT_SYSTEM;
+    case INSTR_OPC_CSRR:
+      return FORMAT_CSRR;
   }
   return -1;
 }
 
 
+// ACSE annotates the first instruction generated for each line of the source
+// program with a "file:line" comment. When such a comment is found after an
+// instruction in .text, it becomes the source location of all the following
+// code until the next one.
+static void parserHandleSourceComment(t_parserState *state, const char *cmt)
+{
+  if (!cmt || objSecGetID(state->curSection) != OBJ_SECTION_TEXT)
+    return;
+
+  while (isspace(*cmt))
+    cmt++;
+  const char *colon = strrchr(cmt, ':');
+  if (!colon || colon == cmt || !isdigit(colon[1]))
+    return;
+  char *end;
+  long line = strtol(colon + 1, &end, 10);
+  while (isspace(*end))
+    end++;
+  if (*end != '\0' || line <= 0 || line > INT_MAX)
+    return;
+
+  size_t fileLen = (size_t)(colon - cmt);
+  t_fileLocation *cur = &state->srcLocation;
+  if (cur->file && cur->row == line - 1 && strlen(cur->file) == fileLen &&
+      strncmp(cur->file, cmt, fileLen) == 0)
+    return;
+  free(cur->file);
+  cur->file = malloc(fileLen + 1);
+  if (!cur->file)
+    fatalError("out of memory");
+  memcpy(cur->file, cmt, fileLen);
+  cur->file[fileLen] = '\0';
+  cur->row = (int)line - 1;
+  cur->column = -1;
+  objSecAppendSourceLocation(state->curSection, *cur);
+}
+
 static t_parserError expectInstruction(t_parserState *state)
 {
   t_immSizeClass immSize;
@@ -505,10 +518,38 @@ static t_parserError expectInstruction(t_parserState *state)
     case FORMAT_SYSTEM:
       break;
 
+    case FORMAT_LR:
+    case FORMAT_AMO:
+      if (expectRegister(state, &instr.dest, false) != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (format == FORMAT_AMO &&
+          expectRegister(state, &instr.src2, false) != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (parserExpect(state, TOK_LPAR, "expected parenthesis") != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (expectRegister(state, &instr.src1, true) != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (parserExpect(state, TOK_RPAR, "expected parenthesis") != P_ACCEPT)
+        return P_SYN_ERROR;
+      break;
+
+    case FORMAT_CSR:
+    case FORMAT_CSRR:
+      if (expectRegister(state, &instr.dest, false) != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (expectCSR(state, &instr.constant, format == FORMAT_CSRR) != P_ACCEPT)
+        return P_SYN_ERROR;
+      if (format == FORMAT_CSR &&
+          expectRegister(state, &instr.src1, true) != P_ACCEPT)
+        return P_SYN_ERROR;
+      break;
+
     default:
       return P_SYN_ERROR;
   }
 
+  if (state->lookaheadToken->id == TOK_NEWLINE)
+    parserHandleSourceComment(state, state->lookaheadToken->value.comment);
   objSecAppendInstruction(state->curSection, instr);
   return P_ACCEPT;
 }
@@ -828,6 +869,7 @@ t_object *parseObject(t_lexer *lex)
   state.lookaheadToken = lexNextToken(lex);
   state.backLabels = NULL;
   state.forwardLabels = NULL;
+  state.srcLocation = nullFileLocation;
 
   while (parserAccept(&state, TOK_EOF) != P_ACCEPT) {
     t_parserError err = expectLine(&state);
@@ -848,6 +890,7 @@ t_object *parseObject(t_lexer *lex)
   deleteToken(state.lookaheadToken);
   deleteLocalLabelList(state.backLabels);
   deleteLocalLabelList(state.forwardLabels);
+  free(state.srcLocation.file);
 
   if (state.numErrors > 0) {
     fprintf(stderr, "%d error(s) generated.\n", state.numErrors);
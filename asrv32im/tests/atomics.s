@@ -0,0 +1,18 @@
+        .global _start
+        .text
+_start:
+        lr.w a0, (a1)
+        sc.w a0, a2, (a1)
+        amoswap.w t0, t1, (t2)
+        amoadd.w x1, x2, (x3)
+        amoxor.w x1, x2, (x3)
+        amoand.w x1, x2, (x3)
+        amoor.w x1, x2, (x3)
+        amomin.w x1, x2, (x3)
+        amomax.w x1, x2, (x3)
+        amominu.w x1, x2, (x3)
+        amomaxu.w x31, x30, (x29)
+        csrr a0, mhartid
+        csrrs a0, mhartid, x0
+        csrrc a0, 0xF14, x0
+        csrrw a0, 0x340, a1
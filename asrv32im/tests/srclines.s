@@ -0,0 +1,16 @@
+# "file:line" comments after an instruction are recorded in .srclines
+
+        .global _start
+        .data
+l_a:    .word 0                         # prog.src:2
+        .text
+_start: li     s0, 0x12345              # prog.src:3
+        li     s1, 0
+        la     s2, l_a                  # prog.src:4
+l_1:    addi   s1, s1, 1                # prog.src:5
+        blt    s1, s0, l_1              # prog.src:5
+        sw     s1, l_a, t6              # prog.src:6 is not a location
+        li     a7, 93                   # lib/other.src:10
+        ecall                           // prog.src:7
+        nop                             /* prog.src:8 */
+        nop
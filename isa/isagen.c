@@ -0,0 +1,392 @@
+/* Generates the instruction tables of the assembler and of the simulator from
+ * the ISA description (rv32im.isa). Usage:
+ *   isagen -a <description>   encoding table of the assembler
+ *   isagen -l <description>   list of the instructions of the assembler
+ *   isagen -e <description>   instruction identifiers of the simulator
+ *   isagen -t <description>   decoding and disassembly tables of the simulator
+ * The output is written to the standard output. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_OPCODES 32
+#define MAX_INSTRS 255
+#define MAX_NAME 16
+#define NUM_GROUPS 32
+
+#define FUNCT3_BITS ((uint32_t)0x7 << 12)
+
+typedef struct {
+  char name[MAX_NAME];
+  uint32_t value;
+} t_opcode;
+
+typedef struct {
+  const char *name;
+  bool hasFunct3;
+  bool hasExtra;
+  char encType;
+  /* Syntax of the operands in the assembler, NULL if not supported. */
+  const char *asSyntax;
+} t_format;
+
+typedef struct {
+  char mnemonic[MAX_NAME];
+  const t_format *format;
+  uint32_t opcode;
+  uint32_t funct3;
+  uint32_t extra;
+  bool inAssembler;
+  uint32_t mask;
+  uint32_t match;
+} t_instr;
+
+/* Fields used to select the instructions sharing the same major opcode and
+ * funct3, beyond those two. */
+typedef struct {
+  int shift;
+  uint32_t mask;
+} t_keyField;
+
+static const t_format formats[] = {
+    {   "R",  true,  true, 'R',     "OP"},
+    { "ISH",  true,  true, 'I',  "OPIMM"},
+    {   "I",  true, false, 'I',  "OPIMM"},
+    {  "IL",  true, false, 'I',   "LOAD"},
+    {   "S",  true, false, 'S',  "STORE"},
+    {   "B",  true, false, 'B', "BRANCH"},
+    {   "U", false, false, 'U',    "LUI"},
+    {   "J", false, false, 'J',    "JAL"},
+    { "SYS",  true,  true, 'I', "SYSTEM"},
+    { "CSR",  true, false, 'I',    "CSR"},
+    {"CSRI",  true, false, 'I',     NULL},
+    { "AMO",  true,  true, 'R',    "AMO"},
+    {  "LR",  true,  true, 'R',     "LR"},
+};
+#define NUM_FORMATS (int)(sizeof(formats) / sizeof(formats[0]))
+
+static const t_keyField keyFields[] = {
+    { 0,    0}, /* funct3 alone */
+    {25, 0x7F}, /* funct7 */
+    {20, 0x1F}, /* rs2 */
+};
+#define NUM_KEY_FIELDS (int)(sizeof(keyFields) / sizeof(keyFields[0]))
+
+t_opcode opcodes[MAX_OPCODES];
+int numOpcodes = 0;
+t_instr instrs[MAX_INSTRS];
+int numInstrs = 0;
+
+const char *descFile;
+int lineNum;
+
+
+static void fatal(const char *msg, const char *arg)
+{
+  fprintf(stderr, "%s:%d: %s '%s'\n", descFile, lineNum, msg, arg);
+  exit(1);
+}
+
+static uint32_t parseNumber(const char *str)
+{
+  char *end;
+  unsigned long value = strtoul(str, &end, 0);
+  if (*end != '\0' || end == str)
+    fatal("invalid number", str);
+  return (uint32_t)value;
+}
+
+static const t_opcode *findOpcode(const char *name)
+{
+  for (int i = 0; i < numOpcodes; i++) {
+    if (strcmp(opcodes[i].name, name) == 0)
+      return &opcodes[i];
+  }
+  fatal("unknown opcode", name);
+  return NULL;
+}
+
+static const t_format *findFormat(const char *name)
+{
+  for (int i = 0; i < NUM_FORMATS; i++) {
+    if (strcmp(formats[i].name, name) == 0)
+      return &formats[i];
+  }
+  fatal("unknown format", name);
+  return NULL;
+}
+
+static void computeEncoding(t_instr *instr)
+{
+  const char *fmt = instr->format->name;
+  instr->mask = 0x7F;
+  instr->match = instr->opcode;
+  if (instr->format->hasFunct3) {
+    instr->mask |= FUNCT3_BITS;
+    instr->match |= instr->funct3 << 12;
+  }
+  if (strcmp(fmt, "R") == 0 || strcmp(fmt, "ISH") == 0) {
+    instr->mask |= (uint32_t)0x7F << 25;
+    instr->match |= instr->extra << 25;
+  } else if (strcmp(fmt, "AMO") == 0 || strcmp(fmt, "LR") == 0) {
+    // The aq and rl bits are not part of the encoding
+    instr->mask |= (uint32_t)0x1F << 27;
+    instr->match |= instr->extra << 27;
+    if (strcmp(fmt, "LR") == 0)
+      instr->mask |= (uint32_t)0x1F << 20;
+  } else if (strcmp(fmt, "SYS") == 0) {
+    instr->mask = 0xFFFFFFFF;
+    instr->match |= instr->extra << 20;
+  }
+}
+
+static void readDescription(void)
+{
+  FILE *fp = fopen(descFile, "r");
+  if (fp == NULL) {
+    perror(descFile);
+    exit(1);
+  }
+
+  char line[256];
+  for (lineNum = 1; fgets(line, sizeof(line), fp); lineNum++) {
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+    char f[6][MAX_NAME + 1];
+    int n = sscanf(line, "%16s %16s %16s %16s %16s %16s", f[0], f[1], f[2],
+        f[3], f[4], f[5]);
+    if (n <= 0)
+      continue;
+
+    if (strcmp(f[0], "opcode") == 0) {
+      if (n != 3)
+        fatal("invalid opcode definition", f[0]);
+      if (numOpcodes == MAX_OPCODES)
+        fatal("too many opcodes", f[1]);
+      strcpy(opcodes[numOpcodes].name, f[1]);
+      opcodes[numOpcodes].value = parseNumber(f[2]);
+      if ((opcodes[numOpcodes].value & 0x3) != 0x3 ||
+          opcodes[numOpcodes].value > 0x7F)
+        fatal("invalid major opcode", f[2]);
+      numOpcodes++;
+      continue;
+    }
+
+    if (n != 6)
+      fatal("invalid instruction definition", f[0]);
+    if (numInstrs == MAX_INSTRS)
+      fatal("too many instructions", f[0]);
+    t_instr *instr = &instrs[numInstrs];
+    strcpy(instr->mnemonic, f[0]);
+    instr->format = findFormat(f[1]);
+    instr->opcode = findOpcode(f[2])->value;
+    if (instr->format->hasFunct3 != (strcmp(f[3], "-") != 0))
+      fatal("funct3 not allowed or missing for", f[0]);
+    instr->funct3 = instr->format->hasFunct3 ? parseNumber(f[3]) : 0;
+    if (instr->format->hasExtra != (strcmp(f[4], "-") != 0))
+      fatal("extra field not allowed or missing for", f[0]);
+    instr->extra = instr->format->hasExtra ? parseNumber(f[4]) : 0;
+    if (strcmp(f[5], "as") == 0) {
+      instr->inAssembler = true;
+      if (instr->format->asSyntax == NULL)
+        fatal("format not supported by the assembler for", f[0]);
+    } else if (strcmp(f[5], "-") == 0)
+      instr->inAssembler = false;
+    else
+      fatal("invalid tool list", f[5]);
+    computeEncoding(instr);
+    numInstrs++;
+  }
+  fclose(fp);
+}
+
+
+/* Prints the mnemonic as an identifier suffix (e.g. "LR_W" for "lr.w") or
+ * in upper case (e.g. "LR.W"). */
+static void printMnemonic(const char *mnemonic, bool asIdentifier)
+{
+  for (const char *p = mnemonic; *p; p++) {
+    if (asIdentifier && !isalnum((unsigned char)*p))
+      putchar('_');
+    else
+      putchar(toupper((unsigned char)*p));
+  }
+}
+
+static void printHeader(void)
+{
+  const char *name = strrchr(descFile, '/');
+  printf("/* Generated by isagen from %s, do not edit. */\n\n",
+      name ? name + 1 : descFile);
+}
+
+
+static void genAssemblerTable(void)
+{
+  printHeader();
+  for (int i = 0; i < numInstrs; i++) {
+    t_instr *instr = &instrs[i];
+    if (!instr->inAssembler)
+      continue;
+    // For the I and S types funct7 is or-ed to the immediate
+    uint32_t funct7 = instr->extra;
+    if (strcmp(instr->format->name, "ISH") == 0)
+      funct7 = instr->extra << 5;
+    else if (instr->format->encType == 'R' && instr->format->hasExtra &&
+        strcmp(instr->format->name, "R") != 0)
+      funct7 = instr->extra << 2;
+    printf("{INSTR_OPC_");
+    printMnemonic(instr->mnemonic, true);
+    printf(", '%c', 0x%02X, %u, 0x%03X},\n", instr->format->encType,
+        instr->opcode, instr->funct3, funct7);
+  }
+}
+
+
+/* The list is made of ISA_AS_INSTR(<id>, <mnemonic>, <syntax>) lines, where
+ * <syntax> is the suffix of the FORMAT_* constant of the parser. jalr shares
+ * the format of the loads, but does not accept a label in place of the
+ * offset. */
+static void genAssemblerList(void)
+{
+  printHeader();
+  uint32_t jalr = findOpcode("JALR")->value;
+  for (int i = 0; i < numInstrs; i++) {
+    t_instr *instr = &instrs[i];
+    if (!instr->inAssembler)
+      continue;
+    printf("ISA_AS_INSTR(");
+    printMnemonic(instr->mnemonic, true);
+    printf(", \"%s\", %s)\n", instr->mnemonic,
+        instr->opcode == jalr ? "JALR" : instr->format->asSyntax);
+  }
+}
+
+
+static void genSimulatorIDs(void)
+{
+  printHeader();
+  printf("#ifndef ISA_INSTRS_H\n#define ISA_INSTRS_H\n\n");
+  printf("typedef int t_isaInstrID;\nenum {\n  ISA_INSTR_ILLEGAL = 0,\n");
+  for (int i = 0; i < numInstrs; i++) {
+    printf("  ISA_INSTR_");
+    printMnemonic(instrs[i].mnemonic, true);
+    printf(",\n");
+  }
+  printf("  ISA_INSTR_COUNT\n};\n\n#endif\n");
+}
+
+
+static bool keyFieldSeparates(t_instr *group[], int n, const t_keyField *key)
+{
+  uint32_t keyBits = FUNCT3_BITS | (key->mask << key->shift);
+  for (int i = 0; i < n; i++) {
+    for (int j = i + 1; j < n; j++) {
+      uint32_t common = group[i]->mask & group[j]->mask & keyBits;
+      if (((group[i]->match ^ group[j]->match) & common) == 0)
+        return false;
+    }
+  }
+  return true;
+}
+
+static void genSimulatorTables(void)
+{
+  static uint8_t table[NUM_GROUPS * 8 * 128];
+  int groupBase[NUM_GROUPS];
+  const t_keyField *groupKey[NUM_GROUPS];
+  int tableSize = 8; // the first 8 entries are for unused opcodes
+
+  for (int g = 0; g < NUM_GROUPS; g++) {
+    t_instr *group[MAX_INSTRS];
+    int n = 0;
+    for (int i = 0; i < numInstrs; i++) {
+      if (instrs[i].opcode == (uint32_t)((g << 2) | 3))
+        group[n++] = &instrs[i];
+    }
+    groupBase[g] = 0;
+    groupKey[g] = &keyFields[0];
+    if (n == 0)
+      continue;
+
+    int k;
+    for (k = 0; k < NUM_KEY_FIELDS; k++) {
+      if (keyFieldSeparates(group, n, &keyFields[k]))
+        break;
+    }
+    if (k == NUM_KEY_FIELDS)
+      fatal("cannot decode the instructions of", group[0]->mnemonic);
+    const t_keyField *key = &keyFields[k];
+    uint32_t keyBits = FUNCT3_BITS | (key->mask << key->shift);
+    groupBase[g] = tableSize;
+    groupKey[g] = key;
+
+    uint32_t numKeys = 8 * (key->mask + 1);
+    for (uint32_t idx = 0; idx < numKeys; idx++) {
+      uint32_t bits = ((idx & 7) << 12) | ((idx >> 3) << key->shift);
+      table[tableSize + idx] = 0;
+      for (int i = 0; i < n; i++) {
+        if (((bits ^ group[i]->match) & group[i]->mask & keyBits) == 0)
+          table[tableSize + idx] = (uint8_t)(group[i] - instrs + 1);
+      }
+    }
+    tableSize += numKeys;
+  }
+
+  printHeader();
+  printf("const t_isaInstrInfo isaInstrs[ISA_INSTR_COUNT] = {\n");
+  printf("    {NULL, ISA_FORMAT_ILLEGAL, 0x00000000, 0x00000000},\n");
+  for (int i = 0; i < numInstrs; i++) {
+    printf("    {\"");
+    printMnemonic(instrs[i].mnemonic, false);
+    printf("\", ISA_FORMAT_%s, 0x%08X, 0x%08X},\n", instrs[i].format->name,
+        instrs[i].mask, instrs[i].match);
+  }
+  printf("};\n\n");
+
+  printf("const t_isaDecodeGroup isaDecodeGroups[%d] = {\n", NUM_GROUPS);
+  for (int g = 0; g < NUM_GROUPS; g++)
+    printf("    {%4d, %2d, 0x%02X},\n", groupBase[g], groupKey[g]->shift,
+        groupKey[g]->mask);
+  printf("};\n\n");
+
+  printf("const uint8_t isaDecodeTable[%d] = {", tableSize);
+  for (int i = 0; i < tableSize; i++)
+    printf("%s%2d,", i % 16 ? " " : "\n    ", table[i]);
+  printf("\n};\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc != 3 || argv[1][0] != '-' || strlen(argv[1]) != 2) {
+    fprintf(stderr, "usage: %s -a|-l|-e|-t <description>\n", argv[0]);
+    return 1;
+  }
+  descFile = argv[2];
+  readDescription();
+
+  switch (argv[1][1]) {
+    case 'a':
+      genAssemblerTable();
+      break;
+    case 'l':
+      genAssemblerList();
+      break;
+    case 'e':
+      genSimulatorIDs();
+      break;
+    case 't':
+      genSimulatorTables();
+      break;
+    default:
+      fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[1]);
+      return 1;
+  }
+  return ferror(stdout) ? 1 : 0;
+}
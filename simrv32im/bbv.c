@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bbv.h"
+
+/* Basic-block vectors in the format read by the SimPoint tool. Every
+ * interval of bbvInterval instructions produces one line:
+ *   T:<block id>:<instructions> :<block id>:<instructions> ...
+ * where ids are assigned in order of first execution starting from 1, and the
+ * second number is the count of instructions executed in the block during the
+ * interval. A block which spans two intervals is counted in both, so that
+ * every interval but the last one has exactly the required length, and
+ * interval i starts when `instret' reaches i * bbvInterval. The supervisor
+ * ends the slices of instructions of the boot hart where intervals end.
+ *   Only the boot hart is profiled, since the instructions of different
+ * harts are not ordered with respect to each other. */
+
+typedef struct {
+  t_memAddress address;
+  uint64_t count;
+} t_bbvBlock;
+
+FILE *bbvFile = NULL;
+uint64_t bbvInterval;
+t_cpuHart *bbvHart = NULL;
+
+/* Block ids are indexes in bbvBlocks plus one. bbvBlockMap is an open
+ * addressing hash table from addresses to block ids, where 0 marks an empty
+ * slot. */
+t_bbvBlock *bbvBlocks = NULL;
+int bbvNumBlocks = 0;
+int bbvBlocksBufSize = 0;
+int *bbvBlockMap = NULL;
+uint32_t bbvBlockMapSize = 0;
+
+/* Ids of the blocks executed in the current interval. */
+int *bbvTouched = NULL;
+int bbvNumTouched = 0;
+
+int bbvCurBlock = 0;
+uint64_t bbvBlockStart;
+uint64_t bbvIntervalStart;
+t_bbvError bbvStatus = BBV_NO_ERROR;
+
+
+t_bbvError bbvEnable(const char *path, uint64_t interval)
+{
+  bbvFile = fopen(path, "w");
+  if (bbvFile == NULL)
+    return BBV_FILE_ERROR;
+  bbvInterval = interval;
+  cpuSetBlockTracking(true);
+  return BBV_NO_ERROR;
+}
+
+
+static uint32_t bbvHash(t_memAddress addr)
+{
+  return (addr >> 2) * 0x9E3779B1u;
+}
+
+static t_bbvError bbvGrowBlocks(void)
+{
+  int newSize = bbvBlocksBufSize * 2 + 256;
+  t_bbvBlock *newBlocks = realloc(bbvBlocks, sizeof(t_bbvBlock) * newSize);
+  if (newBlocks == NULL)
+    return BBV_MEMORY_ERROR;
+  bbvBlocks = newBlocks;
+  int *newTouched = realloc(bbvTouched, sizeof(int) * newSize);
+  if (newTouched == NULL)
+    return BBV_MEMORY_ERROR;
+  bbvTouched = newTouched;
+  bbvBlocksBufSize = newSize;
+
+  // Keep the load of the hash table under 50%
+  uint32_t newMapSize = bbvBlockMapSize ? bbvBlockMapSize : 512;
+  while (newMapSize < (uint32_t)newSize * 2)
+    newMapSize *= 2;
+  if (newMapSize == bbvBlockMapSize)
+    return BBV_NO_ERROR;
+  int *newMap = calloc(newMapSize, sizeof(int));
+  if (newMap == NULL)
+    return BBV_MEMORY_ERROR;
+  for (int id = 1; id <= bbvNumBlocks; id++) {
+    uint32_t slot = bbvHash(bbvBlocks[id - 1].address) & (newMapSize - 1);
+    while (newMap[slot] != 0)
+      slot = (slot + 1) & (newMapSize - 1);
+    newMap[slot] = id;
+  }
+  free(bbvBlockMap);
+  bbvBlockMap = newMap;
+  bbvBlockMapSize = newMapSize;
+  return BBV_NO_ERROR;
+}
+
+static int bbvGetBlock(t_memAddress addr)
+{
+  uint32_t slot = bbvHash(addr) & (bbvBlockMapSize - 1);
+  for (; bbvBlockMap && bbvBlockMap[slot] != 0;
+       slot = (slot + 1) & (bbvBlockMapSize - 1)) {
+    if (bbvBlocks[bbvBlockMap[slot] - 1].address == addr)
+      return bbvBlockMap[slot];
+  }
+
+  if (bbvNumBlocks == bbvBlocksBufSize) {
+    if (bbvGrowBlocks() != BBV_NO_ERROR)
+      return 0;
+    slot = bbvHash(addr) & (bbvBlockMapSize - 1);
+    while (bbvBlockMap[slot] != 0)
+      slot = (slot + 1) & (bbvBlockMapSize - 1);
+  }
+  int id = ++bbvNumBlocks;
+  bbvBlocks[id - 1].address = addr;
+  bbvBlocks[id - 1].count = 0;
+  bbvBlockMap[slot] = id;
+  return id;
+}
+
+static void bbvCloseBlock(void)
+{
+  uint64_t count = bbvHart->instret - bbvBlockStart;
+  bbvBlockStart = bbvHart->instret;
+  if (bbvCurBlock == 0 || count == 0)
+    return;
+  t_bbvBlock *block = &bbvBlocks[bbvCurBlock - 1];
+  if (block->count == 0)
+    bbvTouched[bbvNumTouched++] = bbvCurBlock;
+  block->count += count;
+}
+
+static void bbvWriteInterval(void)
+{
+  if (bbvNumTouched == 0)
+    return;
+  fputc('T', bbvFile);
+  for (int i = 0; i < bbvNumTouched; i++) {
+    t_bbvBlock *block = &bbvBlocks[bbvTouched[i] - 1];
+    fprintf(bbvFile, ":%d:%llu ", bbvTouched[i],
+        (unsigned long long)block->count);
+    block->count = 0;
+  }
+  fputc('\n', bbvFile);
+  bbvNumTouched = 0;
+}
+
+
+/* Called by the supervisor before every slice of instructions of a hart.
+ * Writes the interval of the boot hart if it is over, and returns the value of
+ * `instret' at which the next one ends. */
+uint64_t bbvBeginSlice(t_cpuHart *hart)
+{
+  if (bbvFile == NULL || hart->hartID != 0 || bbvStatus != BBV_NO_ERROR)
+    return UINT64_MAX;
+  if (bbvHart == NULL) {
+    bbvHart = hart;
+    bbvBlockStart = bbvIntervalStart = hart->instret;
+  }
+
+  if (hart->instret - bbvIntervalStart >= bbvInterval) {
+    bbvCloseBlock();
+    bbvWriteInterval();
+    bbvIntervalStart = hart->instret;
+  }
+  return bbvIntervalStart + bbvInterval;
+}
+
+
+void bbvEnterBlock(t_cpuHart *hart)
+{
+  if (bbvHart != hart || bbvStatus != BBV_NO_ERROR)
+    return;
+
+  bbvCloseBlock();
+  bbvCurBlock = bbvGetBlock(hart->pc);
+  if (bbvCurBlock == 0)
+    bbvStatus = BBV_MEMORY_ERROR;
+}
+
+
+t_bbvError bbvFinish(void)
+{
+  if (bbvFile == NULL)
+    return BBV_NO_ERROR;
+
+  t_bbvError res = bbvStatus;
+  if (bbvHart != NULL && res == BBV_NO_ERROR) {
+    // The last interval is usually shorter than the others.
+    bbvCloseBlock();
+    bbvWriteInterval();
+  }
+  if (ferror(bbvFile) && res == BBV_NO_ERROR)
+    res = BBV_FILE_ERROR;
+  if (fclose(bbvFile) != 0 && res == BBV_NO_ERROR)
+    res = BBV_FILE_ERROR;
+  bbvFile = NULL;
+  return res;
+}
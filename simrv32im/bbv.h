@@ -0,0 +1,24 @@
+#ifndef BBV_H
+#define BBV_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+
+typedef int t_bbvError;
+enum {
+  BBV_NO_ERROR = 0,
+  BBV_MEMORY_ERROR = -1,
+  BBV_FILE_ERROR = -2
+};
+
+
+t_bbvError bbvEnable(const char *path, uint64_t interval);
+
+uint64_t bbvBeginSlice(t_cpuHart *hart);
+
+void bbvEnterBlock(t_cpuHart *hart);
+
+t_bbvError bbvFinish(void);
+
+#endif
@@ -0,0 +1,53 @@
+# Bubble sort of 2000 pseudo-random words, 3 times.
+
+        .data
+array:  .space 8000
+
+        .text
+        .global _start
+_start: li     s0, 3                    # repetitions
+        li     s1, 2000                 # n
+        la     s2, array
+repeat:
+        li     t0, 12345                # fill with a linear congruential
+        li     t1, 1103515245           # generator
+        addi   t2, s2, 0
+        slli   t3, s1, 2
+        add    t3, s2, t3
+fill:
+        mul    t0, t0, t1
+        addi   t0, t0, 1234
+        srli   t4, t0, 8
+        sw     t4, 0(t2)
+        addi   t2, t2, 4
+        bltu   t2, t3, fill
+
+        addi   s3, s1, -1               # last position to compare
+outer:
+        addi   t0, s2, 0
+        slli   t1, s3, 2
+        add    t1, s2, t1
+inner:
+        lw     t2, 0(t0)
+        lw     t3, 4(t0)
+        bleu   t2, t3, in_order
+        sw     t3, 0(t0)
+        sw     t2, 4(t0)
+in_order:
+        addi   t0, t0, 4
+        bltu   t0, t1, inner
+        addi   s3, s3, -1
+        bgtz   s3, outer
+
+        addi   s0, s0, -1
+        bnez   s0, repeat
+
+        lw     a0, 0(s2)                # print the smallest element
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
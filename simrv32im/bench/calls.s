@@ -0,0 +1,35 @@
+# Recursive computation of the 30th Fibonacci number.
+
+        .text
+        .global _start
+_start: li     a0, 30
+        jal    fib
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
+
+fib:
+        li     t0, 2
+        blt    a0, t0, fib_base
+        addi   sp, sp, -12
+        sw     ra, 0(sp)
+        sw     s0, 4(sp)
+        sw     s1, 8(sp)
+        addi   s0, a0, 0
+        addi   a0, s0, -1
+        jal    fib
+        addi   s1, a0, 0
+        addi   a0, s0, -2
+        jal    fib
+        add    a0, a0, s1
+        lw     ra, 0(sp)
+        lw     s0, 4(sp)
+        lw     s1, 8(sp)
+        addi   sp, sp, 12
+fib_base:
+        jalr   zero, 0(ra)
@@ -0,0 +1,50 @@
+# Bitwise CRC-32 of a 64 KiB buffer, 10 times.
+
+        .data
+buffer: .space 65536
+
+        .text
+        .global _start
+_start: la     s0, buffer               # fill the buffer with a pattern
+        li     t0, 0
+        li     t1, 65536
+fill:
+        add    t2, s0, t0
+        mul    t3, t0, t0
+        sb     t3, 0(t2)
+        addi   t0, t0, 1
+        blt    t0, t1, fill
+
+        li     s1, 10                   # repetitions
+        li     s2, 0xEDB88320           # reflected polynomial
+repeat:
+        li     a0, -1                   # crc
+        addi   t0, s0, 0
+        add    t1, s0, t1
+byte:
+        lbu    t2, 0(t0)
+        xor    a0, a0, t2
+        li     t3, 8
+bit:
+        andi   t4, a0, 1
+        srli   a0, a0, 1
+        beqz   t4, no_xor
+        xor    a0, a0, s2
+no_xor:
+        addi   t3, t3, -1
+        bnez   t3, bit
+        addi   t0, t0, 1
+        bltu   t0, t1, byte
+        xori   a0, a0, -1
+        sub    t1, t1, s0
+        addi   s1, s1, -1
+        bnez   s1, repeat
+
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
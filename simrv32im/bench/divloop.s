@@ -0,0 +1,26 @@
+# Sum of the decimal digits of the numbers from 1 to 1000000.
+
+        .text
+        .global _start
+_start: li     s0, 1                    # number
+        li     s1, 1000000
+        li     s2, 10
+        li     a0, 0                    # sum
+number:
+        addi   t0, s0, 0
+digit:
+        rem    t1, t0, s2
+        add    a0, a0, t1
+        div    t0, t0, s2
+        bnez   t0, digit
+        addi   s0, s0, 1
+        ble    s0, s1, number
+
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
@@ -0,0 +1,74 @@
+# Multiplication of two 64x64 matrices of words, 20 times.
+
+        .data
+mat_a:  .space 16384
+mat_b:  .space 16384
+mat_c:  .space 16384
+
+        .text
+        .global _start
+_start: la     s0, mat_a                # fill A and B with small values
+        la     s1, mat_b
+        li     t0, 0
+        li     t1, 4096
+fill:
+        andi   t2, t0, 15
+        sw     t2, 0(s0)
+        xori   t2, t2, 7
+        sw     t2, 0(s1)
+        addi   s0, s0, 4
+        addi   s1, s1, 4
+        addi   t0, t0, 1
+        blt    t0, t1, fill
+
+        li     s11, 20                  # repetitions
+        li     s10, 64                  # n
+repeat:
+        la     s2, mat_a                # row of A
+        la     s4, mat_c                # element of C
+        li     s5, 0                    # i
+loop_i:
+        la     s3, mat_b                # column of B
+        li     s6, 0                    # j
+loop_j:
+        addi   t0, s2, 0
+        addi   t1, s3, 0
+        li     t2, 0                    # sum
+        li     t3, 0                    # k
+loop_k:
+        lw     t4, 0(t0)
+        lw     t5, 0(t1)
+        mul    t4, t4, t5
+        add    t2, t2, t4
+        addi   t0, t0, 4
+        addi   t1, t1, 256
+        addi   t3, t3, 1
+        blt    t3, s10, loop_k
+        sw     t2, 0(s4)
+        addi   s4, s4, 4
+        addi   s3, s3, 4
+        addi   s6, s6, 1
+        blt    s6, s10, loop_j
+        addi   s2, s2, 256
+        addi   s5, s5, 1
+        blt    s5, s10, loop_i
+        addi   s11, s11, -1
+        bnez   s11, repeat
+
+        la     t0, mat_c                # print the trace of C
+        li     t1, 0
+        li     a0, 0
+trace:
+        lw     t2, 0(t0)
+        add    a0, a0, t2
+        addi   t0, t0, 260
+        addi   t1, t1, 1
+        blt    t1, s10, trace
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
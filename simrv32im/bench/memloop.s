@@ -0,0 +1,49 @@
+# Copies a 256 KiB buffer allocated on the heap to another one and sums it,
+# 100 times.
+
+        .text
+        .global _start
+_start: li     a0, 0                    # get the start of the heap
+        li     a7, 214
+        ecall
+        addi   s0, a0, 0                # source
+        li     t0, 262144
+        add    s1, s0, t0               # destination
+        add    a0, s1, t0
+        li     a7, 214
+        ecall
+
+        addi   t0, s0, 0                # fill the source
+        li     t1, 0
+fill:
+        sw     t1, 0(t0)
+        addi   t1, t1, 3
+        addi   t0, t0, 4
+        bltu   t0, s1, fill
+
+        li     s2, 100                  # repetitions
+        li     a0, 0                    # sum
+repeat:
+        addi   t0, s0, 0
+        addi   t1, s1, 0
+copy:
+        lw     t2, 0(t0)
+        lw     t3, 4(t0)
+        sw     t2, 0(t1)
+        sw     t3, 4(t1)
+        add    a0, a0, t2
+        add    a0, a0, t3
+        addi   t0, t0, 8
+        addi   t1, t1, 8
+        bltu   t0, s1, copy
+        addi   s2, s2, -1
+        bnez   s2, repeat
+
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
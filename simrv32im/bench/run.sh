@@ -0,0 +1,61 @@
+#!/bin/sh
+# Measures the speed of the simulator, in millions of instructions per
+# second, on every kernel given. Each measurement is the best of a number of
+# runs.
+#
+# usage: run.sh [-j] [-r runs] [-s simulator] kernel.o...
+#   -j  prints the results in JSON format
+#   -r  number of runs of every kernel (default 3)
+#   -s  path of the simulator (default ../../bin/simrv32im)
+
+sim=../../bin/simrv32im
+json=0
+runs=3
+while getopts "jr:s:" opt; do
+  case $opt in
+    j) json=1 ;;
+    r) runs=$OPTARG ;;
+    s) sim=$OPTARG ;;
+    *) exit 2 ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+if [ $json -eq 1 ]; then
+  printf '{\n  "date": "%s",\n  "results": [' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+else
+  printf '%-20s %14s %10s %10s\n' kernel instructions seconds MIPS
+fi
+
+sep=''
+for kernel in "$@"; do
+  name=${kernel%.o}
+  best=''
+  i=0
+  while [ $i -lt "$runs" ]; do
+    # The statistics are on the standard error, the output is discarded
+    if ! stats=$("$sim" --stats "$kernel" 2>&1 >/dev/null); then
+      echo "$kernel: $stats" >&2
+      exit 1
+    fi
+    seconds=$(echo "$stats" | awk '/^seconds:/ { print $2 }')
+    if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+      best=$seconds
+      instrs=$(echo "$stats" | awk '/^instructions:/ { print $2 }')
+    fi
+    i=$((i + 1))
+  done
+  mips=$(awk "BEGIN { printf \"%.2f\", $instrs / $best / 1e6 }")
+  if [ $json -eq 1 ]; then
+    printf '%s\n    {"kernel": "%s", "instructions": %s, ' \
+      "$sep" "$name" "$instrs"
+    printf '"seconds": %s, "mips": %s}' "$best" "$mips"
+    sep=','
+  else
+    printf '%-20s %14s %10s %10s\n' "$name" "$instrs" "$best" "$mips"
+  fi
+done
+
+if [ $json -eq 1 ]; then
+  printf '\n  ]\n}\n'
+fi
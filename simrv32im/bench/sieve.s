@@ -0,0 +1,50 @@
+# Sieve of Eratosthenes: counts the primes below 200000, 12 times.
+
+        .data
+flags:  .space 200000
+
+        .text
+        .global _start
+_start: li     s0, 12                   # repetitions
+        li     s1, 200000               # n
+repeat:
+        la     t0, flags                # clear the flags
+        add    t1, t0, s1
+clear:
+        sw     zero, 0(t0)
+        addi   t0, t0, 4
+        bltu   t0, t1, clear
+
+        la     s2, flags
+        li     s3, 2                    # i
+        li     s4, 0                    # count
+outer:
+        add    t0, s2, s3
+        lbu    t1, 0(t0)
+        bnez   t1, next
+        addi   s4, s4, 1
+        li     t2, 448                  # no multiples to mark if i*i >= n
+        bge    s3, t2, next
+        mul    t2, s3, s3               # mark the multiples starting at i*i
+        li     t3, 1
+mark:
+        add    t0, s2, t2
+        sb     t3, 0(t0)
+        add    t2, t2, s3
+        blt    t2, s1, mark
+next:
+        addi   s3, s3, 1
+        blt    s3, s1, outer
+
+        addi   s0, s0, -1
+        bnez   s0, repeat
+
+        addi   a0, s4, 0
+        li     a7, 1
+        ecall
+        li     a0, 10
+        li     a7, 11
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "compare.h"
+#include "isa.h"
+#include "symbols.h"
+
+/* Comparison of two executables on the same input. Each one is run in a child
+ * process forked from the simulator before anything is loaded, so that every
+ * run starts from a clean machine. The children read the input from a
+ * temporary copy of it, and write the output of the program and the counters
+ * collected while running it to two more temporary files, which the parent
+ * reads back once both runs are over.
+ *   Only the boot hart is profiled. Cycles are estimated with the costs of a
+ * simple in-order pipeline: one cycle per instruction, plus one for loads
+ * (load-use stall), two for multiplications, 33 for divisions and remainders,
+ * and two for taken branches and jumps (pipeline refill). */
+
+#define CMP_CYCLES_LOAD 1
+#define CMP_CYCLES_MUL 2
+#define CMP_CYCLES_DIV 33
+#define CMP_CYCLES_TAKEN 2
+
+typedef struct {
+  t_memAddress pc;
+  uint64_t instret;
+  uint64_t cycles;
+} t_cmpInstr;
+
+/* Costs of the instructions belonging to a source line. Instructions without
+ * a source line are grouped by the label preceding them, with line 0. */
+typedef struct {
+  char *name;
+  int line;
+  uint64_t instret;
+  uint64_t cycles;
+} t_cmpLine;
+
+typedef struct {
+  t_svStatus status;
+  int exitCode;
+  uint64_t instret;
+  uint64_t cycles;
+  uint64_t loads;
+  uint64_t stores;
+  t_cmpLine *lines;
+  size_t numLines;
+} t_cmpRun;
+
+int cmpCurRun = CMP_PARENT;
+FILE *cmpInput = NULL;
+FILE *cmpOutputs[2] = {NULL, NULL};
+FILE *cmpStats[2] = {NULL, NULL};
+
+bool cmpOutOfMemory = false;
+uint64_t cmpInstret = 0;
+uint64_t cmpCycles = 0;
+uint64_t cmpLoads = 0;
+uint64_t cmpStores = 0;
+
+/* Open addressing hash table from addresses to their costs. Slots with a zero
+ * instruction count are free. */
+t_cmpInstr *cmpInstrs = NULL;
+uint32_t cmpInstrsSize = 0;
+uint32_t cmpNumInstrs = 0;
+
+
+static t_cmpError cmpCopyInput(const char *inputFile)
+{
+  FILE *in = stdin;
+  if (inputFile != NULL && (in = fopen(inputFile, "r")) == NULL)
+    return CMP_FILE_ERROR;
+  cmpInput = tmpfile();
+  if (cmpInput == NULL) {
+    if (in != stdin)
+      fclose(in);
+    return CMP_FILE_ERROR;
+  }
+
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    fwrite(buf, 1, n, cmpInput);
+  bool failed = ferror(in) || fflush(cmpInput) != 0;
+  if (in != stdin)
+    fclose(in);
+  return failed ? CMP_FILE_ERROR : CMP_NO_ERROR;
+}
+
+/* Returns in the parent process once both runs are over, with *outRun set to
+ * CMP_PARENT. The child processes return with *outRun set to the index of the
+ * executable to run, and the standard input and output redirected. */
+t_cmpError cmpStartRuns(const char *inputFile, int *outRun)
+{
+  t_cmpError err = cmpCopyInput(inputFile);
+  if (err != CMP_NO_ERROR)
+    return err;
+  for (int i = 0; i < 2; i++) {
+    cmpOutputs[i] = tmpfile();
+    cmpStats[i] = tmpfile();
+    if (cmpOutputs[i] == NULL || cmpStats[i] == NULL)
+      return CMP_FILE_ERROR;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 0; i < 2; i++) {
+    // The file offset is shared with the children
+    if (lseek(fileno(cmpInput), 0, SEEK_SET) < 0)
+      return CMP_FILE_ERROR;
+    pid_t pid = fork();
+    if (pid < 0)
+      return CMP_PROCESS_ERROR;
+    if (pid == 0) {
+      if (dup2(fileno(cmpInput), STDIN_FILENO) < 0 ||
+          dup2(fileno(cmpOutputs[i]), STDOUT_FILENO) < 0)
+        _exit(1);
+      clearerr(stdin);
+      cmpCurRun = i;
+      cpuSetInstrProfiling(true);
+      *outRun = i;
+      return CMP_NO_ERROR;
+    }
+    if (waitpid(pid, NULL, 0) < 0)
+      return CMP_PROCESS_ERROR;
+  }
+  *outRun = CMP_PARENT;
+  return CMP_NO_ERROR;
+}
+
+
+static uint32_t cmpHash(t_memAddress addr)
+{
+  return (addr >> 2) * 0x9E3779B1u;
+}
+
+static bool cmpGrowInstrs(void)
+{
+  uint32_t newSize = cmpInstrsSize ? cmpInstrsSize * 2 : 1024;
+  t_cmpInstr *newInstrs = calloc(newSize, sizeof(t_cmpInstr));
+  if (newInstrs == NULL)
+    return false;
+  for (uint32_t i = 0; i < cmpInstrsSize; i++) {
+    if (cmpInstrs[i].instret == 0)
+      continue;
+    uint32_t slot = cmpHash(cmpInstrs[i].pc) & (newSize - 1);
+    while (newInstrs[slot].instret != 0)
+      slot = (slot + 1) & (newSize - 1);
+    newInstrs[slot] = cmpInstrs[i];
+  }
+  free(cmpInstrs);
+  cmpInstrs = newInstrs;
+  cmpInstrsSize = newSize;
+  return true;
+}
+
+static t_cmpInstr *cmpGetInstr(t_memAddress pc)
+{
+  // Keep the load of the hash table under 50%
+  if ((cmpNumInstrs + 1) * 2 > cmpInstrsSize && !cmpGrowInstrs())
+    return NULL;
+  uint32_t slot = cmpHash(pc) & (cmpInstrsSize - 1);
+  for (; cmpInstrs[slot].instret != 0; slot = (slot + 1) & (cmpInstrsSize - 1))
+    if (cmpInstrs[slot].pc == pc)
+      return &cmpInstrs[slot];
+  cmpInstrs[slot].pc = pc;
+  cmpNumInstrs++;
+  return &cmpInstrs[slot];
+}
+
+/* Returns the cycles taken by the instruction at `pc` in the pipeline model.
+ * Must be called after the instruction is retired, with the program counter of
+ * the hart pointing to the next one. */
+uint64_t cmpGetCycles(const t_cpuHart *hart, t_memAddress pc, uint32_t instr)
+{
+  uint64_t cycles = 1;
+  uint32_t funct3 = ISA_INST_FUNCT3(instr);
+  switch (ISA_INST_OPCODE(instr)) {
+    case ISA_INST_OPCODE_LOAD:
+      cycles += CMP_CYCLES_LOAD;
+      break;
+    case ISA_INST_OPCODE_AMO:
+      // sc.w does not load
+      if ((instr >> 27) != 0x03)
+        cycles += CMP_CYCLES_LOAD;
+      break;
+    case ISA_INST_OPCODE_OP:
+      if (ISA_INST_FUNCT7(instr) == 0x01)
+        cycles += funct3 < 4 ? CMP_CYCLES_MUL : CMP_CYCLES_DIV;
+      break;
+    case ISA_INST_OPCODE_BRANCH:
+      if (hart->pc != pc + 4)
+        cycles += CMP_CYCLES_TAKEN;
+      break;
+    case ISA_INST_OPCODE_JAL:
+    case ISA_INST_OPCODE_JALR:
+      cycles += CMP_CYCLES_TAKEN;
+      break;
+  }
+  return cycles;
+}
+
+
+/* Must be called after the instruction at `pc` is retired, with the program
+ * counter of the hart pointing to the next one. */
+void cmpRecordInstr(t_cpuHart *hart, t_memAddress pc, uint32_t instr)
+{
+  if (hart->hartID != 0 || cmpOutOfMemory)
+    return;
+
+  uint32_t opcode = ISA_INST_OPCODE(instr);
+  // lr.w only loads, sc.w only stores
+  if (opcode == ISA_INST_OPCODE_LOAD ||
+      (opcode == ISA_INST_OPCODE_AMO && (instr >> 27) != 0x03))
+    cmpLoads++;
+  if (opcode == ISA_INST_OPCODE_STORE ||
+      (opcode == ISA_INST_OPCODE_AMO && (instr >> 27) != 0x02))
+    cmpStores++;
+  uint64_t cycles = cmpGetCycles(hart, pc, instr);
+  cmpInstret++;
+  cmpCycles += cycles;
+
+  t_cmpInstr *entry = cmpGetInstr(pc);
+  if (entry == NULL) {
+    cmpOutOfMemory = true;
+    return;
+  }
+  entry->instret++;
+  entry->cycles += cycles;
+}
+
+
+static int cmpCompareLines(const void *a, const void *b)
+{
+  const t_cmpLine *la = a, *lb = b;
+  int res = strcmp(la->name, lb->name);
+  if (res != 0)
+    return res;
+  return (la->line > lb->line) - (la->line < lb->line);
+}
+
+/* Writes the counters of the current run, with the costs of the instructions
+ * summed by source line and sorted by location. */
+t_cmpError cmpFinishRun(t_svStatus status)
+{
+  FILE *fp = cmpStats[cmpCurRun];
+  if (cmpOutOfMemory)
+    return CMP_MEMORY_ERROR;
+
+  t_cmpLine *lines = malloc(sizeof(t_cmpLine) * (cmpNumInstrs + 1));
+  if (lines == NULL)
+    return CMP_MEMORY_ERROR;
+  size_t n = 0;
+  for (uint32_t i = 0; i < cmpInstrsSize; i++) {
+    t_cmpInstr *instr = &cmpInstrs[i];
+    if (instr->instret == 0)
+      continue;
+    const char *file;
+    if (!symGetSourceLine(instr->pc, &file, &lines[n].line)) {
+      t_memAddress offset;
+      file = symGetLabel(instr->pc, &offset);
+      lines[n].line = 0;
+    }
+    lines[n].name = (char *)(file ? file : "-");
+    lines[n].instret = instr->instret;
+    lines[n].cycles = instr->cycles;
+    n++;
+  }
+  qsort(lines, n, sizeof(t_cmpLine), cmpCompareLines);
+
+  fprintf(fp, "status %d %d\n", status, (int)svGetExitCode());
+  fprintf(fp, "totals %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+      cmpInstret, cmpCycles, cmpLoads, cmpStores);
+  for (size_t i = 0; i < n;) {
+    t_cmpLine sum = lines[i];
+    for (i++; i < n && cmpCompareLines(&sum, &lines[i]) == 0; i++) {
+      sum.instret += lines[i].instret;
+      sum.cycles += lines[i].cycles;
+    }
+    fprintf(fp, "line %" PRIu64 " %" PRIu64 " %d %s\n", sum.instret,
+        sum.cycles, sum.line, sum.name);
+  }
+  free(lines);
+  return fflush(fp) == 0 ? CMP_NO_ERROR : CMP_FILE_ERROR;
+}
+
+
+static void cmpDeinitRun(t_cmpRun *run)
+{
+  for (size_t i = 0; i < run->numLines; i++)
+    free(run->lines[i].name);
+  free(run->lines);
+}
+
+static t_cmpError cmpReadRun(FILE *fp, t_cmpRun *run)
+{
+  memset(run, 0, sizeof(t_cmpRun));
+  rewind(fp);
+  if (fscanf(fp, "status %d %d ", &run->status, &run->exitCode) != 2)
+    return CMP_RUN_FAILED;
+  if (fscanf(fp, "totals %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " ",
+          &run->instret, &run->cycles, &run->loads, &run->stores) != 4)
+    return CMP_RUN_FAILED;
+
+  size_t size = 0;
+  t_cmpLine line;
+  char name[1024];
+  while (fscanf(fp, "line %" SCNu64 " %" SCNu64 " %d ", &line.instret,
+             &line.cycles, &line.line) == 3) {
+    if (fgets(name, sizeof(name), fp) == NULL)
+      return CMP_RUN_FAILED;
+    name[strcspn(name, "\n")] = '\0';
+    if (run->numLines == size) {
+      size = size ? size * 2 : 64;
+      t_cmpLine *newLines = realloc(run->lines, sizeof(t_cmpLine) * size);
+      if (newLines == NULL)
+        return CMP_MEMORY_ERROR;
+      run->lines = newLines;
+    }
+    if ((line.name = strdup(name)) == NULL)
+      return CMP_MEMORY_ERROR;
+    run->lines[run->numLines++] = line;
+  }
+  return CMP_NO_ERROR;
+}
+
+static bool cmpOutputsMatch(void)
+{
+  char bufA[4096], bufB[4096];
+  rewind(cmpOutputs[0]);
+  rewind(cmpOutputs[1]);
+  size_t n;
+  do {
+    n = fread(bufA, 1, sizeof(bufA), cmpOutputs[0]);
+    if (fread(bufB, 1, sizeof(bufB), cmpOutputs[1]) != n)
+      return false;
+    if (memcmp(bufA, bufB, n) != 0)
+      return false;
+  } while (n > 0);
+  return true;
+}
+
+static void cmpPrintStatus(const t_cmpRun *run)
+{
+  char buf[32];
+  if (run->status == SV_STATUS_MEMORY_FAULT)
+    strcpy(buf, "mem-fault");
+  else if (run->status == SV_STATUS_ILL_INST_FAULT)
+    strcpy(buf, "ill-inst");
+  else if (run->status == SV_STATUS_INVALID_SYSCALL)
+    strcpy(buf, "bad-ecall");
+  else if (run->status == SV_STATUS_INSTR_LIMIT)
+    strcpy(buf, "instr-limit");
+  else if (run->status == SV_STATUS_TIMEOUT)
+    strcpy(buf, "timeout");
+  else
+    snprintf(buf, sizeof(buf), "exit(%d)", run->exitCode);
+  printf(" %14s", buf);
+}
+
+static void cmpPrintCounter(const char *name, uint64_t a, uint64_t b)
+{
+  printf("%-14s %14" PRIu64 " %14" PRIu64, name, a, b);
+  if (a == 0 && b == 0)
+    putchar('\n');
+  else if (a == 0)
+    printf(" %14s\n", "-");
+  else
+    printf(" %+13.2f%%\n", ((double)b - (double)a) * 100.0 / (double)a);
+}
+
+typedef struct {
+  const t_cmpLine *a;
+  const t_cmpLine *b;
+  int64_t delta;
+} t_cmpLineDiff;
+
+static int cmpCompareDiffs(const void *a, const void *b)
+{
+  const t_cmpLineDiff *da = a, *db = b;
+  uint64_t magA = da->delta < 0 ? -(uint64_t)da->delta : (uint64_t)da->delta;
+  uint64_t magB = db->delta < 0 ? -(uint64_t)db->delta : (uint64_t)db->delta;
+  if (magA != magB)
+    return magA > magB ? -1 : 1;
+  const t_cmpLine *la = da->a ? da->a : da->b;
+  const t_cmpLine *lb = db->a ? db->a : db->b;
+  return cmpCompareLines(la, lb);
+}
+
+static void cmpPrintLineDiffs(const t_cmpRun *a, const t_cmpRun *b)
+{
+  t_cmpLineDiff *diffs =
+      malloc(sizeof(t_cmpLineDiff) * (a->numLines + b->numLines + 1));
+  if (diffs == NULL)
+    return;
+
+  // Both runs list their lines in the same order
+  size_t n = 0, i = 0, j = 0;
+  while (i < a->numLines || j < b->numLines) {
+    int order;
+    if (i == a->numLines)
+      order = 1;
+    else if (j == b->numLines)
+      order = -1;
+    else
+      order = cmpCompareLines(&a->lines[i], &b->lines[j]);
+    diffs[n].a = order <= 0 ? &a->lines[i++] : NULL;
+    diffs[n].b = order >= 0 ? &b->lines[j++] : NULL;
+    uint64_t cyclesA = diffs[n].a ? diffs[n].a->cycles : 0;
+    uint64_t cyclesB = diffs[n].b ? diffs[n].b->cycles : 0;
+    uint64_t instretA = diffs[n].a ? diffs[n].a->instret : 0;
+    uint64_t instretB = diffs[n].b ? diffs[n].b->instret : 0;
+    diffs[n].delta = (int64_t)(cyclesB - cyclesA);
+    if (cyclesA != cyclesB || instretA != instretB)
+      n++;
+  }
+  qsort(diffs, n, sizeof(t_cmpLineDiff), cmpCompareDiffs);
+
+  if (n > 0)
+    printf("\n%14s %14s %14s %14s %14s  %s\n", "instret A", "instret B",
+        "cycles A", "cycles B", "cycles B-A", "location");
+  for (i = 0; i < n; i++) {
+    const t_cmpLine *la = diffs[i].a, *lb = diffs[i].b;
+    const t_cmpLine *loc = la ? la : lb;
+    printf("%14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64
+           " %+14" PRId64 "  %s",
+        la ? la->instret : 0, lb ? lb->instret : 0, la ? la->cycles : 0,
+        lb ? lb->cycles : 0, diffs[i].delta, loc->name);
+    if (loc->line > 0)
+      printf(":%d", loc->line);
+    putchar('\n');
+  }
+  free(diffs);
+}
+
+/* Prints the counters of the two runs side by side, followed by the source
+ * lines whose costs changed, in order of decreasing difference in cycles.
+ * Returns CMP_OUTPUT_MISMATCH if the programs did not produce the same output
+ * or did not terminate in the same way. */
+t_cmpError cmpWriteReport(const char *names[2])
+{
+  t_cmpRun runs[2];
+  t_cmpError res = CMP_NO_ERROR;
+  for (int i = 0; i < 2; i++) {
+    t_cmpError err = cmpReadRun(cmpStats[i], &runs[i]);
+    if (err == CMP_RUN_FAILED)
+      fprintf(stderr, "Could not run %s\n", names[i]);
+    if (err != CMP_NO_ERROR)
+      res = err;
+  }
+  if (res != CMP_NO_ERROR)
+    goto cleanup;
+
+  printf("A: %s\nB: %s\n\n", names[0], names[1]);
+  printf("%-14s %14s %14s %14s\n", "", "A", "B", "change");
+  printf("%-14s", "status");
+  cmpPrintStatus(&runs[0]);
+  cmpPrintStatus(&runs[1]);
+  putchar('\n');
+  cmpPrintCounter("instret", runs[0].instret, runs[1].instret);
+  cmpPrintCounter("cycles (est.)", runs[0].cycles, runs[1].cycles);
+  cmpPrintCounter("loads", runs[0].loads, runs[1].loads);
+  cmpPrintCounter("stores", runs[0].stores, runs[1].stores);
+  cmpPrintLineDiffs(&runs[0], &runs[1]);
+
+  bool sameStatus = runs[0].status == runs[1].status &&
+      runs[0].exitCode == runs[1].exitCode;
+  if (!sameStatus || !cmpOutputsMatch()) {
+    puts("\nThe outputs of the programs differ.");
+    res = CMP_OUTPUT_MISMATCH;
+  } else {
+    puts("\nThe outputs of the programs match.");
+  }
+
+cleanup:
+  cmpDeinitRun(&runs[0]);
+  cmpDeinitRun(&runs[1]);
+  return res;
+}
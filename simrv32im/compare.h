@@ -0,0 +1,32 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+#include "supervisor.h"
+
+typedef int t_cmpError;
+enum {
+  CMP_NO_ERROR = 0,
+  CMP_MEMORY_ERROR = -1,
+  CMP_FILE_ERROR = -2,
+  CMP_PROCESS_ERROR = -3,
+  CMP_RUN_FAILED = -4,
+  CMP_OUTPUT_MISMATCH = -5
+};
+
+#define CMP_PARENT (-1)
+
+
+t_cmpError cmpStartRuns(const char *inputFile, int *outRun);
+
+uint64_t cmpGetCycles(const t_cpuHart *hart, t_memAddress pc, uint32_t instr);
+
+void cmpRecordInstr(t_cpuHart *hart, t_memAddress pc, uint32_t instr);
+
+t_cmpError cmpFinishRun(t_svStatus status);
+
+t_cmpError cmpWriteReport(const char *names[2]);
+
+#endif
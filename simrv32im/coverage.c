@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "isa.h"
+#include "cpu.h"
+#include "coverage.h"
+#include "symbols.h"
+
+/* Coverage is tracked at the granularity of basic blocks. The CPU reports
+ * the address of the first instruction executed after every control transfer
+ * (see cpuSetBlockTracking), and the corresponding bit in covBlockBitmap is
+ * set the first time the block is entered. The instructions in each block are
+ * only recovered when the report is written, and mapped to the source lines
+ * loaded in the symbol table. */
+
+typedef struct {
+  int file;
+  int line;
+  bool hit;
+} t_covLineHit;
+
+bool covEnabled = false;
+
+/* Range of addresses covered by the bitmaps, one bit per word. */
+t_memAddress covCodeStart = 0;
+t_memAddress covCodeEnd = 0;
+uint32_t *covBlockBitmap = NULL;
+
+
+void covEnable(void)
+{
+  covEnabled = true;
+  cpuSetBlockTracking(true);
+}
+
+
+bool covGetEnabled(void)
+{
+  return covEnabled;
+}
+
+
+static size_t covBitmapWords(void)
+{
+  return ((size_t)(covCodeEnd - covCodeStart) / 4 + 31) / 32;
+}
+
+
+t_covError covAddCodeRange(t_memAddress base, t_memSize size)
+{
+  if (size == 0)
+    return COV_NO_ERROR;
+  if (covBlockBitmap == NULL) {
+    covCodeStart = base;
+    covCodeEnd = base + size;
+  } else {
+    if (base < covCodeStart)
+      covCodeStart = base;
+    if (base + size > covCodeEnd)
+      covCodeEnd = base + size;
+  }
+  // Code ranges are only added before the execution starts, so there are no
+  // marked blocks to preserve.
+  free(covBlockBitmap);
+  covBlockBitmap = calloc(covBitmapWords(), sizeof(uint32_t));
+  if (covBlockBitmap == NULL) {
+    covCodeStart = covCodeEnd = 0;
+    return COV_MEMORY_ERROR;
+  }
+  return COV_NO_ERROR;
+}
+
+
+void covMarkBlock(t_memAddress addr)
+{
+  // Also rejects all addresses when no code range was registered.
+  if (addr - covCodeStart >= covCodeEnd - covCodeStart)
+    return;
+  t_memAddress idx = (addr - covCodeStart) / 4;
+  uint32_t *word = &covBlockBitmap[idx / 32];
+  uint32_t bit = (uint32_t)1 << (idx % 32);
+  // Avoid writing to shared cache lines once the block has been seen.
+  if ((__atomic_load_n(word, __ATOMIC_RELAXED) & bit) == 0)
+    __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+}
+
+
+static bool covTestBit(uint32_t *bitmap, t_memAddress idx)
+{
+  return (bitmap[idx / 32] & ((uint32_t)1 << (idx % 32))) != 0;
+}
+
+static void covSetBit(uint32_t *bitmap, t_memAddress idx)
+{
+  bitmap[idx / 32] |= (uint32_t)1 << (idx % 32);
+}
+
+/* Must match the instructions which end a block in cpuExecute(). */
+static bool covEndsBlock(uint32_t instr)
+{
+  switch (ISA_INST_OPCODE(instr)) {
+    case ISA_INST_OPCODE_BRANCH:
+    case ISA_INST_OPCODE_JALR:
+    case ISA_INST_OPCODE_JAL:
+    case ISA_INST_OPCODE_SYSTEM:
+      return true;
+  }
+  return false;
+}
+
+/* Expands the set of executed blocks to the set of executed instructions.
+ * An instruction is assumed to be executed if the block containing it was
+ * entered, which is not true only if the program was stopped by a fault in
+ * the middle of the block. */
+static uint32_t *covComputeExecutedWords(void)
+{
+  size_t nWords = covBitmapWords();
+  uint32_t *executed = calloc(nWords > 0 ? nWords : 1, sizeof(uint32_t));
+  if (executed == NULL)
+    return NULL;
+
+  t_memAddress nInstrs = (covCodeEnd - covCodeStart) / 4;
+  for (t_memAddress leader = 0; leader < nInstrs; leader++) {
+    if (!covTestBit(covBlockBitmap, leader))
+      continue;
+    for (t_memAddress i = leader; i < nInstrs; i++) {
+      if (covTestBit(executed, i))
+        break;
+      covSetBit(executed, i);
+      int mapped;
+      uint32_t instr = memDebugRead32(covCodeStart + i * 4, &mapped);
+      if (!mapped || covEndsBlock(instr))
+        break;
+    }
+  }
+  return executed;
+}
+
+static int covCompareLineHits(const void *a, const void *b)
+{
+  const t_covLineHit *la = a, *lb = b;
+  if (la->file != lb->file)
+    return la->file - lb->file;
+  return la->line - lb->line;
+}
+
+t_covError covWriteLCOV(const char *path)
+{
+  t_covError res = COV_NO_ERROR;
+  uint32_t *executed = NULL;
+  t_covLineHit *hits = NULL;
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL)
+    return COV_FILE_ERROR;
+
+  size_t numLines;
+  const t_symSourceLine *lines = symGetSourceLines(&numLines);
+  executed = covComputeExecutedWords();
+  hits = malloc(sizeof(t_covLineHit) * (numLines + 1));
+  if (executed == NULL || hits == NULL) {
+    res = COV_MEMORY_ERROR;
+    goto cleanup;
+  }
+
+  // Each entry describes the code up to the address of the next one. Mark
+  // the entries with at least one executed instruction in that range.
+  for (size_t i = 0; i < numLines; i++) {
+    t_memAddress start = lines[i].address;
+    t_memAddress end = covCodeEnd;
+    if (i + 1 < numLines && lines[i + 1].address < end)
+      end = lines[i + 1].address;
+    hits[i].file = lines[i].file;
+    hits[i].line = lines[i].line;
+    hits[i].hit = false;
+    for (t_memAddress addr = start; addr >= covCodeStart && addr < end;
+         addr += 4) {
+      if (covTestBit(executed, (addr - covCodeStart) / 4)) {
+        hits[i].hit = true;
+        break;
+      }
+    }
+  }
+
+  // Merge the entries for the same line, and emit one record per file.
+  qsort(hits, numLines, sizeof(t_covLineHit), covCompareLineHits);
+  size_t i = 0;
+  while (i < numLines) {
+    int file = hits[i].file;
+    int linesFound = 0, linesHit = 0;
+    fprintf(fp, "TN:\nSF:%s\n", symGetFileName(file));
+    while (i < numLines && hits[i].file == file) {
+      int line = hits[i].line;
+      bool hit = false;
+      for (; i < numLines && hits[i].file == file && hits[i].line == line;
+           i++)
+        hit = hit || hits[i].hit;
+      fprintf(fp, "DA:%d,%d\n", line, hit ? 1 : 0);
+      linesFound++;
+      linesHit += hit ? 1 : 0;
+    }
+    fprintf(fp, "LF:%d\nLH:%d\nend_of_record\n", linesFound, linesHit);
+  }
+  if (ferror(fp))
+    res = COV_FILE_ERROR;
+
+cleanup:
+  free(executed);
+  free(hits);
+  if (fclose(fp) != 0 && res == COV_NO_ERROR)
+    res = COV_FILE_ERROR;
+  return res;
+}
@@ -0,0 +1,24 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdbool.h>
+#include "memory.h"
+
+typedef int t_covError;
+enum {
+  COV_NO_ERROR = 0,
+  COV_MEMORY_ERROR = -1,
+  COV_FILE_ERROR = -2
+};
+
+
+void covEnable(void);
+bool covGetEnabled(void);
+
+t_covError covAddCodeRange(t_memAddress base, t_memSize size);
+
+void covMarkBlock(t_memAddress addr);
+
+t_covError covWriteLCOV(const char *path);
+
+#endif
@@ -1,13 +1,74 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include "cpu.h"
 #include "memory.h"
+#include "coverage.h"
+#include "bbv.h"
+#include "loops.h"
+#include "valprof.h"
+#include "compare.h"
+#include "simpoint.h"
+
+#define CPU_CSR_CYCLE    0xC00
+#define CPU_CSR_INSTRET  0xC02
+#define CPU_CSR_CYCLEH   0xC80
+#define CPU_CSR_INSTRETH 0xC82
+#define CPU_CSR_MHARTID  0xF14
+
+t_cpuHart cpuBootHart;
+_Thread_local t_cpuHart *cpuCurHart = &cpuBootHart;
+
+/* Reservations of LR.W, indexed by hart ID, which hold the address of the
+ * reserved word or CPU_NO_RESERVATION. Every store and AMO clears the
+ * reservations of all harts on the words it writes, so that SC.W fails after
+ * any intervening store, even if the word was then given back the value
+ * loaded by LR.W. cpuNumReservations counts the reservations held, so that
+ * stores do not look at them when there are none. cpuNumHarts is the number of
+ * reservations to look at. */
+#define CPU_NO_RESERVATION ((t_cpuURegValue)1)
+t_cpuURegValue cpuReservations[CPU_MAX_HARTS] = {CPU_NO_RESERVATION};
+int cpuNumReservations;
+int cpuNumHarts = 1;
+bool cpuTrackBlocks = false;
+bool cpuTrackLoops = false;
+bool cpuProfileValues = false;
+bool cpuProfileInstrs = false;
+
+
+/* Harts are created by one thread at a time, with increasing IDs. */
+t_cpuHart *cpuNewHart(t_cpuURegValue hartID)
+{
+  if (hartID >= CPU_MAX_HARTS)
+    return NULL;
+  t_cpuHart *hart = calloc(1, sizeof(t_cpuHart));
+  if (hart == NULL)
+    return NULL;
+  hart->hartID = hartID;
+  cpuReservations[hartID] = CPU_NO_RESERVATION;
+  if ((int)hartID >= cpuNumHarts)
+    __atomic_store_n(&cpuNumHarts, (int)hartID + 1, __ATOMIC_RELEASE);
+  return hart;
+}
+
 
-#define CPU_N_REGS 32
+void cpuDeleteHart(t_cpuHart *hart)
+{
+  if (hart != &cpuBootHart)
+    free(hart);
+}
 
-t_cpuURegValue cpuRegs[CPU_N_REGS];
-t_cpuURegValue cpuPC;
-t_cpuStatus lastStatus;
+
+void cpuSetCurrentHart(t_cpuHart *hart)
+{
+  cpuCurHart = hart;
+}
+
+
+t_cpuHart *cpuGetCurrentHart(void)
+{
+  return cpuCurHart;
+}
 
 
 t_cpuURegValue cpuGetRegister(t_cpuRegID reg)
@@ -15,416 +76,715 @@ t_cpuURegValue cpuGetRegister(t_cpuRegID reg)
   if (reg == CPU_REG_X0)
     return 0;
   if (reg == CPU_REG_PC)
-    return cpuPC;
-  return cpuRegs[reg];
+    return cpuCurHart->pc;
+  return cpuCurHart->regs[reg];
 }
 
 
 void cpuSetRegister(t_cpuRegID reg, t_cpuURegValue value)
 {
   if (reg == CPU_REG_PC)
-    cpuPC = value;
+    cpuCurHart->pc = value;
   if (reg != CPU_REG_ZERO)
-    cpuRegs[reg] = value;
+    cpuCurHart->regs[reg] = value;
+}
+
+
+/* Gives up the reservation of a hart, and returns the address which was
+ * reserved, or CPU_NO_RESERVATION. */
+static t_cpuURegValue cpuReleaseReservation(t_cpuHart *hart)
+{
+  t_cpuURegValue addr = __atomic_exchange_n(
+      &cpuReservations[hart->hartID], CPU_NO_RESERVATION, __ATOMIC_SEQ_CST);
+  if (addr != CPU_NO_RESERVATION)
+    __atomic_fetch_sub(&cpuNumReservations, 1, __ATOMIC_SEQ_CST);
+  return addr;
+}
+
+
+/* Reserves a word for LR.W. The reservation is counted before being made, so
+ * that no store can see it without also seeing the count. */
+static void cpuAcquireReservation(t_cpuHart *hart, t_memAddress addr)
+{
+  __atomic_fetch_add(&cpuNumReservations, 1, __ATOMIC_SEQ_CST);
+  t_cpuURegValue old = __atomic_exchange_n(
+      &cpuReservations[hart->hartID], addr, __ATOMIC_SEQ_CST);
+  if (old != CPU_NO_RESERVATION)
+    __atomic_fetch_sub(&cpuNumReservations, 1, __ATOMIC_SEQ_CST);
+}
+
+
+/* Clears the reservations of all harts on the words overlapped by a store of
+ * `size' bytes at `addr', which has already been made. */
+static void cpuClearReservations(t_memAddress addr, t_memSize size)
+{
+  int numHarts = __atomic_load_n(&cpuNumHarts, __ATOMIC_ACQUIRE);
+  // The store must be visible to the other harts before their reservations
+  // are read. Otherwise a LR.W executed at the same time on another hart
+  // could both load the old value and be missed here.
+  if (numHarts > 1)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&cpuNumReservations, __ATOMIC_RELAXED) == 0)
+    return;
+
+  t_memAddress first = addr & ~(t_memAddress)3;
+  t_memAddress last = (addr + size - 1) & ~(t_memAddress)3;
+  for (int i = 0; i < numHarts; i++) {
+    t_cpuURegValue resv =
+        __atomic_load_n(&cpuReservations[i], __ATOMIC_RELAXED);
+    if ((resv == first || resv == last) &&
+        __atomic_compare_exchange_n(&cpuReservations[i], &resv,
+            CPU_NO_RESERVATION, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+      __atomic_fetch_sub(&cpuNumReservations, 1, __ATOMIC_SEQ_CST);
+  }
 }
 
 
 void cpuReset(t_cpuURegValue pcValue)
 {
-  lastStatus = CPU_STATUS_OK;
-  cpuPC = pcValue;
+  t_cpuHart *hart = cpuCurHart;
+  hart->lastStatus = CPU_STATUS_OK;
+  hart->pc = pcValue;
   for (int i = 0; i < CPU_N_REGS; i++) {
-    cpuRegs[i] = 0;
+    hart->regs[i] = 0;
   }
+  cpuReleaseReservation(hart);
+  hart->instret = 0;
+  hart->atBlockStart = cpuTrackBlocks;
 }
 
 
 t_cpuStatus cpuClearLastFault(void)
 {
-  if (lastStatus == CPU_STATUS_ILL_INST_FAULT ||
-      lastStatus == CPU_STATUS_EBREAK_TRAP ||
-      lastStatus == CPU_STATUS_ECALL_TRAP)
-    cpuPC += 4;
-  lastStatus = CPU_STATUS_OK;
-  return lastStatus;
+  t_cpuHart *hart = cpuCurHart;
+  if (hart->lastStatus == CPU_STATUS_ILL_INST_FAULT ||
+      hart->lastStatus == CPU_STATUS_EBREAK_TRAP ||
+      hart->lastStatus == CPU_STATUS_ECALL_TRAP)
+    hart->pc += 4;
+  // Traps retire the instruction that caused them, faults do not.
+  if (hart->lastStatus == CPU_STATUS_EBREAK_TRAP ||
+      hart->lastStatus == CPU_STATUS_ECALL_TRAP)
+    hart->instret++;
+  hart->lastStatus = CPU_STATUS_OK;
+  return hart->lastStatus;
 }
 
 
-t_cpuStatus cpuExecuteLOAD(uint32_t instr);
-t_cpuStatus cpuExecuteOPIMM(uint32_t instr);
-t_cpuStatus cpuExecuteAUIPC(uint32_t instr);
-t_cpuStatus cpuExecuteSTORE(uint32_t instr);
-t_cpuStatus cpuExecuteOP(uint32_t instr);
-t_cpuStatus cpuExecuteLUI(uint32_t instr);
-t_cpuStatus cpuExecuteBRANCH(uint32_t instr);
-t_cpuStatus cpuExecuteJALR(uint32_t instr);
-t_cpuStatus cpuExecuteJAL(uint32_t instr);
-t_cpuStatus cpuExecuteSYSTEM(uint32_t instr);
+/* When enabled, the address of the first instruction of each basic block is
+ * reported to the coverage tracker and to the basic-block vector profiler
+ * when the block is entered. Blocks end after every branch, jump and SYSTEM
+ * instruction. */
+void cpuSetBlockTracking(bool enabled)
+{
+  cpuTrackBlocks = enabled;
+}
 
-t_cpuStatus cpuTick(void)
+
+/* When enabled, branches and jumps are reported to the loop profiler. */
+void cpuSetLoopTracking(bool enabled)
 {
-  if (lastStatus != CPU_STATUS_OK)
-    return lastStatus;
+  cpuTrackLoops = enabled;
+}
 
-  uint32_t nextInst;
-  t_memError fetchErr = memRead32(cpuPC, &nextInst);
-  if (fetchErr != MEM_NO_ERROR) {
-    lastStatus = CPU_STATUS_MEMORY_FAULT;
-    return lastStatus;
-  }
 
-  switch (ISA_INST_OPCODE(nextInst)) {
-    case ISA_INST_OPCODE_LOAD:
-      lastStatus = cpuExecuteLOAD(nextInst);
-      break;
-    case ISA_INST_OPCODE_OPIMM:
-      lastStatus = cpuExecuteOPIMM(nextInst);
-      break;
-    case ISA_INST_OPCODE_AUIPC:
-      lastStatus = cpuExecuteAUIPC(nextInst);
-      break;
-    case ISA_INST_OPCODE_STORE:
-      lastStatus = cpuExecuteSTORE(nextInst);
-      break;
-    case ISA_INST_OPCODE_OP:
-      lastStatus = cpuExecuteOP(nextInst);
+/* When enabled, the operands of multiplications, divisions and variable
+ * shifts are reported to the value profiler. */
+void cpuSetValueProfiling(bool enabled)
+{
+  cpuProfileValues = enabled;
+}
+
+
+/* When enabled, every instruction retired is reported to the profiler of
+ * the comparison mode. */
+void cpuSetInstrProfiling(bool enabled)
+{
+  cpuProfileInstrs = enabled;
+}
+
+
+/* Decodes an instruction, and extracts its operands. */
+static void cpuDecode(t_cpuDecodedInstr *dec, uint32_t instr)
+{
+  t_isaInstrID id = isaDecode(instr);
+  dec->instr = instr;
+  dec->id = (uint8_t)id;
+  dec->rd = (uint8_t)ISA_INST_RD(instr);
+  dec->rs1 = (uint8_t)ISA_INST_RS1(instr);
+  dec->rs2 = (uint8_t)ISA_INST_RS2(instr);
+  dec->writesMemory = ISA_INST_OPCODE(instr) == ISA_INST_OPCODE_STORE ||
+      ISA_INST_OPCODE(instr) == ISA_INST_OPCODE_AMO;
+
+  switch (isaInstrs[id].format) {
+    case ISA_FORMAT_I:
+    case ISA_FORMAT_IL:
+      dec->imm = ISA_INST_I_IMM12_SEXT(instr);
       break;
-    case ISA_INST_OPCODE_LUI:
-      lastStatus = cpuExecuteLUI(nextInst);
+    case ISA_FORMAT_ISH:
+      dec->imm = ISA_INST_RS2(instr);
       break;
-    case ISA_INST_OPCODE_BRANCH:
-      lastStatus = cpuExecuteBRANCH(nextInst);
+    case ISA_FORMAT_S:
+      dec->imm = ISA_INST_S_IMM12_SEXT(instr);
       break;
-    case ISA_INST_OPCODE_JALR:
-      lastStatus = cpuExecuteJALR(nextInst);
+    case ISA_FORMAT_B:
+      dec->imm = ISA_INST_B_IMM13_SEXT(instr);
       break;
-    case ISA_INST_OPCODE_JAL:
-      lastStatus = cpuExecuteJAL(nextInst);
+    case ISA_FORMAT_U:
+      dec->imm = ISA_INST_U_IMM20(instr) << 12;
       break;
-    case ISA_INST_OPCODE_SYSTEM:
-      lastStatus = cpuExecuteSYSTEM(nextInst);
+    case ISA_FORMAT_J:
+      dec->imm = ISA_INST_J_IMM21_SEXT(instr);
       break;
     default:
-      lastStatus = CPU_STATUS_ILL_INST_FAULT;
+      dec->imm = 0;
+      break;
   }
-  cpuRegs[CPU_REG_ZERO] = 0;
-  return lastStatus;
 }
 
-t_cpuStatus cpuExecuteLOAD(uint32_t instr)
+/* Fetches and decodes the instruction at `pc' into an entry of the cache of
+ * decoded instructions. */
+static t_memError cpuFetch(
+    t_cpuDecodedInstr *dec, t_cpuURegValue pc, uint64_t generation)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_memAddress addr = cpuRegs[rs1] + ISA_INST_I_IMM12_SEXT(instr);
+  uint32_t instr;
+  t_memError err = memFetch32(pc, &instr);
+  if (err != MEM_NO_ERROR)
+    return err;
+  cpuDecode(dec, instr);
+  dec->pc = pc;
+  dec->generation = generation;
+  dec->blockSeen = false;
+  return MEM_NO_ERROR;
+}
 
+static t_cpuStatus cpuLoad(
+    t_cpuHart *hart, t_isaInstrID id, t_cpuRegID rd, t_memAddress addr)
+{
   uint8_t tmp8;
   uint16_t tmp16;
   uint32_t tmp32;
-  t_memError memStatus;
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* LB */
-      memStatus = memRead8(addr, &tmp8);
-      if (memStatus != MEM_NO_ERROR)
+
+  switch (id) {
+    case ISA_INSTR_LB:
+      if (memRead8(addr, &tmp8) != MEM_NO_ERROR)
         return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int8_t)tmp8));
+      hart->regs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int8_t)tmp8));
       break;
-    case 1: /* LH */
-      memStatus = memRead16(addr, &tmp16);
-      if (memStatus != MEM_NO_ERROR)
+    case ISA_INSTR_LH:
+      if (memRead16(addr, &tmp16) != MEM_NO_ERROR)
         return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int16_t)tmp16));
+      hart->regs[rd] = (t_cpuURegValue)((t_cpuSRegValue)((int16_t)tmp16));
       break;
-    case 2: /* LW */
-      memStatus = memRead32(addr, &tmp32);
-      if (memStatus != MEM_NO_ERROR)
+    case ISA_INSTR_LW:
+      if (memRead32(addr, &tmp32) != MEM_NO_ERROR)
         return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = tmp32;
+      hart->regs[rd] = tmp32;
       break;
-    case 4: /* LBU */
-      memStatus = memRead8(addr, &tmp8);
-      if (memStatus != MEM_NO_ERROR)
+    case ISA_INSTR_LBU:
+      if (memRead8(addr, &tmp8) != MEM_NO_ERROR)
         return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)tmp8;
+      hart->regs[rd] = (t_cpuURegValue)tmp8;
       break;
-    case 5: /* LHU */
-      memStatus = memRead16(addr, &tmp16);
-      if (memStatus != MEM_NO_ERROR)
+    case ISA_INSTR_LHU:
+      if (memRead16(addr, &tmp16) != MEM_NO_ERROR)
         return CPU_STATUS_MEMORY_FAULT;
-      cpuRegs[rd] = (t_cpuURegValue)tmp16;
+      hart->regs[rd] = (t_cpuURegValue)tmp16;
       break;
-    default:
-      return CPU_STATUS_ILL_INST_FAULT;
   }
-
-  cpuPC += 4;
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteOPIMM(uint32_t instr)
+static t_cpuStatus cpuStore(
+    t_isaInstrID id, t_memAddress addr, t_cpuURegValue value)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* ADDI */
-      cpuRegs[rd] = cpuRegs[rs1] + ISA_INST_I_IMM12_SEXT(instr);
-      break;
-    case 1: /* SLLI */
-      if (ISA_INST_FUNCT7(instr) == 0x00)
-        cpuRegs[rd] = cpuRegs[rs1] << (ISA_INST_I_IMM12(instr) & 0x1F);
-      else
-        return CPU_STATUS_ILL_INST_FAULT;
-      break;
-    case 2: /* SLTI */
-      cpuRegs[rd] = ((t_cpuSRegValue)cpuRegs[rs1]) <
-          ((t_cpuSRegValue)ISA_INST_I_IMM12_SEXT(instr));
-      break;
-    case 3: /* SLTIU */
-      cpuRegs[rd] = cpuRegs[rs1] < ISA_INST_I_IMM12(instr);
-      break;
-    case 4: /* XORI */
-      cpuRegs[rd] = cpuRegs[rs1] ^ ISA_INST_I_IMM12_SEXT(instr);
-      break;
-    case 5: /* SRLI / SRAI */
-      if (ISA_INST_FUNCT7(instr) == 0x00)
-        cpuRegs[rd] = cpuRegs[rs1] >> (ISA_INST_I_IMM12(instr) & 0x1F);
-      else if (ISA_INST_FUNCT7(instr) == 0x20)
-        cpuRegs[rd] = SRA(cpuRegs[rs1], (ISA_INST_I_IMM12(instr) & 0x1F));
-      else
-        return CPU_STATUS_ILL_INST_FAULT;
+  switch (id) {
+    case ISA_INSTR_SB:
+      if (memWrite8(addr, value & 0xFF) != MEM_NO_ERROR)
+        return CPU_STATUS_MEMORY_FAULT;
+      cpuClearReservations(addr, 1);
       break;
-    case 6: /* ORI */
-      cpuRegs[rd] = cpuRegs[rs1] | ISA_INST_I_IMM12_SEXT(instr);
+    case ISA_INSTR_SH:
+      if (memWrite16(addr, value & 0xFFFF) != MEM_NO_ERROR)
+        return CPU_STATUS_MEMORY_FAULT;
+      cpuClearReservations(addr, 2);
       break;
-    case 7: /* ANDI */
-      cpuRegs[rd] = cpuRegs[rs1] & ISA_INST_I_IMM12_SEXT(instr);
+    case ISA_INSTR_SW:
+      if (memWrite32(addr, value) != MEM_NO_ERROR)
+        return CPU_STATUS_MEMORY_FAULT;
+      cpuClearReservations(addr, 4);
       break;
   }
-
-  cpuPC += 4;
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteAUIPC(uint32_t instr)
-{
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = cpuPC + (ISA_INST_U_IMM20(instr) << 12);
-  cpuPC += 4;
-  return CPU_STATUS_OK;
-}
+t_cpuStatus cpuExecute(t_cpuHart *hart, const t_cpuDecodedInstr *dec);
 
-t_cpuStatus cpuExecuteSTORE(uint32_t instr)
+/* Executes one instruction of a hart, and reports it to the trackers and
+ * profilers which are enabled. */
+static t_cpuStatus cpuStep(t_cpuHart *hart)
 {
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
-  t_memAddress addr = cpuRegs[rs1] + ISA_INST_S_IMM12_SEXT(instr);
+  if (hart->lastStatus != CPU_STATUS_OK)
+    return hart->lastStatus;
 
-  t_memError memStatus;
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* SB */
-      memStatus = memWrite8(addr, cpuRegs[rs2] & 0xFF);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      break;
-    case 1: /* SH */
-      memStatus = memWrite16(addr, cpuRegs[rs2] & 0xFFFF);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      break;
-    case 2: /* SW */
-      memStatus = memWrite32(addr, cpuRegs[rs2]);
-      if (memStatus != MEM_NO_ERROR)
-        return CPU_STATUS_MEMORY_FAULT;
-      break;
-    default:
-      return CPU_STATUS_ILL_INST_FAULT;
+  t_memAddress pc = hart->pc;
+  uint32_t nextInst;
+  t_memError fetchErr = memRead32(hart->pc, &nextInst);
+  if (fetchErr != MEM_NO_ERROR) {
+    hart->lastStatus = CPU_STATUS_MEMORY_FAULT;
+    return hart->lastStatus;
   }
+  t_cpuDecodedInstr dec;
+  cpuDecode(&dec, nextInst);
 
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+  if (hart->atBlockStart) {
+    hart->atBlockStart = false;
+    covMarkBlock(hart->pc);
+    bbvEnterBlock(hart);
+  }
+  if (cpuProfileValues && ISA_INST_OPCODE(nextInst) == ISA_INST_OPCODE_OP)
+    vpRecordOP(hart, nextInst);
+
+  hart->lastStatus = cpuExecute(hart, &dec);
+  if (hart->lastStatus == CPU_STATUS_OK)
+    hart->instret++;
+  // Traps retire the instruction, faults do not
+  if (hart->lastStatus != CPU_STATUS_MEMORY_FAULT &&
+      hart->lastStatus != CPU_STATUS_ILL_INST_FAULT) {
+    if (cpuProfileInstrs)
+      cmpRecordInstr(hart, pc, nextInst);
+    if (hart->sampleCycles)
+      spRecordInstr(hart, pc, nextInst);
+  }
+  hart->regs[CPU_REG_ZERO] = 0;
+  return hart->lastStatus;
 }
 
-t_cpuStatus cpuExecuteOP(uint32_t instr)
+t_cpuStatus cpuTick(void)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
+  return cpuStep(cpuCurHart);
+}
 
-  if (ISA_INST_FUNCT7(instr) == 0x00) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* ADD */
-        cpuRegs[rd] = cpuRegs[rs1] + cpuRegs[rs2];
-        break;
-      case 1: /* SLL */
-        cpuRegs[rd] = cpuRegs[rs1] << (cpuRegs[rs2] & 0x1F);
-        break;
-      case 2: /* SLT */
-        cpuRegs[rd] =
-            ((t_cpuSRegValue)cpuRegs[rs1]) < ((t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 3: /* SLTU */
-        cpuRegs[rd] = cpuRegs[rs1] < cpuRegs[rs2];
-        break;
-      case 4: /* XOR */
-        cpuRegs[rd] = cpuRegs[rs1] ^ cpuRegs[rs2];
-        break;
-      case 5: /* SRL */
-        cpuRegs[rd] = cpuRegs[rs1] >> (cpuRegs[rs2] & 0x1F);
-        break;
-      case 6: /* OR */
-        cpuRegs[rd] = cpuRegs[rs1] | cpuRegs[rs2];
-        break;
-      case 7: /* AND */
-        cpuRegs[rd] = cpuRegs[rs1] & cpuRegs[rs2];
-        break;
-    }
-  } else if (ISA_INST_FUNCT7(instr) == 0x20) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* SUB */
-        cpuRegs[rd] = cpuRegs[rs1] - cpuRegs[rs2];
-        break;
-      case 1:
-      case 2:
-      case 3:
-      case 4:
-        return CPU_STATUS_ILL_INST_FAULT;
-      case 5: /* SRA */
-        cpuRegs[rd] = SRA(cpuRegs[rs1], (cpuRegs[rs2] & 0x1F));
-        break;
-      case 6:
-      case 7:
-        return CPU_STATUS_ILL_INST_FAULT;
+/* Executes instructions of the current hart until one of them traps or
+ * faults, or until `instret` reaches `endInstret`. The flags, including the
+ * sampleCycles flag of the hart, are read once per call, so that when no
+ * tracker or profiler other than the block tracking is enabled the
+ * instructions run in a loop which does not check them.
+ *   That loop takes the instructions from the cache of decoded instructions
+ * of the hart, which is indexed by their address. An entry is valid as long as
+ * the code generation it was decoded in is current, that is until a write to
+ * a page holding code. The generation is read again after every instruction
+ * which writes to memory, and at every call. A block leader is reported to
+ * the coverage tracker only the first time it is executed from the cache, and
+ * then costs a single flag test. */
+t_cpuStatus cpuRun(uint64_t endInstret)
+{
+  t_cpuHart *hart = cpuCurHart;
+
+  if (cpuTrackLoops || cpuProfileValues || cpuProfileInstrs ||
+      hart->sampleCycles) {
+    while (hart->instret < endInstret && cpuStep(hart) == CPU_STATUS_OK)
+      ;
+    return hart->lastStatus;
+  }
+
+  uint64_t generation = memGetCodeGeneration();
+  t_cpuStatus status = hart->lastStatus;
+  while (status == CPU_STATUS_OK && hart->instret < endInstret) {
+    t_cpuURegValue pc = hart->pc;
+    t_cpuDecodedInstr *dec =
+        &hart->decodeCache[(pc >> 2) & (CPU_DECODE_CACHE_SIZE - 1)];
+    if ((dec->pc != pc || dec->generation != generation) &&
+        cpuFetch(dec, pc, generation) != MEM_NO_ERROR) {
+      status = CPU_STATUS_MEMORY_FAULT;
+      break;
     }
-  } else if (ISA_INST_FUNCT7(instr) == 0x01) {
-    switch (ISA_INST_FUNCT3(instr)) {
-      case 0: /* MUL */
-        cpuRegs[rd] = cpuRegs[rs1] * cpuRegs[rs2];
-        break;
-      case 1: /* MULH */
-        cpuRegs[rd] = (uint32_t)(((int64_t)((int32_t)cpuRegs[rs1]) *
-                                     (int64_t)((int32_t)cpuRegs[rs2])) >>
-            32);
-        break;
-      case 2: /* MULHSU */
-        cpuRegs[rd] = (uint32_t)(((int64_t)((int32_t)cpuRegs[rs1]) *
-                                     (int64_t)(cpuRegs[rs2])) >>
-            32);
-        break;
-      case 3: /* MULHU */
-        cpuRegs[rd] = (t_cpuURegValue)(((uint64_t)(cpuRegs[rs1]) *
-                                           (uint64_t)(cpuRegs[rs2])) >>
-            32);
-        break;
-      case 4: /* DIV */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = 0xFFFFFFFF;
-        else if (cpuRegs[rs1] == 0x80000000 && cpuRegs[rs2] == 0xFFFFFFFF)
-          cpuRegs[rd] = 0x80000000;
-        else
-          cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)cpuRegs[rs1] /
-              (t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 5: /* DIVU */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = 0xFFFFFFFF;
-        else
-          cpuRegs[rd] = cpuRegs[rs1] / cpuRegs[rs2];
-        break;
-      case 6: /* REM */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = cpuRegs[rs1];
-        else if (cpuRegs[rs1] == 0x80000000 && cpuRegs[rs2] == 0xFFFFFFFF)
-          cpuRegs[rd] = 0;
-        else
-          cpuRegs[rd] = (t_cpuURegValue)((t_cpuSRegValue)cpuRegs[rs1] %
-              (t_cpuSRegValue)cpuRegs[rs2]);
-        break;
-      case 7: /* REMU */
-        if (cpuRegs[rs2] == 0)
-          cpuRegs[rd] = cpuRegs[rs1];
-        else
-          cpuRegs[rd] = cpuRegs[rs1] % cpuRegs[rs2];
-        break;
+    if (hart->atBlockStart) {
+      hart->atBlockStart = false;
+      if (!dec->blockSeen) {
+        dec->blockSeen = true;
+        covMarkBlock(pc);
+      }
+      bbvEnterBlock(hart);
     }
-  } else {
-    return CPU_STATUS_ILL_INST_FAULT;
+    status = cpuExecute(hart, dec);
+    if (status == CPU_STATUS_OK)
+      hart->instret++;
+    hart->regs[CPU_REG_ZERO] = 0;
+    if (dec->writesMemory)
+      generation = memGetCodeGeneration();
   }
+  hart->lastStatus = status;
+  return status;
+}
 
-  cpuPC += 4;
-  return CPU_STATUS_OK;
+/* Classifies jumps according to the conventions of the RISC-V ABI. */
+static t_loopTransfer cpuJumpKind(t_cpuRegID rd, t_cpuRegID rs1)
+{
+  if (rd != CPU_REG_ZERO)
+    return LOOP_XFER_CALL;
+  if (rs1 == CPU_REG_RA)
+    return LOOP_XFER_RETURN;
+  return LOOP_XFER_JUMP;
 }
 
-t_cpuStatus cpuExecuteLUI(uint32_t instr)
+static t_cpuStatus cpuBranch(
+    t_cpuHart *hart, t_cpuURegValue offset, bool taken)
 {
-  t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = ISA_INST_U_IMM20(instr) << 12;
-  cpuPC += 4;
+  t_cpuURegValue pc = hart->pc;
+  if (taken)
+    hart->pc += offset;
+  else
+    hart->pc += 4;
+  hart->atBlockStart = cpuTrackBlocks;
+  if (cpuTrackLoops && taken)
+    loopControlTransfer(
+        hart, pc, hart->pc, LOOP_XFER_BRANCH, hart->instret + 1);
+  else if (cpuTrackLoops)
+    loopControlTransfer(
+        hart, pc, pc + offset, LOOP_XFER_NOT_TAKEN, hart->instret + 1);
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteBRANCH(uint32_t instr)
+t_cpuStatus cpuExecuteCSR(t_cpuHart *hart, uint32_t instr);
+t_cpuStatus cpuExecuteAMO(t_cpuHart *hart, t_isaInstrID id, uint32_t instr);
+
+/* Executes a single instruction, without updating `instret`. */
+t_cpuStatus cpuExecute(t_cpuHart *hart, const t_cpuDecodedInstr *dec)
 {
-  t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  t_cpuRegID rs2 = ISA_INST_RS2(instr);
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_B_IMM13_SEXT(instr);
-  bool taken = 0;
+  t_cpuRegID rd = dec->rd;
+  t_cpuURegValue src1 = hart->regs[dec->rs1];
+  t_cpuURegValue src2 = hart->regs[dec->rs2];
+  t_cpuURegValue imm = dec->imm;
+  t_cpuURegValue pc = hart->pc;
+  t_cpuStatus status;
+
+  switch (dec->id) {
+    case ISA_INSTR_LUI:
+      hart->regs[rd] = imm;
+      break;
+    case ISA_INSTR_AUIPC:
+      hart->regs[rd] = pc + imm;
+      break;
+
+    case ISA_INSTR_JAL:
+      hart->regs[rd] = pc + 4;
+      hart->pc += imm;
+      hart->atBlockStart = cpuTrackBlocks;
+      if (cpuTrackLoops)
+        loopControlTransfer(hart, pc, hart->pc, cpuJumpKind(rd, CPU_REG_ZERO),
+            hart->instret + 1);
+      return CPU_STATUS_OK;
+    case ISA_INSTR_JALR:
+      hart->regs[rd] = pc + 4;
+      // clear bit zero as suggested by the spec
+      hart->pc = (src1 + imm) & ~(t_cpuURegValue)1;
+      hart->atBlockStart = cpuTrackBlocks;
+      if (cpuTrackLoops)
+        loopControlTransfer(hart, pc, hart->pc, cpuJumpKind(rd, dec->rs1),
+            hart->instret + 1);
+      return CPU_STATUS_OK;
 
-  switch (ISA_INST_FUNCT3(instr)) {
-    case 0: /* BEQ */
-      taken = cpuRegs[rs1] == cpuRegs[rs2];
+    case ISA_INSTR_BEQ:
+      return cpuBranch(hart, imm, src1 == src2);
+    case ISA_INSTR_BNE:
+      return cpuBranch(hart, imm, src1 != src2);
+    case ISA_INSTR_BLT:
+      return cpuBranch(hart, imm, (t_cpuSRegValue)src1 < (t_cpuSRegValue)src2);
+    case ISA_INSTR_BGE:
+      return cpuBranch(
+          hart, imm, (t_cpuSRegValue)src1 >= (t_cpuSRegValue)src2);
+    case ISA_INSTR_BLTU:
+      return cpuBranch(hart, imm, src1 < src2);
+    case ISA_INSTR_BGEU:
+      return cpuBranch(hart, imm, src1 >= src2);
+
+    case ISA_INSTR_LB:
+    case ISA_INSTR_LH:
+    case ISA_INSTR_LW:
+    case ISA_INSTR_LBU:
+    case ISA_INSTR_LHU:
+      status = cpuLoad(hart, dec->id, rd, src1 + imm);
+      if (status != CPU_STATUS_OK)
+        return status;
+      break;
+
+    case ISA_INSTR_SB:
+    case ISA_INSTR_SH:
+    case ISA_INSTR_SW:
+      status = cpuStore(dec->id, src1 + imm, src2);
+      if (status != CPU_STATUS_OK)
+        return status;
+      break;
+
+    case ISA_INSTR_ADDI:
+      hart->regs[rd] = src1 + imm;
+      break;
+    case ISA_INSTR_SLTI:
+      hart->regs[rd] = (t_cpuSRegValue)src1 < (t_cpuSRegValue)imm;
+      break;
+    case ISA_INSTR_SLTIU:
+      // The immediate is sign-extended, and then compared as unsigned.
+      hart->regs[rd] = src1 < imm;
+      break;
+    case ISA_INSTR_XORI:
+      hart->regs[rd] = src1 ^ imm;
+      break;
+    case ISA_INSTR_ORI:
+      hart->regs[rd] = src1 | imm;
+      break;
+    case ISA_INSTR_ANDI:
+      hart->regs[rd] = src1 & imm;
+      break;
+    case ISA_INSTR_SLLI:
+      hart->regs[rd] = src1 << imm;
+      break;
+    case ISA_INSTR_SRLI:
+      hart->regs[rd] = src1 >> imm;
+      break;
+    case ISA_INSTR_SRAI:
+      hart->regs[rd] = SRA(src1, (int)imm);
+      break;
+
+    case ISA_INSTR_ADD:
+      hart->regs[rd] = src1 + src2;
+      break;
+    case ISA_INSTR_SUB:
+      hart->regs[rd] = src1 - src2;
+      break;
+    case ISA_INSTR_SLL:
+      hart->regs[rd] = src1 << (src2 & 0x1F);
+      break;
+    case ISA_INSTR_SLT:
+      hart->regs[rd] = (t_cpuSRegValue)src1 < (t_cpuSRegValue)src2;
       break;
-    case 1: /* BNE */
-      taken = cpuRegs[rs1] != cpuRegs[rs2];
+    case ISA_INSTR_SLTU:
+      hart->regs[rd] = src1 < src2;
       break;
-    case 4: /* BLT */
-      taken = (t_cpuSRegValue)cpuRegs[rs1] < (t_cpuSRegValue)cpuRegs[rs2];
+    case ISA_INSTR_XOR:
+      hart->regs[rd] = src1 ^ src2;
       break;
-    case 5: /* BGE */
-      taken = (t_cpuSRegValue)cpuRegs[rs1] >= (t_cpuSRegValue)cpuRegs[rs2];
+    case ISA_INSTR_SRL:
+      hart->regs[rd] = src1 >> (src2 & 0x1F);
+      break;
+    case ISA_INSTR_SRA:
+      hart->regs[rd] = SRA(src1, (src2 & 0x1F));
+      break;
+    case ISA_INSTR_OR:
+      hart->regs[rd] = src1 | src2;
       break;
-    case 6: /* BLTU */
-      taken = cpuRegs[rs1] < cpuRegs[rs2];
+    case ISA_INSTR_AND:
+      hart->regs[rd] = src1 & src2;
       break;
-    case 7: /* BGEU */
-      taken = cpuRegs[rs1] >= cpuRegs[rs2];
+
+    case ISA_INSTR_MUL:
+      hart->regs[rd] = src1 * src2;
+      break;
+    case ISA_INSTR_MULH:
+      hart->regs[rd] = (uint32_t)(((int64_t)((int32_t)src1) *
+                                   (int64_t)((int32_t)src2)) >>
+          32);
+      break;
+    case ISA_INSTR_MULHSU:
+      hart->regs[rd] =
+          (uint32_t)(((int64_t)((int32_t)src1) * (int64_t)(src2)) >> 32);
+      break;
+    case ISA_INSTR_MULHU:
+      hart->regs[rd] =
+          (t_cpuURegValue)(((uint64_t)(src1) * (uint64_t)(src2)) >> 32);
+      break;
+    case ISA_INSTR_DIV:
+      if (src2 == 0)
+        hart->regs[rd] = 0xFFFFFFFF;
+      else if (src1 == 0x80000000 && src2 == 0xFFFFFFFF)
+        hart->regs[rd] = 0x80000000;
+      else
+        hart->regs[rd] =
+            (t_cpuURegValue)((t_cpuSRegValue)src1 / (t_cpuSRegValue)src2);
       break;
+    case ISA_INSTR_DIVU:
+      if (src2 == 0)
+        hart->regs[rd] = 0xFFFFFFFF;
+      else
+        hart->regs[rd] = src1 / src2;
+      break;
+    case ISA_INSTR_REM:
+      if (src2 == 0)
+        hart->regs[rd] = src1;
+      else if (src1 == 0x80000000 && src2 == 0xFFFFFFFF)
+        hart->regs[rd] = 0;
+      else
+        hart->regs[rd] =
+            (t_cpuURegValue)((t_cpuSRegValue)src1 % (t_cpuSRegValue)src2);
+      break;
+    case ISA_INSTR_REMU:
+      if (src2 == 0)
+        hart->regs[rd] = src1;
+      else
+        hart->regs[rd] = src1 % src2;
+      break;
+
+    case ISA_INSTR_ECALL:
+      hart->atBlockStart = cpuTrackBlocks;
+      return CPU_STATUS_ECALL_TRAP;
+    case ISA_INSTR_EBREAK:
+      hart->atBlockStart = cpuTrackBlocks;
+      return CPU_STATUS_EBREAK_TRAP;
+    case ISA_INSTR_CSRRW:
+    case ISA_INSTR_CSRRS:
+    case ISA_INSTR_CSRRC:
+    case ISA_INSTR_CSRRWI:
+    case ISA_INSTR_CSRRSI:
+    case ISA_INSTR_CSRRCI:
+      hart->atBlockStart = cpuTrackBlocks;
+      return cpuExecuteCSR(hart, dec->instr);
+
+    case ISA_INSTR_LR_W:
+    case ISA_INSTR_SC_W:
+    case ISA_INSTR_AMOSWAP_W:
+    case ISA_INSTR_AMOADD_W:
+    case ISA_INSTR_AMOXOR_W:
+    case ISA_INSTR_AMOAND_W:
+    case ISA_INSTR_AMOOR_W:
+    case ISA_INSTR_AMOMIN_W:
+    case ISA_INSTR_AMOMAX_W:
+    case ISA_INSTR_AMOMINU_W:
+    case ISA_INSTR_AMOMAXU_W:
+      return cpuExecuteAMO(hart, dec->id, dec->instr);
+
     default:
       return CPU_STATUS_ILL_INST_FAULT;
   }
 
-  cpuPC += taken ? (t_cpuURegValue)offs : 4;
+  hart->pc += 4;
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteJALR(uint32_t instr)
+t_cpuStatus cpuExecuteCSR(t_cpuHart *hart, uint32_t instr)
 {
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_I_IMM12_SEXT(instr);
   t_cpuRegID rd = ISA_INST_RD(instr);
   t_cpuRegID rs1 = ISA_INST_RS1(instr);
-  if (ISA_INST_FUNCT3(instr) != 0)
-    return CPU_STATUS_ILL_INST_FAULT;
-  cpuRegs[rd] = cpuPC + 4;
-  // clear bit zero as suggested by the spec
-  cpuPC = (cpuRegs[rs1] + (t_cpuURegValue)offs) & ~(t_cpuURegValue)1;
+  t_cpuURegValue csrValue;
+
+  switch (ISA_INST_I_IMM12(instr)) {
+    // There is no timing model: every instruction takes one cycle.
+    case CPU_CSR_CYCLE:
+    case CPU_CSR_INSTRET:
+      csrValue = (t_cpuURegValue)hart->instret;
+      break;
+    case CPU_CSR_CYCLEH:
+    case CPU_CSR_INSTRETH:
+      csrValue = (t_cpuURegValue)(hart->instret >> 32);
+      break;
+    case CPU_CSR_MHARTID:
+      csrValue = hart->hartID;
+      break;
+    default:
+      return CPU_STATUS_ILL_INST_FAULT;
+  }
+
+  // All implemented CSRs are read-only. CSRRS and CSRRC (and their immediate
+  // variants) with x0 or a zero immediate do not write the CSR.
+  switch (ISA_INST_FUNCT3(instr)) {
+    case 2: /* CSRRS */
+    case 3: /* CSRRC */
+    case 6: /* CSRRSI */
+    case 7: /* CSRRCI */
+      if (rs1 != 0)
+        return CPU_STATUS_ILL_INST_FAULT;
+      break;
+    default: /* CSRRW / CSRRWI */
+      return CPU_STATUS_ILL_INST_FAULT;
+  }
+
+  hart->regs[rd] = csrValue;
+  hart->pc += 4;
   return CPU_STATUS_OK;
 }
 
-t_cpuStatus cpuExecuteJAL(uint32_t instr)
+t_cpuStatus cpuExecuteAMO(t_cpuHart *hart, t_isaInstrID id, uint32_t instr)
 {
-  t_cpuSRegValue offs = (t_cpuSRegValue)ISA_INST_J_IMM21_SEXT(instr);
   t_cpuRegID rd = ISA_INST_RD(instr);
-  cpuRegs[rd] = cpuPC + 4;
-  cpuPC += (t_cpuURegValue)offs;
-  return CPU_STATUS_OK;
-}
+  t_cpuRegID rs1 = ISA_INST_RS1(instr);
+  t_cpuRegID rs2 = ISA_INST_RS2(instr);
+  t_memAddress addr = hart->regs[rs1];
 
-t_cpuStatus cpuExecuteSYSTEM(uint32_t instr)
-{
-  if (ISA_INST_FUNCT3(instr) != 0)
-    return CPU_STATUS_ILL_INST_FAULT;
-  if (ISA_INST_I_IMM12(instr) == 0)
-    return CPU_STATUS_ECALL_TRAP;
-  if (ISA_INST_I_IMM12(instr) == 1)
-    return CPU_STATUS_EBREAK_TRAP;
-  return CPU_STATUS_ILL_INST_FAULT;
+  // Since all atomic memory operations are sequentially consistent, the aq
+  // and rl bits are ignored.
+  uint32_t tmp32;
+  bool success;
+  t_memAtomicOp op;
+  t_memError memStatus;
+  switch (id) {
+    case ISA_INSTR_LR_W:
+      // The reservation is made before loading the word, so that any store
+      // made after the load clears it.
+      if ((addr & 3) == 0)
+        cpuAcquireReservation(hart, addr);
+      memStatus = memAtomic32(addr, MEM_ATOMIC_LOAD, 0, &tmp32);
+      if (memStatus != MEM_NO_ERROR)
+        return CPU_STATUS_MEMORY_FAULT;
+      hart->reservationValue = tmp32;
+      hart->regs[rd] = tmp32;
+      hart->pc += 4;
+      return CPU_STATUS_OK;
+
+    case ISA_INSTR_SC_W:
+      // The word is also compared with the value loaded by LR.W, which catches
+      // the stores made by other harts while SC.W is being executed.
+      success = false;
+      if (cpuReleaseReservation(hart) == addr) {
+        memStatus = memCompareExchange32(
+            addr, hart->reservationValue, hart->regs[rs2], &success);
+        if (memStatus != MEM_NO_ERROR)
+          return CPU_STATUS_MEMORY_FAULT;
+        if (success)
+          cpuClearReservations(addr, 4);
+      } else {
+        // Still check that the address is valid for an atomic access.
+        memStatus = memAtomic32(addr, MEM_ATOMIC_LOAD, 0, &tmp32);
+        if (memStatus != MEM_NO_ERROR)
+          return CPU_STATUS_MEMORY_FAULT;
+      }
+      hart->regs[rd] = success ? 0 : 1;
+      hart->pc += 4;
+      return CPU_STATUS_OK;
+
+    case ISA_INSTR_AMOSWAP_W:
+      op = MEM_ATOMIC_SWAP;
+      break;
+    case ISA_INSTR_AMOADD_W:
+      op = MEM_ATOMIC_ADD;
+      break;
+    case ISA_INSTR_AMOXOR_W:
+      op = MEM_ATOMIC_XOR;
+      break;
+    case ISA_INSTR_AMOAND_W:
+      op = MEM_ATOMIC_AND;
+      break;
+    case ISA_INSTR_AMOOR_W:
+      op = MEM_ATOMIC_OR;
+      break;
+    case ISA_INSTR_AMOMIN_W:
+      op = MEM_ATOMIC_MIN;
+      break;
+    case ISA_INSTR_AMOMAX_W:
+      op = MEM_ATOMIC_MAX;
+      break;
+    case ISA_INSTR_AMOMINU_W:
+      op = MEM_ATOMIC_MINU;
+      break;
+    case ISA_INSTR_AMOMAXU_W:
+      op = MEM_ATOMIC_MAXU;
+      break;
+    default:
+      return CPU_STATUS_ILL_INST_FAULT;
+  }
+
+  memStatus = memAtomic32(addr, op, hart->regs[rs2], &tmp32);
+  if (memStatus != MEM_NO_ERROR)
+    return CPU_STATUS_MEMORY_FAULT;
+  cpuClearReservations(addr, 4);
+  hart->regs[rd] = tmp32;
+  hart->pc += 4;
+  return CPU_STATUS_OK;
 }
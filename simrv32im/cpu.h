@@ -1,8 +1,13 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "isa.h"
 
+#define CPU_N_REGS 32
+#define CPU_MAX_HARTS 64
+
 typedef int t_cpuStatus;
 enum {
   CPU_STATUS_OK = 0,
@@ -12,11 +17,56 @@ enum {
   CPU_STATUS_EBREAK_TRAP = -4
 };
 
+/* Number of entries of the cache of decoded instructions of each hart, which
+ * must be a power of two. */
+#define CPU_DECODE_CACHE_SIZE 4096
+
+typedef struct {
+  t_cpuURegValue pc;
+  uint32_t instr;
+  uint64_t generation;
+  /* Immediate operand, sign-extended or shifted as required. */
+  t_cpuURegValue imm;
+  uint8_t id;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  bool writesMemory;
+  /* Set when the instruction is first executed as the leader of a basic
+   * block, after reporting it to the coverage tracker. */
+  bool blockSeen;
+} t_cpuDecodedInstr;
+
+typedef struct t_cpuHart {
+  t_cpuURegValue regs[CPU_N_REGS];
+  t_cpuURegValue pc;
+  t_cpuStatus lastStatus;
+  t_cpuURegValue hartID;
+  uint32_t reservationValue;
+  uint64_t instret;
+  bool atBlockStart;
+  /* Set by the sampled simulation while the hart runs one of the intervals
+   * which it times. */
+  bool sampleCycles;
+  t_cpuDecodedInstr decodeCache[CPU_DECODE_CACHE_SIZE];
+} t_cpuHart;
+
+t_cpuHart *cpuNewHart(t_cpuURegValue hartID);
+void cpuDeleteHart(t_cpuHart *hart);
+void cpuSetCurrentHart(t_cpuHart *hart);
+t_cpuHart *cpuGetCurrentHart(void);
+
 t_cpuURegValue cpuGetRegister(t_cpuRegID reg);
 void cpuSetRegister(t_cpuRegID reg, t_cpuURegValue value);
 
 void cpuReset(t_cpuURegValue pcValue);
 t_cpuStatus cpuTick(void);
+t_cpuStatus cpuRun(uint64_t endInstret);
 t_cpuStatus cpuClearLastFault(void);
 
+void cpuSetBlockTracking(bool enabled);
+void cpuSetLoopTracking(bool enabled);
+void cpuSetValueProfiling(bool enabled);
+void cpuSetInstrProfiling(bool enabled);
+
 #endif
@@ -120,6 +120,7 @@ static inline uint32_t bits32(uint32_t x, int a, int b)
 #define ISA_INST_RS1(x) BITS(x, 15, 20)
 #define ISA_INST_RS2(x) BITS(x, 20, 25)
 #define ISA_INST_FUNCT7(x) BITS(x, 25, 32)
+#define ISA_INST_FUNCT5(x) BITS(x, 27, 32)
 #define ISA_INST_I_IMM12(x) BITS(x, 20, 32)
 #define ISA_INST_I_IMM12_SEXT(x) SEXT(ISA_INST_I_IMM12(x), 12)
 #define ISA_INST_S_IMM12(x) (BITS(x, 7, 12) | (BITS(x, 25, 32) << 5))
@@ -140,6 +141,7 @@ static inline uint32_t bits32(uint32_t x, int a, int b)
 #define ISA_INST_OPCODE_OPIMM ISA_INST_OPCODE_CODE(0x04)
 #define ISA_INST_OPCODE_AUIPC ISA_INST_OPCODE_CODE(0x05)
 #define ISA_INST_OPCODE_STORE ISA_INST_OPCODE_CODE(0x08)
+#define ISA_INST_OPCODE_AMO ISA_INST_OPCODE_CODE(0x0B)
 #define ISA_INST_OPCODE_OP ISA_INST_OPCODE_CODE(0x0C)
 #define ISA_INST_OPCODE_LUI ISA_INST_OPCODE_CODE(0x0D)
 #define ISA_INST_OPCODE_BRANCH ISA_INST_OPCODE_CODE(0x18)
@@ -147,6 +149,61 @@ static inline uint32_t bits32(uint32_t x, int a, int b)
 #define ISA_INST_OPCODE_JAL ISA_INST_OPCODE_CODE(0x1B)
 #define ISA_INST_OPCODE_SYSTEM ISA_INST_OPCODE_CODE(0x1C)
 
+/* The instruction identifiers (ISA_INSTR_*) and the tables below are generated
+ * from the ISA description in isa/rv32im.isa. */
+#include "isa_instrs.h"
+
+typedef int t_isaFormat;
+enum {
+  ISA_FORMAT_ILLEGAL = 0,
+  ISA_FORMAT_R,    // rd, rs1, rs2
+  ISA_FORMAT_ISH,  // rd, rs1, shamt
+  ISA_FORMAT_I,    // rd, rs1, imm
+  ISA_FORMAT_IL,   // rd, imm(rs1)
+  ISA_FORMAT_S,    // rs2, imm(rs1)
+  ISA_FORMAT_B,    // rs1, rs2, offset
+  ISA_FORMAT_U,    // rd, imm20
+  ISA_FORMAT_J,    // rd, offset
+  ISA_FORMAT_SYS,  // no operands
+  ISA_FORMAT_CSR,  // rd, csr, rs1
+  ISA_FORMAT_CSRI, // rd, csr, uimm5
+  ISA_FORMAT_AMO,  // rd, rs2, (rs1)
+  ISA_FORMAT_LR    // rd, (rs1)
+};
+
+typedef struct {
+  const char *mnemonic;
+  t_isaFormat format;
+  uint32_t mask;  // bits that identify the instruction
+  uint32_t match; // value of those bits
+} t_isaInstrInfo;
+
+/* Instructions are decoded with a lookup in isaDecodeTable. The major opcode
+ * (bits 2-6) selects a group, which gives the position of its entries in the
+ * table and the field used with funct3 to index them (funct7, rs2 or none).
+ * The instruction found is then checked against its mask and match, which
+ * rejects any encoding not covered by the index. */
+typedef struct {
+  uint16_t base;
+  uint8_t shift;
+  uint8_t mask;
+} t_isaDecodeGroup;
+
+extern const t_isaInstrInfo isaInstrs[ISA_INSTR_COUNT];
+extern const t_isaDecodeGroup isaDecodeGroups[32];
+extern const uint8_t isaDecodeTable[];
+
+static inline t_isaInstrID isaDecode(uint32_t instr)
+{
+  const t_isaDecodeGroup *group = &isaDecodeGroups[BITS(instr, 2, 7)];
+  uint32_t key = ISA_INST_FUNCT3(instr) |
+      (((instr >> group->shift) & group->mask) << 3);
+  t_isaInstrID id = isaDecodeTable[group->base + key];
+  if ((instr & isaInstrs[id].mask) != isaInstrs[id].match)
+    return ISA_INSTR_ILLEGAL;
+  return id;
+}
+
 
 int isaDisassemble(uint32_t instr, char *out, size_t bufsz);
 
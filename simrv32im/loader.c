@@ -1,46 +1,112 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include "cpu.h"
 #include "loader.h"
 #include "debugger.h"
+#include "coverage.h"
+#include "symbols.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#define LDR_USE_MMAP
+#endif
+
+/* Maximum size of a raw binary which is read in memory when it cannot be
+ * mapped directly from the file. */
+#define LDR_MAX_READ_SIZE ((off_t)0x8000000)
+
+
+#ifdef LDR_USE_MMAP
+/* Maps `fileSize` bytes at `offset` in the file, followed by zeros up to
+ * `memSize` bytes, at guest address `base`. The file is mapped copy-on-write,
+ * so that only the pages modified by the program are copied, and the zeros
+ * are anonymous memory which is only allocated when touched. The caller must
+ * ensure that the file contains the requested range. */
+static t_ldrError ldrMapFile(FILE *fp, off_t offset, t_memSize fileSize,
+    t_memAddress base, t_memSize memSize)
+{
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t pageOffset = (size_t)(offset % (off_t)pageSize);
+  size_t mapSize = pageOffset + (size_t)memSize;
+
+  // Reserve the whole range first, then replace the beginning with the file
+  uint8_t *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return LDR_MEMORY_ERROR;
+  if (fileSize > 0) {
+    size_t fileMapSize = pageOffset + (size_t)fileSize;
+    if (mmap(map, fileMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+            fileno(fp), offset - (off_t)pageOffset) == MAP_FAILED)
+      goto fail;
+    // The last page mapped from the file may contain the data which follows
+    // the segment in the file, where the program expects zeros.
+    size_t clearEnd = (fileMapSize + pageSize - 1) / pageSize * pageSize;
+    if (clearEnd > mapSize)
+      clearEnd = mapSize;
+    if (clearEnd > fileMapSize)
+      memset(map + fileMapSize, 0, clearEnd - fileMapSize);
+  }
+  if (memMapHostArea(base, memSize, map + pageOffset) != MEM_NO_ERROR)
+    goto fail;
+  return LDR_NO_ERROR;
+
+fail:
+  munmap(map, mapSize);
+  return LDR_MEMORY_ERROR;
+}
+#endif
 
 
 t_ldrError ldrLoadBinary(
     const char *path, t_memAddress baseAddr, t_memAddress entry)
 {
-  dbgPrintf("Loading raw binary file \"%s\" at address %" PRIu32 "\n", path);
+  t_ldrError res = LDR_NO_ERROR;
+
+  dbgPrintf("Loading raw binary file \"%s\" at address %" PRIu32 "\n", path,
+      baseAddr);
 
   FILE *fp = fopen(path, "rb");
   if (fp == NULL)
     return LDR_FILE_ERROR;
 
-  if (fseek(fp, 0, SEEK_END) < 0)
-    return LDR_FILE_ERROR;
+  if (fseeko(fp, 0, SEEK_END) < 0)
+    goto read_error;
   off_t fpos = ftello(fp);
-  if (fpos < 0 || fpos > (size_t)0x8000000) {
-    fclose(fp);
-    return LDR_FILE_ERROR;
-  }
+  // The image must fit in the address space after the load address (an area
+  // cannot end at 2^32). This is checked before the size is converted to a
+  // t_memSize, which would truncate it.
+  if (fpos < 0 || (uint64_t)fpos > (uint64_t)(0xFFFFFFFF - baseAddr))
+    goto read_error;
   t_memSize size = (t_memSize)fpos;
-  if (fseek(fp, 0, SEEK_SET) < 0) {
-    fclose(fp);
-    return LDR_FILE_ERROR;
-  }
 
+#ifdef LDR_USE_MMAP
+  if (ldrMapFile(fp, 0, size, baseAddr, size) == LDR_NO_ERROR)
+    goto done;
+#endif
+  if (fpos > LDR_MAX_READ_SIZE)
+    goto read_error;
+  if (fseeko(fp, 0, SEEK_SET) < 0)
+    goto read_error;
   uint8_t *buf;
   if (memMapArea(baseAddr, size, &buf) != MEM_NO_ERROR) {
-    fclose(fp);
-    return LDR_MEMORY_ERROR;
-  }
-  if (fread(buf, size, 1, fp) < 1) {
-    fclose(fp);
-    return LDR_FILE_ERROR;
+    res = LDR_MEMORY_ERROR;
+    goto cleanup;
   }
+  if (size > 0 && fread(buf, size, 1, fp) < 1)
+    goto read_error;
 
+done:
   cpuReset(entry);
-
+  goto cleanup;
+read_error:
+  res = LDR_FILE_ERROR;
+cleanup:
   fclose(fp);
-  return LDR_NO_ERROR;
+  return res;
 }
 
 
@@ -96,6 +162,8 @@ typedef struct __attribute__((packed)) Elf32_Ehdr {
 #define PT_LOAD 1 /* Loadable segment */
 #define PT_NOTE 4 /* Target-dependent auxiliary information */
 
+#define PF_X 0x1 /* Program segment eXecute flag */
+
 typedef struct __attribute__((packed)) Elf32_Phdr {
   Elf32_Word p_type;
   Elf32_Off p_offset;
@@ -107,6 +175,177 @@ typedef struct __attribute__((packed)) Elf32_Phdr {
   Elf32_Word p_align;
 } Elf32_Phdr;
 
+typedef struct __attribute__((packed)) Elf32_Shdr {
+  Elf32_Word sh_name;
+  Elf32_Word sh_type;
+  Elf32_Word sh_flags;
+  Elf32_Addr sh_addr;
+  Elf32_Off sh_offset;
+  Elf32_Word sh_size;
+  Elf32_Word sh_link;
+  Elf32_Word sh_info;
+  Elf32_Word sh_addralign;
+  Elf32_Word sh_entsize;
+} Elf32_Shdr;
+
+/* Entry of the .srclines section produced by asrv32im. The file name is an
+ * offset in the section name string table. */
+typedef struct __attribute__((packed)) t_ldrSrcLine {
+  Elf32_Addr address;
+  Elf32_Word file;
+  Elf32_Word line;
+} t_ldrSrcLine;
+
+static t_ldrError ldrReadSection(
+    FILE *fp, Elf32_Ehdr *header, Elf32_Half idx, Elf32_Shdr *out)
+{
+  off_t offset = (off_t)header->e_shoff + (off_t)idx * header->e_shentsize;
+  if (fseeko(fp, offset, SEEK_SET) < 0)
+    return LDR_FILE_ERROR;
+  if (fread(out, sizeof(Elf32_Shdr), 1, fp) < 1)
+    return LDR_FILE_ERROR;
+  return LDR_NO_ERROR;
+}
+
+static void *ldrReadSectionContent(FILE *fp, Elf32_Shdr *section)
+{
+  // One more zero byte to guarantee the termination of string tables
+  char *buf = calloc(section->sh_size + 1, sizeof(char));
+  if (buf == NULL)
+    return NULL;
+  if (fseeko(fp, (off_t)section->sh_offset, SEEK_SET) < 0 ||
+      (section->sh_size > 0 && fread(buf, section->sh_size, 1, fp) < 1)) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+#define SHT_SYMTAB 2 /* Symbol table */
+
+typedef struct __attribute__((packed)) Elf32_Sym {
+  Elf32_Word st_name;
+  Elf32_Addr st_value;
+  Elf32_Word st_size;
+  unsigned char st_info;
+  unsigned char st_other;
+  Elf32_Half st_shndx;
+} Elf32_Sym;
+
+#define STT_NOTYPE 0  /* Symbol type not specified */
+#define STT_OBJECT 1  /* Data object */
+#define STT_FUNC 2    /* Code object */
+#define ELF32_ST_TYPE(i) ((i) & 0xf)
+
+/* Passes the labels in the symbol table to the symbol module. */
+static t_ldrError ldrLoadSymbols(
+    FILE *fp, Elf32_Ehdr *header, Elf32_Shdr *symtabHdr)
+{
+  t_ldrError res = LDR_NO_ERROR;
+  char *strtab = NULL;
+  Elf32_Sym *syms = NULL;
+
+  if (symtabHdr->sh_link >= header->e_shnum)
+    goto invalid_file;
+  Elf32_Shdr strtabHdr;
+  res = ldrReadSection(fp, header, (Elf32_Half)symtabHdr->sh_link, &strtabHdr);
+  if (res != LDR_NO_ERROR)
+    goto cleanup;
+  strtab = ldrReadSectionContent(fp, &strtabHdr);
+  syms = ldrReadSectionContent(fp, symtabHdr);
+  if (strtab == NULL || syms == NULL)
+    goto read_error;
+
+  size_t n = symtabHdr->sh_size / sizeof(Elf32_Sym);
+  for (size_t i = 0; i < n; i++) {
+    Elf32_Word type = ELF32_ST_TYPE(syms[i].st_info);
+    if (syms[i].st_shndx == 0 || syms[i].st_name == 0 ||
+        (type != STT_NOTYPE && type != STT_OBJECT && type != STT_FUNC))
+      continue;
+    if (syms[i].st_name >= strtabHdr.sh_size)
+      goto invalid_file;
+    if (symAddLabel(syms[i].st_value, strtab + syms[i].st_name) !=
+        SYM_NO_ERROR)
+      goto mem_error;
+  }
+
+  goto cleanup;
+mem_error:
+  res = LDR_MEMORY_ERROR;
+  goto cleanup;
+read_error:
+  res = LDR_FILE_ERROR;
+  goto cleanup;
+invalid_file:
+  res = LDR_INVALID_FORMAT;
+cleanup:
+  free(strtab);
+  free(syms);
+  return res;
+}
+
+/* Passes the labels in the symbol table and the mapping from code addresses
+ * to source lines found in the .srclines section, if any, to the symbol
+ * module. */
+static t_ldrError ldrLoadDebugInfo(FILE *fp, Elf32_Ehdr *header)
+{
+  t_ldrError res = LDR_NO_ERROR;
+  char *strtab = NULL;
+  t_ldrSrcLine *lines = NULL;
+
+  if (header->e_shnum == 0 || header->e_shstrndx >= header->e_shnum)
+    return LDR_NO_ERROR;
+  Elf32_Shdr strtabHdr;
+  res = ldrReadSection(fp, header, header->e_shstrndx, &strtabHdr);
+  if (res != LDR_NO_ERROR)
+    goto cleanup;
+  strtab = ldrReadSectionContent(fp, &strtabHdr);
+  if (strtab == NULL)
+    goto read_error;
+
+  for (Elf32_Half shi = 0; shi < header->e_shnum; shi++) {
+    Elf32_Shdr section;
+    res = ldrReadSection(fp, header, shi, &section);
+    if (res != LDR_NO_ERROR)
+      goto cleanup;
+    if (section.sh_type == SHT_SYMTAB) {
+      res = ldrLoadSymbols(fp, header, &section);
+      if (res != LDR_NO_ERROR)
+        goto cleanup;
+      continue;
+    }
+    if (section.sh_name >= strtabHdr.sh_size ||
+        strcmp(strtab + section.sh_name, ".srclines") != 0 || lines != NULL)
+      continue;
+
+    lines = ldrReadSectionContent(fp, &section);
+    if (lines == NULL)
+      goto read_error;
+    size_t n = section.sh_size / sizeof(t_ldrSrcLine);
+    for (size_t i = 0; i < n; i++) {
+      if (lines[i].file >= strtabHdr.sh_size)
+        goto invalid_file;
+      if (symAddSourceLine(lines[i].address, strtab + lines[i].file,
+              (int)lines[i].line) != SYM_NO_ERROR)
+        goto mem_error;
+    }
+  }
+
+  goto cleanup;
+mem_error:
+  res = LDR_MEMORY_ERROR;
+  goto cleanup;
+read_error:
+  res = LDR_FILE_ERROR;
+  goto cleanup;
+invalid_file:
+  res = LDR_INVALID_FORMAT;
+cleanup:
+  free(strtab);
+  free(lines);
+  return res;
+}
+
 t_ldrError ldrLoadELF(const char *path)
 {
   t_ldrError res = LDR_NO_ERROR;
@@ -130,6 +369,12 @@ t_ldrError ldrLoadELF(const char *path)
   if (header.e_machine != EM_RISCV)
     goto invalid_arch;
 
+  if (fseeko(fp, 0, SEEK_END) < 0)
+    goto read_error;
+  off_t fileSize = ftello(fp);
+  if (fileSize < 0)
+    goto read_error;
+
   off_t phnum = header.e_phnum;
   off_t phoff = header.e_phoff;
   off_t phentsize = header.e_phentsize;
@@ -148,18 +393,35 @@ t_ldrError ldrLoadELF(const char *path)
               ") to 0x%08" PRIx32 " (size=0x%08" PRIx32 ")\n",
         segment.p_offset, segment.p_filesz, segment.p_vaddr, segment.p_memsz);
     if (segment.p_memsz > 0) {
-      uint8_t *buf;
-      if (memMapArea(segment.p_vaddr, segment.p_memsz, &buf) != MEM_NO_ERROR)
-        goto mem_error;
-      if (segment.p_filesz > 0) {
-        fseeko(fp, (off_t)segment.p_offset, SEEK_SET);
-        size_t readsz = MIN(segment.p_memsz, segment.p_filesz);
-        if (fread(buf, readsz, 1, fp) < 1)
-          goto read_error;
+      t_memSize filesz = MIN(segment.p_memsz, segment.p_filesz);
+      if ((off_t)segment.p_offset + (off_t)filesz > fileSize)
+        goto read_error;
+      t_ldrError mapErr = LDR_MEMORY_ERROR;
+#ifdef LDR_USE_MMAP
+      mapErr = ldrMapFile(fp, (off_t)segment.p_offset, filesz,
+          segment.p_vaddr, segment.p_memsz);
+#endif
+      if (mapErr != LDR_NO_ERROR) {
+        uint8_t *buf;
+        if (memMapArea(segment.p_vaddr, segment.p_memsz, &buf) !=
+            MEM_NO_ERROR)
+          goto mem_error;
+        if (filesz > 0) {
+          fseeko(fp, (off_t)segment.p_offset, SEEK_SET);
+          if (fread(buf, filesz, 1, fp) < 1)
+            goto read_error;
+        }
       }
+      if (covGetEnabled() && (segment.p_flags & PF_X) &&
+          covAddCodeRange(segment.p_vaddr, segment.p_memsz) != COV_NO_ERROR)
+        goto mem_error;
     }
   }
 
+  res = ldrLoadDebugInfo(fp, &header);
+  if (res != LDR_NO_ERROR)
+    goto cleanup;
+
   dbgPrintf("Setting the entry point to 0x%" PRIx32 "\n", header.e_entry);
   cpuReset(header.e_entry);
 
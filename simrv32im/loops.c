@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "loops.h"
+#include "symbols.h"
+
+/* Loops are detected at runtime from taken backward branches and jumps: the
+ * target of a back edge is the head of a loop, and the loop extends from the
+ * head to the farthest back edge seen so far. A loop is exited when control
+ * is transferred outside of this range at the same call depth, or when the
+ * function containing it returns.
+ *   A loop is recognized at its first back edge, either taken or not, so the
+ * time it was entered is recovered from a short history of recent control
+ * transfers, looking for the last one which landed outside the loop. Once
+ * known, a loop is also entered whenever its head is executed from outside,
+ * and left when the code falls through past its last back edge, so that
+ * entries which do not reach any back edge are counted too.
+ *   For every loop the report lists the instructions executed from entry to
+ * exit (including nested loops and calls), the number of entries and the
+ * distribution of the iterations, that is the number of times the head of the
+ * loop is executed per entry: one more than the back edges taken if the loop
+ * is entered from its head, as many as the back edges otherwise.
+ *   Only the boot hart is profiled. */
+
+#define LOOP_HISTORY_SIZE 256
+#define LOOP_HIST_BUCKETS 65
+
+typedef struct {
+  t_memAddress head;
+  t_memAddress tail;
+  uint64_t instructions;
+  uint64_t entries;
+  uint64_t iterations;
+  uint64_t minTrips;
+  uint64_t maxTrips;
+  /* Bucket 0 counts the entries without iterations, bucket i > 0 those with
+   * a number of iterations in [2^(i-1), 2^i). */
+  uint64_t histogram[LOOP_HIST_BUCKETS];
+} t_loopInfo;
+
+typedef struct {
+  t_loopInfo *loop;
+  uint64_t entryInstret;
+  uint64_t trips;
+  int depth;
+  /* Length of the history up to the transfer which entered the loop. */
+  uint64_t entryKeep;
+} t_loopActive;
+
+/* Destination of a control transfer, and number of instructions retired
+ * before the instruction at that address. */
+typedef struct {
+  t_memAddress pc;
+  uint64_t instret;
+  int depth;
+} t_loopArrival;
+
+bool loopEnabled = false;
+t_cpuHart *loopHart = NULL;
+bool loopOutOfMemory = false;
+
+/* Open addressing hash table from loop heads to loops, and the same loops
+ * sorted by head. */
+t_loopInfo **loopTable = NULL;
+uint32_t loopTableSize = 0;
+uint32_t loopCount = 0;
+t_loopInfo **loopByHead = NULL;
+
+t_loopActive *loopStack = NULL;
+int loopStackDepth = 0;
+int loopStackSize = 0;
+int loopCallDepth = 0;
+
+/* Circular buffer of the last transfers, loopHistory[seq % size]. */
+t_loopArrival loopHistory[LOOP_HISTORY_SIZE];
+uint64_t loopHistorySeq = 0;
+
+
+void loopEnable(void)
+{
+  loopEnabled = true;
+  cpuSetLoopTracking(true);
+}
+
+
+bool loopGetEnabled(void)
+{
+  return loopEnabled;
+}
+
+
+static uint32_t loopHash(t_memAddress addr)
+{
+  return (addr >> 2) * 0x9E3779B1u;
+}
+
+static bool loopGrowTable(void)
+{
+  uint32_t newSize = loopTableSize ? loopTableSize * 2 : 256;
+  t_loopInfo **newByHead =
+      realloc(loopByHead, sizeof(t_loopInfo *) * (newSize / 2));
+  if (newByHead == NULL)
+    return false;
+  loopByHead = newByHead;
+  t_loopInfo **newTable = calloc(newSize, sizeof(t_loopInfo *));
+  if (newTable == NULL)
+    return false;
+  for (uint32_t i = 0; i < loopTableSize; i++) {
+    if (loopTable[i] == NULL)
+      continue;
+    uint32_t slot = loopHash(loopTable[i]->head) & (newSize - 1);
+    while (newTable[slot] != NULL)
+      slot = (slot + 1) & (newSize - 1);
+    newTable[slot] = loopTable[i];
+  }
+  free(loopTable);
+  loopTable = newTable;
+  loopTableSize = newSize;
+  return true;
+}
+
+/* Returns the index in loopByHead of the first loop with head >= `addr`. */
+static uint32_t loopFindHead(t_memAddress addr)
+{
+  uint32_t lo = 0, hi = loopCount;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (loopByHead[mid]->head < addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static t_loopInfo *loopGet(t_memAddress head)
+{
+  // Keep the load of the hash table under 50%
+  if ((loopCount + 1) * 2 > loopTableSize && !loopGrowTable())
+    return NULL;
+  uint32_t slot = loopHash(head) & (loopTableSize - 1);
+  for (; loopTable[slot] != NULL; slot = (slot + 1) & (loopTableSize - 1)) {
+    if (loopTable[slot]->head == head)
+      return loopTable[slot];
+  }
+
+  t_loopInfo *loop = calloc(1, sizeof(t_loopInfo));
+  if (loop == NULL)
+    return NULL;
+  loop->head = loop->tail = head;
+  loop->minTrips = UINT64_MAX;
+  loopTable[slot] = loop;
+  uint32_t pos = loopFindHead(head);
+  memmove(&loopByHead[pos + 1], &loopByHead[pos],
+      sizeof(t_loopInfo *) * (loopCount - pos));
+  loopByHead[pos] = loop;
+  loopCount++;
+  return loop;
+}
+
+
+static bool loopContains(t_loopInfo *loop, t_memAddress addr)
+{
+  return loop->head <= addr && addr <= loop->tail;
+}
+
+/* Returns the number of instructions retired when the range of `loop` was
+ * last entered at the current call depth. `now` is the time of the transfer
+ * being processed, which is not in the history yet. *outKeep is set to the
+ * length of the history up to the transfer which entered the loop, or to
+ * zero if it is not known. *outAtHead is set if the loop was entered from its
+ * head. */
+static uint64_t loopFindEntry(
+    t_loopInfo *loop, uint64_t now, uint64_t *outKeep, bool *outAtHead)
+{
+  uint64_t next = now;
+  t_memAddress nextPc = loop->head;
+  uint64_t seq = loopHistorySeq;
+  uint64_t oldest = seq > LOOP_HISTORY_SIZE ? seq - LOOP_HISTORY_SIZE : 0;
+
+  *outKeep = 0;
+  for (; seq > oldest; seq--) {
+    t_loopArrival *arr = &loopHistory[(seq - 1) % LOOP_HISTORY_SIZE];
+    if (arr->depth < loopCallDepth)
+      break;
+    if (arr->depth == loopCallDepth && !loopContains(loop, arr->pc)) {
+      *outKeep = seq + 1;
+      // The code from arr->pc was executed sequentially up to the next
+      // transfer. If it reached the head, the loop was entered there,
+      // otherwise the next transfer jumped inside the loop.
+      t_memAddress end = arr->pc + (t_memAddress)(next - arr->instret) * 4;
+      if (arr->pc < loop->head && end > loop->head) {
+        *outAtHead = true;
+        return arr->instret + (loop->head - arr->pc) / 4;
+      }
+      *outAtHead = nextPc == loop->head;
+      return next;
+    }
+    next = arr->instret;
+    nextPc = arr->pc;
+  }
+  *outAtHead = nextPc == loop->head;
+  return next;
+}
+
+static void loopRecordExit(t_loopActive *active, uint64_t instret)
+{
+  t_loopInfo *loop = active->loop;
+  loop->instructions += instret - active->entryInstret;
+  loop->entries++;
+  loop->iterations += active->trips;
+  if (active->trips < loop->minTrips)
+    loop->minTrips = active->trips;
+  if (active->trips > loop->maxTrips)
+    loop->maxTrips = active->trips;
+  int bucket = active->trips ? 64 - __builtin_clzll(active->trips) : 0;
+  loop->histogram[bucket]++;
+}
+
+static void loopPushHistory(t_memAddress pc, uint64_t instret)
+{
+  t_loopArrival *arr = &loopHistory[loopHistorySeq % LOOP_HISTORY_SIZE];
+  arr->pc = pc;
+  arr->instret = instret;
+  arr->depth = loopCallDepth;
+  loopHistorySeq++;
+}
+
+static bool loopIsActive(t_loopInfo *loop)
+{
+  for (int i = loopStackDepth - 1;
+       i >= 0 && loopStack[i].depth == loopCallDepth; i--) {
+    if (loopStack[i].loop == loop)
+      return true;
+  }
+  return false;
+}
+
+static bool loopPushActive(
+    t_loopInfo *loop, uint64_t entryInstret, uint64_t trips, uint64_t keep)
+{
+  if (loopStackDepth == loopStackSize) {
+    int newSize = loopStackSize * 2 + 16;
+    t_loopActive *newStack = realloc(loopStack, sizeof(t_loopActive) * newSize);
+    if (newStack == NULL) {
+      loopOutOfMemory = true;
+      return false;
+    }
+    loopStack = newStack;
+    loopStackSize = newSize;
+  }
+  t_loopActive *top = &loopStack[loopStackDepth++];
+  top->loop = loop;
+  top->entryInstret = entryInstret;
+  top->trips = trips;
+  top->depth = loopCallDepth;
+  top->entryKeep = keep;
+  return true;
+}
+
+static void loopPopActive(uint64_t instret)
+{
+  t_loopActive *top = &loopStack[--loopStackDepth];
+  loopRecordExit(top, instret);
+  // Forget the transfers within the loop, so that the entry of the loops
+  // which contain it can still be found in the history. A loop left by the
+  // transfer which entered it has nothing to forget.
+  if (top->entryKeep != 0 && top->entryKeep <= loopHistorySeq &&
+      top->entryKeep + LOOP_HISTORY_SIZE >= loopHistorySeq + 2)
+    loopHistorySeq = top->entryKeep;
+}
+
+/* Number of instructions retired when the code executed sequentially from
+ * `last` reached `addr`. */
+static uint64_t loopRunTime(const t_loopArrival *last, t_memAddress addr)
+{
+  if (addr < last->pc)
+    return last->instret;
+  return last->instret + (addr - last->pc) / 4;
+}
+
+/* Leaves the loops which the code executed sequentially from `last` up to
+ * `from` fell out of, past their last back edge. A loop whose head is
+ * `backEdge` is not left, since its back edge is being taken at `from`. */
+static void loopLeaveRun(
+    const t_loopArrival *last, t_memAddress from, const t_memAddress *backEdge)
+{
+  while (loopStackDepth > 0) {
+    t_loopInfo *loop = loopStack[loopStackDepth - 1].loop;
+    if (loopStack[loopStackDepth - 1].depth != loopCallDepth ||
+        loop->tail >= from || (backEdge && *backEdge == loop->head))
+      break;
+    loopPopActive(loopRunTime(last, loop->tail + 4));
+  }
+}
+
+/* Enters the known loops whose head was executed by the code run
+ * sequentially from `last` up to `from`. Loops which also end before `from`
+ * are left at once, with one iteration. */
+static void loopEnterRun(const t_loopArrival *last, t_memAddress from)
+{
+  for (uint32_t i = loopFindHead(last->pc);
+       i < loopCount && loopByHead[i]->head <= from; i++) {
+    t_loopInfo *loop = loopByHead[i];
+    if (loopIsActive(loop))
+      continue;
+    uint64_t entry = loopRunTime(last, loop->head);
+    if (loop->tail < from) {
+      t_loopActive active = {loop, entry, 1, loopCallDepth, 0};
+      loopRecordExit(&active, loopRunTime(last, loop->tail + 4));
+    } else if (!loopPushActive(loop, entry, 1, loopHistorySeq + 1))
+      return;
+  }
+}
+
+
+void loopControlTransfer(t_cpuHart *hart, t_memAddress from, t_memAddress to,
+    t_loopTransfer kind, uint64_t instret)
+{
+  if (hart->hartID != 0 || loopOutOfMemory)
+    return;
+  if (loopHart == NULL) {
+    // The code before the first transfer was executed sequentially from the
+    // entry point.
+    loopHart = hart;
+    loopPushHistory(from - (t_memAddress)(instret - 1) * 4, 0);
+  }
+
+  // Branches which are not taken continue with the next instruction, but
+  // their target still tells where the loop ending at them begins.
+  t_memAddress target = to;
+  if (kind == LOOP_XFER_NOT_TAKEN)
+    to = from + 4;
+  bool backEdge = target <= from && kind != LOOP_XFER_CALL &&
+      kind != LOOP_XFER_RETURN;
+
+  t_loopArrival last = loopHistory[(loopHistorySeq - 1) % LOOP_HISTORY_SIZE];
+  loopLeaveRun(&last, from, backEdge ? &target : NULL);
+  loopEnterRun(&last, from);
+  if (loopOutOfMemory)
+    return;
+
+  if (kind == LOOP_XFER_CALL) {
+    loopCallDepth++;
+    loopPushHistory(to, instret);
+    return;
+  }
+  if (kind == LOOP_XFER_RETURN) {
+    loopCallDepth--;
+    while (loopStackDepth > 0 &&
+        loopStack[loopStackDepth - 1].depth > loopCallDepth)
+      loopPopActive(instret);
+  }
+
+  t_loopInfo *loop = NULL;
+  if (backEdge) {
+    loop = loopGet(target);
+    if (loop == NULL) {
+      loopOutOfMemory = true;
+      return;
+    }
+    if (from > loop->tail)
+      loop->tail = from;
+  }
+  // A loop which ends with a branch not taken was entered even if it is not
+  // active, and is left below.
+  if (kind == LOOP_XFER_NOT_TAKEN && backEdge && !loopIsActive(loop)) {
+    uint64_t keep;
+    bool atHead;
+    uint64_t entry = loopFindEntry(loop, instret, &keep, &atHead);
+    if (!loopPushActive(loop, entry, atHead ? 1 : 0, keep))
+      return;
+  }
+
+  while (loopStackDepth > 0) {
+    t_loopActive *top = &loopStack[loopStackDepth - 1];
+    if (top->depth != loopCallDepth || loopContains(top->loop, to))
+      break;
+    loopPopActive(instret);
+  }
+
+  if (kind != LOOP_XFER_NOT_TAKEN && backEdge) {
+    t_loopActive *top =
+        loopStackDepth > 0 ? &loopStack[loopStackDepth - 1] : NULL;
+    if (top && top->loop == loop && top->depth == loopCallDepth) {
+      top->trips++;
+    } else {
+      uint64_t keep;
+      bool atHead;
+      uint64_t entry = loopFindEntry(loop, instret, &keep, &atHead);
+      if (!loopPushActive(loop, entry, atHead ? 2 : 1, keep))
+        return;
+    }
+  }
+
+  loopPushHistory(to, instret);
+}
+
+
+static int loopCompare(const void *a, const void *b)
+{
+  const t_loopInfo *la = *(t_loopInfo *const *)a;
+  const t_loopInfo *lb = *(t_loopInfo *const *)b;
+  if (la->instructions != lb->instructions)
+    return la->instructions > lb->instructions ? -1 : 1;
+  if (la->head != lb->head)
+    return la->head < lb->head ? -1 : 1;
+  return 0;
+}
+
+static void loopPrintLocation(FILE *fp, t_memAddress addr)
+{
+  t_memAddress offset;
+  const char *label = symGetLabel(addr, &offset);
+  if (label && offset == 0)
+    fprintf(fp, " %s", label);
+  else if (label)
+    fprintf(fp, " %s+0x%x", label, offset);
+  const char *file;
+  int line;
+  if (symGetSourceLine(addr, &file, &line))
+    fprintf(fp, " (%s:%d)", file, line);
+}
+
+t_loopError loopWriteReport(const char *path)
+{
+  t_loopError res = LOOP_NO_ERROR;
+  t_loopInfo **loops = NULL;
+
+  if (loopOutOfMemory)
+    return LOOP_MEMORY_ERROR;
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL)
+    return LOOP_FILE_ERROR;
+
+  // Loops still active when the program terminated end here.
+  uint64_t total = loopHart ? loopHart->instret : 0;
+  while (loopStackDepth > 0)
+    loopRecordExit(&loopStack[--loopStackDepth], total);
+
+  loops = malloc(sizeof(t_loopInfo *) * (loopCount + 1));
+  if (loops == NULL) {
+    res = LOOP_MEMORY_ERROR;
+    goto cleanup;
+  }
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < loopTableSize; i++) {
+    if (loopTable[i] != NULL)
+      loops[n++] = loopTable[i];
+  }
+  qsort(loops, n, sizeof(t_loopInfo *), loopCompare);
+
+  fprintf(fp, "%" PRIu32 " loops, %llu instructions\n", n,
+      (unsigned long long)total);
+  for (uint32_t i = 0; i < n; i++) {
+    t_loopInfo *loop = loops[i];
+    fprintf(fp, "\nloop at 0x%08x", loop->head);
+    loopPrintLocation(fp, loop->head);
+    fprintf(fp, "\n  back edge at 0x%08x", loop->tail);
+    loopPrintLocation(fp, loop->tail);
+    double percent = total ? 100.0 * (double)loop->instructions / total : 0;
+    fprintf(fp, "\n  instructions: %llu (%.2f%%)\n",
+        (unsigned long long)loop->instructions, percent);
+    fprintf(fp, "  entries: %llu\n", (unsigned long long)loop->entries);
+    fprintf(fp, "  iterations: min %llu, avg %.2f, max %llu\n",
+        (unsigned long long)loop->minTrips,
+        (double)loop->iterations / loop->entries,
+        (unsigned long long)loop->maxTrips);
+    for (int b = 0; b < LOOP_HIST_BUCKETS; b++) {
+      if (loop->histogram[b] == 0)
+        continue;
+      uint64_t lo = b ? (uint64_t)1 << (b - 1) : 0;
+      uint64_t hi = b ? lo * 2 - 1 : 0;
+      if (lo == hi)
+        fprintf(fp, "    %llu: %llu\n", (unsigned long long)lo,
+            (unsigned long long)loop->histogram[b]);
+      else
+        fprintf(fp, "    %llu-%llu: %llu\n", (unsigned long long)lo,
+            (unsigned long long)hi, (unsigned long long)loop->histogram[b]);
+    }
+  }
+  if (ferror(fp))
+    res = LOOP_FILE_ERROR;
+
+cleanup:
+  free(loops);
+  if (fclose(fp) != 0 && res == LOOP_NO_ERROR)
+    res = LOOP_FILE_ERROR;
+  return res;
+}
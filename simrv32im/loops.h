@@ -0,0 +1,33 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+
+typedef int t_loopError;
+enum {
+  LOOP_NO_ERROR = 0,
+  LOOP_MEMORY_ERROR = -1,
+  LOOP_FILE_ERROR = -2
+};
+
+typedef int t_loopTransfer;
+enum {
+  LOOP_XFER_BRANCH,
+  LOOP_XFER_NOT_TAKEN,
+  LOOP_XFER_JUMP,
+  LOOP_XFER_CALL,
+  LOOP_XFER_RETURN
+};
+
+
+void loopEnable(void);
+bool loopGetEnabled(void);
+
+void loopControlTransfer(t_cpuHart *hart, t_memAddress from, t_memAddress to,
+    t_loopTransfer kind, uint64_t instret);
+
+t_loopError loopWriteReport(const char *path);
+
+#endif
@@ -1,27 +1,56 @@
 #include <stdlib.h>
+#include <pthread.h>
 #include "memory.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#define MEM_USE_MMAP
+#endif
+
 typedef struct memArea {
   struct memArea *next;
   t_memAddress baseAddress;
+  /* Accessible size, can be changed at any time up to `capacity` by
+   * memResizeArea, hence it is read with atomic loads. */
   t_memSize extent;
+  t_memSize capacity;
   uint8_t *buffer;
+  /* One flag for each page of the area, set when an instruction is fetched
+   * from it by memFetch32. NULL until the first fetch. */
+  uint8_t *codePages;
 } t_memArea;
 
+/* The area list is read without locks by all harts. Areas are never removed,
+ * and new areas are published with a release store after being fully
+ * initialized, so readers only need acquire loads. Writers are serialized by
+ * memMapMutex. */
 t_memArea *memAreas = NULL;
+static pthread_mutex_t memMapMutex = PTHREAD_MUTEX_INITIALIZER;
+
+_Thread_local t_memAddress memLastFaultAddress = 0;
+
+/* Incremented by every write to a page holding code. It starts from 1, so
+ * that zero never matches a valid generation. */
+#define MEM_CODE_PAGE_SHIFT 12
+uint64_t memCodeGeneration = 1;
+
+/* Set when a second hart is started. Until then, stores of bytes and
+ * halfwords do not need to preserve the rest of the word atomically. */
+bool memShared = false;
 
-t_memAddress memLastFaultAddress = 0;
+
+#define MEM_AREA_ALIGN ((uintptr_t)8)
 
 
 static t_memAddress memAreaEnd(t_memArea *area)
 {
-  return area->baseAddress + area->extent;
+  return area->baseAddress + __atomic_load_n(&area->extent, __ATOMIC_RELAXED);
 }
 
 
 static t_memArea *memFindArea(t_memAddress addr, t_memSize extent, int isDbg)
 {
-  t_memArea *curArea = memAreas;
+  t_memArea *curArea = __atomic_load_n(&memAreas, __ATOMIC_ACQUIRE);
   while (curArea) {
     if (curArea->baseAddress <= addr && addr < memAreaEnd(curArea)) {
       if ((addr + extent) <= memAreaEnd(curArea))
@@ -29,7 +58,7 @@ static t_memArea *memFindArea(t_memAddress addr, t_memSize extent, int isDbg)
       else
         goto fail;
     }
-    curArea = curArea->next;
+    curArea = __atomic_load_n(&curArea->next, __ATOMIC_ACQUIRE);
   }
 
 fail:
@@ -39,14 +68,18 @@ fail:
 }
 
 
-t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer)
+static t_memError memInsertArea(t_memAddress base, t_memSize extent,
+    uint8_t *hostBuffer, uint8_t **outBuffer)
 {
-  t_memArea *prevArea = NULL;
-  t_memArea *nextArea = memAreas;
+  t_memError res = MEM_NO_ERROR;
 
   if (extent == 0)
     return MEM_NO_ERROR;
 
+  pthread_mutex_lock(&memMapMutex);
+
+  t_memArea *prevArea = NULL;
+  t_memArea *nextArea = memAreas;
   while (nextArea) {
     if ((base + extent) <= nextArea->baseAddress)
       break;
@@ -54,25 +87,127 @@ t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer)
     nextArea = nextArea->next;
   }
   if (prevArea) {
-    if (!(base >= memAreaEnd(prevArea)))
-      return MEM_EXTENT_MAPPED;
+    if (!(base >= prevArea->baseAddress + prevArea->capacity)) {
+      res = MEM_EXTENT_MAPPED;
+      goto cleanup;
+    }
   }
 
-  t_memArea *newArea = calloc(1, sizeof(t_memArea) + (size_t)extent);
-  if (!newArea)
-    return MEM_OUT_OF_MEMORY;
+  t_memArea *newArea;
+  if (hostBuffer) {
+    newArea = calloc(1, sizeof(t_memArea));
+    if (!newArea) {
+      res = MEM_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+    newArea->buffer = hostBuffer;
+  } else {
+    // The buffer is placed so that its host alignment matches the alignment
+    // of the guest addresses, which allows atomic accesses to aligned words.
+    newArea = calloc(1, sizeof(t_memArea) + MEM_AREA_ALIGN + (size_t)extent);
+    if (!newArea) {
+      res = MEM_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+    uintptr_t bufStart = (uintptr_t)newArea + sizeof(t_memArea);
+    bufStart += (base - bufStart) & (MEM_AREA_ALIGN - 1);
+    newArea->buffer = (uint8_t *)bufStart;
+  }
   newArea->baseAddress = base;
   newArea->extent = extent;
-  newArea->buffer = (uint8_t *)((void *)newArea) + sizeof(t_memArea);
+  newArea->capacity = extent;
   if (outBuffer)
     *outBuffer = newArea->buffer;
   newArea->next = nextArea;
   if (prevArea)
-    prevArea->next = newArea;
+    __atomic_store_n(&prevArea->next, newArea, __ATOMIC_RELEASE);
   else
-    memAreas = newArea;
+    __atomic_store_n(&memAreas, newArea, __ATOMIC_RELEASE);
 
-  return MEM_NO_ERROR;
+cleanup:
+  pthread_mutex_unlock(&memMapMutex);
+  return res;
+}
+
+
+t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer)
+{
+  return memInsertArea(base, extent, NULL, outBuffer);
+}
+
+
+/* Maps a buffer owned by the caller (e.g. a file mapped in memory), which
+ * must stay valid until the simulator exits. Aligned guest words must be
+ * aligned in the host as well, as required by the atomic accesses. */
+t_memError memMapHostArea(
+    t_memAddress base, t_memSize extent, uint8_t *hostBuffer)
+{
+  if (((uintptr_t)hostBuffer - base) & (sizeof(uint32_t) - 1))
+    return MEM_BAD_ALIGNMENT;
+  return memInsertArea(base, extent, hostBuffer, NULL);
+}
+
+
+/* Maps a zero-filled area whose host memory is only allocated when it is
+ * touched, so that large areas can be reserved in advance at no cost. */
+t_memError memReserveArea(t_memAddress base, t_memSize extent)
+{
+#ifdef MEM_USE_MMAP
+  if (extent == 0)
+    return MEM_NO_ERROR;
+  uint8_t *buffer = mmap(NULL, (size_t)extent, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (buffer != MAP_FAILED) {
+    t_memError res = memMapHostArea(base, extent, buffer);
+    if (res != MEM_NO_ERROR)
+      munmap(buffer, (size_t)extent);
+    return res;
+  }
+#endif
+  // Large allocations from calloc() are usually backed lazily as well.
+  return memInsertArea(base, extent, NULL, NULL);
+}
+
+
+/* Changes the accessible size of the area which starts at `base`, within the
+ * size it was mapped with. The contents beyond the new size are preserved. */
+t_memError memResizeArea(t_memAddress base, t_memSize extent)
+{
+  t_memError res = MEM_MAPPING_ERROR;
+
+  pthread_mutex_lock(&memMapMutex);
+  t_memArea *curArea = memAreas;
+  while (curArea && curArea->baseAddress < base)
+    curArea = curArea->next;
+  if (curArea && curArea->baseAddress == base && extent <= curArea->capacity) {
+    __atomic_store_n(&curArea->extent, extent, __ATOMIC_RELAXED);
+    res = MEM_NO_ERROR;
+  }
+  pthread_mutex_unlock(&memMapMutex);
+  return res;
+}
+
+
+/* Returns the end address of the highest mapped area. */
+t_memAddress memGetMappedEnd(void)
+{
+  t_memAddress end = 0;
+
+  pthread_mutex_lock(&memMapMutex);
+  for (t_memArea *curArea = memAreas; curArea; curArea = curArea->next)
+    end = curArea->baseAddress + curArea->capacity;
+  pthread_mutex_unlock(&memMapMutex);
+  return end;
+}
+
+
+static inline uint32_t memHostToLE32(uint32_t x)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap32(x);
+#else
+  return x;
+#endif
 }
 
 
@@ -102,6 +237,11 @@ t_memError memRead32(t_memAddress addr, uint32_t *out)
   if (!area)
     return MEM_MAPPING_ERROR;
   uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
+  if ((addr & 3) == 0) {
+    uint32_t *wordPtr = (uint32_t *)((void *)bufBasePtr);
+    *out = memHostToLE32(__atomic_load_n(wordPtr, __ATOMIC_RELAXED));
+    return MEM_NO_ERROR;
+  }
   *out = (uint32_t)bufBasePtr[0] + (uint32_t)((uint32_t)bufBasePtr[1] << 8) +
       (uint32_t)((uint32_t)bufBasePtr[2] << 16) +
       (uint32_t)((uint32_t)bufBasePtr[3] << 24);
@@ -109,6 +249,65 @@ t_memError memRead32(t_memAddress addr, uint32_t *out)
 }
 
 
+/* Marks the pages of the area overlapped by an access as holding code. */
+static bool memMarkCode(t_memArea *area, t_memAddress addr, t_memSize extent)
+{
+  uint8_t *codePages = __atomic_load_n(&area->codePages, __ATOMIC_ACQUIRE);
+  if (!codePages) {
+    pthread_mutex_lock(&memMapMutex);
+    codePages = area->codePages;
+    if (!codePages) {
+      codePages =
+          calloc((size_t)(area->capacity >> MEM_CODE_PAGE_SHIFT) + 1, 1);
+      __atomic_store_n(&area->codePages, codePages, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&memMapMutex);
+    if (!codePages)
+      return false;
+  }
+  t_memAddress offset = addr - area->baseAddress;
+  __atomic_store_n(
+      &codePages[offset >> MEM_CODE_PAGE_SHIFT], 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&codePages[(offset + extent - 1) >> MEM_CODE_PAGE_SHIFT], 1,
+      __ATOMIC_RELAXED);
+  return true;
+}
+
+/* Called after every write, to invalidate the instructions decoded from the
+ * memory written. */
+static void memCheckCode(t_memArea *area, t_memAddress addr, t_memSize extent)
+{
+  uint8_t *codePages = __atomic_load_n(&area->codePages, __ATOMIC_ACQUIRE);
+  if (!codePages)
+    return;
+  t_memAddress offset = addr - area->baseAddress;
+  if (__atomic_load_n(
+          &codePages[offset >> MEM_CODE_PAGE_SHIFT], __ATOMIC_RELAXED) ||
+      __atomic_load_n(&codePages[(offset + extent - 1) >> MEM_CODE_PAGE_SHIFT],
+          __ATOMIC_RELAXED))
+    __atomic_fetch_add(&memCodeGeneration, 1, __ATOMIC_RELEASE);
+}
+
+/* Reads an instruction. Every later write to the same page increments the
+ * value returned by memGetCodeGeneration(), so that the copies of the
+ * instructions read can be invalidated. Writes made by other harts are seen at
+ * the latest when the generation is read again. */
+t_memError memFetch32(t_memAddress addr, uint32_t *out)
+{
+  t_memArea *area = memFindArea(addr, 4, 0);
+  if (!area)
+    return MEM_MAPPING_ERROR;
+  if (!memMarkCode(area, addr, 4))
+    return MEM_OUT_OF_MEMORY;
+  return memRead32(addr, out);
+}
+
+uint64_t memGetCodeGeneration(void)
+{
+  return __atomic_load_n(&memCodeGeneration, __ATOMIC_ACQUIRE);
+}
+
+
 uint8_t memDebugRead8(t_memAddress addr, int *mapped)
 {
   t_memArea *area = memFindArea(addr, 1, 1);
@@ -148,18 +347,52 @@ uint32_t memDebugRead32(t_memAddress addr, int *mapped)
   uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
   if (mapped)
     *mapped = 1;
+  // The word may be written by the harts at the same time.
+  if ((addr & 3) == 0) {
+    uint32_t *wordPtr = (uint32_t *)((void *)bufBasePtr);
+    return memHostToLE32(__atomic_load_n(wordPtr, __ATOMIC_RELAXED));
+  }
   return (uint32_t)bufBasePtr[0] + ((uint32_t)bufBasePtr[1] << 8) +
       ((uint32_t)bufBasePtr[2] << 16) + ((uint32_t)bufBasePtr[3] << 24);
 }
 
 
+/* Writes the `size` lowest bytes of `in` at `addr`, within the same word. The
+ * write is a compare-and-swap on the whole word, so that it does not undo a
+ * concurrent write of another hart to the other bytes of the word with a
+ * store or an AMO. Words at the edges of unaligned areas cannot be accessed
+ * as a whole, and are written one byte at a time instead, like all words
+ * while a single hart is running. */
+static void memWriteSubword(
+    t_memArea *area, t_memAddress addr, uint32_t in, int size)
+{
+  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
+  t_memAddress wordAddr = addr & ~(t_memAddress)3;
+  if (!__atomic_load_n(&memShared, __ATOMIC_RELAXED) ||
+      wordAddr < area->baseAddress || memAreaEnd(area) - wordAddr < 4) {
+    for (int i = 0; i < size; i++)
+      bufBasePtr[i] = (uint8_t)(in >> (i * 8));
+    return;
+  }
+
+  uint32_t *wordPtr = (uint32_t *)((void *)(bufBasePtr - (addr & 3)));
+  int shift = (int)(addr & 3) * 8;
+  uint32_t mask = (size == 1 ? 0xFFu : 0xFFFFu) << shift;
+  uint32_t old = __atomic_load_n(wordPtr, __ATOMIC_RELAXED);
+  uint32_t new;
+  do {
+    new = (memHostToLE32(old) & ~mask) | ((in << shift) & mask);
+  } while (!__atomic_compare_exchange_n(wordPtr, &old, memHostToLE32(new),
+      true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 t_memError memWrite8(t_memAddress addr, uint8_t in)
 {
   t_memArea *area = memFindArea(addr, 1, 0);
   if (!area)
     return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = in;
+  memWriteSubword(area, addr, in, 1);
+  memCheckCode(area, addr, 1);
   return MEM_NO_ERROR;
 }
 
@@ -168,9 +401,15 @@ t_memError memWrite16(t_memAddress addr, uint16_t in)
   t_memArea *area = memFindArea(addr, 2, 0);
   if (!area)
     return MEM_MAPPING_ERROR;
-  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = (uint8_t)(in & 0xFF);
-  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
+  if ((addr & 3) == 3) {
+    // Crosses two words
+    uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
+    bufBasePtr[0] = (uint8_t)(in & 0xFF);
+    bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
+  } else {
+    memWriteSubword(area, addr, in, 2);
+  }
+  memCheckCode(area, addr, 2);
   return MEM_NO_ERROR;
 }
 
@@ -180,14 +419,116 @@ t_memError memWrite32(t_memAddress addr, uint32_t in)
   if (!area)
     return MEM_MAPPING_ERROR;
   uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
-  bufBasePtr[0] = (uint8_t)(in & 0xFF);
-  bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
-  bufBasePtr[2] = (uint8_t)((in >> 16) & 0xFF);
-  bufBasePtr[3] = (uint8_t)((in >> 24) & 0xFF);
+  if ((addr & 3) == 0) {
+    uint32_t *wordPtr = (uint32_t *)((void *)bufBasePtr);
+    __atomic_store_n(wordPtr, memHostToLE32(in), __ATOMIC_RELAXED);
+  } else {
+    bufBasePtr[0] = (uint8_t)(in & 0xFF);
+    bufBasePtr[1] = (uint8_t)((in >> 8) & 0xFF);
+    bufBasePtr[2] = (uint8_t)((in >> 16) & 0xFF);
+    bufBasePtr[3] = (uint8_t)((in >> 24) & 0xFF);
+  }
+  memCheckCode(area, addr, 4);
   return MEM_NO_ERROR;
 }
 
 
+static uint32_t *memFindAtomicWord(t_memAddress addr, t_memArea **outArea)
+{
+  if ((addr & 3) != 0) {
+    memLastFaultAddress = addr;
+    return NULL;
+  }
+  t_memArea *area = memFindArea(addr, 4, 0);
+  if (!area)
+    return NULL;
+  *outArea = area;
+  uint8_t *bufBasePtr = area->buffer + (size_t)(addr - area->baseAddress);
+  return (uint32_t *)((void *)bufBasePtr);
+}
+
+t_memError memAtomic32(
+    t_memAddress addr, t_memAtomicOp op, uint32_t in, uint32_t *out)
+{
+  t_memArea *area;
+  uint32_t *wordPtr = memFindAtomicWord(addr, &area);
+  if (!wordPtr)
+    return MEM_MAPPING_ERROR;
+
+  uint32_t old, new;
+  switch (op) {
+    case MEM_ATOMIC_LOAD:
+      old = __atomic_load_n(wordPtr, __ATOMIC_SEQ_CST);
+      break;
+    case MEM_ATOMIC_SWAP:
+      old = __atomic_exchange_n(wordPtr, memHostToLE32(in), __ATOMIC_SEQ_CST);
+      break;
+    case MEM_ATOMIC_XOR:
+      old = __atomic_fetch_xor(wordPtr, memHostToLE32(in), __ATOMIC_SEQ_CST);
+      break;
+    case MEM_ATOMIC_AND:
+      old = __atomic_fetch_and(wordPtr, memHostToLE32(in), __ATOMIC_SEQ_CST);
+      break;
+    case MEM_ATOMIC_OR:
+      old = __atomic_fetch_or(wordPtr, memHostToLE32(in), __ATOMIC_SEQ_CST);
+      break;
+    default:
+      // Arithmetic operations depend on the byte order, therefore they are
+      // implemented with a compare-and-swap loop.
+      old = __atomic_load_n(wordPtr, __ATOMIC_RELAXED);
+      do {
+        uint32_t cur = memHostToLE32(old);
+        switch (op) {
+          case MEM_ATOMIC_ADD:
+            new = cur + in;
+            break;
+          case MEM_ATOMIC_MIN:
+            new = (int32_t)cur < (int32_t)in ? cur : in;
+            break;
+          case MEM_ATOMIC_MAX:
+            new = (int32_t)cur > (int32_t)in ? cur : in;
+            break;
+          case MEM_ATOMIC_MINU:
+            new = cur < in ? cur : in;
+            break;
+          case MEM_ATOMIC_MAXU:
+          default:
+            new = cur > in ? cur : in;
+            break;
+        }
+      } while (!__atomic_compare_exchange_n(wordPtr, &old, memHostToLE32(new),
+          true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+  }
+
+  if (op != MEM_ATOMIC_LOAD)
+    memCheckCode(area, addr, 4);
+  *out = memHostToLE32(old);
+  return MEM_NO_ERROR;
+}
+
+t_memError memCompareExchange32(
+    t_memAddress addr, uint32_t expected, uint32_t desired, bool *success)
+{
+  t_memArea *area;
+  uint32_t *wordPtr = memFindAtomicWord(addr, &area);
+  if (!wordPtr)
+    return MEM_MAPPING_ERROR;
+  uint32_t hostExpected = memHostToLE32(expected);
+  *success = __atomic_compare_exchange_n(wordPtr, &hostExpected,
+      memHostToLE32(desired), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  if (*success)
+    memCheckCode(area, addr, 4);
+  return MEM_NO_ERROR;
+}
+
+
+/* Must be called before starting a second hart. */
+void memSetShared(void)
+{
+  __atomic_store_n(&memShared, true, __ATOMIC_RELAXED);
+}
+
+
 t_memAddress memGetLastFaultAddress(void)
 {
   return memLastFaultAddress;
@@ -2,6 +2,7 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "isa.h"
 
 typedef t_isaUXSize t_memAddress;
@@ -13,14 +14,23 @@ enum {
   MEM_OUT_OF_MEMORY = -1,
   MEM_EXTENT_MAPPED = -2,
   MEM_MAPPING_ERROR = -3,
+  MEM_BAD_ALIGNMENT = -4
 };
 
 t_memError memMapArea(t_memAddress base, t_memSize extent, uint8_t **outBuffer);
+t_memError memMapHostArea(
+    t_memAddress base, t_memSize extent, uint8_t *hostBuffer);
+t_memError memReserveArea(t_memAddress base, t_memSize extent);
+t_memError memResizeArea(t_memAddress base, t_memSize extent);
+t_memAddress memGetMappedEnd(void);
 
 t_memError memRead8(t_memAddress addr, uint8_t *out);
 t_memError memRead16(t_memAddress addr, uint16_t *out);
 t_memError memRead32(t_memAddress addr, uint32_t *out);
 
+t_memError memFetch32(t_memAddress addr, uint32_t *out);
+uint64_t memGetCodeGeneration(void);
+
 uint8_t memDebugRead8(t_memAddress addr, int *mapped);
 uint16_t memDebugRead16(t_memAddress addr, int *mapped);
 uint32_t memDebugRead32(t_memAddress addr, int *mapped);
@@ -29,6 +39,26 @@ t_memError memWrite8(t_memAddress addr, uint8_t in);
 t_memError memWrite16(t_memAddress addr, uint16_t in);
 t_memError memWrite32(t_memAddress addr, uint32_t in);
 
+typedef int t_memAtomicOp;
+enum {
+  MEM_ATOMIC_LOAD,
+  MEM_ATOMIC_SWAP,
+  MEM_ATOMIC_ADD,
+  MEM_ATOMIC_XOR,
+  MEM_ATOMIC_AND,
+  MEM_ATOMIC_OR,
+  MEM_ATOMIC_MIN,
+  MEM_ATOMIC_MAX,
+  MEM_ATOMIC_MINU,
+  MEM_ATOMIC_MAXU
+};
+
+t_memError memAtomic32(
+    t_memAddress addr, t_memAtomicOp op, uint32_t in, uint32_t *out);
+t_memError memCompareExchange32(
+    t_memAddress addr, uint32_t expected, uint32_t desired, bool *success);
+
+void memSetShared(void);
 t_memAddress memGetLastFaultAddress(void);
 
 #endif
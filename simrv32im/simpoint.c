@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "simpoint.h"
+#include "compare.h"
+
+/* Sampled simulation of the intervals picked by the SimPoint tool from the
+ * basic-block vectors written with --bbv. The tool writes the simulation
+ * points, one per cluster of intervals, to a file with lines
+ *   <interval index> <cluster id>
+ * and the fraction of the intervals in each cluster to a file with lines
+ *   <weight> <cluster id>
+ * Interval i holds the instructions retired by the boot hart while its
+ * `instret' goes from i * spInterval to (i + 1) * spInterval.
+ *   The program runs functionally up to the start of each simulation point,
+ * and the instructions of the point are timed with the cycle model of the
+ * comparison mode. The CPI of the program is estimated as the mean of the CPIs
+ * of the points weighted as their clusters. */
+
+typedef struct {
+  uint64_t interval;
+  int cluster;
+  double weight;
+  uint64_t instret;
+  uint64_t cycles;
+} t_spPoint;
+
+/* Sorted by interval. */
+t_spPoint *spPoints = NULL;
+int spNumPoints = 0;
+uint64_t spInterval;
+/* Index of the first point not over yet. */
+int spNextPoint = 0;
+t_cpuHart *spHart = NULL;
+
+
+static t_spError spReadPoints(const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return SP_FILE_ERROR;
+
+  t_spError res = SP_NO_ERROR;
+  int bufSize = 0;
+  uint64_t interval;
+  int cluster, n;
+  while ((n = fscanf(fp, "%" SCNu64 " %d", &interval, &cluster)) == 2) {
+    if (spNumPoints == bufSize) {
+      bufSize = bufSize * 2 + 16;
+      t_spPoint *newPoints = realloc(spPoints, sizeof(t_spPoint) * bufSize);
+      if (newPoints == NULL) {
+        res = SP_MEMORY_ERROR;
+        goto cleanup;
+      }
+      spPoints = newPoints;
+    }
+    t_spPoint *point = &spPoints[spNumPoints++];
+    point->interval = interval;
+    point->cluster = cluster;
+    point->weight = -1;
+    point->instret = 0;
+    point->cycles = 0;
+  }
+  if (ferror(fp))
+    res = SP_FILE_ERROR;
+  else if (n != EOF || spNumPoints == 0)
+    res = SP_FORMAT_ERROR;
+
+cleanup:
+  fclose(fp);
+  return res;
+}
+
+static t_spError spReadWeights(const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return SP_FILE_ERROR;
+
+  t_spError res = SP_NO_ERROR;
+  double weight;
+  int cluster, n;
+  while ((n = fscanf(fp, "%lf %d", &weight, &cluster)) == 2) {
+    int i = 0;
+    while (i < spNumPoints && spPoints[i].cluster != cluster)
+      i++;
+    if (i == spNumPoints || !(weight >= 0)) {
+      res = SP_FORMAT_ERROR;
+      goto cleanup;
+    }
+    spPoints[i].weight = weight;
+  }
+  if (ferror(fp))
+    res = SP_FILE_ERROR;
+  else if (n != EOF)
+    res = SP_FORMAT_ERROR;
+
+cleanup:
+  fclose(fp);
+  return res;
+}
+
+static int spComparePoints(const void *a, const void *b)
+{
+  const t_spPoint *pa = a, *pb = b;
+  if (pa->interval != pb->interval)
+    return pa->interval < pb->interval ? -1 : 1;
+  return 0;
+}
+
+t_spError spEnable(
+    const char *pointsPath, const char *weightsPath, uint64_t interval)
+{
+  spInterval = interval;
+  t_spError res = spReadPoints(pointsPath);
+  if (res == SP_NO_ERROR)
+    res = spReadWeights(weightsPath);
+  if (res != SP_NO_ERROR)
+    goto fail;
+
+  qsort(spPoints, spNumPoints, sizeof(t_spPoint), spComparePoints);
+  for (int i = 0; i < spNumPoints; i++) {
+    // Every point needs a weight, and must end within the 64-bit counter
+    if (spPoints[i].weight < 0 ||
+        spPoints[i].interval >= UINT64_MAX / spInterval ||
+        (i > 0 && spPoints[i].interval == spPoints[i - 1].interval)) {
+      res = SP_FORMAT_ERROR;
+      goto fail;
+    }
+  }
+  return SP_NO_ERROR;
+
+fail:
+  free(spPoints);
+  spPoints = NULL;
+  spNumPoints = 0;
+  return res;
+}
+
+
+/* Called by the supervisor before every slice of instructions of a hart.
+ * Enables the cycle model of the boot hart while it is inside a simulation
+ * point, and returns the value of `instret' at which the slice must end for
+ * the model to be enabled or disabled. */
+uint64_t spBeginSlice(t_cpuHart *hart)
+{
+  if (spPoints == NULL || hart->hartID != 0)
+    return UINT64_MAX;
+  spHart = hart;
+
+  uint64_t instret = hart->instret;
+  while (spNextPoint < spNumPoints &&
+      instret >= (spPoints[spNextPoint].interval + 1) * spInterval)
+    spNextPoint++;
+  if (spNextPoint == spNumPoints) {
+    hart->sampleCycles = false;
+    return UINT64_MAX;
+  }
+  uint64_t start = spPoints[spNextPoint].interval * spInterval;
+  hart->sampleCycles = instret >= start;
+  return hart->sampleCycles ? start + spInterval : start;
+}
+
+
+/* Must be called after the instruction at `pc` is retired, with the program
+ * counter of the hart pointing to the next one. */
+void spRecordInstr(t_cpuHart *hart, t_memAddress pc, uint32_t instr)
+{
+  t_spPoint *point = &spPoints[spNextPoint];
+  point->instret++;
+  point->cycles += cmpGetCycles(hart, pc, instr);
+}
+
+
+/* Points which the program did not reach are left out of the estimate, and
+ * the weights of the others are scaled to sum up to one. The last point
+ * reached may be shorter than the others. */
+void spPrintReport(FILE *fp)
+{
+  if (spPoints == NULL)
+    return;
+
+  fprintf(fp, "SimPoint intervals of %" PRIu64 " instructions:\n", spInterval);
+  fprintf(fp, "%12s %8s %12s %12s %8s\n", "interval", "weight", "instructions",
+      "cycles", "CPI");
+  double cpiSum = 0, weightSum = 0;
+  for (int i = 0; i < spNumPoints; i++) {
+    t_spPoint *point = &spPoints[i];
+    if (point->instret == 0) {
+      fprintf(fp, "%12" PRIu64 " %8.4f %12s\n", point->interval,
+          point->weight, "not reached");
+      continue;
+    }
+    double cpi = (double)point->cycles / (double)point->instret;
+    fprintf(fp, "%12" PRIu64 " %8.4f %12" PRIu64 " %12" PRIu64 " %8.3f\n",
+        point->interval, point->weight, point->instret, point->cycles, cpi);
+    cpiSum += point->weight * cpi;
+    weightSum += point->weight;
+  }
+  if (!(weightSum > 0)) {
+    fprintf(fp, "No simulation point was reached.\n");
+    return;
+  }
+
+  double cpi = cpiSum / weightSum;
+  uint64_t instret = spHart->instret;
+  fprintf(fp, "weighted CPI: %.3f\n", cpi);
+  fprintf(fp, "estimated cycles: %.0f (%" PRIu64 " instructions)\n",
+      cpi * (double)instret, instret);
+}
@@ -0,0 +1,27 @@
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+
+typedef int t_spError;
+enum {
+  SP_NO_ERROR = 0,
+  SP_MEMORY_ERROR = -1,
+  SP_FILE_ERROR = -2,
+  SP_FORMAT_ERROR = -3
+};
+
+
+t_spError spEnable(
+    const char *pointsPath, const char *weightsPath, uint64_t interval);
+
+uint64_t spBeginSlice(t_cpuHart *hart);
+
+void spRecordInstr(t_cpuHart *hart, t_memAddress pc, uint32_t instr);
+
+void spPrintReport(FILE *fp);
+
+#endif
@@ -3,23 +3,68 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
 #include "isa.h"
 #include "cpu.h"
 #include "memory.h"
 #include "loader.h"
 #include "supervisor.h"
 #include "debugger.h"
+#include "coverage.h"
+#include "bbv.h"
+#include "loops.h"
+#include "valprof.h"
+#include "compare.h"
+#include "simpoint.h"
+#include "symbols.h"
 
 
 void usage(const char *name)
 {
   puts("ACSE RISC-V RV32IM simulator, (c) 2022-24 Politecnico di Milano");
-  printf("usage: %s [options] executable\n\n", name);
+  printf("usage: %s [options] executable\n", name);
+  printf("       %s --compare [options] executable_a executable_b\n\n", name);
   puts("Options:");
+  puts("  -b, --bbv=FILE        Writes the basic-block vectors of the program");
+  puts("                          to FILE in SimPoint format");
+  puts("  -i, --bbv-interval=N  Sets the length of the intervals of the");
+  puts("                          basic-block vectors and of the SimPoints");
+  puts("                          (default 100000000)");
+  puts("  -C, --compare         Runs two executables on the same input,");
+  puts("                          checks that their outputs match and");
+  puts("                          compares their instructions, cycles and");
+  puts("                          memory accesses");
+  puts("  -I, --input=FILE      Reads the input of the executables compared");
+  puts("                          from FILE instead of the standard input");
+  puts("  -c, --coverage=FILE   Writes the list of source lines executed by");
+  puts("                          the program to FILE in lcov format");
   puts("  -d, --debug           Enters debug mode before starting execution");
   puts("  -e, --entry=ADDR      Force the entry point to ADDR");
+  puts("  -L, --loops=FILE      Writes a report of the loops executed by the");
+  puts("                          program, with their iterations, to FILE");
+  puts("  -m, --max-instructions=N");
+  puts("                        Stops the program after N instructions");
+  puts("                          retired by all harts together");
+  puts("  -n, --harts=N         Allows the program to spawn up to N harts");
+  puts("                          running in parallel (default 1)");
   puts("  -l, --load-addr=ADDR  Sets the executable loading address (only");
   puts("                          for executables in raw binary format)");
+  puts("  -p, --simpoints=FILE  Times only the intervals listed in FILE, as");
+  puts("                          written by SimPoint, and estimates the");
+  puts("                          cycles of the whole program from them");
+  puts("  -w, --simpoint-weights=FILE");
+  puts("                        Reads the weights of the SimPoints from FILE");
+  puts("  -s, --stack-size=SIZE Reserves SIZE bytes for the stack of each");
+  puts("                          hart (default 16 MiB)");
+  puts("  -S, --stats           Prints the instructions retired and the");
+  puts("                          simulation speed at the end of the run");
+  puts("  -t, --timeout=SECONDS Stops the program after SECONDS seconds");
+  puts("  -v, --value-profile=FILE");
+  puts("                        Writes the most frequent operands of the");
+  puts("                          multiplications, divisions and shifts of");
+  puts("                          the program to FILE");
   puts("  -x, --prg-exit-code   Exits the simulator with the same exit code");
   puts("                          as the simulated program. In case of faults");
   puts("                          produces POSIX-style exit codes.");
@@ -35,14 +80,17 @@ enum {
   SIM_EXIT_INVALID_FILE,
   SIM_EXIT_SIGSEGV,
   SIM_EXIT_SIGILL,
+  SIM_EXIT_OUTPUT_MISMATCH,
+  SIM_EXIT_LIMIT,
   COUNT_SIM_EXIT
 };
 
 int exitCode(t_exitCode code, bool toPosix)
 {
-  static const int normalCodes[COUNT_SIM_EXIT] = {0, 0, 1, 2, 100, 101};
+  static const int normalCodes[COUNT_SIM_EXIT] = {
+      0, 0, 1, 2, 100, 101, 3, 102};
   static const int posixCodes[COUNT_SIM_EXIT] = {
-      0, 126, 126, 126, 128 + 11, 128 + 4};
+      0, 126, 126, 126, 128 + 11, 128 + 4, 1, 128 + 24};
   if (code < 0 || code >= COUNT_SIM_EXIT)
     return code;
   if (toPosix)
@@ -51,16 +99,46 @@ int exitCode(t_exitCode code, bool toPosix)
 }
 
 
+void printLocation(t_memAddress pc)
+{
+  t_memAddress offset;
+  const char *label = symGetLabel(pc, &offset);
+  const char *file;
+  int line;
+  fprintf(stderr, "  at 0x%08x", pc);
+  if (label != NULL)
+    fprintf(stderr, " <%s+0x%x>", label, offset);
+  if (symGetSourceLine(pc, &file, &line))
+    fprintf(stderr, " (%s:%d)", file, line);
+  fputc('\n', stderr);
+}
+
+
 int main(int argc, char *argv[])
 {
   int ch;
   char *tmpStr;
   static const struct option options[] = {
-      {        "debug",       no_argument, NULL, 'd'},
-      {        "entry", required_argument, NULL, 'e'},
-      {         "help",       no_argument, NULL, 'h'},
-      {    "load-addr", required_argument, NULL, 'l'},
-      {"prg-exit-code",       no_argument, NULL, 'x'},
+      {             "bbv", required_argument, NULL, 'b'},
+      {    "bbv-interval", required_argument, NULL, 'i'},
+      {         "compare",       no_argument, NULL, 'C'},
+      {        "coverage", required_argument, NULL, 'c'},
+      {           "debug",       no_argument, NULL, 'd'},
+      {           "entry", required_argument, NULL, 'e'},
+      {           "harts", required_argument, NULL, 'n'},
+      {            "help",       no_argument, NULL, 'h'},
+      {           "input", required_argument, NULL, 'I'},
+      {       "load-addr", required_argument, NULL, 'l'},
+      {           "loops", required_argument, NULL, 'L'},
+      {"max-instructions", required_argument, NULL, 'm'},
+      {   "prg-exit-code",       no_argument, NULL, 'x'},
+      {"simpoint-weights", required_argument, NULL, 'w'},
+      {       "simpoints", required_argument, NULL, 'p'},
+      {      "stack-size", required_argument, NULL, 's'},
+      {           "stats",       no_argument, NULL, 'S'},
+      {         "timeout", required_argument, NULL, 't'},
+      {   "value-profile", required_argument, NULL, 'v'},
+      {              NULL,                 0, NULL,   0},
   };
 
   char *name = argv[0];
@@ -69,9 +147,46 @@ int main(int argc, char *argv[])
   bool entryIsSet = false;
   t_memAddress load = 0;
   bool prgExitCode = false;
+  int maxHarts = 1;
+  t_memSize stackSize = SV_DEFAULT_STACK_SIZE;
+  char *coverageFile = NULL;
+  char *bbvFile = NULL;
+  char *simpointsFile = NULL;
+  char *weightsFile = NULL;
+  char *loopsFile = NULL;
+  char *valueProfileFile = NULL;
+  bool compare = false;
+  bool stats = false;
+  uint64_t maxInstrs = 0;
+  double timeout = 0;
+  char *inputFile = NULL;
+  uint64_t bbvInterval = 100000000;
 
-  while ((ch = getopt_long(argc, argv, "de:hl:x", options, NULL)) != -1) {
+  const char *optstring = "b:Cc:de:hI:i:l:L:m:n:p:Ss:t:v:w:x";
+  while ((ch = getopt_long(argc, argv, optstring, options, NULL)) != -1) {
     switch (ch) {
+      case 'b':
+        bbvFile = optarg;
+        break;
+      case 'i':
+        bbvInterval = strtoull(optarg, &tmpStr, 0);
+        if (tmpStr == optarg || bbvInterval == 0) {
+          fprintf(stderr, "Invalid interval length\n");
+          return 1;
+        }
+        break;
+      case 'C':
+        compare = true;
+        break;
+      case 'S':
+        stats = true;
+        break;
+      case 'I':
+        inputFile = optarg;
+        break;
+      case 'c':
+        coverageFile = optarg;
+        break;
       case 'd':
         debug = true;
         break;
@@ -90,6 +205,46 @@ int main(int argc, char *argv[])
           return 1;
         }
         break;
+      case 'L':
+        loopsFile = optarg;
+        break;
+      case 'p':
+        simpointsFile = optarg;
+        break;
+      case 'w':
+        weightsFile = optarg;
+        break;
+      case 'v':
+        valueProfileFile = optarg;
+        break;
+      case 'm':
+        maxInstrs = strtoull(optarg, &tmpStr, 0);
+        if (tmpStr == optarg || maxInstrs == 0) {
+          fprintf(stderr, "Invalid instruction limit\n");
+          return 1;
+        }
+        break;
+      case 't':
+        timeout = strtod(optarg, &tmpStr);
+        if (tmpStr == optarg || !(timeout > 0)) {
+          fprintf(stderr, "Invalid timeout\n");
+          return 1;
+        }
+        break;
+      case 'n':
+        maxHarts = (int)strtol(optarg, &tmpStr, 0);
+        if (tmpStr == optarg || maxHarts < 1 || maxHarts > SV_MAX_HARTS) {
+          fprintf(stderr, "Invalid number of harts (max %d)\n", SV_MAX_HARTS);
+          return 1;
+        }
+        break;
+      case 's':
+        stackSize = (t_memSize)strtoul(optarg, &tmpStr, 0);
+        if (tmpStr == optarg) {
+          fprintf(stderr, "Invalid stack size\n");
+          return 1;
+        }
+        break;
       case 'x':
         prgExitCode = true;
         break;
@@ -104,16 +259,75 @@ int main(int argc, char *argv[])
   argc -= optind;
   argv += optind;
 
-  if (argc < 1) {
+  if (argc < (compare ? 2 : 1)) {
     usage(name);
     return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
-  } else if (argc > 1) {
-    fprintf(stderr, "Cannot load more than one file, exiting.\n");
+  } else if (argc > (compare ? 2 : 1)) {
+    if (compare)
+      fprintf(stderr, "Cannot compare more than two files, exiting.\n");
+    else
+      fprintf(stderr, "Cannot load more than one file, exiting.\n");
     return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
   }
 
+  if ((simpointsFile == NULL) != (weightsFile == NULL)) {
+    fprintf(stderr, "SimPoints require both --simpoints and "
+                    "--simpoint-weights.\n");
+    return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  }
+
+  if (compare) {
+    if (debug || coverageFile || loopsFile || valueProfileFile || bbvFile ||
+        simpointsFile) {
+      fprintf(stderr, "Cannot debug or profile the executables compared.\n");
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    }
+    // Each executable is loaded and run by a child process, which continues
+    // from here. The parent only collects the results.
+    int run;
+    t_cmpError cmpErr = cmpStartRuns(inputFile, &run);
+    if (cmpErr == CMP_FILE_ERROR) {
+      fprintf(stderr, "Could not read the input, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    } else if (cmpErr != CMP_NO_ERROR) {
+      fprintf(stderr, "Could not start the executables, exiting.\n");
+      return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+    }
+    if (run == CMP_PARENT) {
+      cmpErr = cmpWriteReport((const char **)argv);
+      if (cmpErr == CMP_OUTPUT_MISMATCH)
+        return exitCode(SIM_EXIT_OUTPUT_MISMATCH, prgExitCode);
+      else if (cmpErr != CMP_NO_ERROR)
+        return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+      return 0;
+    }
+    argv += run;
+  }
+
   if (debug)
     dbgEnable();
+  if (coverageFile)
+    covEnable();
+  if (loopsFile)
+    loopEnable();
+  if (valueProfileFile)
+    vpEnable();
+  if (bbvFile && bbvEnable(bbvFile, bbvInterval) != BBV_NO_ERROR) {
+    fprintf(stderr, "Could not open %s, exiting.\n", bbvFile);
+    return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  }
+  if (simpointsFile) {
+    t_spError spErr = spEnable(simpointsFile, weightsFile, bbvInterval);
+    if (spErr == SP_FORMAT_ERROR) {
+      fprintf(stderr, "Invalid SimPoints in %s or %s, exiting.\n",
+          simpointsFile, weightsFile);
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    } else if (spErr != SP_NO_ERROR) {
+      fprintf(stderr, "Could not read %s or %s, exiting.\n", simpointsFile,
+          weightsFile);
+      return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+    }
+  }
 
   t_ldrError ldrErr;
   t_ldrFileType excType = ldrDetectExecType(argv[0]);
@@ -141,19 +355,58 @@ int main(int argc, char *argv[])
     return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
   }
 
-  t_svStatus status = initSupervisor();
+  t_svError svErr = initSupervisor(maxHarts, stackSize);
+  if (svErr == SV_INVALID_STACK_SIZE) {
+    fprintf(stderr, "Invalid stack size for %d harts, exiting.\n", maxHarts);
+    return exitCode(SIM_EXIT_INVALID_ARGS, prgExitCode);
+  } else if (svErr != SV_NO_ERROR) {
+    fprintf(stderr, "Could not allocate the stack, exiting.\n");
+    return exitCode(SIM_EXIT_INVALID_FILE, prgExitCode);
+  }
 
+  svSetLimits(maxInstrs, timeout);
   if (debug)
     dbgRequestEnter();
 
-  while (status == SV_STATUS_RUNNING) {
-    status = svVMTick();
+  struct timespec startTime, endTime;
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+  t_svStatus status = svRun();
+  clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+  if (compare && cmpFinishRun(status) != CMP_NO_ERROR)
+    fprintf(stderr, "Could not record the costs of %s\n", argv[0]);
+
+  if (coverageFile && covWriteLCOV(coverageFile) != COV_NO_ERROR)
+    fprintf(stderr, "Could not write coverage data to %s\n", coverageFile);
+  if (loopsFile && loopWriteReport(loopsFile) != LOOP_NO_ERROR)
+    fprintf(stderr, "Could not write the loop report to %s\n", loopsFile);
+  if (valueProfileFile && vpWriteProfile(valueProfileFile) != VP_NO_ERROR)
+    fprintf(stderr, "Could not write the value profile to %s\n",
+        valueProfileFile);
+  if (bbvFinish() != BBV_NO_ERROR)
+    fprintf(stderr, "Could not write basic-block vectors to %s\n", bbvFile);
+  spPrintReport(stderr);
+  if (stats) {
+    double seconds = (double)(endTime.tv_sec - startTime.tv_sec) +
+        (double)(endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+    uint64_t instrs = svGetRetiredInstrs();
+    fprintf(stderr, "instructions: %" PRIu64 "\n", instrs);
+    fprintf(stderr, "seconds: %.6f\n", seconds);
+    fprintf(stderr, "MIPS: %.2f\n", seconds > 0 ? instrs / seconds / 1e6 : 0);
   }
 
   if (status == SV_STATUS_MEMORY_FAULT) {
     fprintf(stderr, "Memory fault at address 0x%08x, execution stopped.\n",
-        memGetLastFaultAddress());
+        svGetFaultAddress());
     return exitCode(SIM_EXIT_SIGSEGV, prgExitCode);
+  } else if (status == SV_STATUS_INSTR_LIMIT) {
+    fprintf(stderr, "Instruction limit reached, execution stopped.\n");
+    printLocation(cpuGetRegister(CPU_REG_PC));
+    return exitCode(SIM_EXIT_LIMIT, prgExitCode);
+  } else if (status == SV_STATUS_TIMEOUT) {
+    fprintf(stderr, "Timeout expired, execution stopped.\n");
+    printLocation(cpuGetRegister(CPU_REG_PC));
+    return exitCode(SIM_EXIT_LIMIT, prgExitCode);
   } else if (status == SV_STATUS_ILL_INST_FAULT) {
     fprintf(stderr, "Illegal instruction at address 0x%08x\n",
         cpuGetRegister(CPU_REG_PC));
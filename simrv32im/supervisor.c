@@ -1,33 +1,416 @@
 #include <stdio.h>
 #include <inttypes.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "supervisor.h"
 #include "memory.h"
 #include "debugger.h"
+#include "bbv.h"
+#include "simpoint.h"
+
+typedef struct {
+  t_cpuHart *cpu;
+  pthread_t thread;
+  bool finished;
+  t_svStatus status;
+  t_memAddress faultAddress;
+  uint64_t claimedInstret;
+} t_svHart;
 
 const t_memAddress svStackTop = 0x80000000;
-t_memAddress svStackBottom;
 t_isaInt svExitCode;
 
+/* Every hart stack is reserved entirely when the hart is started, and is
+ * followed by an unmapped guard page to catch stack overflows. */
+t_memSize svStackSize;
+t_memSize svStackStride;
+
+/* The heap lies between the end of the program and the lowest hart stack. It
+ * is reserved on the first brk() which grows it, then resized at every call.
+ * svHeapBreak is protected by svHeapMutex. */
+t_memAddress svHeapStart;
+t_memAddress svHeapLimit;
+t_memAddress svHeapBreak;
+bool svHeapReserved;
+pthread_mutex_t svHeapMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Harts are allocated sequentially in svHarts. svNumHarts, the finished flags
+ * and svStoppingHart are protected by svHartsMutex. */
+t_svHart svHarts[SV_MAX_HARTS];
+int svNumHarts;
+int svMaxHarts;
+pthread_mutex_t svHartsMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Uses CLOCK_MONOTONIC, like svDeadline. */
+pthread_cond_t svHartFinishedCond;
+/* First hart which stopped the whole simulation by exiting or faulting. */
+t_svHart *svStoppingHart;
+/* Polled by all harts between slices of instructions and at every system
+ * call, without taking the lock. */
+int svStopRequested;
+/* Becomes readable when svStopRequested is set, to wake up the harts waiting
+ * for input. Nothing is ever read from it. Not opened with a single hart. */
+int svStopPipe[2] = {-1, -1};
+
+_Thread_local t_svHart *svCurHart;
+
+/* Limits on the execution of the program, 0 if disabled. Harts run slices of
+ * at most SV_LIMITS_INTERVAL instructions, and check them before every slice.
+ * Slices end early at traps, when they would exceed the instruction budget,
+ * and where the intervals of the basic-block vectors and of the sampled
+ * simulation begin or end.
+ *   The instruction budget is shared by all harts. Every hart claims the
+ * instructions of its slices from svInstrsLeft, up to the value of `instret'
+ * in its claimedInstret field, and gives back what it did not use when it
+ * finishes. */
+#define SV_LIMITS_INTERVAL 65536
+uint64_t svMaxInstrs;
+uint64_t svInstrsLeft;
+double svTimeout;
+struct timespec svDeadline;
+
+/* Input of the program. It is read from the standard input without stdio, so
+ * that a read can be interrupted by the timeout. When debugging, the input is
+ * read one byte at a time and stdin is unbuffered, so that neither the program
+ * nor the debugger reads ahead the input of the other. Protected by
+ * svInputMutex. */
+unsigned char svInputBuf[4096];
+size_t svInputPos;
+size_t svInputLen;
+bool svInputEOF;
+pthread_mutex_t svInputMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static t_memAddress svPageAlign(t_memAddress addr)
+{
+  t_memAddress mask = SV_STACK_PAGE_SIZE - 1;
+  return (addr + mask) & ~mask;
+}
 
-t_svError initSupervisor(void)
+
+static t_svError svInitHartStack(t_svHart *hart, int hartID)
 {
-  svStackBottom = svStackTop - SV_STACK_PAGE_SIZE;
-  t_memError merr = memMapArea(svStackBottom, SV_STACK_PAGE_SIZE, NULL);
+  t_memAddress top = svStackTop - (t_memAddress)hartID * svStackStride;
+  t_memError merr = memReserveArea(top - svStackSize, svStackSize);
   if (merr != MEM_NO_ERROR)
     return SV_MEMORY_ERROR;
-  cpuSetRegister(CPU_REG_SP, svStackTop - 4);
+  cpuSetRegister(CPU_REG_SP, top - 4);
   return SV_NO_ERROR;
 }
 
 
-void svExpandStack(void)
+t_svError initSupervisor(int maxHarts, t_memSize stackSize)
 {
-  t_memAddress faultAddr = memGetLastFaultAddress();
-  if (faultAddr < svStackBottom &&
-      faultAddr >= (svStackBottom - SV_STACK_PAGE_SIZE)) {
-    svStackBottom -= SV_STACK_PAGE_SIZE;
-    memMapArea(svStackBottom, SV_STACK_PAGE_SIZE, NULL);
+  // The stacks of all harts must fit below svStackTop
+  svStackSize = svPageAlign(stackSize);
+  if (svStackSize == 0 ||
+      svStackSize > svStackTop / (t_memSize)maxHarts - SV_STACK_PAGE_SIZE)
+    return SV_INVALID_STACK_SIZE;
+  svStackStride = svStackSize + SV_STACK_PAGE_SIZE;
+
+  t_memAddress programEnd = memGetMappedEnd();
+  svHeapStart = svPageAlign(programEnd);
+  svHeapLimit = svStackTop - (t_memAddress)maxHarts * svStackStride;
+  if (svHeapStart < programEnd || svHeapStart > svHeapLimit)
+    svHeapStart = svHeapLimit = 0;
+  svHeapBreak = svHeapStart;
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&svHartFinishedCond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  if (maxHarts > 1 && pipe(svStopPipe) != 0)
+    return SV_MEMORY_ERROR;
+
+  svMaxHarts = maxHarts;
+  svNumHarts = 1;
+  svCurHart = &svHarts[0];
+  svHarts[0].cpu = cpuGetCurrentHart();
+  return svInitHartStack(&svHarts[0], 0);
+}
+
+
+static void svHartFinished(t_svHart *hart, t_svStatus status)
+{
+  pthread_mutex_lock(&svHartsMutex);
+  hart->status = status;
+  hart->faultAddress = memGetLastFaultAddress();
+  hart->finished = true;
+  if (status != SV_STATUS_RUNNING && status != SV_STATUS_HART_EXITED &&
+      svStoppingHart == NULL) {
+    svStoppingHart = hart;
+    __atomic_store_n(&svStopRequested, 1, __ATOMIC_RELAXED);
+    if (svStopPipe[1] >= 0)
+      while (write(svStopPipe[1], "", 1) < 0 && errno == EINTR)
+        ;
   }
+  pthread_cond_broadcast(&svHartFinishedCond);
+  pthread_mutex_unlock(&svHartsMutex);
+}
+
+
+void svSetLimits(uint64_t maxInstrs, double timeout)
+{
+  svMaxInstrs = maxInstrs;
+  svInstrsLeft = maxInstrs;
+  svTimeout = timeout;
+}
+
+
+/* Returns the number of milliseconds left before the deadline, rounded up, or
+ * zero if it has passed. */
+static int svGetTimeLeft(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double left = (double)(svDeadline.tv_sec - now.tv_sec) * 1e3 +
+      (double)(svDeadline.tv_nsec - now.tv_nsec) / 1e6;
+  if (left <= 0)
+    return 0;
+  return left >= INT32_MAX ? INT32_MAX : (int)left + 1;
+}
+
+
+/* Returns in `endInstret' the value of `instret' at which the next slice of
+ * instructions of a hart ends. */
+static t_svStatus svCheckLimits(t_svHart *hart, uint64_t *endInstret)
+{
+  if (svTimeout > 0 && svGetTimeLeft() == 0)
+    return SV_STATUS_TIMEOUT;
+
+  uint64_t instret = hart->cpu->instret;
+  *endInstret = instret + SV_LIMITS_INTERVAL;
+  if (svMaxInstrs > 0) {
+    // Claim enough instructions for a whole slice, if there are any left.
+    uint64_t claimed = hart->claimedInstret - instret;
+    uint64_t left = __atomic_load_n(&svInstrsLeft, __ATOMIC_RELAXED);
+    uint64_t n;
+    do {
+      n = SV_LIMITS_INTERVAL - claimed;
+      if (n > left)
+        n = left;
+    } while (n > 0 && !__atomic_compare_exchange_n(&svInstrsLeft, &left,
+                          left - n, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    hart->claimedInstret += n;
+    if (hart->claimedInstret == instret)
+      return SV_STATUS_INSTR_LIMIT;
+    *endInstret = hart->claimedInstret;
+  }
+
+  uint64_t boundary = bbvBeginSlice(hart->cpu);
+  if (boundary < *endInstret)
+    *endInstret = boundary;
+  boundary = spBeginSlice(hart->cpu);
+  if (boundary < *endInstret)
+    *endInstret = boundary;
+  return SV_STATUS_RUNNING;
+}
+
+
+static t_svStatus svHandleCpuStatus(t_cpuStatus cpuStatus);
+
+static t_svStatus svRunHart(t_svHart *hart)
+{
+  svCurHart = hart;
+  cpuSetCurrentHart(hart->cpu);
+
+  // Only the boot hart is controlled by the debugger, which must be called
+  // before every instruction.
+  bool debugged = hart == &svHarts[0] && dbgGetEnabled();
+  t_svStatus status = SV_STATUS_RUNNING;
+  while (status == SV_STATUS_RUNNING &&
+      !__atomic_load_n(&svStopRequested, __ATOMIC_RELAXED)) {
+    uint64_t endInstret;
+    if ((status = svCheckLimits(hart, &endInstret)) != SV_STATUS_RUNNING)
+      break;
+    if (!debugged) {
+      status = svHandleCpuStatus(cpuRun(endInstret));
+      continue;
+    }
+    while (status == SV_STATUS_RUNNING && hart->cpu->instret < endInstret &&
+        !__atomic_load_n(&svStopRequested, __ATOMIC_RELAXED))
+      status = svVMTick();
+  }
+
+  if (svMaxInstrs > 0)
+    __atomic_fetch_add(&svInstrsLeft, hart->claimedInstret - hart->cpu->instret,
+        __ATOMIC_RELAXED);
+  svHartFinished(hart, status);
+  return status;
+}
+
+
+static void *svHartThread(void *arg)
+{
+  svRunHart((t_svHart *)arg);
+  return NULL;
+}
+
+
+static t_isaInt svSpawnHart(t_memAddress entry, t_cpuURegValue arg)
+{
+  t_isaInt res = -1;
+  t_cpuHart *parent = cpuGetCurrentHart();
+
+  pthread_mutex_lock(&svHartsMutex);
+  if (svNumHarts >= svMaxHarts || svStoppingHart != NULL)
+    goto cleanup;
+
+  int hartID = svNumHarts;
+  t_svHart *hart = &svHarts[hartID];
+  hart->cpu = cpuNewHart((t_cpuURegValue)hartID);
+  if (hart->cpu == NULL)
+    goto cleanup;
+
+  cpuSetCurrentHart(hart->cpu);
+  cpuReset(entry);
+  cpuSetRegister(CPU_REG_A0, arg);
+  t_svError err = svInitHartStack(hart, hartID);
+  cpuSetCurrentHart(parent);
+  memSetShared();
+  if (err != SV_NO_ERROR ||
+      pthread_create(&hart->thread, NULL, svHartThread, hart) != 0) {
+    cpuDeleteHart(hart->cpu);
+    hart->cpu = NULL;
+    goto cleanup;
+  }
+
+  svNumHarts++;
+  res = hartID;
+cleanup:
+  pthread_mutex_unlock(&svHartsMutex);
+  return res;
+}
+
+
+static t_svStatus svJoinHart(t_cpuURegValue hartID, t_isaInt *res)
+{
+  t_svStatus status = SV_STATUS_RUNNING;
+  *res = -1;
+
+  pthread_mutex_lock(&svHartsMutex);
+  if (hartID >= (t_cpuURegValue)svNumHarts || &svHarts[hartID] == svCurHart)
+    goto cleanup;
+  t_svHart *hart = &svHarts[hartID];
+  while (!hart->finished && !svStopRequested) {
+    if (svTimeout <= 0)
+      pthread_cond_wait(&svHartFinishedCond, &svHartsMutex);
+    else if (pthread_cond_timedwait(&svHartFinishedCond, &svHartsMutex,
+                 &svDeadline) == ETIMEDOUT) {
+      status = SV_STATUS_TIMEOUT;
+      goto cleanup;
+    }
+  }
+  *res = 0;
+cleanup:
+  pthread_mutex_unlock(&svHartsMutex);
+  return status;
+}
+
+
+/* Returns in `c' the next byte of the input without consuming it, or EOF at
+ * the end of the input. Must be called with svInputMutex held. Waiting for
+ * the input ends with SV_STATUS_KILLED when another hart stops the
+ * simulation, and the system call is not completed. */
+static t_svStatus svPeekInput(int *c)
+{
+  while (svInputPos == svInputLen && !svInputEOF) {
+    // The prompts of the program must be visible while it waits for input.
+    fflush(stdout);
+    int timeLeft = -1;
+    if (svTimeout > 0 && (timeLeft = svGetTimeLeft()) == 0)
+      return SV_STATUS_TIMEOUT;
+    // Negative descriptors are ignored by poll()
+    struct pollfd pfds[2] = {
+        {.fd = STDIN_FILENO, .events = POLLIN},
+        {.fd = svStopPipe[0], .events = POLLIN}
+    };
+    if (poll(pfds, 2, timeLeft) <= 0)
+      continue;
+    if (pfds[1].revents != 0)
+      return SV_STATUS_KILLED;
+    size_t size = dbgGetEnabled() ? 1 : sizeof(svInputBuf);
+    ssize_t n = read(STDIN_FILENO, svInputBuf, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    svInputPos = 0;
+    svInputLen = n > 0 ? (size_t)n : 0;
+    svInputEOF = n <= 0;
+  }
+  *c = svInputPos < svInputLen ? svInputBuf[svInputPos] : EOF;
+  return SV_STATUS_RUNNING;
+}
+
+
+/* Reads a decimal integer like scanf("%d"): leading white space is skipped,
+ * and the character after the number is left in the input. The result is
+ * zero if there is no number. */
+static t_svStatus svReadInt(int32_t *res)
+{
+  int c = EOF;
+  t_svStatus status;
+  *res = 0;
+  pthread_mutex_lock(&svInputMutex);
+  while ((status = svPeekInput(&c)) == SV_STATUS_RUNNING && isspace(c))
+    svInputPos++;
+  bool negative = c == '-';
+  if (status == SV_STATUS_RUNNING && (c == '-' || c == '+')) {
+    svInputPos++;
+    status = svPeekInput(&c);
+  }
+  uint32_t value = 0;
+  while (status == SV_STATUS_RUNNING && isdigit(c)) {
+    value = value * 10 + (uint32_t)(c - '0');
+    svInputPos++;
+    status = svPeekInput(&c);
+  }
+  *res = (int32_t)(negative ? -value : value);
+  pthread_mutex_unlock(&svInputMutex);
+  return status;
+}
+
+
+/* Reads a character like getchar(). */
+static t_svStatus svReadChar(int32_t *res)
+{
+  int c;
+  pthread_mutex_lock(&svInputMutex);
+  t_svStatus status = svPeekInput(&c);
+  if (status == SV_STATUS_RUNNING && c != EOF)
+    svInputPos++;
+  *res = c;
+  pthread_mutex_unlock(&svInputMutex);
+  return status;
+}
+
+
+static t_memAddress svSetHeapBreak(t_memAddress newBreak)
+{
+  pthread_mutex_lock(&svHeapMutex);
+  // Invalid requests, like zero, just return the current break
+  if (newBreak < svHeapStart || newBreak > svHeapLimit)
+    goto cleanup;
+  t_memSize extent = svPageAlign(newBreak - svHeapStart);
+  if (!svHeapReserved) {
+    if (newBreak == svHeapStart)
+      goto cleanup;
+    if (memReserveArea(svHeapStart, svHeapLimit - svHeapStart) != MEM_NO_ERROR)
+      goto cleanup;
+    svHeapReserved = true;
+  }
+  if (memResizeArea(svHeapStart, extent) != MEM_NO_ERROR)
+    goto cleanup;
+  svHeapBreak = newBreak;
+cleanup:
+  newBreak = svHeapBreak;
+  pthread_mutex_unlock(&svHeapMutex);
+  return newBreak;
 }
 
 
@@ -37,12 +420,17 @@ enum {
   SV_SYSCALL_EXIT_0 = 10,
   SV_SYSCALL_PRINT_CHAR = 11,
   SV_SYSCALL_READ_CHAR = 12,
-  SV_SYSCALL_EXIT = 93
+  SV_SYSCALL_EXIT = 93,
+  SV_SYSCALL_BRK = 214,
+  SV_SYSCALL_HART_SPAWN = 500,
+  SV_SYSCALL_HART_EXIT = 501,
+  SV_SYSCALL_HART_JOIN = 502
 };
 
 t_svStatus svHandleEnvCall(void)
 {
   t_cpuURegValue syscallId = cpuGetRegister(CPU_REG_A7);
+  t_svStatus status;
   int32_t ret;
 
   switch (syscallId) {
@@ -51,7 +439,8 @@ t_svStatus svHandleEnvCall(void)
       break;
     case SV_SYSCALL_READ_INT:
       fputs("int value? >", stdout);
-      fscanf(stdin, "%" PRId32, &ret);
+      if ((status = svReadInt(&ret)) != SV_STATUS_RUNNING)
+        return status;
       cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
       break;
     case SV_SYSCALL_EXIT_0:
@@ -61,12 +450,28 @@ t_svStatus svHandleEnvCall(void)
       putchar((int)cpuGetRegister(CPU_REG_A0));
       break;
     case SV_SYSCALL_READ_CHAR:
-      ret = getchar();
+      if ((status = svReadChar(&ret)) != SV_STATUS_RUNNING)
+        return status;
       cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
       break;
     case SV_SYSCALL_EXIT:
       svExitCode = (int)cpuGetRegister(CPU_REG_A0);
       return SV_STATUS_TERMINATED;
+    case SV_SYSCALL_BRK:
+      cpuSetRegister(CPU_REG_A0, svSetHeapBreak(cpuGetRegister(CPU_REG_A0)));
+      break;
+    case SV_SYSCALL_HART_SPAWN:
+      ret = svSpawnHart(cpuGetRegister(CPU_REG_A0), cpuGetRegister(CPU_REG_A1));
+      cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
+      break;
+    case SV_SYSCALL_HART_EXIT:
+      return SV_STATUS_HART_EXITED;
+    case SV_SYSCALL_HART_JOIN:
+      if ((status = svJoinHart(cpuGetRegister(CPU_REG_A0), &ret)) !=
+          SV_STATUS_RUNNING)
+        return status;
+      cpuSetRegister(CPU_REG_A0, (t_cpuURegValue)ret);
+      break;
     default:
       return SV_STATUS_INVALID_SYSCALL;
   }
@@ -81,34 +486,95 @@ t_isaInt svGetExitCode(void)
 }
 
 
-t_svStatus svVMTick(void)
+t_memAddress svGetFaultAddress(void)
+{
+  return svCurHart->faultAddress;
+}
+
+
+/* Must not be called while harts are running. */
+uint64_t svGetRetiredInstrs(void)
+{
+  uint64_t total = 0;
+  for (int i = 0; i < svNumHarts; i++)
+    total += svHarts[i].cpu->instret;
+  return total;
+}
+
+
+/* Handles the trap or fault which stopped the current hart, if any. */
+static t_svStatus svHandleCpuStatus(t_cpuStatus cpuStatus)
 {
   t_svStatus status = SV_STATUS_RUNNING;
 
-  t_dbgResult dbgRes = dbgTick();
-  if (dbgRes == DBG_RESULT_EXIT) {
-    status = SV_STATUS_KILLED;
-  } else {
-    t_cpuStatus cpuStatus = cpuTick();
-    if (cpuStatus == CPU_STATUS_MEMORY_FAULT) {
-      svExpandStack();
+  if (cpuStatus == CPU_STATUS_ECALL_TRAP) {
+    // Once the simulation is being stopped, system calls are not executed
+    // anymore. The trap is left pending, and the hart stops at the next check
+    // of svStopRequested.
+    if (__atomic_load_n(&svStopRequested, __ATOMIC_RELAXED))
+      return status;
+    status = svHandleEnvCall();
+    if (status == SV_STATUS_RUNNING)
       cpuClearLastFault();
-      cpuStatus = cpuTick();
+  } else if (cpuStatus == CPU_STATUS_EBREAK_TRAP) {
+    if (svCurHart == &svHarts[0] && dbgGetEnabled())
+      dbgRequestEnter();
+    cpuClearLastFault();
+  } else if (cpuStatus == CPU_STATUS_ILL_INST_FAULT)
+    status = SV_STATUS_ILL_INST_FAULT;
+  else if (cpuStatus == CPU_STATUS_MEMORY_FAULT)
+    status = SV_STATUS_MEMORY_FAULT;
+
+  return status;
+}
+
+
+t_svStatus svVMTick(void)
+{
+  // Only the boot hart is controlled by the debugger.
+  bool isBootHart = svCurHart == &svHarts[0];
+  t_dbgResult dbgRes = isBootHart ? dbgTick() : DBG_RESULT_CONTINUE;
+  if (dbgRes == DBG_RESULT_EXIT)
+    return SV_STATUS_KILLED;
+  return svHandleCpuStatus(cpuTick());
+}
+
+
+t_svStatus svRun(void)
+{
+  if (svTimeout > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &svDeadline);
+    time_t whole = (time_t)svTimeout;
+    svDeadline.tv_sec += whole;
+    svDeadline.tv_nsec += (long)((svTimeout - (double)whole) * 1e9);
+    if (svDeadline.tv_nsec >= 1000000000L) {
+      svDeadline.tv_sec++;
+      svDeadline.tv_nsec -= 1000000000L;
     }
+  }
+  if (dbgGetEnabled())
+    setvbuf(stdin, NULL, _IONBF, 0);
+  svRunHart(&svHarts[0]);
 
-    if (cpuStatus == CPU_STATUS_ECALL_TRAP) {
-      status = svHandleEnvCall();
-      if (status == SV_STATUS_RUNNING)
-        cpuClearLastFault();
-    } else if (cpuStatus == CPU_STATUS_EBREAK_TRAP) {
-      if (dbgGetEnabled())
-        dbgRequestEnter();
-      cpuClearLastFault();
-    } else if (cpuStatus == CPU_STATUS_ILL_INST_FAULT)
-      status = SV_STATUS_ILL_INST_FAULT;
-    else if (cpuStatus == CPU_STATUS_MEMORY_FAULT)
-      status = SV_STATUS_MEMORY_FAULT;
+  // The simulation ends when all harts are done. Harts still running at this
+  // point either were stopped by the boot hart or are allowed to finish if the
+  // boot hart only exited by itself.
+  pthread_mutex_lock(&svHartsMutex);
+  int numHarts = svNumHarts;
+  pthread_mutex_unlock(&svHartsMutex);
+  for (int i = 1; i < numHarts; i++) {
+    pthread_join(svHarts[i].thread, NULL);
+    // Harts spawned while joining are caught by the loop condition.
+    pthread_mutex_lock(&svHartsMutex);
+    numHarts = svNumHarts;
+    pthread_mutex_unlock(&svHartsMutex);
   }
 
-  return status;
+  // Report the status of the hart which ended the simulation, and make it the
+  // current one so that its state can be inspected.
+  if (svStoppingHart == NULL)
+    return SV_STATUS_TERMINATED;
+  svCurHart = svStoppingHart;
+  cpuSetCurrentHart(svStoppingHart->cpu);
+  return svStoppingHart->status;
 }
@@ -3,13 +3,17 @@
 
 #include "isa.h"
 #include "cpu.h"
+#include "memory.h"
 
 #define SV_STACK_PAGE_SIZE 4096
+#define SV_MAX_HARTS CPU_MAX_HARTS
+#define SV_DEFAULT_STACK_SIZE 0x1000000
 
 typedef int t_svError;
 enum {
   SV_NO_ERROR = 0,
-  SV_MEMORY_ERROR = -1
+  SV_MEMORY_ERROR = -1,
+  SV_INVALID_STACK_SIZE = -2
 };
 
 typedef int t_svStatus;
@@ -17,14 +21,21 @@ enum {
   SV_STATUS_RUNNING = 0,
   SV_STATUS_TERMINATED = 1,
   SV_STATUS_KILLED = 2,
+  SV_STATUS_HART_EXITED = 3,
+  SV_STATUS_INSTR_LIMIT = 4,
+  SV_STATUS_TIMEOUT = 5,
   SV_STATUS_MEMORY_FAULT = CPU_STATUS_MEMORY_FAULT,
   SV_STATUS_ILL_INST_FAULT = CPU_STATUS_ILL_INST_FAULT,
   SV_STATUS_INVALID_SYSCALL = -1000
 };
 
 
-t_svError initSupervisor(void);
+t_svError initSupervisor(int maxHarts, t_memSize stackSize);
+void svSetLimits(uint64_t maxInstrs, double timeout);
 t_svStatus svVMTick(void);
+t_svStatus svRun(void);
 t_isaInt svGetExitCode(void);
+t_memAddress svGetFaultAddress(void);
+uint64_t svGetRetiredInstrs(void);
 
 #endif
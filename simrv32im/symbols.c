@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "symbols.h"
+
+/* Debugging information read from the executable: the labels from .symtab
+ * and the mapping of code addresses to source lines from .srclines. Both are
+ * added while loading the program, and sorted by address on the first
+ * lookup. */
+
+typedef struct {
+  t_memAddress address;
+  char *name;
+} t_symLabel;
+
+t_symLabel *symLabels = NULL;
+size_t symNumLabels = 0;
+size_t symLabelsBufSize = 0;
+bool symLabelsSorted = true;
+
+char **symFiles = NULL;
+int symNumFiles = 0;
+t_symSourceLine *symLines = NULL;
+size_t symNumLines = 0;
+size_t symLinesBufSize = 0;
+bool symLinesSorted = true;
+
+
+t_symError symAddLabel(t_memAddress addr, const char *name)
+{
+  if (symNumLabels == symLabelsBufSize) {
+    size_t newSize = symLabelsBufSize * 2 + 64;
+    t_symLabel *newLabels = realloc(symLabels, sizeof(t_symLabel) * newSize);
+    if (newLabels == NULL)
+      return SYM_MEMORY_ERROR;
+    symLabels = newLabels;
+    symLabelsBufSize = newSize;
+  }
+  char *nameCopy = strdup(name);
+  if (nameCopy == NULL)
+    return SYM_MEMORY_ERROR;
+  symLabels[symNumLabels].address = addr;
+  symLabels[symNumLabels].name = nameCopy;
+  symNumLabels++;
+  symLabelsSorted = false;
+  return SYM_NO_ERROR;
+}
+
+
+t_symError symAddSourceLine(t_memAddress addr, const char *file, int line)
+{
+  int fileIdx = symNumFiles - 1;
+  if (fileIdx < 0 || strcmp(symFiles[fileIdx], file) != 0) {
+    for (fileIdx = 0; fileIdx < symNumFiles; fileIdx++) {
+      if (strcmp(symFiles[fileIdx], file) == 0)
+        break;
+    }
+  }
+  if (fileIdx == symNumFiles) {
+    char **newFiles = realloc(symFiles, sizeof(char *) * (symNumFiles + 1));
+    if (newFiles == NULL)
+      return SYM_MEMORY_ERROR;
+    symFiles = newFiles;
+    symFiles[fileIdx] = strdup(file);
+    if (symFiles[fileIdx] == NULL)
+      return SYM_MEMORY_ERROR;
+    symNumFiles++;
+  }
+
+  if (symNumLines == symLinesBufSize) {
+    size_t newSize = symLinesBufSize * 2 + 64;
+    t_symSourceLine *newLines =
+        realloc(symLines, sizeof(t_symSourceLine) * newSize);
+    if (newLines == NULL)
+      return SYM_MEMORY_ERROR;
+    symLines = newLines;
+    symLinesBufSize = newSize;
+  }
+  symLines[symNumLines].address = addr;
+  symLines[symNumLines].file = fileIdx;
+  symLines[symNumLines].line = line;
+  symNumLines++;
+  symLinesSorted = false;
+  return SYM_NO_ERROR;
+}
+
+
+static int symCompareLabels(const void *a, const void *b)
+{
+  const t_symLabel *la = a, *lb = b;
+  if (la->address != lb->address)
+    return la->address < lb->address ? -1 : 1;
+  return strcmp(la->name, lb->name);
+}
+
+static int symCompareLines(const void *a, const void *b)
+{
+  const t_symSourceLine *la = a, *lb = b;
+  if (la->address != lb->address)
+    return la->address < lb->address ? -1 : 1;
+  return 0;
+}
+
+
+/* Returns the closest label at or before `addr`, and the distance of `addr`
+ * from it in *outOffset. Returns NULL if there is no such label. */
+const char *symGetLabel(t_memAddress addr, t_memAddress *outOffset)
+{
+  if (!symLabelsSorted) {
+    qsort(symLabels, symNumLabels, sizeof(t_symLabel), symCompareLabels);
+    symLabelsSorted = true;
+  }
+
+  size_t lo = 0, hi = symNumLabels;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (symLabels[mid].address <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return NULL;
+  // Among labels at the same address, prefer the first one.
+  t_memAddress labelAddr = symLabels[lo - 1].address;
+  while (lo > 1 && symLabels[lo - 2].address == labelAddr)
+    lo--;
+  if (outOffset)
+    *outOffset = addr - labelAddr;
+  return symLabels[lo - 1].name;
+}
+
+
+/* Returns the source line the code at `addr` was generated from, that is the
+ * closest line entry at or before `addr`. */
+bool symGetSourceLine(t_memAddress addr, const char **outFile, int *outLine)
+{
+  size_t count;
+  const t_symSourceLine *lines = symGetSourceLines(&count);
+
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (lines[mid].address <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return false;
+  if (outFile)
+    *outFile = symFiles[lines[lo - 1].file];
+  if (outLine)
+    *outLine = lines[lo - 1].line;
+  return true;
+}
+
+
+/* Returns all the line entries sorted by address. */
+const t_symSourceLine *symGetSourceLines(size_t *outCount)
+{
+  if (!symLinesSorted) {
+    qsort(symLines, symNumLines, sizeof(t_symSourceLine), symCompareLines);
+    symLinesSorted = true;
+  }
+  *outCount = symNumLines;
+  return symLines;
+}
+
+
+const char *symGetFileName(int file)
+{
+  return symFiles[file];
+}
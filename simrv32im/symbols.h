@@ -0,0 +1,30 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "memory.h"
+
+typedef int t_symError;
+enum {
+  SYM_NO_ERROR = 0,
+  SYM_MEMORY_ERROR = -1
+};
+
+typedef struct {
+  t_memAddress address;
+  int file;
+  int line;
+} t_symSourceLine;
+
+
+t_symError symAddLabel(t_memAddress addr, const char *name);
+t_symError symAddSourceLine(t_memAddress addr, const char *file, int line);
+
+const char *symGetLabel(t_memAddress addr, t_memAddress *outOffset);
+bool symGetSourceLine(t_memAddress addr, const char **outFile, int *outLine);
+
+const t_symSourceLine *symGetSourceLines(size_t *outCount);
+const char *symGetFileName(int file);
+
+#endif
@@ -0,0 +1,47 @@
+# See LICENSE for license details.
+
+#*****************************************************************************
+# amo.S
+#-----------------------------------------------------------------------------
+
+# Test LR/SC and AMO instructions (single hart).
+
+.text; .global _start; .global amo_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "amo"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  #-------------------------------------------------------------
+  # AMO tests
+  #-------------------------------------------------------------
+  test_2: la a3, amo_data; li a1, 0xffff8000; sw a1, 0(a3); li a2, 0x80000000; amoadd.w a4, a2, (a3);; li x29, 0xffff8000; li x28, 2; bne a4, x29, fail;;
+  test_3: lw a5, 0(a3);; li x29, 0x7fff8000; li x28, 3; bne a5, x29, fail;;
+  test_4: la a3, amo_data; li a1, 0x12345678; sw a1, 0(a3); li a2, 0x80000000; amoswap.w a4, a2, (a3);; li x29, 0x12345678; li x28, 4; bne a4, x29, fail;;
+  test_5: lw a5, 0(a3);; li x29, 0x80000000; li x28, 5; bne a5, x29, fail;;
+  test_6: la a3, amo_data; li a1, 0xff00ff00; sw a1, 0(a3); li a2, 0x0ff00ff0; amoxor.w a4, a2, (a3);; li x29, 0xff00ff00; li x28, 6; bne a4, x29, fail;;
+  test_7: lw a5, 0(a3);; li x29, 0xf0f0f0f0; li x28, 7; bne a5, x29, fail;;
+  test_8: la a3, amo_data; li a1, 0xff00ff00; sw a1, 0(a3); li a2, 0x0ff00ff0; amoand.w a4, a2, (a3);; li x29, 0xff00ff00; li x28, 8; bne a4, x29, fail;;
+  test_9: lw a5, 0(a3);; li x29, 0x0f000f00; li x28, 9; bne a5, x29, fail;;
+  test_10: la a3, amo_data; li a1, 0xff00ff00; sw a1, 0(a3); li a2, 0x0ff00ff0; amoor.w a4, a2, (a3);; li x29, 0xff00ff00; li x28, 10; bne a4, x29, fail;;
+  test_11: lw a5, 0(a3);; li x29, 0xfff0fff0; li x28, 11; bne a5, x29, fail;;
+  test_12: la a3, amo_data; li a1, 0x00000001; sw a1, 0(a3); li a2, 0xffffffff; amomin.w a4, a2, (a3);; li x29, 0x00000001; li x28, 12; bne a4, x29, fail;;
+  test_13: lw a5, 0(a3);; li x29, 0xffffffff; li x28, 13; bne a5, x29, fail;;
+  test_14: la a3, amo_data; li a1, 0x00000001; sw a1, 0(a3); li a2, 0xffffffff; amomax.w a4, a2, (a3);; li x29, 0x00000001; li x28, 14; bne a4, x29, fail;;
+  test_15: lw a5, 0(a3);; li x29, 0x00000001; li x28, 15; bne a5, x29, fail;;
+  test_16: la a3, amo_data; li a1, 0x00000001; sw a1, 0(a3); li a2, 0xffffffff; amominu.w a4, a2, (a3);; li x29, 0x00000001; li x28, 16; bne a4, x29, fail;;
+  test_17: lw a5, 0(a3);; li x29, 0x00000001; li x28, 17; bne a5, x29, fail;;
+  test_18: la a3, amo_data; li a1, 0x00000001; sw a1, 0(a3); li a2, 0xffffffff; amomaxu.w a4, a2, (a3);; li x29, 0x00000001; li x28, 18; bne a4, x29, fail;;
+  test_19: lw a5, 0(a3);; li x29, 0xffffffff; li x28, 19; bne a5, x29, fail;;
+  test_20: la a3, amo_data; li a1, 42; sw a1, 0(a3); lr.w a4, (a3); addi a4, a4, 1; sc.w a5, a4, (a3);; li x29, 0; li x28, 20; bne a5, x29, fail;;
+  test_21: lw a5, 0(a3);; li x29, 43; li x28, 21; bne a5, x29, fail;;
+  test_22: li a4, 7; sc.w a5, a4, (a3);; li x29, 1; li x28, 22; bne a5, x29, fail;;
+  test_23: lw a5, 0(a3);; li x29, 43; li x28, 23; bne a5, x29, fail;;
+  test_24: lr.w a4, (a3); li a1, 5; sw a1, 0(a3); sc.w a5, a4, (a3);; li x29, 1; li x28, 24; bne a5, x29, fail;;
+  test_25: csrr a4, mhartid;; li x29, 0; li x28, 25; bne a4, x29, fail;;
+  test_26: lr.w a4, (a3); li a1, 5; sw a1, 0(a3); sw a4, 0(a3); sc.w a5, a4, (a3);; li x29, 1; li x28, 26; bne a5, x29, fail;;
+  test_27: lr.w a4, (a3); li a1, 1; amoadd.w x0, a1, (a3); li a1, -1; amoadd.w x0, a1, (a3); sc.w a5, a4, (a3);; li x29, 1; li x28, 27; bne a5, x29, fail;;
+  test_28: lr.w a4, (a3); lb a1, 3(a3); sb a1, 3(a3); sc.w a5, a4, (a3);; li x29, 1; li x28, 28; bne a5, x29, fail;;
+  test_29: lr.w a4, (a3); sw a4, 4(a3); addi a4, a4, 1; sc.w a5, a4, (a3);; li x29, 0; li x28, 29; bne a5, x29, fail;;
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,amo_ret;
+amo_ret: li a7,93; li a0,0; ecall;
+  .data
+.balign 4;
+amo_data: .word 0, 0
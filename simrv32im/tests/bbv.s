@@ -0,0 +1,13 @@
+# Test the --bbv option: each line counts the instructions executed in each
+# basic block during an interval of 10 instructions.
+
+        .text
+        .global _start
+_start: li     s0, 0
+        li     s1, 10
+l_loop: addi   s0, s0, 1
+        slt    t0, s0, s1
+        bnez   t0, l_loop
+        li     a0, 0
+        li     a7, 93
+        ecall
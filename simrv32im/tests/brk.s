@@ -0,0 +1,28 @@
+# Test the brk system call, which grows and shrinks the heap placed after the
+# program, and accesses to the stack far away from its top.
+
+.text; .global _start; .global brk_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "brk"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  #-------------------------------------------------------------
+  # Heap
+  #-------------------------------------------------------------
+  test_2: li a0, 0; li a7, 214; ecall; addi s1, a0, 0; slli t0, s1, 20;; li x29, 0; li x28, 2; bne t0, x29, fail;;
+  test_3: la t0, data_end; sltu t0, s1, t0;; li x29, 0; li x28, 3; bne t0, x29, fail;;
+  test_4: li t0, 8192; add a0, s1, t0; li a7, 214; ecall; sub a0, a0, s1;; li x29, 8192; li x28, 4; bne a0, x29, fail;;
+  test_5: li t0, 0x1234; sw t0, 0(s1); li t1, 8188; add t1, s1, t1; sw t0, 0(t1); lw a4, 0(t1);; li x29, 0x1234; li x28, 5; bne a4, x29, fail;;
+  test_6: li a0, 1; li a7, 214; ecall; sub a0, a0, s1;; li x29, 8192; li x28, 6; bne a0, x29, fail;;
+  test_7: addi a0, s1, 4; li a7, 214; ecall; sub a0, a0, s1;; li x29, 4; li x28, 7; bne a0, x29, fail;;
+  test_8: lw a4, 0(s1);; li x29, 0x1234; li x28, 8; bne a4, x29, fail;;
+
+  #-------------------------------------------------------------
+  # Stack
+  #-------------------------------------------------------------
+  test_9: li t0, 0x800000; sub t1, sp, t0; li t0, 0x5678; sw t0, 0(t1); lw a4, 0(t1);; li x29, 0x5678; li x28, 9; bne a4, x29, fail;;
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,brk_ret;
+brk_ret: li a7,93; li a0,0; ecall;
+
+  .data
+.balign 4;
+data_buf: .space 5000
+data_end:
@@ -0,0 +1,22 @@
+# Test the --compare option, together with compare_b.s: both programs read
+# a number n and print the sum of the integers from 1 to n. This one uses a
+# loop, compare_b.s uses a formula.
+
+        .text
+        .global _start
+_start: li     a7, 5                    # compare.src:1
+        ecall
+        addi   s0, a0, 0
+        li     s1, 0                    # compare.src:2
+loop:
+        beqz   s0, done                 # compare.src:3
+        add    s1, s1, s0               # compare.src:4
+        addi   s0, s0, -1
+        j      loop
+done:
+        addi   a0, s1, 0                # compare.src:5
+        li     a7, 1
+        ecall
+        li     a0, 0                    # compare.src:6
+        li     a7, 93
+        ecall
@@ -0,0 +1,19 @@
+# Test the --compare option, together with compare_a.s: both programs read
+# a number n and print the sum of the integers from 1 to n. This one uses a
+# formula, compare_a.s uses a loop.
+
+        .text
+        .global _start
+_start: li     a7, 5                    # compare.src:1
+        ecall
+        addi   s0, a0, 0
+        addi   s1, s0, 1                # compare.src:2
+        mul    s1, s1, s0
+        li     t0, 2
+        div    s1, s1, t0
+        addi   a0, s1, 0                # compare.src:5
+        li     a7, 1
+        ecall
+        li     a0, 0                    # compare.src:6
+        li     a7, 93
+        ecall
@@ -0,0 +1,21 @@
+# Test the --coverage option: the "file:line" comments emitted by ACSE map
+# the code to source lines, which are reported as hit only if executed.
+
+        .text
+        .global _start
+_start: li     s0, 0                    # coverage.src:1
+        li     s1, 10                   # coverage.src:2
+l_loop: addi   s0, s0, 1                # coverage.src:3
+        slt    t0, s0, s1               # coverage.src:4
+        bnez   t0, l_loop
+        li     t1, 5                    # coverage.src:5
+        beq    s0, t1, l_never          # coverage.src:6
+        j      l_done
+l_never:
+        li     s0, 0                    # coverage.src:7
+        addi   s0, s0, 1
+l_done: li     a0, 0                    # coverage.src:8
+        li     a7, 93                   # lib.src:1
+        ecall
+        li     a7, 10                   # lib.src:2
+        ecall
@@ -0,0 +1,27 @@
+# Test multi-hart execution: three harts increment shared counters with
+# AMOADD.W and with a LR.W/SC.W loop, the boot hart joins them and checks
+# the result.
+
+.text; .global _start; .global harts_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "harts"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  #-------------------------------------------------------------
+  # Spawn and join
+  #-------------------------------------------------------------
+  test_2: la a0, worker; li a1, 1000; li a7, 500; ecall; addi s1, a0, 0;; li x29, 1; li x28, 2; bne s1, x29, fail;;
+  test_3: la a0, worker; li a1, 1000; li a7, 500; ecall; addi s2, a0, 0;; li x29, 2; li x28, 3; bne s2, x29, fail;;
+  test_4: la a0, worker; li a1, 1000; li a7, 500; ecall; addi s3, a0, 0;; li x29, 3; li x28, 4; bne s3, x29, fail;;
+  test_5: la a0, worker; li a1, 1000; li a7, 500; ecall;; li x29, -1; li x28, 5; bne a0, x29, fail;;
+  test_6: addi a0, s1, 0; li a7, 502; ecall; addi a0, s2, 0; li a7, 502; ecall; addi a0, s3, 0; li a7, 502; ecall;; li x29, 0; li x28, 6; bne a0, x29, fail;;
+  test_7: la a3, amo_counter; lw a4, 0(a3);; li x29, 3000; li x28, 7; bne a4, x29, fail;;
+  test_8: la a3, lrsc_counter; lw a4, 0(a3);; li x29, 3000; li x28, 8; bne a4, x29, fail;;
+  test_9: la a3, hart_ids; lw a4, 0(a3);; li x29, 14; li x28, 9; bne a4, x29, fail;;
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,harts_ret;
+harts_ret: li a7,93; li a0,0; ecall;
+
+worker: la a3, amo_counter; la a4, lrsc_counter; li a5, 1; worker_loop: amoadd.w zero, a5, (a3); 1: lr.w t0, (a4); addi t0, t0, 1; sc.w t1, t0, (a4); bnez t1, 1b; addi a0, a0, -1; bnez a0, worker_loop; csrr t0, mhartid; sll t0, a5, t0; la a3, hart_ids; amoor.w zero, t0, (a3); addi sp, sp, -4; sw t0, 0(sp); li a7, 501; ecall;
+  .data
+.balign 4;
+amo_counter: .word 0
+lrsc_counter: .word 0
+hart_ids: .word 0
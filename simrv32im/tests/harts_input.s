@@ -0,0 +1,21 @@
+# Test the exit of the program while another hart waits for input that never
+# comes: the boot hart gives the reader the time to block, then exits.
+
+        .text
+        .global _start
+_start:
+        la     a0, reader
+        li     a1, 0
+        li     a7, 500
+        ecall
+        li     t0, 5000000
+l_wait: addi   t0, t0, -1
+        bnez   t0, l_wait
+        li     a0, 7
+        li     a7, 93
+        ecall
+reader:
+        li     a7, 5
+        ecall
+        li     a7, 501
+        ecall
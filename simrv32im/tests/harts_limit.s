@@ -0,0 +1,18 @@
+# Test the --max-instructions option with several harts: the boot hart and
+# three other harts spin forever, and the limit applies to all of them
+# together.
+
+        .text
+        .global _start
+_start:
+        li     s0, 3
+1:
+        la     a0, spin
+        li     a1, 0
+        li     a7, 500
+        ecall
+        addi   s0, s0, -1
+        bnez   s0, 1b
+spin:
+        addi   t0, t0, 1
+        j      spin
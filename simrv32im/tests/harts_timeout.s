@@ -0,0 +1,20 @@
+# Test the --timeout option while all harts are blocked: the boot hart joins
+# a hart which waits for input that never comes.
+
+        .text
+        .global _start
+_start:
+        la     a0, reader
+        li     a1, 0
+        li     a7, 500
+        ecall
+        li     a7, 502
+        ecall
+        li     a0, 0
+        li     a7, 93
+        ecall
+reader:
+        li     a7, 12
+        ecall
+        li     a7, 501
+        ecall
@@ -0,0 +1,8 @@
+# Test the --max-instructions and --timeout options on an infinite loop.
+
+        .text
+        .global _start
+_start: li     t0, 0                    # limit.src:1
+spin:
+        addi   t0, t0, 1                # limit.src:2
+        j      spin
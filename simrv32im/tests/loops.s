@@ -0,0 +1,41 @@
+# Test the --loops option: a loop nested in another one, with a different
+# number of iterations at every entry, a loop in a function called from a
+# loop, and a loop with the condition at the head which is last entered
+# without running its body.
+
+        .text
+        .global _start
+_start: li     s0, 0                    # loops.src:1
+        li     s1, 4
+l_outer:
+        li     s2, 0                    # loops.src:2
+l_inner:
+        addi   s2, s2, 1                # loops.src:3
+        blt    s2, s0, l_inner
+        addi   s0, s0, 1                # loops.src:4
+        bne    s0, s1, l_outer
+        li     s0, 3                    # loops.src:5
+l_calls:
+        jal    f_count
+        addi   s0, s0, -1
+        bnez   s0, l_calls
+        li     s0, 2                    # loops.src:6
+l_again:
+        li     s2, 0                    # loops.src:7
+l_while:
+        bge    s2, s0, l_done           # loops.src:8
+        addi   s2, s2, 1
+        j      l_while
+l_done:
+        addi   s0, s0, -1               # loops.src:9
+        bgez   s0, l_again
+        li     a0, 0                    # loops.src:10
+        li     a7, 93
+        ecall
+
+f_count:
+        li     t0, 100                  # loops.src:11
+l_count:
+        addi   t0, t0, -1               # loops.src:12
+        bnez   t0, l_count
+        jalr   zero, 0(ra)
@@ -0,0 +1,70 @@
+# Test that instructions overwritten by the program are executed with their
+# new encoding, although they were already decoded.
+
+.text; .global _start; .global selfmod_ret; _start: lui s0,%hi(test_name); addi s0,s0,%lo(test_name); name_print_loop: lb a0,0(s0); beqz a0,prname_done; li a7,11; ecall; addi s0,s0,1; j name_print_loop; test_name: .ascii "selfmod"; .byte '.','.',0x00; .balign 4, 0; prname_done:
+
+  # Overwrite an instruction already executed with a word store.
+  li x28, 2
+  li s1, 0
+patch_2:
+  addi a0, zero, 1
+  bnez s1, check_2
+  la t0, patch_2
+  li t1, 0x00200513 # addi a0, zero, 2
+  sw t1, 0(t0)
+  li s1, 1
+  j patch_2
+check_2:
+  li x29, 2
+  bne a0, x29, fail
+
+  # Overwrite the immediate of an instruction which follows the patched one.
+  li x28, 3
+  li s1, 0
+patch_3:
+  lui a0, 0x12
+  addi a0, a0, 0x345
+  bnez s1, check_3
+  la t0, patch_3
+  lw t1, 4(t0)
+  li t2, 0x000FFFFF
+  and t1, t1, t2
+  sw t1, 4(t0)
+  li s1, 1
+  j patch_3
+check_3:
+  li x29, 0x12000
+  bne a0, x29, fail
+
+  # Overwrite the immediate of an instruction with a byte store.
+  li x28, 4
+  li s1, 0
+patch_4:
+  addi a0, zero, 1
+  bnez s1, check_4
+  la t0, patch_4
+  li t1, 0x30
+  sb t1, 2(t0)
+  li s1, 1
+  j patch_4
+check_4:
+  li x29, 3
+  bne a0, x29, fail
+
+  # Overwrite an instruction with an AMO.
+  li x28, 5
+  li s1, 0
+patch_5:
+  addi a0, zero, 1
+  bnez s1, check_5
+  la t0, patch_5
+  li t1, 0x00300000 # add 3 to the immediate
+  amoadd.w zero, t1, (t0)
+  li s1, 1
+  j patch_5
+check_5:
+  li x29, 4
+  bne a0, x29, fail
+
+  bne x0, x28, pass; fail: j fail_print; fail_string: .ascii "FAIL\n\0"; .balign 4, 0; fail_print: la s0,fail_string; fail_print_loop: lb a0,0(s0); beqz a0,fail_print_exit; li a7,11; ecall; addi s0,s0,1; j fail_print_loop; fail_print_exit: li a7,93; li a0,1; ecall;; pass: j pass_print; pass_string: .ascii "PASS!\n\0"; .balign 4, 0; pass_print: la s0,pass_string; pass_print_loop: lb a0,0(s0); beqz a0,pass_print_exit; li a7,11; ecall; addi s0,s0,1; j pass_print_loop; pass_print_exit: jal zero,selfmod_ret;
+selfmod_ret: li a7,93; li a0,0; ecall;
@@ -0,0 +1,20 @@
+# Test the --simpoints option: the program has a phase of additions and a
+# phase of divisions, and simpoint.points picks one interval of 90
+# instructions from each of them. Their weights in simpoint.weights are the
+# fractions of the instructions of the program spent in each phase.
+
+        .text
+        .global _start
+_start: li     t0, 0
+        li     t1, 0
+        li     s1, 300
+        li     s2, 200
+l_add:  addi   t0, t0, 1
+        add    t1, t1, t0
+        blt    t0, s1, l_add
+l_div:  div    t2, t1, t0
+        addi   t0, t0, -1
+        bgt    t0, s2, l_div
+        li     a0, 0
+        li     a7, 93
+        ecall
@@ -0,0 +1,28 @@
+# Test the --value-profile option: a divisor, a multiplier and a shift
+# amount that never change, a divisor that takes more values than the ones
+# tracked, and instructions that are not profiled.
+
+        .text
+        .global _start
+_start: li     s0, 0                    # valprof.src:1
+        li     s1, 20
+        li     s2, 10
+        li     s3, 33
+        li     s4, -3
+loop:
+        div    t0, s0, s2               # valprof.src:2
+        andi   t1, s0, 1
+        addi   t1, t1, 1
+        remu   t2, s0, t1               # valprof.src:3
+        addi   t1, s0, 1
+        rem    t2, s1, t1               # valprof.src:4
+        mul    t3, s0, s4               # valprof.src:5
+        mulh   t3, s0, s4
+        sll    t4, s0, s3               # valprof.src:6
+        sra    t4, t4, t1
+        add    t5, t4, t3
+        addi   s0, s0, 1
+        bne    s0, s1, loop
+        li     a0, 0                    # valprof.src:7
+        li     a7, 93
+        ecall
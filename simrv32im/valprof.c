@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "valprof.h"
+#include "memory.h"
+#include "symbols.h"
+
+/* Value profiling of the operands of MUL (both), DIV, DIVU, REM, REMU (the
+ * divisor) and SLL, SRL, SRA (the shift amount). The most frequent values of
+ * every operand are found with the Space-Saving algorithm: each operand keeps
+ * VP_TRACKED_VALUES counters, and a new value replaces the least frequent
+ * one, inheriting its count. The counts of the values reported are exact
+ * unless more than VP_TRACKED_VALUES distinct values were seen, in which case
+ * they are upper bounds.
+ *   The profile has one line per operand, sorted by address, with fields
+ * separated by spaces:
+ *   <pc> <file>:<line> <mnemonic> <rs1|rs2> <executions> <value>:<count>...
+ * The source location is "-" when unknown. Values are printed in decimal,
+ * signed for the signed operations, and ordered by decreasing count.
+ *   Only the boot hart is profiled. */
+
+#define VP_TRACKED_VALUES 8
+#define VP_REPORTED_VALUES 4
+
+typedef struct {
+  uint32_t value;
+  uint64_t count;
+} t_vpCounter;
+
+typedef struct {
+  uint64_t executions;
+  int numCounters;
+  t_vpCounter counters[VP_TRACKED_VALUES];
+} t_vpOperand;
+
+typedef struct {
+  t_memAddress pc;
+  uint32_t instr;
+  t_vpOperand operands[2];
+} t_vpSite;
+
+bool vpEnabled = false;
+bool vpOutOfMemory = false;
+
+/* Open addressing hash table from addresses to profiled instructions. */
+t_vpSite **vpSites = NULL;
+uint32_t vpSitesSize = 0;
+uint32_t vpNumSites = 0;
+
+
+void vpEnable(void)
+{
+  vpEnabled = true;
+  cpuSetValueProfiling(true);
+}
+
+
+static uint32_t vpHash(t_memAddress addr)
+{
+  return (addr >> 2) * 0x9E3779B1u;
+}
+
+static bool vpGrowSites(void)
+{
+  uint32_t newSize = vpSitesSize ? vpSitesSize * 2 : 256;
+  t_vpSite **newSites = calloc(newSize, sizeof(t_vpSite *));
+  if (newSites == NULL)
+    return false;
+  for (uint32_t i = 0; i < vpSitesSize; i++) {
+    if (vpSites[i] == NULL)
+      continue;
+    uint32_t slot = vpHash(vpSites[i]->pc) & (newSize - 1);
+    while (newSites[slot] != NULL)
+      slot = (slot + 1) & (newSize - 1);
+    newSites[slot] = vpSites[i];
+  }
+  free(vpSites);
+  vpSites = newSites;
+  vpSitesSize = newSize;
+  return true;
+}
+
+static t_vpSite *vpGetSite(t_memAddress pc, uint32_t instr)
+{
+  // Keep the load of the hash table under 50%
+  if ((vpNumSites + 1) * 2 > vpSitesSize && !vpGrowSites())
+    return NULL;
+  uint32_t slot = vpHash(pc) & (vpSitesSize - 1);
+  for (; vpSites[slot] != NULL; slot = (slot + 1) & (vpSitesSize - 1)) {
+    // Self-modifying code may place a different instruction at the same pc
+    if (vpSites[slot]->pc == pc && vpSites[slot]->instr == instr)
+      return vpSites[slot];
+  }
+
+  t_vpSite *site = calloc(1, sizeof(t_vpSite));
+  if (site == NULL)
+    return NULL;
+  site->pc = pc;
+  site->instr = instr;
+  vpSites[slot] = site;
+  vpNumSites++;
+  return site;
+}
+
+static void vpRecordValue(t_vpOperand *op, uint32_t value)
+{
+  op->executions++;
+  int minIdx = 0;
+  for (int i = 0; i < op->numCounters; i++) {
+    if (op->counters[i].value == value) {
+      op->counters[i].count++;
+      return;
+    }
+    if (op->counters[i].count < op->counters[minIdx].count)
+      minIdx = i;
+  }
+  if (op->numCounters < VP_TRACKED_VALUES) {
+    op->counters[op->numCounters].value = value;
+    op->counters[op->numCounters].count = 1;
+    op->numCounters++;
+    return;
+  }
+  op->counters[minIdx].value = value;
+  op->counters[minIdx].count++;
+}
+
+
+/* Must be called before the instruction is executed, as it may overwrite
+ * its source registers. */
+void vpRecordOP(t_cpuHart *hart, uint32_t instr)
+{
+  uint32_t funct7 = ISA_INST_FUNCT7(instr);
+  uint32_t funct3 = ISA_INST_FUNCT3(instr);
+  bool isShift = (funct3 == 1 && funct7 == 0x00) ||
+      (funct3 == 5 && (funct7 == 0x00 || funct7 == 0x20));
+  bool isMul = funct7 == 0x01 && funct3 == 0;
+  bool isDiv = funct7 == 0x01 && funct3 >= 4;
+  if (hart->hartID != 0 || vpOutOfMemory || !(isShift || isMul || isDiv))
+    return;
+
+  t_vpSite *site = vpGetSite(hart->pc, instr);
+  if (site == NULL) {
+    vpOutOfMemory = true;
+    return;
+  }
+  uint32_t src1 = hart->regs[ISA_INST_RS1(instr)];
+  uint32_t src2 = hart->regs[ISA_INST_RS2(instr)];
+  if (isMul)
+    vpRecordValue(&site->operands[0], src1);
+  vpRecordValue(&site->operands[1], isShift ? src2 & 0x1F : src2);
+}
+
+
+static const char *vpMnemonic(uint32_t instr, bool *isSigned)
+{
+  static const char *mulDiv[8] = {
+      "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu"};
+  uint32_t funct3 = ISA_INST_FUNCT3(instr);
+  *isSigned = false;
+  if (ISA_INST_FUNCT7(instr) == 0x01) {
+    *isSigned = funct3 == 0 || funct3 == 4 || funct3 == 6;
+    return mulDiv[funct3];
+  }
+  if (funct3 == 1)
+    return "sll";
+  return ISA_INST_FUNCT7(instr) == 0x20 ? "sra" : "srl";
+}
+
+static int vpCompareSites(const void *a, const void *b)
+{
+  const t_vpSite *sa = *(t_vpSite *const *)a;
+  const t_vpSite *sb = *(t_vpSite *const *)b;
+  if (sa->pc != sb->pc)
+    return sa->pc < sb->pc ? -1 : 1;
+  return sa->instr < sb->instr ? -1 : (sa->instr > sb->instr);
+}
+
+static int vpCompareCounters(const void *a, const void *b)
+{
+  const t_vpCounter *ca = a, *cb = b;
+  if (ca->count != cb->count)
+    return ca->count > cb->count ? -1 : 1;
+  return ca->value < cb->value ? -1 : (ca->value > cb->value);
+}
+
+t_vpError vpWriteProfile(const char *path)
+{
+  t_vpError res = VP_NO_ERROR;
+  t_vpSite **sites = NULL;
+
+  if (vpOutOfMemory)
+    return VP_MEMORY_ERROR;
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL)
+    return VP_FILE_ERROR;
+
+  sites = malloc(sizeof(t_vpSite *) * (vpNumSites + 1));
+  if (sites == NULL) {
+    res = VP_MEMORY_ERROR;
+    goto cleanup;
+  }
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < vpSitesSize; i++) {
+    if (vpSites[i] != NULL)
+      sites[n++] = vpSites[i];
+  }
+  qsort(sites, n, sizeof(t_vpSite *), vpCompareSites);
+
+  for (uint32_t i = 0; i < n; i++) {
+    bool isSigned;
+    const char *mnemonic = vpMnemonic(sites[i]->instr, &isSigned);
+    const char *file;
+    int line;
+    bool hasLine = symGetSourceLine(sites[i]->pc, &file, &line);
+    for (int opIdx = 0; opIdx < 2; opIdx++) {
+      t_vpOperand *op = &sites[i]->operands[opIdx];
+      if (op->executions == 0)
+        continue;
+      fprintf(fp, "0x%08" PRIx32, sites[i]->pc);
+      if (hasLine)
+        fprintf(fp, " %s:%d", file, line);
+      else
+        fputs(" -", fp);
+      fprintf(fp, " %s rs%d %llu", mnemonic, opIdx + 1,
+          (unsigned long long)op->executions);
+      qsort(op->counters, op->numCounters, sizeof(t_vpCounter),
+          vpCompareCounters);
+      for (int c = 0; c < op->numCounters && c < VP_REPORTED_VALUES; c++) {
+        if (isSigned)
+          fprintf(fp, " %" PRId32, (int32_t)op->counters[c].value);
+        else
+          fprintf(fp, " %" PRIu32, op->counters[c].value);
+        fprintf(fp, ":%llu", (unsigned long long)op->counters[c].count);
+      }
+      fputc('\n', fp);
+    }
+  }
+  if (ferror(fp))
+    res = VP_FILE_ERROR;
+
+cleanup:
+  free(sites);
+  if (fclose(fp) != 0 && res == VP_NO_ERROR)
+    res = VP_FILE_ERROR;
+  return res;
+}
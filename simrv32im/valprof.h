@@ -0,0 +1,21 @@
+#ifndef VALPROF_H
+#define VALPROF_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+typedef int t_vpError;
+enum {
+  VP_NO_ERROR = 0,
+  VP_MEMORY_ERROR = -1,
+  VP_FILE_ERROR = -2
+};
+
+
+void vpEnable(void);
+
+void vpRecordOP(t_cpuHart *hart, uint32_t instr);
+
+t_vpError vpWriteProfile(const char *path);
+
+#endif
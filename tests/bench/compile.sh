@@ -0,0 +1,136 @@
+#!/usr/bin/env bash
+# Measures the time taken by the compiler and by the assembler on the
+# programs generated by gen.sh, for every shape and for increasing sizes.
+# Each measurement is the best of a number of runs. For every size after the
+# first one, the growth exponent of the time with respect to the previous
+# size is reported (1 for a linear growth, 2 for a quadratic one), and the
+# growths above the threshold are flagged as super-linear.
+#
+# usage: compile.sh [-j] [-r runs] [-n sizes] [-s shapes] [-t threshold]
+#                   [-c compiler] [-a assembler] [-o dir]
+#   -j  prints the results in JSON format
+#   -r  number of runs of every measurement (default 3)
+#   -n  sizes of the programs, in increasing order (default "500 1000 2000")
+#   -s  shapes of the programs (default "scalars arrays nesting exprs
+#       pressure")
+#   -t  growth exponent above which a growth is flagged (default 1.5)
+#   -c  path of the compiler (default ../../bin/acse)
+#   -a  path of the assembler (default ../../bin/asrv32im)
+#   -o  directory of the generated files (default ./out)
+# Times shorter than 50 ms are too imprecise to compute a growth from.
+
+acse=../../bin/acse
+asm=../../bin/asrv32im
+out=./out
+json=0
+runs=3
+sizes="500 1000 2000"
+shapes="scalars arrays nesting exprs pressure"
+threshold=1.5
+while getopts "jr:n:s:t:c:a:o:" opt; do
+  case $opt in
+    j) json=1 ;;
+    r) runs=$OPTARG ;;
+    n) sizes=$OPTARG ;;
+    s) shapes=$OPTARG ;;
+    t) threshold=$OPTARG ;;
+    c) acse=$OPTARG ;;
+    a) asm=$OPTARG ;;
+    o) out=$OPTARG ;;
+    *) exit 2 ;;
+  esac
+done
+gen=$(dirname "$0")/gen.sh
+mkdir -p "$out" || exit 1
+
+# Prints the best wall time of a number of runs of a command, in seconds.
+best_time() {
+  local best='' i seconds
+  TIMEFORMAT=%3R
+  for ((i = 0; i < runs; i++)); do
+    # The time is on the standard error, after the one of the command
+    if ! seconds=$( { time "$@" >/dev/null 2>&1; } 2>&1 ); then
+      echo "failed: $*" >&2
+      return 1
+    fi
+    if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+      best=$seconds
+    fi
+  done
+  echo "$best"
+}
+
+# Prints the growth exponent from time t1 at size n1 to time t2 at size n2,
+# or "-" if the times are too short.
+growth() {
+  awk -v t1="$1" -v t2="$2" -v n1="$3" -v n2="$4" 'BEGIN {
+    if (t1 < 0.05 || t2 < 0.05)
+      print "-"
+    else
+      printf "%.2f\n", log(t2 / t1) / log(n2 / n1)
+  }'
+}
+
+# Prints "*" if a growth exponent is above the threshold.
+flag() {
+  awk -v g="$1" -v t="$threshold" \
+    'BEGIN { print (g != "-" && g > t) ? "*" : "" }'
+}
+
+if [ $json -eq 1 ]; then
+  printf '{\n  "date": "%s",\n  "results": [' "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+else
+  printf '%-10s %7s %8s %10s %7s %10s %7s\n' \
+    shape size lines acse growth asrv32im growth
+fi
+
+sep=''
+flagged=0
+for shape in $shapes; do
+  prev_size=''
+  for size in $sizes; do
+    name=$out/${shape}_$size
+    "$gen" -s "$shape" -n "$size" > "$name.src" || exit 1
+    lines=$(wc -l < "$name.src")
+    acse_time=$(best_time "$acse" "$name.src" -o "$name.s") || exit 1
+    asm_time=$(best_time "$asm" "$name.s" -o "$name.o") || exit 1
+
+    acse_growth=-
+    asm_growth=-
+    if [ -n "$prev_size" ]; then
+      acse_growth=$(growth "$prev_acse" "$acse_time" "$prev_size" "$size")
+      asm_growth=$(growth "$prev_asm" "$asm_time" "$prev_size" "$size")
+    fi
+    acse_flag=$(flag "$acse_growth")
+    asm_flag=$(flag "$asm_growth")
+    if [ -n "$acse_flag$asm_flag" ]; then
+      flagged=$((flagged + 1))
+    fi
+
+    if [ $json -eq 1 ]; then
+      printf '%s\n    {"shape": "%s", "size": %s, "lines": %s, ' \
+        "$sep" "$shape" "$size" "$lines"
+      printf '"acse_seconds": %s, "acse_growth": %s, ' "$acse_time" \
+        "$([ "$acse_growth" = - ] && echo null || echo "$acse_growth")"
+      printf '"asrv32im_seconds": %s, "asrv32im_growth": %s, ' "$asm_time" \
+        "$([ "$asm_growth" = - ] && echo null || echo "$asm_growth")"
+      printf '"superlinear": %s}' \
+        "$([ -n "$acse_flag$asm_flag" ] && echo true || echo false)"
+      sep=','
+    else
+      printf '%-10s %7s %8s %10s %6s%1s %10s %6s%1s\n' "$shape" "$size" \
+        "$lines" "$acse_time" "$acse_growth" "$acse_flag" "$asm_time" \
+        "$asm_growth" "$asm_flag"
+    fi
+
+    prev_size=$size
+    prev_acse=$acse_time
+    prev_asm=$asm_time
+  done
+done
+
+if [ $json -eq 1 ]; then
+  printf '\n  ]\n}\n'
+elif [ $flagged -gt 0 ]; then
+  printf '\n* growth exponent above %s (super-linear)\n' "$threshold"
+fi
@@ -0,0 +1,163 @@
+#!/bin/sh
+# Generates a synthetic LANCE program, for measuring how the compile time of
+# the toolchain grows with the size of its input. The program is written to
+# the standard output, and is always the same for the same options.
+#
+# usage: gen.sh [-s shape] [-n size] [-d depth]
+#   -s  shape of the program (default mixed):
+#         scalars   many scalar variables, each computed from earlier ones
+#         arrays    large arrays, read and written at computed indexes
+#         nesting   nests of if and while statements
+#         exprs     long expressions using all the binary operators
+#         pressure  expressions keeping many values live, like spilltest
+#         mixed     all of the above, each with a fifth of the size
+#   -n  number of statements (default 1000)
+#   -d  depth of the nests and of the pressure expressions (default 32)
+
+shape=mixed
+size=1000
+depth=32
+while getopts "s:n:d:" opt; do
+  case $opt in
+    s) shape=$OPTARG ;;
+    n) size=$OPTARG ;;
+    d) depth=$OPTARG ;;
+    *) exit 2 ;;
+  esac
+done
+
+case $shape in
+  scalars|arrays|nesting|exprs|pressure|mixed) ;;
+  *) echo "gen.sh: unknown shape '$shape'" >&2; exit 2 ;;
+esac
+
+exec awk -v shape="$shape" -v size="$size" -v depth="$depth" '
+# Park-Miller generator, portable across the implementations of awk.
+function rnd(n) {
+  seed = (seed * 16807) % 2147483647
+  return seed % n
+}
+
+# Declares the variables named prefix0 to prefix<n-1>, with the given
+# array size if not zero.
+function declare(prefix, n, arraySize,    i, line) {
+  for (i = 0; i < n; i++) {
+    line = line (i % 8 ? ", " : "int ") prefix i
+    if (arraySize)
+      line = line "[" arraySize "]"
+    if (i % 8 == 7 || i == n - 1) {
+      decls = decls line ";\n"
+      line = ""
+    }
+  }
+}
+
+function emit(indent, stmt) {
+  body = body sprintf("%" indent * 2 "s", "") stmt "\n"
+}
+
+function scalars(n,    i) {
+  declare("s", n, 0)
+  emit(0, "s0 = 1;")
+  for (i = 1; i < n; i++)
+    emit(0, "s" i " = s" rnd(i) " + s" rnd(i) " * " rnd(100) ";")
+  emit(0, "write(s" (n - 1) ");")
+}
+
+function arrays(n,    numArrays, i, a, b) {
+  numArrays = int(n / 500) + 1
+  declare("a", numArrays, 1024)
+  decls = decls "int ai;\n"
+  emit(0, "ai = 0;")
+  for (i = 0; i < n; i++) {
+    a = rnd(numArrays)
+    b = rnd(numArrays)
+    if (i % 16 == 15)
+      emit(0, "ai = (ai + a" a "[ai]) & 1023;")
+    else
+      emit(0, "a" a "[(ai + " rnd(1024) ") & 1023] = a" b "[(ai * " \
+          rnd(7) + 1 ") & 1023] + " rnd(100) ";")
+  }
+  emit(0, "write(ai);")
+}
+
+# Emits a nest of the given depth, whose levels are alternately while loops
+# executed once and if statements. Returns the number of statements emitted.
+function nest(level, d,    count) {
+  if (level == d) {
+    emit(level, "nv = nv + " rnd(100) ";")
+    return 1
+  }
+  if (level % 2 == 0) {
+    emit(level, "nc" level " = 1;")
+    emit(level, "while (nc" level " > 0) {")
+    emit(level + 1, "nc" level " = nc" level " - 1;")
+    count = nest(level + 1, d)
+    emit(level, "}")
+    return count + 3
+  }
+  emit(level, "if ((nv & " rnd(8) + 1 ") == 0) {")
+  count = nest(level + 1, d)
+  emit(level, "} else {")
+  emit(level + 1, "nv = nv - " rnd(100) ";")
+  emit(level, "}")
+  return count + 2
+}
+
+function nesting(n,    count) {
+  declare("nc", depth, 0)
+  decls = decls "int nv;\n"
+  emit(0, "nv = 0;")
+  for (count = 0; count < n; )
+    count += nest(0, depth)
+  emit(0, "write(nv);")
+}
+
+function operand(prefix, numVars) {
+  return rnd(4) ? prefix rnd(numVars) : rnd(1000)
+}
+
+function exprs(n,    i, j, ops, expr) {
+  split("+ - * / % & | ^ << >> < > <= >= == != && ||", ops, " ")
+  declare("e", 8, 0)
+  for (i = 0; i < 8; i++)
+    emit(0, "e" i " = " i + 1 ";")
+  for (i = 0; i < n; i++) {
+    expr = operand("e", 8)
+    for (j = 0; j < 32; j++)
+      expr = expr " " ops[rnd(18) + 1] " " operand("e", 8)
+    emit(0, "e" rnd(8) " = " expr ";")
+  }
+  emit(0, "write(e0 + e1 + e2 + e3 + e4 + e5 + e6 + e7);")
+}
+
+# Right-nested expressions keep every left operand live until the innermost
+# one is computed.
+function pressure(n,    i, j, ops, expr) {
+  split("+ - * & | ^", ops, " ")
+  declare("p", 8, 0)
+  for (i = 0; i < 8; i++)
+    emit(0, "p" i " = " i + 1 ";")
+  for (i = 0; i < n; i++) {
+    expr = operand("p", 8)
+    for (j = 0; j < depth; j++)
+      expr = operand("p", 8) " " ops[rnd(6) + 1] " (" expr ")"
+    emit(0, "p" rnd(8) " = " expr ";")
+  }
+  emit(0, "write(p0 + p1 + p2 + p3 + p4 + p5 + p6 + p7);")
+}
+
+BEGIN {
+  seed = 1
+  if (shape == "scalars" || shape == "mixed")
+    scalars(shape == "mixed" ? int(size / 5) + 1 : size)
+  if (shape == "arrays" || shape == "mixed")
+    arrays(shape == "mixed" ? int(size / 5) + 1 : size)
+  if (shape == "nesting" || shape == "mixed")
+    nesting(shape == "mixed" ? int(size / 5) + 1 : size)
+  if (shape == "exprs" || shape == "mixed")
+    exprs(shape == "mixed" ? int(size / 5) + 1 : size)
+  if (shape == "pressure" || shape == "mixed")
+    pressure(shape == "mixed" ? int(size / 5) + 1 : size)
+  printf "%s\n%s", decls, body
+}'